@@ -41,6 +41,8 @@
 #include "pipewire/extensions/metadata.h"
 #include "pipewire-jack-extensions.h"
 
+#include "mix-ops.h"
+
 /* use 512KB stack per thread - the default is way too high to be feasible
  * with mlockall() on many systems */
 #define THREAD_STACK 524288
@@ -131,8 +133,6 @@ static thread_local float midi_scratch[MIDI_SCRATCH_FRAMES];
 #define OBJECT_CHUNK		8
 #define RECYCLE_THRESHOLD	128
 
-typedef void (*mix_func) (float *dst, float *src[], uint32_t n_src, bool aligned, uint32_t n_samples);
-
 struct object {
 	struct spa_list link;
 
@@ -478,7 +478,7 @@ struct client {
 
 	uint32_t max_frames;
 	uint32_t max_align;
-	mix_func mix_function;
+	struct mix_ops mix_ops;
 
 	jack_position_t jack_position;
 	jack_transport_state_t jack_state;
@@ -919,44 +919,6 @@ static struct object *find_link(struct client *c, uint32_t src, uint32_t dst)
 	return NULL;
 }
 
-#if defined (__SSE__)
-#include <xmmintrin.h>
-static void mix_sse(float *dst, float *src[], uint32_t n_src, bool aligned, uint32_t n_samples)
-{
-	uint32_t i, n, unrolled;
-	__m128 in[1];
-
-	if (SPA_IS_ALIGNED(dst, 16) && aligned)
-		unrolled = n_samples & ~3;
-	else
-		unrolled = 0;
-
-	for (n = 0; n < unrolled; n += 4) {
-		in[0] = _mm_load_ps(&src[0][n]);
-		for (i = 1; i < n_src; i++)
-			in[0] = _mm_add_ps(in[0], _mm_load_ps(&src[i][n]));
-		_mm_store_ps(&dst[n], in[0]);
-	}
-	for (; n < n_samples; n++) {
-		in[0] = _mm_load_ss(&src[0][n]);
-		for (i = 1; i < n_src; i++)
-			in[0] = _mm_add_ss(in[0], _mm_load_ss(&src[i][n]));
-		_mm_store_ss(&dst[n], in[0]);
-	}
-}
-#endif
-
-static void mix_c(float *dst, float *src[], uint32_t n_src, bool aligned, uint32_t n_samples)
-{
-	uint32_t n, i;
-	for (n = 0; n < n_samples; n++)  {
-		float t = src[0][n];
-		for (i = 1; i < n_src; i++)
-			t += src[i][n];
-		dst[n] = t;
-	}
-}
-
 SPA_EXPORT
 void jack_get_version(int *major_ptr, int *minor_ptr, int *micro_ptr, int *proto_ptr)
 {
@@ -4238,6 +4200,7 @@ jack_client_t * jack_client_open (const char *client_name,
 	struct spa_cpu *cpu_iface;
 	const struct pw_properties *props;
 	va_list ap;
+	int res;
         jack_status_t status;
         if (getenv("PIPEWIRE_NOJACK") != NULL ||
             getenv("PIPEWIRE_INTERNAL") != NULL ||
@@ -4330,18 +4293,22 @@ jack_client_t * jack_client_open (const char *client_name,
 
 	support = pw_context_get_support(client->context.context, &n_support);
 
-	client->mix_function = mix_c;
+	client->mix_ops.fmt = SPA_AUDIO_FORMAT_F32;
+	client->mix_ops.n_channels = 1;
 	cpu_iface = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_CPU);
 	if (cpu_iface) {
-#if defined (__SSE__)
-		uint32_t flags = spa_cpu_get_flags(cpu_iface);
-		if (flags & SPA_CPU_FLAG_SSE)
-			client->mix_function = mix_sse;
-#endif
+		client->mix_ops.cpu_flags = spa_cpu_get_flags(cpu_iface);
 		client->max_align = spa_cpu_get_max_align(cpu_iface);
 	} else {
+		client->mix_ops.cpu_flags = 0;
 		client->max_align = MAX_ALIGN;
 	}
+	if ((res = mix_ops_init(&client->mix_ops)) < 0) {
+		pw_log_error("%p: can't find mix function: %s", client, spa_strerror(res));
+		goto no_props;
+	}
+	pw_log_debug("%p: using mix function with cpu flags %08x", client,
+			client->mix_ops.cpu_flags);
 	client->context.old_thread_utils =
 		pw_context_get_object(client->context.context,
 				SPA_TYPE_INTERFACE_ThreadUtils);
@@ -5748,9 +5715,9 @@ static void *get_buffer_input_float(struct port *p, jack_nframes_t frames)
 	struct mix *mix;
 	struct buffer *b;
 	void *ptr = NULL;
-	float *mix_ptr[MAX_MIX], *np;
+	const void *mix_ptr[MAX_MIX];
+	float *np;
 	uint32_t n_ptr = 0;
-	bool ptr_aligned = true;
 	struct client *c = p->client;
 
 	spa_list_for_each(mix, &p->mix, port_link) {
@@ -5766,18 +5733,15 @@ static void *get_buffer_input_float(struct port *p, jack_nframes_t frames)
 		if ((np = get_buffer_data(b, frames)) == NULL)
 			continue;
 
-		if (!SPA_IS_ALIGNED(np, 16))
-			ptr_aligned = false;
-
 		mix_ptr[n_ptr++] = np;
 		if (n_ptr == MAX_MIX)
 			break;
 	}
 	if (n_ptr == 1) {
-		ptr = mix_ptr[0];
+		ptr = (void*)mix_ptr[0];
 	} else if (n_ptr > 1) {
 		ptr = p->emptyptr;
-		c->mix_function(ptr, mix_ptr, n_ptr, ptr_aligned, frames);
+		mix_ops_process(&c->mix_ops, ptr, mix_ptr, n_ptr, frames);
 		p->zeroed = false;
 	}
 	if (ptr == NULL)
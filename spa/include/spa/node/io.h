@@ -41,6 +41,7 @@ enum spa_io_type {
 	SPA_IO_RateMatch,	/**< rate matching between nodes, struct spa_io_rate_match */
 	SPA_IO_Memory,		/**< memory pointer, struct spa_io_memory (currently not used in PipeWire) */
 	SPA_IO_AsyncBuffers,	/**< async area to exchange buffers, struct spa_io_async_buffers */
+	SPA_IO_Meter,		/**< loudness meter results, struct spa_io_meter */
 };
 
 /**
@@ -387,6 +388,22 @@ struct spa_io_async_buffers {
 						  *  readers read from (cycle)&1 */
 };
 
+/**
+ * Loudness meter results of a node.
+ *
+ * The node updates the results from the data thread, a few times per
+ * second. seq is incremented before and after an update, readers use
+ * SPA_SEQ_READ() to get a consistent copy.
+ */
+struct spa_io_meter {
+	uint32_t seq;			/**< sequence number, odd while updating */
+	uint32_t flags;			/**< extra flags, 0 for now */
+	float momentary;		/**< momentary loudness in LUFS */
+	float short_term;		/**< short-term loudness in LUFS */
+	float true_peak;		/**< maximum true-peak since the previous update in dBTP */
+	uint32_t padding[3];
+};
+
 /**
  * \}
  */
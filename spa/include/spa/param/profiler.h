@@ -54,6 +54,11 @@ enum spa_profiler {
 							  *      Int : driver status,
 							  *      Fraction : latency,
 							  *      Int : xrun_count))  */
+	SPA_PROFILER_workerBlock,			/**< data-pool worker info block
+							  *  (Struct(
+							  *      Int : worker index,
+							  *      String : data loop name,
+							  *      Long : processed count))  */
 
 	SPA_PROFILER_START_Follower	= 0x20000,	/**< follower related profiler properties */
 	SPA_PROFILER_followerBlock,			/**< generic follower info block
@@ -79,6 +84,19 @@ enum spa_profiler {
 							  *      Double : clock rate_diff,
 							  *      Long : clock next_nsec,
 							  *      Long : xrun duration)) */
+	SPA_PROFILER_followerStats,			/**< timing statistics of a node since the
+							  *  profiler started, times in nanoseconds
+							  *  (Struct(
+							  *      Int : id,
+							  *      Long : cycle count,
+							  *      Long : wait p50,
+							  *      Long : wait p99,
+							  *      Long : wait p99.9,
+							  *      Long : wait max,
+							  *      Long : busy p50,
+							  *      Long : busy p99,
+							  *      Long : busy p99.9,
+							  *      Long : busy max)) */
 	SPA_PROFILER_START_CUSTOM	= 0x1000000,
 };
 
@@ -49,6 +49,10 @@ struct spa_system { struct spa_interface iface; };
 #define SPA_IO_OUT	(1 << 2)
 #define SPA_IO_ERR	(1 << 3)
 #define SPA_IO_HUP	(1 << 4)
+/** Wake up only one of the pollers when the fd is added to multiple poll
+ * fds. Can only be used when adding the fd, systems that don't support
+ * this wake up all pollers. Since 1.5.0 */
+#define SPA_IO_EXCLUSIVE	(1u << 28)
 
 /* flags */
 #define SPA_FD_CLOEXEC			(1<<0)
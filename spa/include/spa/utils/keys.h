@@ -88,6 +88,11 @@ extern "C" {
 #define SPA_KEY_API_V4L2		"api.v4l2"			/**< key for the v4l2 api */
 #define SPA_KEY_API_V4L2_PATH		"api.v4l2.path"			/**< v4l2 device path as can be
 									  *  used in open() */
+#define SPA_KEY_API_V4L2_IO_MODE	"api.v4l2.io-mode"		/**< how buffers are exchanged with
+									  *  the driver: "mmap", "mmap-copy",
+									  *  "expbuf", "userptr" or "dmabuf" */
+#define SPA_KEY_API_V4L2_COPY_BYTES	"api.v4l2.copy-bytes"		/**< bytes copied per frame, 0 when
+									  *  the frames are not copied */
 
 /** keys for libcamera api */
 #define SPA_KEY_API_LIBCAMERA		"api.libcamera"			/**< key for the libcamera api */
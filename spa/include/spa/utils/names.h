@@ -25,6 +25,8 @@ extern "C" {
 #define SPA_NAME_SUPPORT_LOOP		"support.loop"			/**< A Loop/LoopControl/LoopUtils
 									  *  interface */
 #define SPA_NAME_SUPPORT_SYSTEM		"support.system"		/**< A System interface */
+#define SPA_NAME_SUPPORT_SYSTEM_IO_URING	"support.system.io-uring"	/**< A System interface that
+									  *  uses io_uring */
 
 #define SPA_NAME_SUPPORT_NODE_DRIVER	"support.node.driver"		/**< A dummy driver node */
 
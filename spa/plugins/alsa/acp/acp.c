@@ -6,9 +6,15 @@
 #include "alsa-mixer.h"
 #include "alsa-ucm.h"
 
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+
 #include <spa/utils/string.h>
 #include <spa/utils/json.h>
 #include <spa/utils/cleanup.h>
+#include <spa/utils/result.h>
 #include <spa/param/audio/iec958-types.h>
 
 int _acp_log_level = 1;
@@ -1773,6 +1779,123 @@ int acp_card_set_profile(struct acp_card *card, uint32_t new_index, uint32_t fla
 	return 0;
 }
 
+static int probe_cache_init(pa_probe_cache *cache, pa_card *impl, const char *profile_set)
+{
+	snd_ctl_t *ctl;
+	snd_ctl_card_info_t *info;
+	struct utsname uts;
+	struct spa_strbuf buf;
+	struct stat st;
+	char name[64];
+	spa_autofree char *fn = NULL;
+	int err;
+
+	snd_ctl_card_info_alloca(&info);
+	snprintf(name, sizeof(name), "hw:%d", impl->card.index);
+	if ((err = snd_ctl_open(&ctl, name, 0)) < 0)
+		return err;
+	err = snd_ctl_card_info(ctl, info);
+	snd_ctl_close(ctl);
+	if (err < 0)
+		return err;
+
+	fn = get_data_path(NULL, "profile-sets", profile_set ? profile_set : "default.conf");
+	if (fn == NULL || stat(fn, &st) < 0)
+		return -errno;
+	if (uname(&uts) < 0)
+		return -errno;
+
+	/* the result of probing depends on the hardware, the kernel driver,
+	 * alsa-lib, the profile-set and the probe rate */
+	spa_strbuf_init(&buf, cache->key, sizeof(cache->key));
+	spa_strbuf_append(&buf, "%d|%s|%s|%s|%s|%s|%s|%s|%lld.%09ld|%u",
+			PA_PROBE_CACHE_VERSION,
+			snd_ctl_card_info_get_id(info),
+			snd_ctl_card_info_get_driver(info),
+			snd_ctl_card_info_get_longname(info),
+			snd_ctl_card_info_get_components(info),
+			uts.release, snd_asoundlib_version(), fn,
+			(long long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec,
+			impl->rate);
+
+	snprintf(name, sizeof(name), "probe-%s.json", snd_ctl_card_info_get_id(info));
+	if ((cache->path = get_state_path(name)) == NULL)
+		return -ENOENT;
+	return 0;
+}
+
+static void probe_profile_set(pa_card *impl, const char *device_id)
+{
+	pa_alsa_profile_set_probe(impl->profile_set, impl->ucm.mixers,
+			device_id,
+			&impl->ucm.default_sample_spec,
+			impl->ucm.default_n_fragments,
+			impl->ucm.default_fragment_size_msec);
+}
+
+static int probe_profile_set_cached(pa_card *impl, const char *profile_set,
+		const char *device_id, const char **result)
+{
+	pa_probe_cache cache;
+	int res;
+
+	spa_zero(cache);
+	if ((res = probe_cache_init(&cache, impl, profile_set)) < 0) {
+		pa_log_debug("card %d: can't use probe cache: %s",
+				impl->card.index, spa_strerror(res));
+		*result = "error";
+		probe_profile_set(impl, device_id);
+		res = 0;
+		goto done;
+	}
+
+	res = pa_probe_cache_load(&cache);
+	if (res >= 0)
+		pa_log_debug("card %d: %d cached probe results in %s",
+				impl->card.index, res, cache.path);
+	else if (res != -ENOENT)
+		pa_log_info("card %d: ignoring probe cache %s: %s",
+				impl->card.index, cache.path, spa_strerror(res));
+
+	/* the profiles that are unsupported in the cache are skipped and the
+	 * results of the others are updated */
+	impl->profile_set->probe_cache = &cache;
+	probe_profile_set(impl, device_id);
+	impl->profile_set->probe_cache = NULL;
+
+	if (res < 0) {
+		*result = "miss";
+	} else if (!pa_probe_cache_stale(&cache)) {
+		*result = "hit";
+	} else {
+		pa_log_info("card %d: probe cache %s is stale, probing again",
+				impl->card.index, cache.path);
+		/* the profiles from the cache were already dropped, start over
+		 * with a fresh profile-set and probe everything */
+		pa_alsa_profile_set_free(impl->profile_set);
+		impl->profile_set = pa_alsa_profile_set_new(profile_set,
+				&impl->ucm.default_channel_map);
+		if (impl->profile_set == NULL) {
+			res = -ENOTSUP;
+			goto done;
+		}
+		impl->profile_set->ignore_dB = impl->ignore_dB;
+		pa_probe_cache_reset(&cache);
+		impl->profile_set->probe_cache = &cache;
+		probe_profile_set(impl, device_id);
+		impl->profile_set->probe_cache = NULL;
+		*result = "stale";
+	}
+	if (pa_probe_cache_changed(&cache) &&
+	    (res = pa_probe_cache_save(&cache)) < 0)
+		pa_log_warn("card %d: can't write probe cache %s: %s",
+				impl->card.index, cache.path, spa_strerror(res));
+	res = 0;
+done:
+	pa_probe_cache_clear(&cache);
+	return res;
+}
+
 static void prune_singleton_availability_groups(pa_hashmap *ports) {
     pa_device_port *p;
     pa_hashmap *group_counts;
@@ -1812,8 +1935,9 @@ struct acp_card *acp_card_new(uint32_t index, const struct acp_dict *props)
 {
 	pa_card *impl;
 	struct acp_card *card;
-	const char *s, *profile_set = NULL, *profile = NULL;
+	const char *s, *profile_set = NULL, *profile = NULL, *cache = "off";
 	char device_id[16];
+	struct timespec ts[2];
 	uint32_t profile_index;
 	int res;
 
@@ -1857,6 +1981,8 @@ struct acp_card *acp_card_new(uint32_t index, const struct acp_dict *props)
 			impl->auto_port = spa_atob(s);
 		if ((s = acp_dict_lookup(props, "api.acp.probe-rate")) != NULL)
 			impl->rate = atoi(s);
+		if ((s = acp_dict_lookup(props, "api.acp.probe-cache")) != NULL)
+			impl->probe_cache = spa_atob(s);
 		if ((s = acp_dict_lookup(props, "api.acp.pro-channels")) != NULL)
 			impl->pro_channels = atoi(s);
 		if ((s = acp_dict_lookup(props, "api.alsa.split-enable")) != NULL)
@@ -1911,11 +2037,19 @@ struct acp_card *acp_card_new(uint32_t index, const struct acp_dict *props)
 
 	impl->profile_set->ignore_dB = impl->ignore_dB;
 
-	pa_alsa_profile_set_probe(impl->profile_set, impl->ucm.mixers,
-			device_id,
-			&impl->ucm.default_sample_spec,
-			impl->ucm.default_n_fragments,
-			impl->ucm.default_fragment_size_msec);
+	clock_gettime(CLOCK_MONOTONIC, &ts[0]);
+	if (impl->probe_cache && !impl->use_ucm) {
+		if ((res = probe_profile_set_cached(impl, profile_set, device_id, &cache)) < 0)
+			goto error;
+	} else {
+		probe_profile_set(impl, device_id);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts[1]);
+
+	pa_log_info("card %d: probed %u profiles in %.3fms (cache:%s)", card->index,
+			pa_hashmap_size(impl->profile_set->profiles),
+			(SPA_TIMESPEC_TO_NSEC(&ts[1]) - SPA_TIMESPEC_TO_NSEC(&ts[0])) / 1000000.0,
+			cache);
 
 	pa_alsa_init_proplist_card(NULL, impl->proplist, impl->card.index);
 	pa_proplist_sets(impl->proplist, PA_PROP_DEVICE_STRING, device_id);
@@ -5073,6 +5073,7 @@ void pa_alsa_profile_set_probe(
 
     for (pp = probe_order; *pp; pp++) {
         uint32_t idx;
+        int err;
         p = *pp;
 
         /* Skip if fallback and already found something, but still probe already selected fallbacks.
@@ -5089,14 +5090,23 @@ void pa_alsa_profile_set_probe(
         /* Skip if this is already marked that it is supported (i.e. from the config file) */
         if (!p->supported) {
 
+            if (ps->probe_cache &&
+                pa_probe_cache_get(ps->probe_cache, p->name) == PA_PROBE_UNSUPPORTED) {
+                pa_log_debug("Skipping profile %s - cached as unsupported", p->name);
+                pa_probe_cache_set(ps->probe_cache, p->name, PA_PROBE_UNSUPPORTED);
+                continue;
+            }
+
             profile_finalize_probing(last, p);
             p->supported = true;
+            err = 0;
 
             if (p->output_mappings) {
                 PA_IDXSET_FOREACH(m, p->output_mappings, idx) {
                     if (pa_hashmap_get(broken_outputs, m) == m) {
                         pa_log_debug("Skipping profile %s - will not be able to open output:%s", p->name, m->name);
                         p->supported = false;
+                        err = m->probe_error;
                         break;
                     }
                 }
@@ -5107,6 +5117,7 @@ void pa_alsa_profile_set_probe(
                     if (pa_hashmap_get(broken_inputs, m) == m) {
                         pa_log_debug("Skipping profile %s - will not be able to open input:%s", p->name, m->name);
                         p->supported = false;
+                        err = m->probe_error;
                         break;
                     }
                 }
@@ -5127,6 +5138,7 @@ void pa_alsa_profile_set_probe(
                                                            SND_PCM_STREAM_PLAYBACK,
                                                            default_n_fragments,
                                                            default_fragment_size_msec))) {
+                        err = m->probe_error = errno;
                         p->supported = false;
                         if (pa_idxset_size(p->output_mappings) == 1 &&
                             ((!p->input_mappings) || pa_idxset_size(p->input_mappings) == 0)) {
@@ -5151,6 +5163,7 @@ void pa_alsa_profile_set_probe(
                                                           SND_PCM_STREAM_CAPTURE,
                                                           default_n_fragments,
                                                           default_fragment_size_msec))) {
+                        err = m->probe_error = errno;
                         p->supported = false;
                         if (pa_idxset_size(p->input_mappings) == 1 &&
                             ((!p->output_mappings) || pa_idxset_size(p->output_mappings) == 0)) {
@@ -5166,11 +5179,19 @@ void pa_alsa_profile_set_probe(
 
             last = p;
 
-            if (!p->supported)
+            if (!p->supported) {
+                /* don't remember failures that might be gone the next time */
+                if (ps->probe_cache)
+                    pa_probe_cache_set(ps->probe_cache, p->name,
+                            pa_probe_error_is_transient(err) ?
+                            PA_PROBE_UNKNOWN : PA_PROBE_UNSUPPORTED);
                 continue;
+            }
         }
 
         pa_log_debug("Profile %s supported.", p->name);
+        if (ps->probe_cache)
+            pa_probe_cache_set(ps->probe_cache, p->name, PA_PROBE_SUPPORTED);
 
         if (p->output_mappings)
             PA_IDXSET_FOREACH(m, p->output_mappings, idx)
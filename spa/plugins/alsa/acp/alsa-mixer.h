@@ -83,6 +83,7 @@ typedef enum pa_alsa_direction {
 #include "alsa-util.h"
 #include "alsa-ucm.h"
 #include "card.h"
+#include "probe-cache.h"
 
 /* A setting combines a couple of options into a single entity that
  * may be selected. Only one setting can be active at the same
@@ -350,6 +351,7 @@ struct pa_alsa_mapping {
     /* Temporarily used during probing */
     snd_pcm_t *input_pcm;
     snd_pcm_t *output_pcm;
+    int probe_error;
 
     pa_proplist *input_proplist;
     pa_proplist *output_proplist;
@@ -421,6 +423,9 @@ struct pa_alsa_profile_set {
     bool auto_profiles;
     bool ignore_dB:1;
     bool probed:1;
+
+    /* Results of a previous probe, updated while probing */
+    pa_probe_cache *probe_cache;
 };
 
 void pa_alsa_mapping_dump(pa_alsa_mapping *m);
@@ -771,6 +771,7 @@ snd_pcm_t *pa_alsa_open_by_device_string(
             pa_log("Device %s has %u channels, but PulseAudio supports only %u channels. Unable to use the device.",
                    d, ss->channels, PA_CHANNELS_MAX);
             pa_alsa_close(&pcm_handle);
+            err = -ENOTSUP;
             goto fail;
         }
 
@@ -788,6 +789,7 @@ snd_pcm_t *pa_alsa_open_by_device_string(
 fail:
     pa_xfree(d);
 
+    errno = -err;
     return NULL;
 }
 
@@ -809,6 +811,7 @@ snd_pcm_t *pa_alsa_open_by_template(
 
     snd_pcm_t *pcm_handle;
     char **i;
+    int err = ENOENT;
 
     for (i = template; *i; i++) {
         char *d;
@@ -830,12 +833,17 @@ snd_pcm_t *pa_alsa_open_by_template(
                 query_supported_rates,
                 require_exact_channel_number);
 
-        pa_xfree(d);
-
-        if (pcm_handle)
+        if (pcm_handle) {
+            pa_xfree(d);
             return pcm_handle;
+        }
+        /* report a transient error when any of the devices had one */
+        if (!pa_probe_error_is_transient(err))
+            err = errno;
+        pa_xfree(d);
     }
 
+    errno = err;
     return NULL;
 }
 
@@ -49,6 +49,7 @@ struct pa_card {
 	bool auto_port;
 	bool ignore_dB;
 	bool disable_pro_audio;
+	bool probe_cache;
 	uint32_t rate;
 	uint32_t pro_channels;
 
@@ -286,3 +286,14 @@ char *get_data_path(const char *data_dir, const char *data_type, const char *fna
     spa_autofree char *path = spa_aprintf("%s/%s", PA_ALSA_DATA_DIR, data_type);
     return pa_maybe_prefix_path(fname, path);
 }
+
+char *get_state_path(const char *fname)
+{
+    spa_autofree char *base = NULL;
+
+    base = get_xdg_home("XDG_STATE_HOME", ".local/state");
+    if (base == NULL)
+	return NULL;
+
+    return spa_aprintf("%s/alsa-card-profile/%s", base, fname);
+}
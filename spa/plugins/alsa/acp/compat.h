@@ -701,6 +701,7 @@ static inline char *pa_readlink(const char *p) {
 }
 
 char *get_data_path(const char *data_dir, const char *data_type, const char *fname);
+char *get_state_path(const char *fname);
 
 #include <spa/support/i18n.h>
 
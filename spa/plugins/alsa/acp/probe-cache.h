@@ -0,0 +1,267 @@
+/* ALSA Card Profile */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef PA_PROBE_CACHE_H
+#define PA_PROBE_CACHE_H
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <spa/utils/json.h>
+#include <spa/utils/string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PA_PROBE_CACHE_VERSION	2
+#define PA_PROBE_CACHE_MAX_SIZE	(64 * 1024)
+
+typedef enum pa_probe_result {
+	PA_PROBE_UNKNOWN,		/**< not probed or failed with a transient error */
+	PA_PROBE_SUPPORTED,
+	PA_PROBE_UNSUPPORTED,
+} pa_probe_result;
+
+typedef struct pa_probe_cache_entry {
+	char *name;
+	pa_probe_result cached;		/**< the result in the cache file */
+	pa_probe_result result;		/**< the result of this probe */
+} pa_probe_cache_entry;
+
+typedef struct pa_probe_cache {
+	char *path;
+	char key[1024];
+	pa_probe_cache_entry *entries;
+	uint32_t n_entries;
+} pa_probe_cache;
+
+/* Only errors that will be the same the next time the device is opened
+ * make a profile unsupported in the cache. A busy device, missing
+ * permissions or a lack of memory do not. */
+static inline bool pa_probe_error_is_transient(int err)
+{
+	switch (err) {
+	case ENOENT:
+	case ENODEV:
+	case ENXIO:
+	case EINVAL:
+	case ENOTSUP:
+		return false;
+	default:
+		return true;
+	}
+}
+
+static inline pa_probe_cache_entry *pa_probe_cache_find(pa_probe_cache *c, const char *name)
+{
+	uint32_t i;
+	for (i = 0; i < c->n_entries; i++) {
+		if (spa_streq(c->entries[i].name, name))
+			return &c->entries[i];
+	}
+	return NULL;
+}
+
+static inline pa_probe_cache_entry *pa_probe_cache_add(pa_probe_cache *c, const char *name)
+{
+	pa_probe_cache_entry *e, *entries;
+
+	if ((e = pa_probe_cache_find(c, name)) != NULL)
+		return e;
+
+	entries = realloc(c->entries, (c->n_entries + 1) * sizeof(*entries));
+	if (entries == NULL)
+		return NULL;
+	c->entries = entries;
+
+	e = &c->entries[c->n_entries];
+	if ((e->name = strdup(name)) == NULL)
+		return NULL;
+	e->cached = e->result = PA_PROBE_UNKNOWN;
+	c->n_entries++;
+	return e;
+}
+
+/** The result of a previous probe */
+static inline pa_probe_result pa_probe_cache_get(pa_probe_cache *c, const char *name)
+{
+	pa_probe_cache_entry *e = pa_probe_cache_find(c, name);
+	return e ? e->cached : PA_PROBE_UNKNOWN;
+}
+
+/** Set the result of this probe */
+static inline void pa_probe_cache_set(pa_probe_cache *c, const char *name, pa_probe_result result)
+{
+	pa_probe_cache_entry *e = pa_probe_cache_add(c, name);
+	if (e != NULL)
+		e->result = result;
+}
+
+/** Something that was supported before is not supported now, the state
+ * of the device changed and the cached results can't be trusted */
+static inline bool pa_probe_cache_stale(pa_probe_cache *c)
+{
+	uint32_t i;
+	for (i = 0; i < c->n_entries; i++) {
+		if (c->entries[i].cached == PA_PROBE_SUPPORTED &&
+		    c->entries[i].result != PA_PROBE_SUPPORTED)
+			return true;
+	}
+	return false;
+}
+
+static inline bool pa_probe_cache_changed(pa_probe_cache *c)
+{
+	uint32_t i;
+	for (i = 0; i < c->n_entries; i++) {
+		if (c->entries[i].cached != c->entries[i].result)
+			return true;
+	}
+	return false;
+}
+
+/** Forget all results, for probing again without the cache */
+static inline void pa_probe_cache_reset(pa_probe_cache *c)
+{
+	uint32_t i;
+	for (i = 0; i < c->n_entries; i++)
+		c->entries[i].cached = c->entries[i].result = PA_PROBE_UNKNOWN;
+}
+
+static inline void pa_probe_cache_clear(pa_probe_cache *c)
+{
+	uint32_t i;
+	for (i = 0; i < c->n_entries; i++)
+		free(c->entries[i].name);
+	free(c->entries);
+	free(c->path);
+	c->entries = NULL;
+	c->n_entries = 0;
+	c->path = NULL;
+}
+
+/** Load the results of the previous probe, returns the number of results,
+ * -ESTALE when the cache was made for something else or a negative errno */
+static inline int pa_probe_cache_load(pa_probe_cache *c)
+{
+	struct spa_json it[2];
+	char key[sizeof(c->key)], *data;
+	const char *val;
+	pa_probe_cache_entry *e;
+	size_t len = 0;
+	FILE *f;
+	int l, res = 0;
+	bool supported;
+
+	if ((f = fopen(c->path, "re")) == NULL)
+		return -errno;
+	if ((data = malloc(PA_PROBE_CACHE_MAX_SIZE)) != NULL)
+		len = fread(data, 1, PA_PROBE_CACHE_MAX_SIZE, f);
+	fclose(f);
+	if (len == 0 || len == PA_PROBE_CACHE_MAX_SIZE) {
+		res = -EINVAL;
+		goto done;
+	}
+
+	if (spa_json_str_object_find(data, len, "key", key, sizeof(key)) <= 0 ||
+	    !spa_streq(key, c->key)) {
+		res = -ESTALE;
+		goto done;
+	}
+
+	if (spa_json_begin_object(&it[0], data, len) <= 0) {
+		res = -EINVAL;
+		goto done;
+	}
+	while ((l = spa_json_object_next(&it[0], key, sizeof(key), &val)) > 0) {
+		if (spa_streq(key, "profiles") && spa_json_is_object(val, l))
+			break;
+	}
+	if (l <= 0) {
+		res = -EINVAL;
+		goto done;
+	}
+	spa_json_enter(&it[0], &it[1]);
+
+	while ((l = spa_json_object_next(&it[1], key, sizeof(key), &val)) > 0) {
+		if (spa_json_parse_bool(val, l, &supported) <= 0)
+			continue;
+		if ((e = pa_probe_cache_add(c, key)) == NULL) {
+			res = -errno;
+			goto done;
+		}
+		e->cached = supported ? PA_PROBE_SUPPORTED : PA_PROBE_UNSUPPORTED;
+		res++;
+	}
+done:
+	free(data);
+	return res;
+}
+
+static inline int pa_probe_cache_mkdir(char *path)
+{
+	char *p;
+
+	for (p = strchr(path + 1, '/'); p; p = strchr(p + 1, '/')) {
+		*p = '\0';
+		if (mkdir(path, 0700) < 0 && errno != EEXIST) {
+			*p = '/';
+			return -errno;
+		}
+		*p = '/';
+	}
+	return 0;
+}
+
+/** Write the known results of this probe to the cache file */
+static inline int pa_probe_cache_save(pa_probe_cache *c)
+{
+	char tmp[PATH_MAX], enc[sizeof(c->key) * 2];
+	uint32_t i;
+	FILE *f;
+	int res;
+	bool first = true;
+
+	if ((res = pa_probe_cache_mkdir(c->path)) < 0)
+		return res;
+
+	if (spa_scnprintf(tmp, sizeof(tmp), "%s.tmp", c->path) <= 0)
+		return -ENAMETOOLONG;
+	if ((f = fopen(tmp, "we")) == NULL)
+		return -errno;
+
+	spa_json_encode_string(enc, sizeof(enc), c->key);
+	fprintf(f, "{ \"key\": %s,\n  \"profiles\": {", enc);
+	for (i = 0; i < c->n_entries; i++) {
+		pa_probe_cache_entry *e = &c->entries[i];
+		if (e->result == PA_PROBE_UNKNOWN)
+			continue;
+		spa_json_encode_string(enc, sizeof(enc), e->name);
+		fprintf(f, "%s\n    %s: %s", first ? "" : ",", enc,
+				e->result == PA_PROBE_SUPPORTED ? "true" : "false");
+		first = false;
+	}
+	fprintf(f, "\n  }\n}\n");
+
+	if (fclose(f) != 0 || rename(tmp, c->path) < 0) {
+		res = -errno;
+		unlink(tmp);
+		return res;
+	}
+	return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PA_PROBE_CACHE_H */
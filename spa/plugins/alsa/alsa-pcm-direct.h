@@ -0,0 +1,68 @@
+/* Spa ALSA direct render */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef SPA_ALSA_PCM_DIRECT_H
+#define SPA_ALSA_PCM_DIRECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Sort the \a n_buffers buffer \a ids by \a seq, the order in which they
+ * were given to the producer. The producer takes its free buffers in that
+ * order, so this is the order in which they will be rendered. */
+static inline void spa_alsa_direct_order(uint64_t *seq, uint32_t *ids, uint32_t n_buffers)
+{
+	uint32_t i, j;
+
+	for (i = 1; i < n_buffers; i++) {
+		uint64_t s = seq[i];
+		uint32_t id = ids[i];
+		for (j = i; j > 0 && seq[j-1] > s; j--) {
+			seq[j] = seq[j-1];
+			ids[j] = ids[j-1];
+		}
+		seq[j] = s;
+		ids[j] = id;
+	}
+}
+
+/** Place the free buffers one after the other in the contiguous free area of
+ * the mmap ring of \a avail frames. Buffer i needs \a need[i] frames and gets
+ * the area at \a offset[i] frames from the start of the free area. The areas
+ * don't overlap, so the producer can render into several buffers before they
+ * are written. Returns the number of buffers that fit, the others need to
+ * use their own memory. */
+static inline uint32_t spa_alsa_direct_place(uint64_t avail, const uint32_t *need,
+		uint32_t n_buffers, uint64_t *offset)
+{
+	uint64_t pos = 0;
+	uint32_t i;
+
+	for (i = 0; i < n_buffers; i++) {
+		if (need[i] == 0 || need[i] > avail - pos)
+			break;
+		offset[i] = pos;
+		pos += need[i];
+	}
+	return i;
+}
+
+/** Check if the area of \a frames at ring \a offset overlaps the area of
+ * \a write_frames at \a write_offset, which is about to be overwritten. */
+static inline bool spa_alsa_direct_overlaps(uint64_t offset, uint64_t frames,
+		uint64_t write_offset, uint64_t write_frames)
+{
+	return frames > 0 && write_frames > 0 &&
+		offset < write_offset + write_frames && write_offset < offset + frames;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPA_ALSA_PCM_DIRECT_H */
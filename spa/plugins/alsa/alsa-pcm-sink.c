@@ -723,8 +723,10 @@ impl_node_port_use_buffers(void *object,
 		b->buf = buffers[i];
 		b->id = i;
 		b->flags = BUFFER_FLAG_OUT;
+		b->seq = i;
 
 		b->h = spa_buffer_find_meta_data(b->buf, SPA_META_Header, sizeof(*b->h));
+		spa_alsa_init_buffer(this, b);
 
 		if (d[0].data == NULL) {
 			spa_log_error(this->log, "%p: need mapped memory", this);
@@ -733,6 +735,7 @@ impl_node_port_use_buffers(void *object,
 		spa_log_debug(this->log, "%p: %d %p data:%p", this, i, b->buf, d[0].data);
 	}
 	this->n_buffers = n_buffers;
+	this->out_seq = n_buffers;
 
 	return 0;
 }
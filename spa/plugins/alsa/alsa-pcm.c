@@ -17,6 +17,7 @@
 #include <spa/monitor/device.h>
 
 #include "alsa-pcm.h"
+#include "alsa-pcm-direct.h"
 
 static struct spa_list cards = SPA_LIST_INIT(&cards);
 static struct spa_list states = SPA_LIST_INIT(&states);
@@ -206,6 +207,8 @@ static int alsa_set_param(struct state *state, const char *k, const char *s)
 		state->props.use_chmap = spa_atob(s);
 	} else if (spa_streq(k, "api.alsa.multi-rate")) {
 		state->multi_rate = spa_atob(s);
+	} else if (spa_streq(k, "api.alsa.direct-render")) {
+		state->direct_render = spa_atob(s);
 	} else if (spa_streq(k, "api.alsa.htimestamp")) {
 		state->htimestamp = spa_atob(s);
 	} else if (spa_streq(k, "api.alsa.htimestamp.max-errors")) {
@@ -505,9 +508,17 @@ struct spa_pod *spa_alsa_enum_propinfo(struct state *state,
 			SPA_PROP_INFO_type, SPA_POD_CHOICE_RANGE_Int(state->htimestamp_max_errors, 0, INT32_MAX),
 			SPA_PROP_INFO_params, SPA_POD_Bool(true));
 		break;
+	case 19:
+		param = spa_pod_builder_add_object(b,
+			SPA_TYPE_OBJECT_PropInfo, SPA_PARAM_PropInfo,
+			SPA_PROP_INFO_name, SPA_POD_String("api.alsa.direct-render"),
+			SPA_PROP_INFO_description, SPA_POD_String("Render directly into the MMAP buffer"),
+			SPA_PROP_INFO_type, SPA_POD_CHOICE_Bool(state->direct_render),
+			SPA_PROP_INFO_params, SPA_POD_Bool(true));
+		break;
 	// While adding params here, update the math in default too
 	default:
-		idx -= 18;
+		idx -= 19;
 		if (idx <= state->num_bind_ctls)
 			param = enum_bind_ctl_propinfo(state, idx - 1, b);
 		else
@@ -648,6 +659,9 @@ int spa_alsa_add_prop_params(struct state *state, struct spa_pod_builder *b)
 	spa_pod_builder_string(b, "api.alsa.htimestamp.max-errors");
 	spa_pod_builder_int(b, state->htimestamp_max_errors);
 
+	spa_pod_builder_string(b, "api.alsa.direct-render");
+	spa_pod_builder_bool(b, state->direct_render);
+
 	spa_pod_builder_string(b, "latency.internal.rate");
 	spa_pod_builder_int(b, state->process_latency.rate);
 
@@ -1036,6 +1050,12 @@ int spa_alsa_init(struct state *state, const struct spa_dict *info)
 		state->is_hdmi = spa_strstartswith(state->props.device, "hdmi");
 		state->iec958_codecs |= 1ULL << SPA_AUDIO_IEC958_CODEC_PCM;
 	}
+	/* let the peer render into the mmap ring. Captured samples are always
+	 * copied, the ring memory is given back to the device on commit,
+	 * before the peer is done with it. */
+	if (state->direct_render && !state->disable_mmap &&
+	    state->stream == SND_PCM_STREAM_PLAYBACK)
+		state->port_info.flags |= SPA_PORT_FLAG_DYNAMIC_DATA;
 
 	state->card = ensure_card(state->card_index, state->open_ucm, state->is_split_parent);
 
@@ -2484,6 +2504,130 @@ static int set_timeout(struct state *state, uint64_t time)
 	return 0;
 }
 
+void spa_alsa_init_buffer(struct state *state, struct buffer *b)
+{
+	struct spa_data *d = b->buf->datas;
+	uint32_t i;
+
+	for (i = 0; i < SPA_MIN(b->buf->n_datas, SPA_AUDIO_MAX_CHANNELS); i++)
+		b->data[i] = d[i].data;
+	b->maxsize = d[0].maxsize;
+	SPA_FLAG_CLEAR(b->flags, BUFFER_FLAG_DIRECT);
+}
+
+static inline bool buffer_can_direct(struct state *state, struct buffer *b)
+{
+	return state->direct_render && state->use_mmap &&
+		b->buf->n_datas <= SPA_AUDIO_MAX_CHANNELS &&
+		SPA_FLAG_IS_SET(b->buf->datas[0].flags, SPA_DATA_FLAG_DYNAMIC);
+}
+
+/* Point the buffer back to its own memory. When keep is set, the chunk that
+ * was rendered into the mmap ring is copied along. */
+static void buffer_detach(struct state *state, struct buffer *b, bool keep)
+{
+	struct spa_data *d = b->buf->datas;
+	uint32_t i, offs = 0, size = 0;
+
+	if (!SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_DIRECT))
+		return;
+
+	if (keep) {
+		offs = SPA_MIN(d[0].chunk->offset, d[0].maxsize);
+		size = SPA_MIN(d[0].chunk->size, d[0].maxsize - offs);
+	}
+	for (i = 0; i < b->buf->n_datas; i++) {
+		if (size > 0)
+			memcpy(SPA_PTROFF(b->data[i], offs, void),
+					SPA_PTROFF(d[i].data, offs, void), size);
+		d[i].data = b->data[i];
+		d[i].maxsize = b->maxsize;
+	}
+	SPA_FLAG_CLEAR(b->flags, BUFFER_FLAG_DIRECT);
+}
+
+static void buffers_detach(struct state *state, bool keep)
+{
+	uint32_t i;
+	for (i = 0; i < state->n_buffers; i++) {
+		struct buffer *b = &state->buffers[i];
+		buffer_detach(state, b, keep && !SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_OUT));
+	}
+}
+
+/* Copy the rendered buffers that have an area in the part of the mmap ring
+ * that is about to be overwritten out of the ring. The buffers of the
+ * producer simply go back to their own memory. */
+static void buffers_detach_range(struct state *state, struct buffer *skip,
+		snd_pcm_uframes_t offset, snd_pcm_uframes_t frames)
+{
+	uint32_t i;
+	for (i = 0; i < state->n_buffers; i++) {
+		struct buffer *b = &state->buffers[i];
+		if (b == skip || !SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_DIRECT) ||
+		    !spa_alsa_direct_overlaps(b->direct_offset, b->direct_frames, offset, frames))
+			continue;
+		buffer_detach(state, b, !SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_OUT));
+	}
+}
+
+/* Let the buffers that are free for the producer point to the free area of
+ * the mmap ring so that the producer renders directly into it and the copy in
+ * alsa_write_frames() can be skipped. Each buffer gets an area of one cycle,
+ * in the order in which the producer will take the buffers. The buffers that
+ * don't fit use their own memory and the samples are copied as usual. */
+static void buffers_attach(struct state *state)
+{
+	const snd_pcm_channel_area_t *my_areas;
+	snd_pcm_uframes_t frames, offset;
+	uint32_t ids[MAX_BUFFERS], need[MAX_BUFFERS];
+	uint64_t seq[MAX_BUFFERS], offs[MAX_BUFFERS];
+	uint32_t i, j, size, n_bufs = 0, n_placed = 0;
+
+	/* the producer renders one cycle into each buffer */
+	size = state->read_size > 0 ? state->read_size : state->threshold;
+
+	for (i = 0; i < state->n_buffers; i++) {
+		struct buffer *b = &state->buffers[i];
+
+		if (!SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_OUT))
+			continue;
+		if (!buffer_can_direct(state, b) || size == 0 ||
+		    size > b->maxsize / state->frame_size) {
+			buffer_detach(state, b, false);
+			continue;
+		}
+		ids[n_bufs] = i;
+		seq[n_bufs] = b->seq;
+		need[n_bufs++] = size;
+	}
+	if (n_bufs == 0)
+		return;
+
+	spa_alsa_direct_order(seq, ids, n_bufs);
+
+	frames = state->buffer_frames;
+	if (SPA_LIKELY(snd_pcm_mmap_begin(state->hndl, &my_areas, &offset, &frames) >= 0))
+		n_placed = spa_alsa_direct_place(frames, need, n_bufs, offs);
+
+	for (i = 0; i < n_bufs; i++) {
+		struct buffer *b = &state->buffers[ids[i]];
+		struct spa_data *d = b->buf->datas;
+
+		if (i >= n_placed) {
+			buffer_detach(state, b, false);
+			continue;
+		}
+		b->direct_offset = offset + offs[i];
+		b->direct_frames = need[i];
+		for (j = 0; j < b->buf->n_datas; j++) {
+			d[j].data = channel_area_addr(&my_areas[j], b->direct_offset);
+			d[j].maxsize = need[i] * state->frame_size;
+		}
+		SPA_FLAG_SET(b->flags, BUFFER_FLAG_DIRECT);
+	}
+}
+
 static int spa_alsa_silence(struct state *state, snd_pcm_uframes_t silence)
 {
 	snd_pcm_t *hndl = state->hndl;
@@ -2492,6 +2636,9 @@ static int spa_alsa_silence(struct state *state, snd_pcm_uframes_t silence)
 	int i, res;
 
 	if (state->use_mmap) {
+		/* the silence overwrites what was rendered in the ring */
+		buffers_detach(state, true);
+
 		frames = state->buffer_frames;
 
 		if (SPA_UNLIKELY((res = snd_pcm_mmap_begin(hndl, &my_areas, &offset, &frames)) < 0)) {
@@ -2536,8 +2683,10 @@ static void reset_buffers(struct state *this)
 
 	for (i = 0; i < this->n_buffers; i++) {
 		struct buffer *b = &this->buffers[i];
+		buffer_detach(this, b, false);
 		if (this->stream == SND_PCM_STREAM_PLAYBACK) {
 			SPA_FLAG_SET(b->flags, BUFFER_FLAG_OUT);
+			b->seq = this->out_seq++;
 			spa_node_call_reuse_buffer(&this->callbacks, 0, b->id);
 		} else {
 			spa_list_append(&this->free, &b->link);
@@ -3092,9 +3241,27 @@ again:
 		n_bytes = n_frames * frame_size;
 
 		if (SPA_LIKELY(state->use_mmap)) {
-			for (i = 0; i < b->buf->n_datas; i++) {
-				spa_memcpy(channel_area_addr(&my_areas[i], off),
-						SPA_PTROFF(d[i].data, offs, void), n_bytes);
+			bool in_ring = SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_DIRECT);
+
+			if (in_ring &&
+			    SPA_PTROFF(d[0].data, offs, void) == channel_area_addr(&my_areas[0], off)) {
+				/* rendered in place */
+			} else {
+				/* the samples overwrite the areas of the other
+				 * buffers, copy the ones in the way out of the
+				 * ring first */
+				if (state->direct_render)
+					buffers_detach_range(state, b, off, n_frames);
+
+				for (i = 0; i < b->buf->n_datas; i++) {
+					/* the buffer can overlap the write position */
+					if (in_ring)
+						memmove(channel_area_addr(&my_areas[i], off),
+								SPA_PTROFF(d[i].data, offs, void), n_bytes);
+					else
+						spa_memcpy(channel_area_addr(&my_areas[i], off),
+								SPA_PTROFF(d[i].data, offs, void), n_bytes);
+				}
 			}
 		} else {
 			void *bufs[b->buf->n_datas];
@@ -3111,7 +3278,10 @@ again:
 
 		if (state->ready_offset >= last_offset) {
 			spa_list_remove(&b->link);
+			/* the area is written, the next one is given by buffers_attach() */
+			buffer_detach(state, b, false);
 			SPA_FLAG_SET(b->flags, BUFFER_FLAG_OUT);
+			b->seq = state->out_seq++;
 			state->io->buffer_id = b->id;
 			spa_log_trace_fp(state->log, "%p: reuse buffer %u", state, b->id);
 
@@ -3143,6 +3313,8 @@ again:
 			spa_log_warn(state->log, "%s: mmap_commit wrote %ld instead of %ld",
 				     state->name, commitres, written);
 		}
+		if (state->direct_render && spa_list_is_empty(&state->ready))
+			buffers_attach(state);
 	}
 
 	if (!spa_list_is_empty(&state->ready) && written > 0)
@@ -3651,6 +3823,7 @@ static int do_state_sync(struct spa_loop *loop, bool async, uint32_t seq,
 		if (!state->disable_tsched)
 			set_timeout(state, 0);
 		remove_sources(state);
+		buffers_detach(state, true);
 	}
 	return 0;
 }
@@ -59,9 +59,18 @@ struct props {
 struct buffer {
 	uint32_t id;
 #define BUFFER_FLAG_OUT	(1<<0)
+#define BUFFER_FLAG_DIRECT	(1<<1)
 	uint32_t flags;
 	struct spa_buffer *buf;
 	struct spa_meta_header *h;
+	/* the memory of the buffer when it is not rendering into the mmap ring */
+	void *data[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t maxsize;
+	/* order in which the producer got the buffer, for playback */
+	uint64_t seq;
+	/* the area in the mmap ring, in frames, when BUFFER_FLAG_DIRECT */
+	uint32_t direct_offset;
+	uint32_t direct_frames;
 	struct spa_list link;
 };
 
@@ -153,6 +162,7 @@ struct state {
 	unsigned int disable_mmap:1;
 	unsigned int disable_batch:1;
 	unsigned int disable_tsched:1;
+	unsigned int direct_render:1;
 	unsigned int is_split_parent:1;
 	char clock_name[64];
 	uint32_t quantum_limit;
@@ -193,6 +203,7 @@ struct state {
 	struct spa_list ready;
 
 	size_t ready_offset;
+	uint64_t out_seq;
 
 	/* Either a single source for tsched, or a set of pollfds from ALSA */
 	struct spa_source source[MAX_POLL];
@@ -303,6 +314,7 @@ int spa_alsa_write(struct state *state);
 int spa_alsa_read(struct state *state);
 int spa_alsa_skip(struct state *state);
 
+void spa_alsa_init_buffer(struct state *state, struct buffer *b);
 void spa_alsa_recycle_buffer(struct state *state, uint32_t buffer_id);
 
 void spa_alsa_emit_node_info(struct state *state, bool full);
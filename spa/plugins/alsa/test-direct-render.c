@@ -0,0 +1,284 @@
+/* Spa ALSA direct render test */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <spa/utils/defs.h>
+
+#include "alsa-pcm-direct.h"
+
+static void test_place(void)
+{
+	uint32_t need[] = { 1024, 1024, 512, 2048 };
+	uint64_t offset[SPA_N_ELEMENTS(need)];
+	uint32_t i;
+
+	/* all buffers fit, one after the other */
+	spa_assert_se(spa_alsa_direct_place(8192, need, 4, offset) == 4);
+	spa_assert_se(offset[0] == 0);
+	spa_assert_se(offset[1] == 1024);
+	spa_assert_se(offset[2] == 2048);
+	spa_assert_se(offset[3] == 2560);
+
+	/* the areas never overlap */
+	for (i = 1; i < 4; i++)
+		spa_assert_se(offset[i] >= offset[i-1] + need[i-1]);
+
+	/* exactly the free area */
+	spa_assert_se(spa_alsa_direct_place(4608, need, 4, offset) == 4);
+	spa_assert_se(offset[3] + need[3] == 4608);
+}
+
+static void test_place_partial(void)
+{
+	uint32_t need[] = { 1024, 1024, 1024 };
+	uint64_t offset[SPA_N_ELEMENTS(need)];
+
+	/* the buffers that don't fit use their own memory */
+	spa_assert_se(spa_alsa_direct_place(2500, need, 3, offset) == 2);
+	spa_assert_se(offset[0] == 0);
+	spa_assert_se(offset[1] == 1024);
+
+	spa_assert_se(spa_alsa_direct_place(1023, need, 3, offset) == 0);
+	spa_assert_se(spa_alsa_direct_place(0, need, 3, offset) == 0);
+	spa_assert_se(spa_alsa_direct_place(4096, need, 0, offset) == 0);
+}
+
+static void test_place_empty(void)
+{
+	uint32_t need[] = { 1024, 0, 1024 };
+	uint64_t offset[SPA_N_ELEMENTS(need)];
+
+	/* a buffer without room for a frame stops the placement */
+	spa_assert_se(spa_alsa_direct_place(4096, need, 3, offset) == 1);
+}
+
+static void test_order(void)
+{
+	uint64_t seq[] = { 7, 4, 9, 5 };
+	uint32_t ids[] = { 0, 1, 2, 3 };
+
+	/* the producer takes the buffers it got back first */
+	spa_alsa_direct_order(seq, ids, 4);
+	spa_assert_se(ids[0] == 1);
+	spa_assert_se(ids[1] == 3);
+	spa_assert_se(ids[2] == 0);
+	spa_assert_se(ids[3] == 2);
+	spa_assert_se(seq[0] == 4 && seq[3] == 9);
+}
+
+static void test_overlaps(void)
+{
+	spa_assert_se(spa_alsa_direct_overlaps(256, 256, 0, 512));
+	spa_assert_se(spa_alsa_direct_overlaps(256, 256, 500, 10));
+	spa_assert_se(!spa_alsa_direct_overlaps(256, 256, 0, 256));
+	spa_assert_se(!spa_alsa_direct_overlaps(256, 256, 512, 256));
+	spa_assert_se(!spa_alsa_direct_overlaps(256, 0, 0, 1024));
+}
+
+/* The write path of the sink with a ring that is consumed as soon as it is
+ * committed, like in alsa_write_frames() and buffers_attach(). The producer
+ * takes its free buffers in the order it got them back. */
+#define RING		1024
+#define QUANTUM		256
+#define MAXSIZE		8192
+#define N_BUFFERS	4
+
+struct sim_buffer {
+	uint32_t id;
+	uint64_t seq;
+	bool out;
+	bool direct;
+	uint32_t offset;
+	uint32_t frames;
+	float *data;
+	uint32_t size;
+	float mem[MAXSIZE];
+};
+
+struct sim {
+	float ring[RING];
+	uint32_t pos;
+	struct sim_buffer buffers[N_BUFFERS];
+	uint64_t out_seq;
+
+	uint32_t queue[N_BUFFERS];	/* free buffers of the producer */
+	uint32_t n_queue;
+	uint32_t ready[N_BUFFERS];
+	uint32_t n_ready;
+
+	float next;			/* next sample of the producer */
+	float played;			/* next sample expected from the ring */
+	uint32_t in_place;
+	uint32_t copied;		/* bytes copied out of the ring */
+};
+
+static void sim_detach(struct sim *s, struct sim_buffer *b, bool keep)
+{
+	if (!b->direct)
+		return;
+	if (keep) {
+		memcpy(b->mem, b->data, b->size * sizeof(float));
+		s->copied += b->size * sizeof(float);
+	}
+	b->data = b->mem;
+	b->direct = false;
+}
+
+static void sim_attach(struct sim *s)
+{
+	uint32_t ids[N_BUFFERS], need[N_BUFFERS], i, n = 0, n_placed;
+	uint64_t seq[N_BUFFERS], offs[N_BUFFERS];
+
+	for (i = 0; i < N_BUFFERS; i++) {
+		if (!s->buffers[i].out)
+			continue;
+		ids[n] = i;
+		seq[n] = s->buffers[i].seq;
+		need[n++] = QUANTUM;
+	}
+	spa_alsa_direct_order(seq, ids, n);
+	n_placed = spa_alsa_direct_place(RING - s->pos, need, n, offs);
+
+	for (i = 0; i < n; i++) {
+		struct sim_buffer *b = &s->buffers[ids[i]];
+		if (i >= n_placed) {
+			sim_detach(s, b, false);
+			continue;
+		}
+		b->offset = s->pos + offs[i];
+		b->frames = need[i];
+		b->data = &s->ring[b->offset];
+		b->direct = true;
+	}
+}
+
+static void sim_render(struct sim *s, uint32_t index)
+{
+	struct sim_buffer *b = &s->buffers[s->queue[index]];
+	uint32_t i;
+
+	memmove(&s->queue[index], &s->queue[index + 1], (--s->n_queue - index) * sizeof(uint32_t));
+	for (i = 0; i < QUANTUM; i++)
+		b->data[i] = s->next++;
+	b->size = QUANTUM;
+	b->out = false;
+	s->ready[s->n_ready++] = b->id;
+}
+
+static void sim_write(struct sim *s)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < s->n_ready; i++) {
+		struct sim_buffer *b = &s->buffers[s->ready[i]];
+
+		if (b->direct && b->data == &s->ring[s->pos]) {
+			s->in_place++;
+		} else {
+			for (j = 0; j < N_BUFFERS; j++) {
+				struct sim_buffer *o = &s->buffers[j];
+				if (o != b && o->direct &&
+				    spa_alsa_direct_overlaps(o->offset, o->frames, s->pos, b->size))
+					sim_detach(s, o, !o->out);
+			}
+			memmove(&s->ring[s->pos], b->data, b->size * sizeof(float));
+		}
+		/* commit, the device plays the samples */
+		for (j = 0; j < b->size; j++)
+			spa_assert_se(s->ring[s->pos + j] == s->played++);
+		s->pos = (s->pos + b->size) % RING;
+
+		/* reuse */
+		sim_detach(s, b, false);
+		b->out = true;
+		b->seq = s->out_seq++;
+		s->queue[s->n_queue++] = b->id;
+	}
+	s->n_ready = 0;
+	sim_attach(s);
+}
+
+static void sim_init(struct sim *s)
+{
+	uint32_t i;
+
+	memset(s, 0, sizeof(*s));
+	for (i = 0; i < N_BUFFERS; i++) {
+		struct sim_buffer *b = &s->buffers[i];
+		b->id = i;
+		b->seq = i;
+		b->out = true;
+		b->data = b->mem;
+		s->queue[s->n_queue++] = i;
+	}
+	s->out_seq = N_BUFFERS;
+	sim_attach(s);
+}
+
+static void test_write(void)
+{
+	static struct sim s;
+	uint32_t i;
+
+	sim_init(&s);
+
+	/* the buffers are placed by the quantum, not by their size */
+	for (i = 0; i < N_BUFFERS; i++) {
+		spa_assert_se(s.buffers[i].direct);
+		spa_assert_se(s.buffers[i].offset == i * QUANTUM);
+	}
+
+	/* the producer renders one or two cycles ahead and always takes the
+	 * buffer at the write position */
+	for (i = 0; i < 64; i++) {
+		sim_render(&s, 0);
+		if (i % 3 == 0)
+			sim_render(&s, 0);
+		sim_write(&s);
+	}
+	spa_assert_se(s.copied == 0);
+	spa_assert_se(s.in_place > 64);
+}
+
+static void test_write_out_of_order(void)
+{
+	static struct sim s;
+	uint32_t i;
+
+	sim_init(&s);
+	for (i = 0; i < 8; i++) {
+		sim_render(&s, 0);
+		sim_write(&s);
+	}
+
+	/* the producer takes the second buffer first: the first one is
+	 * written over the area of the second one, which is copied out of
+	 * the ring first, and only its chunk */
+	sim_render(&s, 1);
+	sim_render(&s, 0);
+	sim_write(&s);
+	spa_assert_se(s.copied == QUANTUM * sizeof(float));
+
+	/* and the buffers are in the right place again */
+	s.copied = 0;
+	for (i = 0; i < 8; i++) {
+		sim_render(&s, 0);
+		sim_write(&s);
+	}
+	spa_assert_se(s.copied == 0);
+}
+
+int main(int argc, char *argv[])
+{
+	test_place();
+	test_place_partial();
+	test_place_empty();
+	test_order();
+	test_overlaps();
+	test_write();
+	test_write_out_of_order();
+	return 0;
+}
@@ -0,0 +1,140 @@
+/* Spa ALSA probe cache test */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <spa/utils/defs.h>
+
+#include "acp/probe-cache.h"
+
+static char dir[] = "/tmp/test-probe-cache-XXXXXX";
+
+static void init_cache(pa_probe_cache *c, const char *key)
+{
+	spa_zero(*c);
+	spa_assert_se(asprintf(&c->path, "%s/state/probe-card.json", dir) > 0);
+	snprintf(c->key, sizeof(c->key), "%s", key);
+}
+
+static void write_file(const char *path, const char *data)
+{
+	FILE *f = fopen(path, "w");
+	spa_assert_se(f != NULL);
+	fputs(data, f);
+	fclose(f);
+}
+
+static void test_transient(void)
+{
+	spa_assert_se(!pa_probe_error_is_transient(ENOENT));
+	spa_assert_se(!pa_probe_error_is_transient(ENODEV));
+	spa_assert_se(!pa_probe_error_is_transient(EINVAL));
+	spa_assert_se(pa_probe_error_is_transient(EBUSY));
+	spa_assert_se(pa_probe_error_is_transient(EAGAIN));
+	spa_assert_se(pa_probe_error_is_transient(EACCES));
+	spa_assert_se(pa_probe_error_is_transient(ENOMEM));
+}
+
+static void test_roundtrip(void)
+{
+	pa_probe_cache c;
+
+	init_cache(&c, "1|card|\"driver\"");
+	spa_assert_se(pa_probe_cache_load(&c) == -ENOENT);
+
+	pa_probe_cache_set(&c, "output:analog-stereo", PA_PROBE_SUPPORTED);
+	pa_probe_cache_set(&c, "output:hdmi-stereo", PA_PROBE_UNSUPPORTED);
+	pa_probe_cache_set(&c, "input:analog-stereo", PA_PROBE_UNKNOWN);
+	spa_assert_se(pa_probe_cache_changed(&c));
+	spa_assert_se(!pa_probe_cache_stale(&c));
+	spa_assert_se(pa_probe_cache_save(&c) == 0);
+	pa_probe_cache_clear(&c);
+
+	/* the transient failure is not saved */
+	init_cache(&c, "1|card|\"driver\"");
+	spa_assert_se(pa_probe_cache_load(&c) == 2);
+	spa_assert_se(pa_probe_cache_get(&c, "output:analog-stereo") == PA_PROBE_SUPPORTED);
+	spa_assert_se(pa_probe_cache_get(&c, "output:hdmi-stereo") == PA_PROBE_UNSUPPORTED);
+	spa_assert_se(pa_probe_cache_get(&c, "input:analog-stereo") == PA_PROBE_UNKNOWN);
+
+	/* the same results don't need to be saved again */
+	pa_probe_cache_set(&c, "output:analog-stereo", PA_PROBE_SUPPORTED);
+	pa_probe_cache_set(&c, "output:hdmi-stereo", PA_PROBE_UNSUPPORTED);
+	spa_assert_se(!pa_probe_cache_changed(&c));
+	spa_assert_se(!pa_probe_cache_stale(&c));
+
+	/* the profile that failed with a transient error works now */
+	pa_probe_cache_set(&c, "input:analog-stereo", PA_PROBE_SUPPORTED);
+	spa_assert_se(pa_probe_cache_changed(&c));
+	spa_assert_se(!pa_probe_cache_stale(&c));
+	pa_probe_cache_clear(&c);
+
+	/* a different key ignores the results */
+	init_cache(&c, "1|card|other");
+	spa_assert_se(pa_probe_cache_load(&c) == -ESTALE);
+	spa_assert_se(c.n_entries == 0);
+	pa_probe_cache_clear(&c);
+}
+
+static void test_stale(void)
+{
+	pa_probe_cache c;
+
+	init_cache(&c, "key");
+	pa_probe_cache_set(&c, "output:analog-stereo", PA_PROBE_SUPPORTED);
+	spa_assert_se(pa_probe_cache_save(&c) == 0);
+	pa_probe_cache_clear(&c);
+
+	/* a supported profile that fails now, even with a transient error,
+	 * makes the cache stale */
+	init_cache(&c, "key");
+	spa_assert_se(pa_probe_cache_load(&c) == 1);
+	pa_probe_cache_set(&c, "output:analog-stereo", PA_PROBE_UNKNOWN);
+	spa_assert_se(pa_probe_cache_stale(&c));
+
+	pa_probe_cache_reset(&c);
+	spa_assert_se(!pa_probe_cache_stale(&c));
+	spa_assert_se(pa_probe_cache_get(&c, "output:analog-stereo") == PA_PROBE_UNKNOWN);
+	pa_probe_cache_clear(&c);
+}
+
+static void test_invalid(void)
+{
+	pa_probe_cache c;
+
+	init_cache(&c, "key");
+	write_file(c.path, "");
+	spa_assert_se(pa_probe_cache_load(&c) == -EINVAL);
+	write_file(c.path, "{ \"key\": \"key\" }");
+	spa_assert_se(pa_probe_cache_load(&c) == -EINVAL);
+	write_file(c.path, "{ \"key\": \"key\", \"profiles\": [ ] }");
+	spa_assert_se(pa_probe_cache_load(&c) == -EINVAL);
+	spa_assert_se(c.n_entries == 0);
+
+	/* values that are not booleans are skipped */
+	write_file(c.path, "{ \"key\": \"key\", \"profiles\": { \"a\": 1, \"b\": false } }");
+	spa_assert_se(pa_probe_cache_load(&c) == 1);
+	spa_assert_se(pa_probe_cache_get(&c, "a") == PA_PROBE_UNKNOWN);
+	spa_assert_se(pa_probe_cache_get(&c, "b") == PA_PROBE_UNSUPPORTED);
+	pa_probe_cache_clear(&c);
+}
+
+int main(int argc, char *argv[])
+{
+	char cmd[128];
+
+	spa_assert_se(mkdtemp(dir) != NULL);
+
+	test_transient();
+	test_roundtrip();
+	test_stale();
+	test_invalid();
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+	spa_assert_se(system(cmd) == 0);
+	return 0;
+}
@@ -19,6 +19,7 @@
 #include <spa/utils/names.h>
 #include <spa/utils/string.h>
 #include <spa/utils/ratelimit.h>
+#include <spa/utils/atomic.h>
 #include <spa/node/node.h>
 #include <spa/node/io.h>
 #include <spa/node/utils.h>
@@ -39,6 +40,7 @@
 #include "channelmix-ops.h"
 #include "resample.h"
 #include "wavfile.h"
+#include "meter.h"
 
 #undef SPA_LOG_TOPIC_DEFAULT
 #define SPA_LOG_TOPIC_DEFAULT &log_topic
@@ -103,6 +105,7 @@ struct props {
 	char wav_path[512];
 	unsigned int lock_volumes:1;
 	unsigned int filter_graph_disabled:1;
+	unsigned int meter:1;
 };
 
 static void props_reset(struct props *props)
@@ -125,6 +128,7 @@ static void props_reset(struct props *props)
 	spa_zero(props->wav_path);
 	props->lock_volumes = false;
 	props->filter_graph_disabled = false;
+	props->meter = false;
 }
 
 struct buffer {
@@ -276,6 +280,7 @@ struct impl {
 	struct props props;
 
 	struct spa_io_position *io_position;
+	struct spa_io_meter *io_meter;
 	struct spa_io_rate_match *io_rate_match;
 
 	uint64_t info_all;
@@ -327,6 +332,8 @@ struct impl {
 	float *tmp_datas[2][MAX_PORTS];
 
 	struct wav_file *wav_file;
+
+	struct meter meter;
 };
 
 #define CHECK_PORT(this,d,p)		((p) < this->dir[d].n_ports)
@@ -823,10 +830,18 @@ static int node_param_prop_info(struct impl *this, uint32_t id, uint32_t index,
 			SPA_PROP_INFO_type, SPA_POD_String(""),
 			SPA_PROP_INFO_params, SPA_POD_Bool(true));
 		break;
+	case 30:
+		*param = spa_pod_builder_add_object(b,
+			SPA_TYPE_OBJECT_PropInfo, id,
+			SPA_PROP_INFO_name, SPA_POD_String("meter.enable"),
+			SPA_PROP_INFO_description, SPA_POD_String("Enable loudness metering"),
+			SPA_PROP_INFO_type, SPA_POD_CHOICE_Bool(p->meter),
+			SPA_PROP_INFO_params, SPA_POD_Bool(true));
+		break;
 	default:
 		if (this->filter_graph[0] && this->filter_graph[0]->graph) {
 			return spa_filter_graph_enum_prop_info(this->filter_graph[0]->graph,
-					index - 30, b, param);
+					index - 31, b, param);
 		}
 		return 0;
 	}
@@ -912,6 +927,8 @@ static int node_param_props(struct impl *this, uint32_t id, uint32_t index,
 		spa_pod_builder_bool(b, p->filter_graph_disabled);
 		spa_pod_builder_string(b, "audioconvert.filter-graph");
 		spa_pod_builder_string(b, "");
+		spa_pod_builder_string(b, "meter.enable");
+		spa_pod_builder_bool(b, p->meter);
 		spa_pod_builder_pop(b, &f[1]);
 		*param = spa_pod_builder_pop(b, &f[0]);
 		break;
@@ -1003,6 +1020,11 @@ static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
 	case SPA_IO_Position:
 		this->io_position = data;
 		break;
+	case SPA_IO_Meter:
+		if (data != NULL && size < sizeof(struct spa_io_meter))
+			return -EINVAL;
+		this->io_meter = data;
+		break;
 	default:
 		return -ENOENT;
 	}
@@ -1448,6 +1470,8 @@ static int audioconvert_set_param(struct impl *this, const char *k, const char *
 	}
 	else if (spa_streq(k, "channelmix.lock-volumes"))
 		this->props.lock_volumes = spa_atob(s);
+	else if (spa_streq(k, "meter.enable"))
+		this->props.meter = spa_atob(s);
 	else if (spa_strstartswith(k, "audioconvert.filter-graph.")) {
 		int order = atoi(k + strlen("audioconvert.filter-graph."));
 		if ((res = load_filter_graph(this, s, order)) < 0) {
@@ -3434,6 +3458,60 @@ static void add_wav_stage(struct impl *impl, struct stage_context *ctx)
 	impl->n_stages++;
 }
 
+static void run_meter_stage(struct stage *stage, struct stage_context *c)
+{
+	struct impl *impl = stage->impl;
+	const float **src = (const float **)c->datas[stage->in_idx];
+	struct spa_io_meter *io = impl->io_meter;
+	struct meter_result res;
+
+	if (meter_process(&impl->meter, src, c->n_samples) == 0 || io == NULL)
+		return;
+
+	meter_get_result(&impl->meter, &res);
+	SPA_SEQ_WRITE(io->seq);
+	io->momentary = res.momentary;
+	io->short_term = res.short_term;
+	io->true_peak = res.true_peak;
+	SPA_SEQ_WRITE(io->seq);
+}
+
+static bool meter_enabled(struct impl *impl)
+{
+	struct dir *dir = &impl->dir[impl->direction];
+	return impl->props.meter &&
+		dir->format.info.raw.format == SPA_AUDIO_FORMAT_DSP_F32;
+}
+
+static void add_meter_stage(struct impl *impl, struct stage_context *ctx)
+{
+	struct stage *s = &impl->stages[impl->n_stages];
+	struct spa_audio_info_raw *info = &impl->dir[impl->direction].format.info.raw;
+	struct meter *m = &impl->meter;
+
+	if (m->rate != info->rate || m->channels != info->channels ||
+	    memcmp(m->position, info->position, info->channels * sizeof(uint32_t)) != 0) {
+		m->cpu_flags = impl->cpu_flags;
+		m->log = impl->log;
+		m->rate = info->rate;
+		m->channels = info->channels;
+		memcpy(m->position, info->position, info->channels * sizeof(uint32_t));
+		if (meter_init(m) < 0) {
+			spa_log_warn(impl->log, "%p: can't init meter", impl);
+			meter_free(m);
+			return;
+		}
+	}
+	s->impl = impl;
+	s->passthrough = false;
+	s->in_idx = ctx->src_idx;
+	s->out_idx = ctx->src_idx;
+	s->data = NULL;
+	s->run = run_meter_stage;
+	spa_log_trace(impl->log, "%p: stage %d", impl, impl->n_stages);
+	impl->n_stages++;
+}
+
 static void run_dst_remap_stage(struct stage *s, struct stage_context *c)
 {
 	struct impl *impl = s->impl;
@@ -3680,6 +3758,8 @@ static void recalc_stages(struct impl *this, struct stage_context *ctx)
 	if (this->direction == SPA_DIRECTION_INPUT &&
 	    (this->props.wav_path[0] || this->wav_file != NULL))
 		add_wav_stage(this, ctx);
+	if (this->direction == SPA_DIRECTION_INPUT && meter_enabled(this))
+		add_meter_stage(this, ctx);
 
 	if (!in_passthrough) {
 		if (filter_passthrough && mix_passthrough && resample_passthrough && out_passthrough)
@@ -3741,6 +3821,8 @@ static void recalc_stages(struct impl *this, struct stage_context *ctx)
 	if (this->direction == SPA_DIRECTION_OUTPUT &&
 	    (this->props.wav_path[0] || this->wav_file != NULL))
 		add_wav_stage(this, ctx);
+	if (this->direction == SPA_DIRECTION_OUTPUT && meter_enabled(this))
+		add_meter_stage(this, ctx);
 
 	spa_log_trace(this->log, "got %u processing stages", this->n_stages);
 }
@@ -4198,6 +4280,7 @@ static int impl_clear(struct spa_handle *handle)
 		resample_free(&this->resample);
 	if (this->wav_file != NULL)
 		wav_file_close(this->wav_file);
+	meter_free(&this->meter);
 	free (this->vol_ramp_sequence_data);
 	return 0;
 }
@@ -0,0 +1,295 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <spa/support/log-impl.h>
+
+SPA_LOG_IMPL(logger);
+
+#include "test-helper.h"
+#include "channelmix-ops.h"
+
+static uint32_t cpu_flags;
+
+typedef void (*channelmix_func_t) (struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples);
+
+struct stats {
+	uint32_t n_samples;
+	uint32_t src_chan;
+	uint32_t dst_chan;
+	uint64_t perf;
+	const char *name;
+	const char *impl;
+};
+
+#define MAX_SAMPLES	4096
+#define MAX_CHANNELS	16
+
+#define MAX_COUNT 200
+
+static float samp_in[MAX_CHANNELS][MAX_SAMPLES];
+static float samp_out[MAX_CHANNELS][MAX_SAMPLES];
+
+static const int sample_sizes[] = { 0, 1, 128, 513, 4096 };
+
+#define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * 100
+
+static uint32_t n_results = 0;
+static struct stats results[MAX_RESULTS];
+
+static void init_mix(struct channelmix *mix, uint32_t src_chan, uint32_t src_mask,
+		uint32_t dst_chan, uint32_t dst_mask)
+{
+	uint32_t i, j;
+
+	spa_zero(*mix);
+	mix->src_chan = src_chan;
+	mix->dst_chan = dst_chan;
+	mix->src_mask = src_mask;
+	mix->dst_mask = dst_mask;
+	mix->log = &logger.log;
+	mix->cpu_flags = cpu_flags;
+	spa_assert_se(channelmix_init(mix) == 0);
+
+	if (src_mask == 0 && dst_mask == 0) {
+		for (i = 0; i < dst_chan; i++)
+			for (j = 0; j < src_chan; j++)
+				mix->matrix_orig[i][j] = (float)(drand48() - 0.5f);
+	}
+	channelmix_set_volume(mix, 0.8f, false, 0, NULL);
+}
+
+static void run_test1(const char *name, const char *impl, struct channelmix *mix,
+		channelmix_func_t func, int n_samples)
+{
+	uint32_t i, j;
+	const void *ip[MAX_CHANNELS];
+	void *op[MAX_CHANNELS];
+	struct timespec ts;
+	uint64_t count, t1, t2;
+
+	for (j = 0; j < MAX_CHANNELS; j++) {
+		ip[j] = samp_in[j];
+		op[j] = samp_out[j];
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	count = 0;
+	for (i = 0; i < MAX_COUNT; i++) {
+		func(mix, op, ip, n_samples);
+		count++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	spa_assert(n_results < MAX_RESULTS);
+
+	results[n_results++] = (struct stats) {
+		.n_samples = n_samples,
+		.src_chan = mix->src_chan,
+		.dst_chan = mix->dst_chan,
+		.perf = count * (uint64_t)SPA_NSEC_PER_SEC / SPA_MAX(t2 - t1, 1u),
+		.name = name,
+		.impl = impl
+	};
+}
+
+static void run_test(const char *name, const char *impl, struct channelmix *mix,
+		channelmix_func_t func)
+{
+	SPA_FOR_EACH_ELEMENT_VAR(sample_sizes, s)
+		run_test1(name, impl, mix, func, *s);
+}
+
+static void test_copy(void)
+{
+	struct channelmix mix;
+
+	init_mix(&mix, 2, _M(FL)|_M(FR), 2, _M(FL)|_M(FR));
+	run_test("test_copy", "c", &mix, channelmix_copy_c);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("test_copy", "sse", &mix, channelmix_copy_sse);
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		run_test("test_copy", "avx2", &mix, channelmix_copy_avx2);
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512)
+		run_test("test_copy", "avx512", &mix, channelmix_copy_avx512);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_copy", "neon", &mix, channelmix_copy_neon);
+#endif
+	channelmix_free(&mix);
+}
+
+static void test_n_m(void)
+{
+	struct channelmix mix;
+
+	init_mix(&mix, 16, 0, 12, 0);
+	run_test("test_n_m", "c", &mix, channelmix_f32_n_m_c);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("test_n_m", "sse", &mix, channelmix_f32_n_m_sse);
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		run_test("test_n_m", "avx2", &mix, channelmix_f32_n_m_avx2);
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512)
+		run_test("test_n_m", "avx512", &mix, channelmix_f32_n_m_avx512);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_n_m", "neon", &mix, channelmix_f32_n_m_neon);
+#endif
+	channelmix_free(&mix);
+}
+
+static void test_5p1_2(void)
+{
+	struct channelmix mix;
+
+	init_mix(&mix, 6, _M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR),
+			2, _M(FL)|_M(FR));
+	run_test("test_5p1_2", "c", &mix, channelmix_f32_5p1_2_c);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("test_5p1_2", "sse", &mix, channelmix_f32_5p1_2_sse);
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		run_test("test_5p1_2", "avx2", &mix, channelmix_f32_5p1_2_avx2);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_5p1_2", "neon", &mix, channelmix_f32_5p1_2_neon);
+#endif
+	channelmix_free(&mix);
+}
+
+static void test_5p1_3p1(void)
+{
+	struct channelmix mix;
+
+	init_mix(&mix, 6, _M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR),
+			4, _M(FL)|_M(FR)|_M(FC)|_M(LFE));
+	run_test("test_5p1_3p1", "c", &mix, channelmix_f32_5p1_3p1_c);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("test_5p1_3p1", "sse", &mix, channelmix_f32_5p1_3p1_sse);
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		run_test("test_5p1_3p1", "avx2", &mix, channelmix_f32_5p1_3p1_avx2);
+#endif
+	channelmix_free(&mix);
+}
+
+static void test_5p1_4(void)
+{
+	struct channelmix mix;
+
+	init_mix(&mix, 6, _M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR),
+			4, _M(FL)|_M(FR)|_M(RL)|_M(RR));
+	run_test("test_5p1_4", "c", &mix, channelmix_f32_5p1_4_c);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("test_5p1_4", "sse", &mix, channelmix_f32_5p1_4_sse);
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		run_test("test_5p1_4", "avx2", &mix, channelmix_f32_5p1_4_avx2);
+#endif
+	channelmix_free(&mix);
+}
+
+static void test_7p1_2(void)
+{
+	struct channelmix mix;
+
+	init_mix(&mix, 8, _M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR)|_M(RL)|_M(RR),
+			2, _M(FL)|_M(FR));
+	run_test("test_7p1_2", "c", &mix, channelmix_f32_7p1_2_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		run_test("test_7p1_2", "avx2", &mix, channelmix_f32_7p1_2_avx2);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_7p1_2", "neon", &mix, channelmix_f32_7p1_2_neon);
+#endif
+	channelmix_free(&mix);
+}
+
+static void test_7p1_4(void)
+{
+	struct channelmix mix;
+
+	init_mix(&mix, 8, _M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR)|_M(RL)|_M(RR),
+			4, _M(FL)|_M(FR)|_M(RL)|_M(RR));
+	run_test("test_7p1_4", "c", &mix, channelmix_f32_7p1_4_c);
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		run_test("test_7p1_4", "avx2", &mix, channelmix_f32_7p1_4_avx2);
+#endif
+	channelmix_free(&mix);
+}
+
+static int compare_func(const void *_a, const void *_b)
+{
+	const struct stats *a = _a, *b = _b;
+	int diff;
+	if ((diff = strcmp(a->name, b->name)) != 0) return diff;
+	if ((diff = a->n_samples - b->n_samples) != 0) return diff;
+	if ((diff = a->src_chan - b->src_chan) != 0) return diff;
+	if ((diff = a->dst_chan - b->dst_chan) != 0) return diff;
+	if ((diff = b->perf - a->perf) != 0) return diff;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t i, j;
+
+	cpu_flags = get_cpu_flags();
+	printf("got get CPU flags %d\n", cpu_flags);
+
+	for (i = 0; i < MAX_CHANNELS; i++)
+		for (j = 0; j < MAX_SAMPLES; j++)
+			samp_in[i][j] = (float)((drand48() - 0.5f) * 2.0f);
+
+	test_copy();
+	test_n_m();
+	test_5p1_2();
+	test_5p1_3p1();
+	test_5p1_4();
+	test_7p1_2();
+	test_7p1_4();
+
+	qsort(results, n_results, sizeof(struct stats), compare_func);
+
+	for (i = 0; i < n_results; i++) {
+		struct stats *s = &results[i];
+		fprintf(stderr, "%-12."PRIu64" \t%-32.32s %s \t samples %d, channels %d -> %d\n",
+				s->perf, s->name, s->impl, s->n_samples, s->src_chan, s->dst_chan);
+	}
+	return 0;
+}
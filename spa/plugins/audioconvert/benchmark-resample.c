@@ -14,6 +14,7 @@
 #include "test-helper.h"
 #include "resample.h"
 
+#define MAX_STREAMS	300
 #define MAX_SAMPLES	4096
 #define MAX_CHANNELS	11
 
@@ -107,6 +108,39 @@ static int compare_func(const void *_a, const void *_b)
 	return 0;
 }
 
+static void test_cache(void)
+{
+	struct resample r[MAX_STREAMS];
+	struct resample_cache_stats stats;
+	struct timespec ts;
+	uint64_t t1, t2;
+	uint32_t i;
+
+	/* many streams with the same rates share one filter, only the
+	 * first one needs to build it */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+	for (i = 0; i < MAX_STREAMS; i++) {
+		spa_zero(r[i]);
+		r[i].channels = 2;
+		r[i].cpu_flags = cpu_flags;
+		r[i].i_rate = 44100;
+		r[i].o_rate = 48000;
+		r[i].quality = RESAMPLE_DEFAULT_QUALITY + 4;
+		resample_native_init(&r[i]);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	resample_native_cache_stats(&stats);
+	for (i = 0; i < MAX_STREAMS; i++)
+		resample_free(&r[i]);
+
+	fprintf(stderr, "cache: %d streams init in %"PRIu64" ns, filters:%u size:%zu "
+			"hits:%"PRIu64" misses:%"PRIu64"\n", MAX_STREAMS, t2 - t1,
+			stats.n_filters, stats.size, stats.hits, stats.misses);
+}
+
 int main(int argc, char *argv[])
 {
 	struct resample r;
@@ -172,6 +206,8 @@ int main(int argc, char *argv[])
 	}
 #endif
 
+	test_cache();
+
 	qsort(results, n_results, sizeof(struct stats), compare_func);
 
 	for (i = 0; i < n_results; i++) {
@@ -0,0 +1,447 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "channelmix-ops.h"
+
+#include <immintrin.h>
+#include <float.h>
+#include <math.h>
+
+/* The buffers are aligned to 32 bytes by audioconvert but not always by other
+ * users, we use unaligned loads and stores, they are as fast as the aligned
+ * ones when the data is aligned.
+ *
+ * The operations are done in the same order as the C versions so that the
+ * results are the same. */
+
+static inline void clear_avx2(float *d, uint32_t n_samples)
+{
+	memset(d, 0, n_samples * sizeof(float));
+}
+
+static inline void copy_avx2(float *d, const float *s, uint32_t n_samples)
+{
+	if (d != s)
+		spa_memcpy(d, s, n_samples * sizeof(float));
+}
+
+static inline void vol_avx2(float *d, const float *s, float vol, uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	if (vol == 0.0f) {
+		clear_avx2(d, n_samples);
+	} else if (vol == 1.0f) {
+		copy_avx2(d, s, n_samples);
+	} else {
+		const __m256 v = _mm256_set1_ps(vol);
+
+		unrolled = n_samples & ~31;
+		for(n = 0; n < unrolled; n += 32) {
+			_mm256_storeu_ps(&d[n+ 0], _mm256_mul_ps(_mm256_loadu_ps(&s[n+ 0]), v));
+			_mm256_storeu_ps(&d[n+ 8], _mm256_mul_ps(_mm256_loadu_ps(&s[n+ 8]), v));
+			_mm256_storeu_ps(&d[n+16], _mm256_mul_ps(_mm256_loadu_ps(&s[n+16]), v));
+			_mm256_storeu_ps(&d[n+24], _mm256_mul_ps(_mm256_loadu_ps(&s[n+24]), v));
+		}
+		for(; n < n_samples; n++)
+			d[n] = s[n] * vol;
+	}
+}
+
+static inline void conv_avx2(float *d, const float **s, float *c, uint32_t n_c, uint32_t n_samples)
+{
+	__m256 mi[n_c], sum[2];
+	uint32_t n, j, unrolled;
+
+	for (j = 0; j < n_c; j++)
+		mi[j] = _mm256_set1_ps(c[j]);
+
+	unrolled = n_samples & ~15;
+	for (n = 0; n < unrolled; n += 16) {
+		sum[0] = sum[1] = _mm256_setzero_ps();
+		for (j = 0; j < n_c; j++) {
+			sum[0] = _mm256_add_ps(sum[0], _mm256_mul_ps(_mm256_loadu_ps(&s[j][n + 0]), mi[j]));
+			sum[1] = _mm256_add_ps(sum[1], _mm256_mul_ps(_mm256_loadu_ps(&s[j][n + 8]), mi[j]));
+		}
+		_mm256_storeu_ps(&d[n + 0], sum[0]);
+		_mm256_storeu_ps(&d[n + 8], sum[1]);
+	}
+	for (; n < n_samples; n++) {
+		float t = 0.0f;
+		for (j = 0; j < n_c; j++)
+			t += s[j][n] * c[j];
+		d[n] = t;
+	}
+}
+
+void channelmix_copy_avx2(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, n_dst = mix->dst_chan;
+	float **d = (float **)dst;
+	const float **s = (const float **)src;
+	for (i = 0; i < n_dst; i++)
+		vol_avx2(d[i], s[i], mix->matrix[i][i], n_samples);
+}
+
+void
+channelmix_f32_n_m_avx2(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		   const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	uint32_t i, j, n_dst = mix->dst_chan, n_src = mix->src_chan;
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			clear_avx2(d[i], n_samples);
+		return;
+	}
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_COPY)) {
+		uint32_t copy = SPA_MIN(n_dst, n_src);
+		for (i = 0; i < copy; i++)
+			copy_avx2(d[i], s[i], n_samples);
+		for (; i < n_dst; i++)
+			clear_avx2(d[i], n_samples);
+		return;
+	}
+	for (i = 0; i < n_dst; i++) {
+		float *di = d[i];
+		float mj[n_src];
+		const float *sj[n_src];
+		uint32_t n_j = 0;
+
+		for (j = 0; j < n_src; j++) {
+			if (mix->matrix[i][j] == 0.0f)
+				continue;
+			mj[n_j] = mix->matrix[i][j];
+			sj[n_j++] = s[j];
+		}
+		if (n_j == 0) {
+			clear_avx2(di, n_samples);
+		} else if (n_j == 1) {
+			if (mix->lr4[i].active)
+				lr4_process(&mix->lr4[i], di, sj[0], mj[0], n_samples);
+			else
+				vol_avx2(di, sj[0], mj[0], n_samples);
+		} else {
+			conv_avx2(di, sj, mj, n_j, n_samples);
+			if (mix->lr4[i].active)
+				lr4_process(&mix->lr4[i], di, di, 1.0f, n_samples);
+		}
+	}
+}
+
+/* FL+FR+FC+LFE -> FL+FR */
+void
+channelmix_f32_3p1_2_avx2(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		   const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m0 = mix->matrix[0][0];
+	const float m1 = mix->matrix[1][1];
+	const float m2 = (mix->matrix[0][2] + mix->matrix[1][2]) * 0.5f;
+	const float m3 = (mix->matrix[0][3] + mix->matrix[1][3]) * 0.5f;
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		clear_avx2(d[0], n_samples);
+		clear_avx2(d[1], n_samples);
+	}
+	else {
+		const __m256 v0 = _mm256_set1_ps(m0);
+		const __m256 v1 = _mm256_set1_ps(m1);
+		const __m256 clev = _mm256_set1_ps(m2);
+		const __m256 llev = _mm256_set1_ps(m3);
+		__m256 ctr;
+
+		unrolled = n_samples & ~7;
+		for(n = 0; n < unrolled; n += 8) {
+			ctr = _mm256_add_ps(
+					_mm256_mul_ps(_mm256_loadu_ps(&s[2][n]), clev),
+					_mm256_mul_ps(_mm256_loadu_ps(&s[3][n]), llev));
+			_mm256_storeu_ps(&d[0][n], _mm256_add_ps(
+					_mm256_mul_ps(_mm256_loadu_ps(&s[0][n]), v0), ctr));
+			_mm256_storeu_ps(&d[1][n], _mm256_add_ps(
+					_mm256_mul_ps(_mm256_loadu_ps(&s[1][n]), v1), ctr));
+		}
+		for(; n < n_samples; n++) {
+			const float c = m2 * s[2][n] + m3 * s[3][n];
+			d[0][n] = s[0][n] * m0 + c;
+			d[1][n] = s[1][n] * m1 + c;
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR -> FL+FR */
+void
+channelmix_f32_5p1_2_avx2(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m00 = mix->matrix[0][0];
+	const float m11 = mix->matrix[1][1];
+	const float m2 = (mix->matrix[0][2] + mix->matrix[1][2]) * 0.5f;
+	const float m3 = (mix->matrix[0][3] + mix->matrix[1][3]) * 0.5f;
+	const float m04 = mix->matrix[0][4];
+	const float m15 = mix->matrix[1][5];
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		clear_avx2(d[0], n_samples);
+		clear_avx2(d[1], n_samples);
+	}
+	else {
+		const __m256 v0 = _mm256_set1_ps(m00);
+		const __m256 v1 = _mm256_set1_ps(m11);
+		const __m256 clev = _mm256_set1_ps(m2);
+		const __m256 llev = _mm256_set1_ps(m3);
+		const __m256 slev0 = _mm256_set1_ps(m04);
+		const __m256 slev1 = _mm256_set1_ps(m15);
+		__m256 in, ctr;
+
+		unrolled = n_samples & ~7;
+		for(n = 0; n < unrolled; n += 8) {
+			ctr = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&s[2][n]), clev),
+					_mm256_mul_ps(_mm256_loadu_ps(&s[3][n]), llev));
+			in = _mm256_mul_ps(_mm256_loadu_ps(&s[0][n]), v0);
+			in = _mm256_add_ps(in, ctr);
+			in = _mm256_add_ps(in, _mm256_mul_ps(_mm256_loadu_ps(&s[4][n]), slev0));
+			_mm256_storeu_ps(&d[0][n], in);
+			in = _mm256_mul_ps(_mm256_loadu_ps(&s[1][n]), v1);
+			in = _mm256_add_ps(in, ctr);
+			in = _mm256_add_ps(in, _mm256_mul_ps(_mm256_loadu_ps(&s[5][n]), slev1));
+			_mm256_storeu_ps(&d[1][n], in);
+		}
+		for(; n < n_samples; n++) {
+			const float c = m2 * s[2][n] + m3 * s[3][n];
+			d[0][n] = s[0][n] * m00 + c + (m04 * s[4][n]);
+			d[1][n] = s[1][n] * m11 + c + (m15 * s[5][n]);
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR -> FL+FR+FC+LFE*/
+void
+channelmix_f32_5p1_3p1_avx2(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, n, unrolled, n_dst = mix->dst_chan;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m0 = mix->matrix[0][0];
+	const float m1 = mix->matrix[1][1];
+	const float m4 = mix->matrix[0][4];
+	const float m5 = mix->matrix[1][5];
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			clear_avx2(d[i], n_samples);
+	}
+	else {
+		const __m256 v0 = _mm256_set1_ps(m0);
+		const __m256 v1 = _mm256_set1_ps(m1);
+		const __m256 v4 = _mm256_set1_ps(m4);
+		const __m256 v5 = _mm256_set1_ps(m5);
+
+		unrolled = n_samples & ~7;
+		for(n = 0; n < unrolled; n += 8) {
+			_mm256_storeu_ps(&d[0][n], _mm256_add_ps(
+					_mm256_mul_ps(_mm256_loadu_ps(&s[0][n]), v0),
+					_mm256_mul_ps(_mm256_loadu_ps(&s[4][n]), v4)));
+			_mm256_storeu_ps(&d[1][n], _mm256_add_ps(
+					_mm256_mul_ps(_mm256_loadu_ps(&s[1][n]), v1),
+					_mm256_mul_ps(_mm256_loadu_ps(&s[5][n]), v5)));
+		}
+		for(; n < n_samples; n++) {
+			d[0][n] = s[0][n] * m0 + s[4][n] * m4;
+			d[1][n] = s[1][n] * m1 + s[5][n] * m5;
+		}
+		vol_avx2(d[2], s[2], mix->matrix[2][2], n_samples);
+		vol_avx2(d[3], s[3], mix->matrix[3][3], n_samples);
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR -> FL+FR+RL+RR*/
+void
+channelmix_f32_5p1_4_avx2(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, n_dst = mix->dst_chan;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float v4 = mix->matrix[2][4];
+	const float v5 = mix->matrix[3][5];
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			clear_avx2(d[i], n_samples);
+	}
+	else {
+		channelmix_f32_3p1_2_avx2(mix, dst, src, n_samples);
+
+		vol_avx2(d[2], s[4], v4, n_samples);
+		vol_avx2(d[3], s[5], v5, n_samples);
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR+RL+RR -> FL+FR */
+void
+channelmix_f32_7p1_2_avx2(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m00 = mix->matrix[0][0];
+	const float m11 = mix->matrix[1][1];
+	const float m2 = (mix->matrix[0][2] + mix->matrix[1][2]) * 0.5f;
+	const float m3 = (mix->matrix[0][3] + mix->matrix[1][3]) * 0.5f;
+	const float m04 = mix->matrix[0][4];
+	const float m15 = mix->matrix[1][5];
+	const float m06 = mix->matrix[0][6];
+	const float m17 = mix->matrix[1][7];
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		clear_avx2(d[0], n_samples);
+		clear_avx2(d[1], n_samples);
+	}
+	else {
+		const __m256 v0 = _mm256_set1_ps(m00);
+		const __m256 v1 = _mm256_set1_ps(m11);
+		const __m256 clev = _mm256_set1_ps(m2);
+		const __m256 llev = _mm256_set1_ps(m3);
+		const __m256 slev0 = _mm256_set1_ps(m04);
+		const __m256 slev1 = _mm256_set1_ps(m15);
+		const __m256 rlev0 = _mm256_set1_ps(m06);
+		const __m256 rlev1 = _mm256_set1_ps(m17);
+		__m256 in, ctr;
+
+		unrolled = n_samples & ~7;
+		for(n = 0; n < unrolled; n += 8) {
+			ctr = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&s[2][n]), clev),
+					_mm256_mul_ps(_mm256_loadu_ps(&s[3][n]), llev));
+			in = _mm256_mul_ps(_mm256_loadu_ps(&s[0][n]), v0);
+			in = _mm256_add_ps(in, ctr);
+			in = _mm256_add_ps(in, _mm256_mul_ps(_mm256_loadu_ps(&s[4][n]), slev0));
+			in = _mm256_add_ps(in, _mm256_mul_ps(_mm256_loadu_ps(&s[6][n]), rlev0));
+			_mm256_storeu_ps(&d[0][n], in);
+			in = _mm256_mul_ps(_mm256_loadu_ps(&s[1][n]), v1);
+			in = _mm256_add_ps(in, ctr);
+			in = _mm256_add_ps(in, _mm256_mul_ps(_mm256_loadu_ps(&s[5][n]), slev1));
+			in = _mm256_add_ps(in, _mm256_mul_ps(_mm256_loadu_ps(&s[7][n]), rlev1));
+			_mm256_storeu_ps(&d[1][n], in);
+		}
+		for(; n < n_samples; n++) {
+			const float c = m2 * s[2][n] + m3 * s[3][n];
+			d[0][n] = s[0][n] * m00 + c + s[4][n] * m04 + s[6][n] * m06;
+			d[1][n] = s[1][n] * m11 + c + s[5][n] * m15 + s[7][n] * m17;
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR+RL+RR -> FL+FR+FC+LFE*/
+void
+channelmix_f32_7p1_3p1_avx2(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, n, unrolled, n_dst = mix->dst_chan;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m0 = mix->matrix[0][0];
+	const float m1 = mix->matrix[1][1];
+	const float m4 = (mix->matrix[0][4] + mix->matrix[0][6]) * 0.5f;
+	const float m5 = (mix->matrix[1][5] + mix->matrix[1][7]) * 0.5f;
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			clear_avx2(d[i], n_samples);
+	}
+	else {
+		const __m256 v0 = _mm256_set1_ps(m0);
+		const __m256 v1 = _mm256_set1_ps(m1);
+		const __m256 v4 = _mm256_set1_ps(m4);
+		const __m256 v5 = _mm256_set1_ps(m5);
+
+		unrolled = n_samples & ~7;
+		for(n = 0; n < unrolled; n += 8) {
+			_mm256_storeu_ps(&d[0][n], _mm256_add_ps(
+					_mm256_mul_ps(_mm256_loadu_ps(&s[0][n]), v0),
+					_mm256_mul_ps(_mm256_add_ps(
+						_mm256_loadu_ps(&s[4][n]),
+						_mm256_loadu_ps(&s[6][n])), v4)));
+			_mm256_storeu_ps(&d[1][n], _mm256_add_ps(
+					_mm256_mul_ps(_mm256_loadu_ps(&s[1][n]), v1),
+					_mm256_mul_ps(_mm256_add_ps(
+						_mm256_loadu_ps(&s[5][n]),
+						_mm256_loadu_ps(&s[7][n])), v5)));
+		}
+		for(; n < n_samples; n++) {
+			d[0][n] = s[0][n] * m0 + (s[4][n] + s[6][n]) * m4;
+			d[1][n] = s[1][n] * m1 + (s[5][n] + s[7][n]) * m5;
+		}
+		vol_avx2(d[2], s[2], mix->matrix[2][2], n_samples);
+		vol_avx2(d[3], s[3], mix->matrix[3][3], n_samples);
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR+RL+RR -> FL+FR+RL+RR*/
+void
+channelmix_f32_7p1_4_avx2(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, n, unrolled, n_dst = mix->dst_chan;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m0 = mix->matrix[0][0];
+	const float m1 = mix->matrix[1][1];
+	const float m2 = (mix->matrix[0][2] + mix->matrix[1][2]) * 0.5f;
+	const float m3 = (mix->matrix[0][3] + mix->matrix[1][3]) * 0.5f;
+	const float m24 = mix->matrix[2][4];
+	const float m35 = mix->matrix[3][5];
+	const float m26 = mix->matrix[2][6];
+	const float m37 = mix->matrix[3][7];
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			clear_avx2(d[i], n_samples);
+	}
+	else {
+		const __m256 v0 = _mm256_set1_ps(m0);
+		const __m256 v1 = _mm256_set1_ps(m1);
+		const __m256 clev = _mm256_set1_ps(m2);
+		const __m256 llev = _mm256_set1_ps(m3);
+		const __m256 slev0 = _mm256_set1_ps(m24);
+		const __m256 slev1 = _mm256_set1_ps(m35);
+		const __m256 rlev0 = _mm256_set1_ps(m26);
+		const __m256 rlev1 = _mm256_set1_ps(m37);
+		__m256 ctr, sl, sr;
+
+		unrolled = n_samples & ~7;
+		for(n = 0; n < unrolled; n += 8) {
+			ctr = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&s[2][n]), clev),
+					_mm256_mul_ps(_mm256_loadu_ps(&s[3][n]), llev));
+			sl = _mm256_mul_ps(_mm256_loadu_ps(&s[4][n]), slev0);
+			sr = _mm256_mul_ps(_mm256_loadu_ps(&s[5][n]), slev1);
+			_mm256_storeu_ps(&d[0][n], _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(_mm256_loadu_ps(&s[0][n]), v0), ctr), sl));
+			_mm256_storeu_ps(&d[1][n], _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(_mm256_loadu_ps(&s[1][n]), v1), ctr), sr));
+			_mm256_storeu_ps(&d[2][n], _mm256_add_ps(
+					_mm256_mul_ps(_mm256_loadu_ps(&s[6][n]), rlev0), sl));
+			_mm256_storeu_ps(&d[3][n], _mm256_add_ps(
+					_mm256_mul_ps(_mm256_loadu_ps(&s[7][n]), rlev1), sr));
+		}
+		for(; n < n_samples; n++) {
+			const float c = s[2][n] * m2 + s[3][n] * m3;
+			const float l = s[4][n] * m24;
+			const float r = s[5][n] * m35;
+			d[0][n] = s[0][n] * m0 + c + l;
+			d[1][n] = s[1][n] * m1 + c + r;
+			d[2][n] = s[6][n] * m26 + l;
+			d[3][n] = s[7][n] * m37 + r;
+		}
+	}
+}
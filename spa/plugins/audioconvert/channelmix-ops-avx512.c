@@ -0,0 +1,136 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "channelmix-ops.h"
+
+#include <immintrin.h>
+#include <float.h>
+#include <math.h>
+
+static inline __mmask16 tail_mask(uint32_t n)
+{
+	return n >= 16 ? 0xffff : (__mmask16)((1u << n) - 1);
+}
+
+static inline void clear_avx512(float *d, uint32_t n_samples)
+{
+	memset(d, 0, n_samples * sizeof(float));
+}
+
+static inline void copy_avx512(float *d, const float *s, uint32_t n_samples)
+{
+	if (d != s)
+		spa_memcpy(d, s, n_samples * sizeof(float));
+}
+
+static inline void vol_avx512(float *d, const float *s, float vol, uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	if (vol == 0.0f) {
+		clear_avx512(d, n_samples);
+	} else if (vol == 1.0f) {
+		copy_avx512(d, s, n_samples);
+	} else {
+		const __m512 v = _mm512_set1_ps(vol);
+
+		unrolled = n_samples & ~63;
+		for(n = 0; n < unrolled; n += 64) {
+			_mm512_storeu_ps(&d[n+ 0], _mm512_mul_ps(_mm512_loadu_ps(&s[n+ 0]), v));
+			_mm512_storeu_ps(&d[n+16], _mm512_mul_ps(_mm512_loadu_ps(&s[n+16]), v));
+			_mm512_storeu_ps(&d[n+32], _mm512_mul_ps(_mm512_loadu_ps(&s[n+32]), v));
+			_mm512_storeu_ps(&d[n+48], _mm512_mul_ps(_mm512_loadu_ps(&s[n+48]), v));
+		}
+		for(; n < n_samples; n += 16) {
+			__mmask16 mask = tail_mask(n_samples - n);
+			_mm512_mask_storeu_ps(&d[n], mask,
+					_mm512_mul_ps(_mm512_maskz_loadu_ps(mask, &s[n]), v));
+		}
+	}
+}
+
+static inline void conv_avx512(float *d, const float **s, float *c, uint32_t n_c, uint32_t n_samples)
+{
+	__m512 mi[n_c], sum[2];
+	uint32_t n, j, unrolled;
+
+	for (j = 0; j < n_c; j++)
+		mi[j] = _mm512_set1_ps(c[j]);
+
+	unrolled = n_samples & ~31;
+	for (n = 0; n < unrolled; n += 32) {
+		sum[0] = sum[1] = _mm512_setzero_ps();
+		for (j = 0; j < n_c; j++) {
+			sum[0] = _mm512_add_ps(sum[0], _mm512_mul_ps(_mm512_loadu_ps(&s[j][n +  0]), mi[j]));
+			sum[1] = _mm512_add_ps(sum[1], _mm512_mul_ps(_mm512_loadu_ps(&s[j][n + 16]), mi[j]));
+		}
+		_mm512_storeu_ps(&d[n +  0], sum[0]);
+		_mm512_storeu_ps(&d[n + 16], sum[1]);
+	}
+	for (; n < n_samples; n += 16) {
+		__mmask16 mask = tail_mask(n_samples - n);
+		sum[0] = _mm512_setzero_ps();
+		for (j = 0; j < n_c; j++)
+			sum[0] = _mm512_add_ps(sum[0],
+					_mm512_mul_ps(_mm512_maskz_loadu_ps(mask, &s[j][n]), mi[j]));
+		_mm512_mask_storeu_ps(&d[n], mask, sum[0]);
+	}
+}
+
+void channelmix_copy_avx512(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, n_dst = mix->dst_chan;
+	float **d = (float **)dst;
+	const float **s = (const float **)src;
+	for (i = 0; i < n_dst; i++)
+		vol_avx512(d[i], s[i], mix->matrix[i][i], n_samples);
+}
+
+void
+channelmix_f32_n_m_avx512(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		   const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	uint32_t i, j, n_dst = mix->dst_chan, n_src = mix->src_chan;
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			clear_avx512(d[i], n_samples);
+		return;
+	}
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_COPY)) {
+		uint32_t copy = SPA_MIN(n_dst, n_src);
+		for (i = 0; i < copy; i++)
+			copy_avx512(d[i], s[i], n_samples);
+		for (; i < n_dst; i++)
+			clear_avx512(d[i], n_samples);
+		return;
+	}
+	for (i = 0; i < n_dst; i++) {
+		float *di = d[i];
+		float mj[n_src];
+		const float *sj[n_src];
+		uint32_t n_j = 0;
+
+		for (j = 0; j < n_src; j++) {
+			if (mix->matrix[i][j] == 0.0f)
+				continue;
+			mj[n_j] = mix->matrix[i][j];
+			sj[n_j++] = s[j];
+		}
+		if (n_j == 0) {
+			clear_avx512(di, n_samples);
+		} else if (n_j == 1) {
+			if (mix->lr4[i].active)
+				lr4_process(&mix->lr4[i], di, sj[0], mj[0], n_samples);
+			else
+				vol_avx512(di, sj[0], mj[0], n_samples);
+		} else {
+			conv_avx512(di, sj, mj, n_j, n_samples);
+			if (mix->lr4[i].active)
+				lr4_process(&mix->lr4[i], di, di, 1.0f, n_samples);
+		}
+	}
+}
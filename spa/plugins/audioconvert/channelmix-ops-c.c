@@ -68,39 +68,10 @@ channelmix_copy_c(struct channelmix *mix, void * SPA_RESTRICT dst[],
 
 static void lr4_process_c(struct lr4 *lr4, float *dst, const float *src, const float vol, int samples)
 {
-	float x1 = lr4->x1;
-	float x2 = lr4->x2;
-	float y1 = lr4->y1;
-	float y2 = lr4->y2;
-	float b0 = lr4->bq.b0;
-	float b1 = lr4->bq.b1;
-	float b2 = lr4->bq.b2;
-	float a1 = lr4->bq.a1;
-	float a2 = lr4->bq.a2;
-	float x, y, z;
-	int i;
-
-	if (vol == 0.0f || !lr4->active) {
+	if (vol == 0.0f || !lr4->active)
 		vol_c(dst, src, vol, samples);
-		return;
-	}
-
-	for (i = 0; i < samples; i++) {
-		x  = src[i];
-		y  = b0 * x          + x1;
-		x1 = b1 * x - a1 * y + x2;
-		x2 = b2 * x - a2 * y;
-		z  = b0 * y          + y1;
-		y1 = b1 * y - a1 * z + y2;
-		y2 = b2 * y - a2 * z;
-		dst[i] = z * vol;
-	}
-#define F(x) (isnormal(x) ? (x) : 0.0f)
-	lr4->x1 = F(x1);
-	lr4->x2 = F(x2);
-	lr4->y1 = F(y1);
-	lr4->y2 = F(y2);
-#undef F
+	else
+		lr4_process(lr4, dst, src, vol, samples);
 }
 
 static inline void delay_convolve_run_c(float *buffer, uint32_t *pos,
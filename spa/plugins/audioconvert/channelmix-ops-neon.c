@@ -0,0 +1,211 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "channelmix-ops.h"
+
+#include <arm_neon.h>
+#include <float.h>
+#include <math.h>
+
+static inline void clear_neon(float *d, uint32_t n_samples)
+{
+	memset(d, 0, n_samples * sizeof(float));
+}
+
+static inline void copy_neon(float *d, const float *s, uint32_t n_samples)
+{
+	if (d != s)
+		spa_memcpy(d, s, n_samples * sizeof(float));
+}
+
+static inline void vol_neon(float *d, const float *s, float vol, uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	if (vol == 0.0f) {
+		clear_neon(d, n_samples);
+	} else if (vol == 1.0f) {
+		copy_neon(d, s, n_samples);
+	} else {
+		unrolled = n_samples & ~15;
+		for(n = 0; n < unrolled; n += 16) {
+			vst1q_f32(&d[n+ 0], vmulq_n_f32(vld1q_f32(&s[n+ 0]), vol));
+			vst1q_f32(&d[n+ 4], vmulq_n_f32(vld1q_f32(&s[n+ 4]), vol));
+			vst1q_f32(&d[n+ 8], vmulq_n_f32(vld1q_f32(&s[n+ 8]), vol));
+			vst1q_f32(&d[n+12], vmulq_n_f32(vld1q_f32(&s[n+12]), vol));
+		}
+		for(; n < n_samples; n++)
+			d[n] = s[n] * vol;
+	}
+}
+
+static inline void conv_neon(float *d, const float **s, float *c, uint32_t n_c, uint32_t n_samples)
+{
+	float32x4_t sum[2];
+	uint32_t n, j, unrolled;
+
+	unrolled = n_samples & ~7;
+	for (n = 0; n < unrolled; n += 8) {
+		sum[0] = sum[1] = vdupq_n_f32(0.0f);
+		for (j = 0; j < n_c; j++) {
+			sum[0] = vaddq_f32(sum[0], vmulq_n_f32(vld1q_f32(&s[j][n + 0]), c[j]));
+			sum[1] = vaddq_f32(sum[1], vmulq_n_f32(vld1q_f32(&s[j][n + 4]), c[j]));
+		}
+		vst1q_f32(&d[n + 0], sum[0]);
+		vst1q_f32(&d[n + 4], sum[1]);
+	}
+	for (; n < n_samples; n++) {
+		float t = 0.0f;
+		for (j = 0; j < n_c; j++)
+			t += s[j][n] * c[j];
+		d[n] = t;
+	}
+}
+
+void channelmix_copy_neon(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, n_dst = mix->dst_chan;
+	float **d = (float **)dst;
+	const float **s = (const float **)src;
+	for (i = 0; i < n_dst; i++)
+		vol_neon(d[i], s[i], mix->matrix[i][i], n_samples);
+}
+
+void
+channelmix_f32_n_m_neon(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		   const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	uint32_t i, j, n_dst = mix->dst_chan, n_src = mix->src_chan;
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			clear_neon(d[i], n_samples);
+		return;
+	}
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_COPY)) {
+		uint32_t copy = SPA_MIN(n_dst, n_src);
+		for (i = 0; i < copy; i++)
+			copy_neon(d[i], s[i], n_samples);
+		for (; i < n_dst; i++)
+			clear_neon(d[i], n_samples);
+		return;
+	}
+	for (i = 0; i < n_dst; i++) {
+		float *di = d[i];
+		float mj[n_src];
+		const float *sj[n_src];
+		uint32_t n_j = 0;
+
+		for (j = 0; j < n_src; j++) {
+			if (mix->matrix[i][j] == 0.0f)
+				continue;
+			mj[n_j] = mix->matrix[i][j];
+			sj[n_j++] = s[j];
+		}
+		if (n_j == 0) {
+			clear_neon(di, n_samples);
+		} else if (n_j == 1) {
+			if (mix->lr4[i].active)
+				lr4_process(&mix->lr4[i], di, sj[0], mj[0], n_samples);
+			else
+				vol_neon(di, sj[0], mj[0], n_samples);
+		} else {
+			conv_neon(di, sj, mj, n_j, n_samples);
+			if (mix->lr4[i].active)
+				lr4_process(&mix->lr4[i], di, di, 1.0f, n_samples);
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR -> FL+FR */
+void
+channelmix_f32_5p1_2_neon(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m00 = mix->matrix[0][0];
+	const float m11 = mix->matrix[1][1];
+	const float m2 = (mix->matrix[0][2] + mix->matrix[1][2]) * 0.5f;
+	const float m3 = (mix->matrix[0][3] + mix->matrix[1][3]) * 0.5f;
+	const float m04 = mix->matrix[0][4];
+	const float m15 = mix->matrix[1][5];
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		clear_neon(d[0], n_samples);
+		clear_neon(d[1], n_samples);
+	}
+	else {
+		float32x4_t in, ctr;
+
+		unrolled = n_samples & ~3;
+		for(n = 0; n < unrolled; n += 4) {
+			ctr = vaddq_f32(vmulq_n_f32(vld1q_f32(&s[2][n]), m2),
+					vmulq_n_f32(vld1q_f32(&s[3][n]), m3));
+			in = vmulq_n_f32(vld1q_f32(&s[0][n]), m00);
+			in = vaddq_f32(in, ctr);
+			in = vaddq_f32(in, vmulq_n_f32(vld1q_f32(&s[4][n]), m04));
+			vst1q_f32(&d[0][n], in);
+			in = vmulq_n_f32(vld1q_f32(&s[1][n]), m11);
+			in = vaddq_f32(in, ctr);
+			in = vaddq_f32(in, vmulq_n_f32(vld1q_f32(&s[5][n]), m15));
+			vst1q_f32(&d[1][n], in);
+		}
+		for(; n < n_samples; n++) {
+			const float c = m2 * s[2][n] + m3 * s[3][n];
+			d[0][n] = s[0][n] * m00 + c + (m04 * s[4][n]);
+			d[1][n] = s[1][n] * m11 + c + (m15 * s[5][n]);
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR+RL+RR -> FL+FR */
+void
+channelmix_f32_7p1_2_neon(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m00 = mix->matrix[0][0];
+	const float m11 = mix->matrix[1][1];
+	const float m2 = (mix->matrix[0][2] + mix->matrix[1][2]) * 0.5f;
+	const float m3 = (mix->matrix[0][3] + mix->matrix[1][3]) * 0.5f;
+	const float m04 = mix->matrix[0][4];
+	const float m15 = mix->matrix[1][5];
+	const float m06 = mix->matrix[0][6];
+	const float m17 = mix->matrix[1][7];
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		clear_neon(d[0], n_samples);
+		clear_neon(d[1], n_samples);
+	}
+	else {
+		float32x4_t in, ctr;
+
+		unrolled = n_samples & ~3;
+		for(n = 0; n < unrolled; n += 4) {
+			ctr = vaddq_f32(vmulq_n_f32(vld1q_f32(&s[2][n]), m2),
+					vmulq_n_f32(vld1q_f32(&s[3][n]), m3));
+			in = vmulq_n_f32(vld1q_f32(&s[0][n]), m00);
+			in = vaddq_f32(in, ctr);
+			in = vaddq_f32(in, vmulq_n_f32(vld1q_f32(&s[4][n]), m04));
+			in = vaddq_f32(in, vmulq_n_f32(vld1q_f32(&s[6][n]), m06));
+			vst1q_f32(&d[0][n], in);
+			in = vmulq_n_f32(vld1q_f32(&s[1][n]), m11);
+			in = vaddq_f32(in, ctr);
+			in = vaddq_f32(in, vmulq_n_f32(vld1q_f32(&s[5][n]), m15));
+			in = vaddq_f32(in, vmulq_n_f32(vld1q_f32(&s[7][n]), m17));
+			vst1q_f32(&d[1][n], in);
+		}
+		for(; n < n_samples; n++) {
+			const float c = m2 * s[2][n] + m3 * s[3][n];
+			d[0][n] = s[0][n] * m00 + c + s[4][n] * m04 + s[6][n] * m06;
+			d[1][n] = s[1][n] * m11 + c + s[5][n] * m15 + s[7][n] * m17;
+		}
+	}
+}
@@ -36,10 +36,25 @@ static const struct channelmix_info {
 	uint32_t cpu_flags;
 } channelmix_table[] =
 {
+#if defined (HAVE_AVX512)
+	MAKE(2, MASK_MONO, 2, MASK_MONO, channelmix_copy_avx512, SPA_CPU_FLAG_AVX512),
+	MAKE(2, MASK_STEREO, 2, MASK_STEREO, channelmix_copy_avx512, SPA_CPU_FLAG_AVX512),
+	MAKE(EQ, 0, EQ, 0, channelmix_copy_avx512, SPA_CPU_FLAG_AVX512),
+#endif
+#if defined (HAVE_AVX2)
+	MAKE(2, MASK_MONO, 2, MASK_MONO, channelmix_copy_avx2, SPA_CPU_FLAG_AVX2),
+	MAKE(2, MASK_STEREO, 2, MASK_STEREO, channelmix_copy_avx2, SPA_CPU_FLAG_AVX2),
+	MAKE(EQ, 0, EQ, 0, channelmix_copy_avx2, SPA_CPU_FLAG_AVX2),
+#endif
 #if defined (HAVE_SSE)
 	MAKE(2, MASK_MONO, 2, MASK_MONO, channelmix_copy_sse, SPA_CPU_FLAG_SSE),
 	MAKE(2, MASK_STEREO, 2, MASK_STEREO, channelmix_copy_sse, SPA_CPU_FLAG_SSE),
 	MAKE(EQ, 0, EQ, 0, channelmix_copy_sse, SPA_CPU_FLAG_SSE),
+#endif
+#if defined (HAVE_NEON)
+	MAKE(2, MASK_MONO, 2, MASK_MONO, channelmix_copy_neon, SPA_CPU_FLAG_NEON),
+	MAKE(2, MASK_STEREO, 2, MASK_STEREO, channelmix_copy_neon, SPA_CPU_FLAG_NEON),
+	MAKE(EQ, 0, EQ, 0, channelmix_copy_neon, SPA_CPU_FLAG_NEON),
 #endif
 	MAKE(2, MASK_MONO, 2, MASK_MONO, channelmix_copy_c),
 	MAKE(2, MASK_STEREO, 2, MASK_STEREO, channelmix_copy_c),
@@ -62,30 +77,66 @@ static const struct channelmix_info {
 	MAKE(2, MASK_STEREO, 8, MASK_7_1, channelmix_f32_2_7p1_sse, SPA_CPU_FLAG_SSE),
 #endif
 	MAKE(2, MASK_STEREO, 8, MASK_7_1, channelmix_f32_2_7p1_c),
+#if defined (HAVE_AVX2)
+	MAKE(4, MASK_3_1, 2, MASK_STEREO, channelmix_f32_3p1_2_avx2, SPA_CPU_FLAG_AVX2),
+#endif
 #if defined (HAVE_SSE)
 	MAKE(4, MASK_3_1, 2, MASK_STEREO, channelmix_f32_3p1_2_sse, SPA_CPU_FLAG_SSE),
 #endif
 	MAKE(4, MASK_3_1, 2, MASK_STEREO, channelmix_f32_3p1_2_c),
+#if defined (HAVE_AVX2)
+	MAKE(6, MASK_5_1, 2, MASK_STEREO, channelmix_f32_5p1_2_avx2, SPA_CPU_FLAG_AVX2),
+#endif
 #if defined (HAVE_SSE)
 	MAKE(6, MASK_5_1, 2, MASK_STEREO, channelmix_f32_5p1_2_sse, SPA_CPU_FLAG_SSE),
+#endif
+#if defined (HAVE_NEON)
+	MAKE(6, MASK_5_1, 2, MASK_STEREO, channelmix_f32_5p1_2_neon, SPA_CPU_FLAG_NEON),
 #endif
 	MAKE(6, MASK_5_1, 2, MASK_STEREO, channelmix_f32_5p1_2_c),
+#if defined (HAVE_AVX2)
+	MAKE(6, MASK_5_1, 4, MASK_QUAD, channelmix_f32_5p1_4_avx2, SPA_CPU_FLAG_AVX2),
+#endif
 #if defined (HAVE_SSE)
 	MAKE(6, MASK_5_1, 4, MASK_QUAD, channelmix_f32_5p1_4_sse, SPA_CPU_FLAG_SSE),
 #endif
 	MAKE(6, MASK_5_1, 4, MASK_QUAD, channelmix_f32_5p1_4_c),
 
+#if defined (HAVE_AVX2)
+	MAKE(6, MASK_5_1, 4, MASK_3_1, channelmix_f32_5p1_3p1_avx2, SPA_CPU_FLAG_AVX2),
+#endif
 #if defined (HAVE_SSE)
 	MAKE(6, MASK_5_1, 4, MASK_3_1, channelmix_f32_5p1_3p1_sse, SPA_CPU_FLAG_SSE),
 #endif
 	MAKE(6, MASK_5_1, 4, MASK_3_1, channelmix_f32_5p1_3p1_c),
 
+#if defined (HAVE_AVX2)
+	MAKE(8, MASK_7_1, 2, MASK_STEREO, channelmix_f32_7p1_2_avx2, SPA_CPU_FLAG_AVX2),
+#endif
+#if defined (HAVE_NEON)
+	MAKE(8, MASK_7_1, 2, MASK_STEREO, channelmix_f32_7p1_2_neon, SPA_CPU_FLAG_NEON),
+#endif
 	MAKE(8, MASK_7_1, 2, MASK_STEREO, channelmix_f32_7p1_2_c),
+#if defined (HAVE_AVX2)
+	MAKE(8, MASK_7_1, 4, MASK_QUAD, channelmix_f32_7p1_4_avx2, SPA_CPU_FLAG_AVX2),
+#endif
 	MAKE(8, MASK_7_1, 4, MASK_QUAD, channelmix_f32_7p1_4_c),
+#if defined (HAVE_AVX2)
+	MAKE(8, MASK_7_1, 4, MASK_3_1, channelmix_f32_7p1_3p1_avx2, SPA_CPU_FLAG_AVX2),
+#endif
 	MAKE(8, MASK_7_1, 4, MASK_3_1, channelmix_f32_7p1_3p1_c),
 
+#if defined (HAVE_AVX512)
+	MAKE(ANY, 0, ANY, 0, channelmix_f32_n_m_avx512, SPA_CPU_FLAG_AVX512),
+#endif
+#if defined (HAVE_AVX2)
+	MAKE(ANY, 0, ANY, 0, channelmix_f32_n_m_avx2, SPA_CPU_FLAG_AVX2),
+#endif
 #if defined (HAVE_SSE)
 	MAKE(ANY, 0, ANY, 0, channelmix_f32_n_m_sse, SPA_CPU_FLAG_SSE),
+#endif
+#if defined (HAVE_NEON)
+	MAKE(ANY, 0, ANY, 0, channelmix_f32_n_m_neon, SPA_CPU_FLAG_NEON),
 #endif
 	MAKE(ANY, 0, ANY, 0, channelmix_f32_n_m_c),
 };
@@ -137,5 +137,26 @@ DEFINE_FUNCTION(f32_5p1_3p1, sse);
 DEFINE_FUNCTION(f32_5p1_4, sse);
 DEFINE_FUNCTION(f32_7p1_4, sse);
 #endif
+#if defined (HAVE_AVX2)
+DEFINE_FUNCTION(copy, avx2);
+DEFINE_FUNCTION(f32_n_m, avx2);
+DEFINE_FUNCTION(f32_3p1_2, avx2);
+DEFINE_FUNCTION(f32_5p1_2, avx2);
+DEFINE_FUNCTION(f32_5p1_3p1, avx2);
+DEFINE_FUNCTION(f32_5p1_4, avx2);
+DEFINE_FUNCTION(f32_7p1_2, avx2);
+DEFINE_FUNCTION(f32_7p1_3p1, avx2);
+DEFINE_FUNCTION(f32_7p1_4, avx2);
+#endif
+#if defined (HAVE_AVX512)
+DEFINE_FUNCTION(copy, avx512);
+DEFINE_FUNCTION(f32_n_m, avx512);
+#endif
+#if defined (HAVE_NEON)
+DEFINE_FUNCTION(copy, neon);
+DEFINE_FUNCTION(f32_n_m, neon);
+DEFINE_FUNCTION(f32_5p1_2, neon);
+DEFINE_FUNCTION(f32_7p1_2, neon);
+#endif
 
 #undef DEFINE_FUNCTION
@@ -0,0 +1,250 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#include <spa/support/log.h>
+#include <spa/utils/defs.h>
+
+#include "meter.h"
+
+#define MAX_CHUNK	256
+
+static void set_k_weighting(struct meter *m)
+{
+	double K, Q, Vh, Vb, a0;
+
+	/* stage 1, the high shelf modeling the acoustic effect of the head */
+	K = tan(M_PI * 1681.974450955533 / m->rate);
+	Q = 0.7071752369554196;
+	Vh = pow(10.0, 3.999843853973347 / 20.0);
+	Vb = pow(Vh, 0.4996667741545416);
+	a0 = 1.0 + K / Q + K * K;
+	m->shelf.type = BQ_RAW;
+	m->shelf.b0 = (float)((Vh + Vb * K / Q + K * K) / a0);
+	m->shelf.b1 = (float)(2.0 * (K * K - Vh) / a0);
+	m->shelf.b2 = (float)((Vh - Vb * K / Q + K * K) / a0);
+	m->shelf.a1 = (float)(2.0 * (K * K - 1.0) / a0);
+	m->shelf.a2 = (float)((1.0 - K / Q + K * K) / a0);
+
+	/* stage 2, the RLB high pass */
+	K = tan(M_PI * 38.13547087602444 / m->rate);
+	Q = 0.5003270373238773;
+	a0 = 1.0 + K / Q + K * K;
+	m->highpass.type = BQ_RAW;
+	m->highpass.b0 = 1.0f;
+	m->highpass.b1 = -2.0f;
+	m->highpass.b2 = 1.0f;
+	m->highpass.a1 = (float)(2.0 * (K * K - 1.0) / a0);
+	m->highpass.a2 = (float)((1.0 - K / Q + K * K) / a0);
+}
+
+/* Hann windowed sinc interpolator for the intermediate phases, phase 0 is
+ * the original signal. The output of phase p lies between x[5] and x[6]. */
+static void set_true_peak(struct meter *m)
+{
+	uint32_t p, k;
+
+	for (p = 1; p < METER_TP_PHASES; p++) {
+		double sum = 0.0, t, w, h[METER_TP_TAPS];
+
+		for (k = 0; k < METER_TP_TAPS; k++) {
+			t = (double)k - (METER_TP_TAPS / 2 - 1) - (double)p / METER_TP_PHASES;
+			w = 0.5 * (1.0 + cos(M_PI * t / (METER_TP_TAPS / 2)));
+			h[k] = w * sin(M_PI * t) / (M_PI * t);
+			sum += h[k];
+		}
+		for (k = 0; k < METER_TP_TAPS; k++)
+			m->tp_coef[p - 1][k] = (float)(h[k] / sum);
+	}
+}
+
+static float channel_weight(uint32_t position)
+{
+	switch (position) {
+	case SPA_AUDIO_CHANNEL_LFE:
+	case SPA_AUDIO_CHANNEL_LFE2:
+		return 0.0f;
+	case SPA_AUDIO_CHANNEL_SL:
+	case SPA_AUDIO_CHANNEL_SR:
+	case SPA_AUDIO_CHANNEL_RL:
+	case SPA_AUDIO_CHANNEL_RR:
+		return 1.41f;
+	default:
+		return 1.0f;
+	}
+}
+
+void meter_reset(struct meter *m)
+{
+	uint32_t i;
+
+	for (i = 0; i < m->channels; i++) {
+		struct meter_channel *c = &m->ch[i];
+		spa_zero(c->x1);
+		spa_zero(c->x2);
+		spa_zero(c->hist);
+		c->sum = 0.0;
+	}
+	m->block_fill = 0;
+	m->block_pos = 0;
+	m->n_blocks = 0;
+	m->peak = 0.0f;
+}
+
+int meter_init(struct meter *m)
+{
+	uint32_t i;
+	int res;
+
+	if (m->rate == 0 || m->channels == 0 || m->channels > SPA_AUDIO_MAX_CHANNELS)
+		return -EINVAL;
+
+	m->peaks.cpu_flags = m->cpu_flags;
+	m->peaks.log = m->log;
+	if ((res = peaks_init(&m->peaks)) < 0)
+		return res;
+
+	set_k_weighting(m);
+	set_true_peak(m);
+
+	m->block_size = SPA_MAX(m->rate * METER_BLOCK_MS / 1000, 1u);
+	for (i = 0; i < m->channels; i++)
+		m->ch[i].weight = channel_weight(m->position[i]);
+
+	meter_reset(m);
+
+	spa_log_debug(m->log, "%p: rate:%u channels:%u block:%u peaks:%s", m,
+			m->rate, m->channels, m->block_size, m->peaks.func_name);
+	return 0;
+}
+
+void meter_free(struct meter *m)
+{
+	if (m->peaks.free)
+		peaks_free(&m->peaks);
+	m->rate = 0;
+	m->channels = 0;
+}
+
+static double k_weight_sum(struct meter *m, struct meter_channel *c,
+		const float * SPA_RESTRICT s, uint32_t n_samples)
+{
+	const struct biquad *a = &m->shelf, *b = &m->highpass;
+	float x1 = c->x1[0], x2 = c->x2[0];
+	float y1 = c->x1[1], y2 = c->x2[1];
+	float x, y, z;
+	double sum = 0.0;
+	uint32_t i;
+
+	for (i = 0; i < n_samples; i++) {
+		x  = s[i];
+		y  = a->b0 * x                + x1;
+		x1 = a->b1 * x - a->a1 * y    + x2;
+		x2 = a->b2 * x - a->a2 * y;
+		z  = b->b0 * y                + y1;
+		y1 = b->b1 * y - b->a1 * z    + y2;
+		y2 = b->b2 * y - b->a2 * z;
+		sum += z * z;
+	}
+#define F(x) (isnormal(x) ? (x) : 0.0f)
+	c->x1[0] = F(x1);
+	c->x2[0] = F(x2);
+	c->x1[1] = F(y1);
+	c->x2[1] = F(y2);
+#undef F
+	return sum;
+}
+
+static float true_peak(struct meter *m, struct meter_channel *c,
+		const float * SPA_RESTRICT s, uint32_t n_samples, float peak)
+{
+	float x[MAX_CHUNK + METER_TP_TAPS - 1], out[MAX_CHUNK];
+	uint32_t i, k, p;
+
+	peak = peaks_abs_max(&m->peaks, s, n_samples, peak);
+
+	memcpy(x, c->hist, sizeof(c->hist));
+	memcpy(&x[METER_TP_TAPS - 1], s, n_samples * sizeof(float));
+
+	for (p = 0; p < METER_TP_PHASES - 1; p++) {
+		const float *h = m->tp_coef[p];
+		for (i = 0; i < n_samples; i++) {
+			float sum = 0.0f;
+			for (k = 0; k < METER_TP_TAPS; k++)
+				sum += h[k] * x[i + k];
+			out[i] = sum;
+		}
+		peak = peaks_abs_max(&m->peaks, out, n_samples, peak);
+	}
+	memcpy(c->hist, &x[n_samples], sizeof(c->hist));
+	return peak;
+}
+
+uint32_t meter_process(struct meter *m, const float * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, chunk, offset = 0, n_blocks = 0;
+	float peak = m->peak;
+
+	while (offset < n_samples) {
+		chunk = SPA_MIN(n_samples - offset, m->block_size - m->block_fill);
+		chunk = SPA_MIN(chunk, (uint32_t)MAX_CHUNK);
+
+		for (i = 0; i < m->channels; i++) {
+			struct meter_channel *c = &m->ch[i];
+			const float *s = &src[i][offset];
+
+			c->sum += k_weight_sum(m, c, s, chunk);
+			peak = true_peak(m, c, s, chunk, peak);
+		}
+		offset += chunk;
+		m->block_fill += chunk;
+
+		if (m->block_fill == m->block_size) {
+			double energy = 0.0;
+
+			for (i = 0; i < m->channels; i++) {
+				struct meter_channel *c = &m->ch[i];
+				energy += c->weight * c->sum;
+				c->sum = 0.0;
+			}
+			m->blocks[m->block_pos] = energy / m->block_size;
+			m->block_pos = (m->block_pos + 1) % METER_SHORT_TERM_BLOCKS;
+			m->n_blocks = SPA_MIN(m->n_blocks + 1, (uint32_t)METER_SHORT_TERM_BLOCKS);
+			m->block_fill = 0;
+			n_blocks++;
+		}
+	}
+	m->peak = peak;
+	return n_blocks;
+}
+
+static float to_lufs(double energy)
+{
+	if (energy <= 0.0)
+		return METER_MIN_DB;
+	return SPA_MAX((float)(-0.691 + 10.0 * log10(energy)), METER_MIN_DB);
+}
+
+static double mean_blocks(struct meter *m, uint32_t n_blocks)
+{
+	uint32_t i, n = SPA_MIN(n_blocks, m->n_blocks);
+	double sum = 0.0;
+
+	for (i = 0; i < n; i++)
+		sum += m->blocks[(m->block_pos + METER_SHORT_TERM_BLOCKS - 1 - i) %
+			METER_SHORT_TERM_BLOCKS];
+	return n ? sum / n : 0.0;
+}
+
+void meter_get_result(struct meter *m, struct meter_result *res)
+{
+	res->momentary = to_lufs(mean_blocks(m, METER_MOMENTARY_BLOCKS));
+	res->short_term = to_lufs(mean_blocks(m, METER_SHORT_TERM_BLOCKS));
+	res->true_peak = m->peak > 0.0f ?
+		SPA_MAX(20.0f * log10f(m->peak), METER_MIN_DB) : METER_MIN_DB;
+	m->peak = 0.0f;
+}
@@ -0,0 +1,66 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <spa/utils/defs.h>
+#include <spa/param/audio/raw.h>
+
+#include "biquad.h"
+#include "peaks-ops.h"
+
+/* ITU-R BS.1770 loudness and true-peak meter.
+ *
+ * Samples are K-weighted and the mean square is accumulated in 100ms
+ * blocks. The momentary loudness is the mean of the last 4 blocks, the
+ * short-term loudness the mean of the last 30 blocks. The true-peak is
+ * measured on a 4x oversampled signal. */
+#define METER_BLOCK_MS			100
+#define METER_MOMENTARY_BLOCKS		4
+#define METER_SHORT_TERM_BLOCKS		30
+#define METER_TP_PHASES			4
+#define METER_TP_TAPS			12
+#define METER_MIN_DB			-120.0f
+
+struct meter_channel {
+	float weight;
+	float x1[2], x2[2];
+	float hist[METER_TP_TAPS - 1];
+	double sum;
+};
+
+struct meter {
+	uint32_t cpu_flags;
+	struct spa_log *log;
+
+	uint32_t rate;
+	uint32_t channels;
+	uint32_t position[SPA_AUDIO_MAX_CHANNELS];
+
+	struct peaks peaks;
+	struct biquad shelf;
+	struct biquad highpass;
+	float tp_coef[METER_TP_PHASES - 1][METER_TP_TAPS];
+
+	uint32_t block_size;
+	uint32_t block_fill;
+	uint32_t block_pos;
+	uint32_t n_blocks;
+	double blocks[METER_SHORT_TERM_BLOCKS];
+	float peak;
+
+	struct meter_channel ch[SPA_AUDIO_MAX_CHANNELS];
+};
+
+struct meter_result {
+	float momentary;
+	float short_term;
+	float true_peak;
+};
+
+int meter_init(struct meter *m);
+void meter_reset(struct meter *m);
+/* returns the number of completed blocks */
+uint32_t meter_process(struct meter *m, const float * SPA_RESTRICT src[], uint32_t n_samples);
+/* get the loudness and the true-peak since the last call */
+void meter_get_result(struct meter *m, struct meter_result *res);
+void meter_free(struct meter *m);
@@ -38,6 +38,7 @@ struct native_data {
 	float **history;
 	resample_func_t func;
 	float *filter;
+	struct native_filter *shared;
 	float *hist_mem;
 	const struct resample_info *info;
 };
@@ -3,8 +3,10 @@
 /* SPDX-License-Identifier: MIT */
 
 #include <errno.h>
+#include <pthread.h>
 
 #include <spa/param/audio/format.h>
+#include <spa/utils/list.h>
 
 #include "resample-native-impl.h"
 #ifndef RESAMPLE_DISABLE_PRECOMP
@@ -82,6 +84,160 @@ static int build_filter(float *taps, uint32_t stride, uint32_t n_taps, uint32_t
 	return 0;
 }
 
+/* filters only depend on the reduced rates and the quality, they are
+ * shared between all resamplers in the process. Some unused filters
+ * are kept around so that a format change does not rebuild them. */
+#define MAX_IDLE_FILTERS	4
+
+struct native_filter {
+	struct spa_list link;
+	int ref;
+	uint32_t in_rate;
+	uint32_t out_rate;
+	int quality;
+	uint32_t size;
+	float *taps;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct spa_list filters;
+	uint32_t n_idle;
+	uint64_t hits;
+	uint64_t misses;
+} filter_cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.filters = { &filter_cache.filters, &filter_cache.filters },
+};
+
+static struct native_filter *filter_find(uint32_t in_rate, uint32_t out_rate, int quality)
+{
+	struct native_filter *f;
+	spa_list_for_each(f, &filter_cache.filters, link) {
+		if (f->in_rate == in_rate && f->out_rate == out_rate &&
+		    f->quality == quality)
+			return f;
+	}
+	return NULL;
+}
+
+static void filter_ref(struct native_filter *f)
+{
+	if (f->ref++ == 0)
+		filter_cache.n_idle--;
+	/* keep recently used filters at the front */
+	spa_list_remove(&f->link);
+	spa_list_prepend(&filter_cache.filters, &f->link);
+}
+
+static void filter_unref(struct native_filter *f)
+{
+	struct native_filter *t;
+
+	pthread_mutex_lock(&filter_cache.lock);
+	if (--f->ref == 0)
+		filter_cache.n_idle++;
+
+	while (filter_cache.n_idle > MAX_IDLE_FILTERS) {
+		spa_list_for_each_reverse(t, &filter_cache.filters, link) {
+			if (t->ref == 0)
+				break;
+		}
+		spa_list_remove(&t->link);
+		filter_cache.n_idle--;
+		free(t);
+	}
+	pthread_mutex_unlock(&filter_cache.lock);
+}
+
+static struct native_filter *filter_acquire(struct resample *r, uint32_t in_rate, uint32_t out_rate,
+		uint32_t n_taps, uint32_t n_phases, uint32_t stride, double cutoff)
+{
+	struct native_filter *f, *t;
+	uint32_t size = stride * (n_phases + 1);
+#ifndef RESAMPLE_DISABLE_PRECOMP
+	uint32_t c;
+#endif
+
+	pthread_mutex_lock(&filter_cache.lock);
+	if ((f = filter_find(in_rate, out_rate, r->quality)) != NULL) {
+		filter_ref(f);
+		filter_cache.hits++;
+	}
+	pthread_mutex_unlock(&filter_cache.lock);
+
+	if (f != NULL) {
+		spa_log_debug(r->log, "using shared filter for %u->%u(%u)",
+				r->i_rate, r->o_rate, r->quality);
+		return f;
+	}
+
+	/* build outside of the lock, this can take a while for the
+	 * higher qualities */
+	f = calloc(1, sizeof(struct native_filter) + size + 64);
+	if (f == NULL)
+		return NULL;
+
+	f->ref = 1;
+	f->in_rate = in_rate;
+	f->out_rate = out_rate;
+	f->quality = r->quality;
+	f->size = size;
+	f->taps = SPA_PTROFF_ALIGN(f, sizeof(struct native_filter), 64, float);
+
+#ifndef RESAMPLE_DISABLE_PRECOMP
+	/* See if we have precomputed coefficients */
+	for (c = 0; precomp_coeffs[c].filter; c++) {
+		if (precomp_coeffs[c].in_rate == r->i_rate &&
+				precomp_coeffs[c].out_rate == r->o_rate &&
+				precomp_coeffs[c].quality == r->quality)
+			break;
+	}
+
+	if (precomp_coeffs[c].filter) {
+		spa_log_debug(r->log, "using precomputed filter for %u->%u(%u)",
+				r->i_rate, r->o_rate, r->quality);
+		spa_memcpy(f->taps, precomp_coeffs[c].filter, size);
+	} else {
+#endif
+		build_filter(f->taps, stride / sizeof(float), n_taps, n_phases, cutoff);
+#ifndef RESAMPLE_DISABLE_PRECOMP
+	}
+#endif
+
+	pthread_mutex_lock(&filter_cache.lock);
+	if ((t = filter_find(in_rate, out_rate, r->quality)) != NULL) {
+		/* someone else built the same filter in the meantime */
+		filter_ref(t);
+		filter_cache.hits++;
+		free(f);
+		f = t;
+	} else {
+		spa_list_prepend(&filter_cache.filters, &f->link);
+		filter_cache.misses++;
+	}
+	pthread_mutex_unlock(&filter_cache.lock);
+
+	return f;
+}
+
+void resample_native_cache_stats(struct resample_cache_stats *stats)
+{
+	struct native_filter *f;
+
+	spa_zero(*stats);
+
+	pthread_mutex_lock(&filter_cache.lock);
+	spa_list_for_each(f, &filter_cache.filters, link) {
+		stats->n_filters++;
+		stats->n_users += f->ref;
+		stats->size += f->size;
+	}
+	stats->hits = filter_cache.hits;
+	stats->misses = filter_cache.misses;
+	pthread_mutex_unlock(&filter_cache.lock);
+}
+
 MAKE_RESAMPLER_COPY(c);
 
 #define MAKE(fmt,copy,full,inter,...) \
@@ -119,7 +275,11 @@ static const struct resample_info *find_resample_info(uint32_t format, uint32_t
 
 static void impl_native_free(struct resample *r)
 {
+	struct native_data *d = r->data;
+
 	spa_log_debug(r->log, "native %p: free", r);
+	if (d != NULL && d->shared != NULL)
+		filter_unref(d->shared);
 	free(r->data);
 	r->data = NULL;
 }
@@ -342,7 +502,7 @@ int resample_native_init(struct resample *r)
 	struct native_data *d;
 	const struct quality *q;
 	double scale;
-	uint32_t c, n_taps, n_phases, filter_size, in_rate, out_rate, gcd, filter_stride;
+	uint32_t c, n_taps, n_phases, in_rate, out_rate, gcd, filter_stride;
 	uint32_t history_stride, history_size, oversample;
 
 	r->quality = SPA_CLAMP(r->quality, 0, (int) SPA_N_ELEMENTS(window_qualities) - 1);
@@ -375,12 +535,10 @@ int resample_native_init(struct resample *r)
 	n_phases *= oversample;
 
 	filter_stride = SPA_ROUND_UP_N(n_taps * sizeof(float), 64);
-	filter_size = filter_stride * (n_phases + 1);
 	history_stride = SPA_ROUND_UP_N(2 * n_taps * sizeof(float), 64);
 	history_size = r->channels * history_stride;
 
 	d = calloc(1, sizeof(struct native_data) +
-			filter_size +
 			history_size +
 			(r->channels * sizeof(float*)) +
 			64);
@@ -393,33 +551,17 @@ int resample_native_init(struct resample *r)
 	d->n_phases = n_phases;
 	d->in_rate = in_rate;
 	d->out_rate = out_rate;
-	d->filter = SPA_PTROFF_ALIGN(d, sizeof(struct native_data), 64, float);
-	d->hist_mem = SPA_PTROFF_ALIGN(d->filter, filter_size, 64, float);
+	d->hist_mem = SPA_PTROFF_ALIGN(d, sizeof(struct native_data), 64, float);
 	d->history = SPA_PTROFF(d->hist_mem, history_size, float*);
 	d->filter_stride = filter_stride / sizeof(float);
 	d->filter_stride_os = d->filter_stride * oversample;
 	for (c = 0; c < r->channels; c++)
 		d->history[c] = SPA_PTROFF(d->hist_mem, c * history_stride, float);
 
-#ifndef RESAMPLE_DISABLE_PRECOMP
-	/* See if we have precomputed coefficients */
-	for (c = 0; precomp_coeffs[c].filter; c++) {
-		if (precomp_coeffs[c].in_rate == r->i_rate &&
-				precomp_coeffs[c].out_rate == r->o_rate &&
-				precomp_coeffs[c].quality == r->quality)
-			break;
-	}
-
-	if (precomp_coeffs[c].filter) {
-		spa_log_debug(r->log, "using precomputed filter for %u->%u(%u)",
-				r->i_rate, r->o_rate, r->quality);
-		spa_memcpy(d->filter, precomp_coeffs[c].filter, filter_size);
-	} else {
-#endif
-		build_filter(d->filter, d->filter_stride, n_taps, n_phases, scale);
-#ifndef RESAMPLE_DISABLE_PRECOMP
-	}
-#endif
+	d->shared = filter_acquire(r, in_rate, out_rate, n_taps, n_phases, filter_stride, scale);
+	if (d->shared == NULL)
+		return -errno;
+	d->filter = d->shared->taps;
 
 	d->info = find_resample_info(SPA_AUDIO_FORMAT_F32, r->cpu_flags);
 	if (SPA_UNLIKELY(d->info == NULL)) {
@@ -48,7 +48,16 @@ struct resample {
 #define resample_delay(r)		(r)->delay(r)
 #define resample_phase(r)		(r)->phase(r)
 
+struct resample_cache_stats {
+	uint32_t n_filters;		/**< filters in the cache */
+	uint32_t n_users;		/**< resamplers using a cached filter */
+	size_t size;			/**< memory used by the filters */
+	uint64_t hits;			/**< filters that were reused */
+	uint64_t misses;		/**< filters that needed to be built */
+};
+
 int resample_native_init(struct resample *r);
+void resample_native_cache_stats(struct resample_cache_stats *stats);
 int resample_peaks_init(struct resample *r);
 
 #endif /* RESAMPLE_H */
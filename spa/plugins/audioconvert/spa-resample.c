@@ -268,8 +268,14 @@ static int do_conversion(struct data *d)
 			written += pout_len;
 		}
 	}
-	if (d->verbose)
+	if (d->verbose) {
+		struct resample_cache_stats stats;
+
+		resample_native_cache_stats(&stats);
 		fprintf(stdout, "read %zu samples, wrote %zu samples\n", read, written);
+		fprintf(stdout, "filter cache: filters:%u size:%zu hits:%"PRIu64" misses:%"PRIu64"\n",
+				stats.n_filters, stats.size, stats.hits, stats.misses);
+	}
 
 	return 0;
 }
@@ -8,9 +8,11 @@
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
+#include <math.h>
 
 #include <spa/utils/names.h>
 #include <spa/utils/string.h>
+#include <spa/utils/atomic.h>
 #include <spa/support/plugin.h>
 #include <spa/param/param.h>
 #include <spa/param/audio/format.h>
@@ -1116,6 +1118,93 @@ static int test_convert_remap_conv(struct context *ctx)
 	return 0;
 }
 
+#define METER_SAMPLES	4800
+
+static float meter_in[METER_SAMPLES];
+static float meter_out[METER_SAMPLES];
+
+struct data dsp_meter = {
+	.mode = SPA_PARAM_PORT_CONFIG_MODE_dsp,
+	.info = SPA_AUDIO_INFO_RAW_INIT(
+		.format = SPA_AUDIO_FORMAT_F32,
+		.rate = 48000,
+		.channels = 1,
+		.position = { SPA_AUDIO_CHANNEL_MONO, }),
+	.ports = 1,
+	.planes = 1,
+	.data = { meter_in, },
+	.size = sizeof(meter_in)
+};
+
+struct data conv_meter = {
+	.mode = SPA_PARAM_PORT_CONFIG_MODE_convert,
+	.info = SPA_AUDIO_INFO_RAW_INIT(
+		.format = SPA_AUDIO_FORMAT_F32,
+		.rate = 48000,
+		.channels = 1,
+		.position = { SPA_AUDIO_CHANNEL_MONO, }),
+	.ports = 1,
+	.planes = 1,
+	.data = { meter_out, },
+	.size = sizeof(meter_out)
+};
+
+static void set_meter_enable(struct context *ctx, bool enable)
+{
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod_frame f[2];
+	struct spa_pod *param;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	spa_pod_builder_push_object(&b, &f[0], SPA_TYPE_OBJECT_Props, SPA_PARAM_Props);
+	spa_pod_builder_prop(&b, SPA_PROP_params, 0);
+	spa_pod_builder_push_struct(&b, &f[1]);
+	spa_pod_builder_string(&b, "meter.enable");
+	spa_pod_builder_bool(&b, enable);
+	spa_pod_builder_pop(&b, &f[1]);
+	param = spa_pod_builder_pop(&b, &f[0]);
+
+	spa_assert_se(spa_node_set_param(ctx->convert_node, SPA_PARAM_Props, 0, param) == 0);
+}
+
+/* the meter results are written in the meter io area, 100ms of a 1kHz
+ * sine of -6dB gives one update */
+static int test_meter(struct context *ctx)
+{
+	struct spa_io_meter io;
+	uint32_t i;
+
+	for (i = 0; i < METER_SAMPLES; i++)
+		meter_in[i] = meter_out[i] = 0.5f * sinf(2.0f * (float)M_PI * 1000.0f * i / 48000.0f);
+
+	spa_zero(io);
+	spa_assert_se(spa_node_set_io(ctx->convert_node, SPA_IO_Meter, &io, sizeof(io)) == 0);
+	spa_assert_se(spa_node_set_io(ctx->convert_node, SPA_IO_Meter, &io, 4) == -EINVAL);
+
+	/* nothing is written when the meter is disabled */
+	run_convert(ctx, &dsp_meter, &conv_meter);
+	spa_assert_se(SPA_SEQ_READ(io.seq) == 0);
+
+	set_meter_enable(ctx, true);
+	run_convert(ctx, &dsp_meter, &conv_meter);
+	spa_assert_se(SPA_SEQ_READ(io.seq) == 2);
+	spa_assert_se(io.true_peak > -6.5f && io.true_peak < -5.5f);
+	spa_assert_se(io.momentary > -11.0f && io.momentary < -8.5f);
+	spa_assert_se(io.short_term > -11.0f && io.short_term < -8.5f);
+
+	run_convert(ctx, &dsp_meter, &conv_meter);
+	spa_assert_se(SPA_SEQ_READ(io.seq) == 4);
+
+	/* no io, the meter still runs */
+	spa_assert_se(spa_node_set_io(ctx->convert_node, SPA_IO_Meter, NULL, 0) == 0);
+	run_convert(ctx, &dsp_meter, &conv_meter);
+	spa_assert_se(SPA_SEQ_READ(io.seq) == 4);
+
+	set_meter_enable(ctx, false);
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	struct context ctx;
@@ -1140,6 +1229,8 @@ int main(int argc, char *argv[])
 	test_convert_remap_dsp(&ctx);
 	test_convert_remap_conv(&ctx);
 
+	test_meter(&ctx);
+
 	clean_context(&ctx);
 
 	return 0;
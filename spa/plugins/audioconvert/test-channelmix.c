@@ -323,6 +323,24 @@ static void run_n_m_impl(struct channelmix *mix, const void **src, uint32_t n_sa
 		check_samples((float**)dst_c, (float**)dst_x, dst_chan, n_samples);
 	}
 #endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		channelmix_f32_n_m_avx2(mix, dst_x, src, n_samples);
+		check_samples((float**)dst_c, (float**)dst_x, dst_chan, n_samples);
+	}
+#endif
+#if defined(HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		channelmix_f32_n_m_avx512(mix, dst_x, src, n_samples);
+		check_samples((float**)dst_c, (float**)dst_x, dst_chan, n_samples);
+	}
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		channelmix_f32_n_m_neon(mix, dst_x, src, n_samples);
+		check_samples((float**)dst_c, (float**)dst_x, dst_chan, n_samples);
+	}
+#endif
 }
 
 static void test_n_m_impl(void)
@@ -368,6 +386,65 @@ static void test_n_m_impl(void)
 	run_n_m_impl(&mix, (const void**)src, N_SAMPLES);
 }
 
+static void run_downmix_impl(uint32_t src_chan, uint32_t src_mask,
+		uint32_t dst_chan, uint32_t dst_mask, channelmix_func_t func_c)
+{
+	struct channelmix mix;
+	uint32_t i, j;
+	float src_data[src_chan][N_SAMPLES], *src[src_chan];
+	float dst_c_data[dst_chan][N_SAMPLES], dst_x_data[dst_chan][N_SAMPLES];
+	void *dst_c[dst_chan], *dst_x[dst_chan];
+
+	spa_log_debug(&logger.log, "start %d->%d (%08x -> %08x)", src_chan, dst_chan, src_mask, dst_mask);
+
+	for (i = 0; i < src_chan; i++) {
+		for (j = 0; j < N_SAMPLES; j++)
+			src_data[i][j] = (float)((drand48() - 0.5f) * 2.5f);
+		src[i] = src_data[i];
+	}
+	for (i = 0; i < dst_chan; i++) {
+		dst_c[i] = dst_c_data[i];
+		dst_x[i] = dst_x_data[i];
+	}
+
+	spa_zero(mix);
+	mix.src_chan = src_chan;
+	mix.dst_chan = dst_chan;
+	mix.src_mask = src_mask;
+	mix.dst_mask = dst_mask;
+	mix.log = &logger.log;
+	mix.cpu_flags = cpu_flags;
+	spa_assert_se(channelmix_init(&mix) == 0);
+	channelmix_set_volume(&mix, 0.8f, false, 0, NULL);
+
+	func_c(&mix, dst_c, (const void**)src, N_SAMPLES);
+
+	/* whatever implementation was selected for the current CPU */
+	channelmix_process(&mix, dst_x, (const void**)src, N_SAMPLES);
+	spa_log_debug(&logger.log, "compare %s", mix.func_name);
+	check_samples((float**)dst_c, (float**)dst_x, dst_chan, N_SAMPLES);
+
+	channelmix_free(&mix);
+}
+
+static void test_downmix_impl(void)
+{
+	run_downmix_impl(4, _M(FL)|_M(FR)|_M(FC)|_M(LFE),
+			2, _M(FL)|_M(FR), channelmix_f32_3p1_2_c);
+	run_downmix_impl(6, _M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR),
+			2, _M(FL)|_M(FR), channelmix_f32_5p1_2_c);
+	run_downmix_impl(6, _M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR),
+			4, _M(FL)|_M(FR)|_M(FC)|_M(LFE), channelmix_f32_5p1_3p1_c);
+	run_downmix_impl(6, _M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR),
+			4, _M(FL)|_M(FR)|_M(RL)|_M(RR), channelmix_f32_5p1_4_c);
+	run_downmix_impl(8, _M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR)|_M(RL)|_M(RR),
+			2, _M(FL)|_M(FR), channelmix_f32_7p1_2_c);
+	run_downmix_impl(8, _M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR)|_M(RL)|_M(RR),
+			4, _M(FL)|_M(FR)|_M(FC)|_M(LFE), channelmix_f32_7p1_3p1_c);
+	run_downmix_impl(8, _M(FL)|_M(FR)|_M(FC)|_M(LFE)|_M(SL)|_M(SR)|_M(RL)|_M(RR),
+			4, _M(FL)|_M(FR)|_M(RL)|_M(RR), channelmix_f32_7p1_4_c);
+}
+
 int main(int argc, char *argv[])
 {
 	struct timespec ts;
@@ -391,6 +468,7 @@ int main(int argc, char *argv[])
 	test_7p1_N();
 
 	test_n_m_impl();
+	test_downmix_impl();
 
 	return 0;
 }
@@ -0,0 +1,169 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+
+#include <spa/support/log-impl.h>
+
+SPA_LOG_IMPL(logger);
+
+static uint32_t cpu_flags;
+
+#include "test-helper.h"
+#include "meter.h"
+
+#define RATE		48000
+#define N_SAMPLES	(RATE * 3)
+
+static float samples[2][N_SAMPLES];
+static float silence[N_SAMPLES];
+
+static void init_meter(struct meter *m, uint32_t channels, const uint32_t *position)
+{
+	spa_zero(*m);
+	m->log = &logger.log;
+	m->cpu_flags = cpu_flags;
+	m->rate = RATE;
+	m->channels = channels;
+	memcpy(m->position, position, channels * sizeof(uint32_t));
+	spa_assert_se(meter_init(m) == 0);
+}
+
+static void run_meter(struct meter *m, const float *src[], uint32_t n_samples,
+		uint32_t chunk)
+{
+	const float *s[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t i, j, n;
+
+	for (i = 0; i < n_samples; i += n) {
+		n = SPA_MIN(chunk, n_samples - i);
+		for (j = 0; j < m->channels; j++)
+			s[j] = &src[j][i];
+		meter_process(m, s, n);
+	}
+}
+
+static void test_sine(void)
+{
+	static const uint32_t pos[] = { SPA_AUDIO_CHANNEL_FL, SPA_AUDIO_CHANNEL_FR };
+	struct meter m;
+	struct meter_result res;
+	const float *src[2] = { samples[0], silence };
+	uint32_t i;
+
+	/* a 0 dBFS 997 Hz sine in one channel reads -3.01 LUFS */
+	for (i = 0; i < N_SAMPLES; i++)
+		samples[0][i] = sinf(2.0f * (float)M_PI * 997.0f * i / RATE);
+
+	init_meter(&m, 2, pos);
+	run_meter(&m, src, N_SAMPLES, 1024);
+	meter_get_result(&m, &res);
+
+	fprintf(stderr, "momentary:%f short-term:%f true-peak:%f\n",
+			res.momentary, res.short_term, res.true_peak);
+	spa_assert(fabsf(res.momentary - -3.01f) < 0.05f);
+	spa_assert(fabsf(res.short_term - -3.01f) < 0.05f);
+	spa_assert(fabsf(res.true_peak) < 0.1f);
+
+	/* true-peak is reset after reading the result */
+	meter_get_result(&m, &res);
+	spa_assert(res.true_peak == METER_MIN_DB);
+
+	meter_free(&m);
+}
+
+static void test_true_peak(void)
+{
+	static const uint32_t pos[] = { SPA_AUDIO_CHANNEL_MONO };
+	struct meter m;
+	struct meter_result res;
+	const float *src[1] = { samples[0] };
+	float sample_peak = 0.0f;
+	uint32_t i;
+
+	/* a sine at rate/4 with a 45 degree phase never has a sample at its
+	 * peak, the sample peak is -3 dBFS and the true-peak 0 dBTP */
+	for (i = 0; i < RATE; i++) {
+		samples[0][i] = sinf((float)M_PI * ((i % 4) / 2.0f + 0.25f));
+		sample_peak = SPA_MAX(sample_peak, fabsf(samples[0][i]));
+	}
+	spa_assert(fabsf(20.0f * log10f(sample_peak) - -3.01f) < 0.01f);
+
+	init_meter(&m, 1, pos);
+	run_meter(&m, src, RATE, 333);
+	meter_get_result(&m, &res);
+
+	fprintf(stderr, "true-peak:%f\n", res.true_peak);
+	spa_assert(fabsf(res.true_peak) < 0.5f);
+
+	meter_free(&m);
+}
+
+static void test_silence(void)
+{
+	static const uint32_t pos[] = { SPA_AUDIO_CHANNEL_FL, SPA_AUDIO_CHANNEL_FR };
+	struct meter m;
+	struct meter_result res;
+	const float *src[2] = { silence, silence };
+	uint32_t n_blocks;
+
+	init_meter(&m, 2, pos);
+
+	/* no complete block yet */
+	n_blocks = meter_process(&m, src, RATE / 20);
+	spa_assert(n_blocks == 0);
+	n_blocks = meter_process(&m, src, RATE / 20);
+	spa_assert(n_blocks == 1);
+
+	meter_get_result(&m, &res);
+	spa_assert(res.momentary == METER_MIN_DB);
+	spa_assert(res.short_term == METER_MIN_DB);
+	spa_assert(res.true_peak == METER_MIN_DB);
+
+	meter_free(&m);
+}
+
+static void test_lfe(void)
+{
+	static const uint32_t pos[] = { SPA_AUDIO_CHANNEL_FL, SPA_AUDIO_CHANNEL_LFE };
+	struct meter m;
+	struct meter_result res;
+	const float *src[2] = { silence, samples[0] };
+	uint32_t i;
+
+	/* the LFE channel is not included in the loudness */
+	for (i = 0; i < RATE; i++)
+		samples[0][i] = sinf(2.0f * (float)M_PI * 997.0f * i / RATE);
+
+	init_meter(&m, 2, pos);
+	run_meter(&m, src, RATE, 480);
+	meter_get_result(&m, &res);
+
+	spa_assert(res.momentary == METER_MIN_DB);
+	spa_assert(fabsf(res.true_peak) < 0.1f);
+
+	meter_free(&m);
+}
+
+int main(int argc, char *argv[])
+{
+	logger.log.level = SPA_LOG_LEVEL_TRACE;
+
+	cpu_flags = get_cpu_flags();
+	printf("got CPU flags %d\n", cpu_flags);
+
+	test_sine();
+	test_true_peak();
+	test_silence();
+	test_lfe();
+
+	return 0;
+}
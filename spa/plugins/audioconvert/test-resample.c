@@ -15,6 +15,7 @@
 SPA_LOG_IMPL(logger);
 
 #include "resample.h"
+#include "resample-native-impl.h"
 
 #define N_SAMPLES	253
 #define N_CHANNELS	11
@@ -146,12 +147,63 @@ static void test_in_len(void)
 	resample_free(&r);
 }
 
+static void init_native(struct resample *r, uint32_t i_rate, uint32_t o_rate, int quality)
+{
+	spa_zero(*r);
+	r->log = &logger.log;
+	r->channels = 2;
+	r->i_rate = i_rate;
+	r->o_rate = o_rate;
+	r->quality = quality;
+	spa_assert_se(resample_native_init(r) == 0);
+}
+
+static void test_cache(void)
+{
+	struct resample r1, r2, r3;
+	struct native_data *d1, *d2, *d3;
+	struct resample_cache_stats s1, s2;
+
+	resample_native_cache_stats(&s1);
+
+	init_native(&r1, 22050, 24000, 6);
+	/* same reduced rates and quality share the filter */
+	init_native(&r2, 44100, 48000, 6);
+	/* other quality gets its own filter */
+	init_native(&r3, 44100, 48000, 7);
+
+	d1 = r1.data;
+	d2 = r2.data;
+	d3 = r3.data;
+	spa_assert_se(d1->filter == d2->filter);
+	spa_assert_se(d1->filter != d3->filter);
+
+	resample_native_cache_stats(&s2);
+	spa_assert_se(s2.hits == s1.hits + 1);
+	spa_assert_se(s2.misses == s1.misses + 2);
+	spa_assert_se(s2.n_users == s1.n_users + 3);
+
+	resample_free(&r1);
+	resample_free(&r2);
+	resample_free(&r3);
+
+	resample_native_cache_stats(&s2);
+	spa_assert_se(s2.n_users == s1.n_users);
+
+	/* unused filters are kept around for a while */
+	init_native(&r1, 44100, 48000, 6);
+	resample_native_cache_stats(&s2);
+	spa_assert_se(s2.hits == s1.hits + 2);
+	resample_free(&r1);
+}
+
 int main(int argc, char *argv[])
 {
 	logger.log.level = SPA_LOG_LEVEL_TRACE;
 
 	test_native();
 	test_in_len();
+	test_cache();
 
 	return 0;
 }
@@ -0,0 +1,46 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "volume-ops.h"
+
+#include <immintrin.h>
+
+void
+volume_f32_avx512(struct volume *vol, void * SPA_RESTRICT dst,
+		const void * SPA_RESTRICT src, float volume, uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	float *d = (float*)dst;
+	const float *s = (const float*)src;
+
+	if (volume == VOLUME_MIN) {
+		memset(d, 0, n_samples * sizeof(float));
+	}
+	else if (volume == VOLUME_NORM) {
+		spa_memcpy(d, s, n_samples * sizeof(float));
+	}
+	else {
+		__m512 t[4];
+		const __m512 vol = _mm512_set1_ps(volume);
+
+		unrolled = n_samples & ~63;
+
+		for(n = 0; n < unrolled; n += 64) {
+			t[0] = _mm512_loadu_ps(&s[n]);
+			t[1] = _mm512_loadu_ps(&s[n+16]);
+			t[2] = _mm512_loadu_ps(&s[n+32]);
+			t[3] = _mm512_loadu_ps(&s[n+48]);
+			_mm512_storeu_ps(&d[n], _mm512_mul_ps(t[0], vol));
+			_mm512_storeu_ps(&d[n+16], _mm512_mul_ps(t[1], vol));
+			_mm512_storeu_ps(&d[n+32], _mm512_mul_ps(t[2], vol));
+			_mm512_storeu_ps(&d[n+48], _mm512_mul_ps(t[3], vol));
+		}
+		for(; n < n_samples; n += 16) {
+			uint32_t left = n_samples - n;
+			__mmask16 mask = left >= 16 ? 0xffff : (__mmask16)((1u << left) - 1);
+			_mm512_mask_storeu_ps(&d[n], mask,
+					_mm512_mul_ps(_mm512_maskz_loadu_ps(mask, &s[n]), vol));
+		}
+	}
+}
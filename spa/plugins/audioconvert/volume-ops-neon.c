@@ -0,0 +1,41 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "volume-ops.h"
+
+#include <arm_neon.h>
+
+void
+volume_f32_neon(struct volume *vol, void * SPA_RESTRICT dst,
+		const void * SPA_RESTRICT src, float volume, uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	float *d = (float*)dst;
+	const float *s = (const float*)src;
+
+	if (volume == VOLUME_MIN) {
+		memset(d, 0, n_samples * sizeof(float));
+	}
+	else if (volume == VOLUME_NORM) {
+		spa_memcpy(d, s, n_samples * sizeof(float));
+	}
+	else {
+		float32x4_t t[4];
+
+		unrolled = n_samples & ~15;
+
+		for(n = 0; n < unrolled; n += 16) {
+			t[0] = vld1q_f32(&s[n]);
+			t[1] = vld1q_f32(&s[n+4]);
+			t[2] = vld1q_f32(&s[n+8]);
+			t[3] = vld1q_f32(&s[n+12]);
+			vst1q_f32(&d[n], vmulq_n_f32(t[0], volume));
+			vst1q_f32(&d[n+4], vmulq_n_f32(t[1], volume));
+			vst1q_f32(&d[n+8], vmulq_n_f32(t[2], volume));
+			vst1q_f32(&d[n+12], vmulq_n_f32(t[3], volume));
+		}
+		for(; n < n_samples; n++)
+			d[n] = s[n] * volume;
+	}
+}
@@ -25,8 +25,17 @@ static const struct volume_info {
 	uint32_t cpu_flags;
 } volume_table[] =
 {
+#if defined (HAVE_AVX512)
+	MAKE(volume_f32_avx512, SPA_CPU_FLAG_AVX512),
+#endif
+#if defined (HAVE_AVX2)
+	MAKE(volume_f32_avx2, SPA_CPU_FLAG_AVX2),
+#endif
 #if defined (HAVE_SSE)
 	MAKE(volume_f32_sse, SPA_CPU_FLAG_SSE),
+#endif
+#if defined (HAVE_NEON)
+	MAKE(volume_f32_neon, SPA_CPU_FLAG_NEON),
 #endif
 	MAKE(volume_f32_c),
 };
@@ -44,5 +44,14 @@ DEFINE_FUNCTION(f32, c);
 #if defined (HAVE_SSE)
 DEFINE_FUNCTION(f32, sse);
 #endif
+#if defined (HAVE_AVX2)
+DEFINE_FUNCTION(f32, avx2);
+#endif
+#if defined (HAVE_AVX512)
+DEFINE_FUNCTION(f32, avx512);
+#endif
+#if defined (HAVE_NEON)
+DEFINE_FUNCTION(f32, neon);
+#endif
 
 #undef DEFINE_FUNCTION
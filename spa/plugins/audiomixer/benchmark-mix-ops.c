@@ -27,7 +27,7 @@ struct stats {
 };
 
 #define MAX_SAMPLES	4096
-#define MAX_SRC		11
+#define MAX_SRC		64
 
 #define MAX_COUNT 100
 
@@ -35,14 +35,15 @@ static uint8_t samp_in[MAX_SAMPLES * MAX_SRC * 8];
 static uint8_t samp_out[MAX_SAMPLES * 8];
 
 static const int sample_sizes[] = { 0, 1, 128, 513, 4096 };
-static const int src_counts[] = { 1, 2, 4, 6, 8, 11 };
+static const int src_counts[] = { 1, 2, 4, 6, 8, 11, 16, 32, 64 };
 
 #define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * SPA_N_ELEMENTS(src_counts) * 70
 
 static uint32_t n_results = 0;
 static struct stats results[MAX_RESULTS];
 
-static void run_test1(const char *name, const char *impl, mix_func_t func, int n_src, int n_samples)
+static void run_test1(const char *name, const char *impl, mix_func_t func, int n_src, int n_samples,
+		uint32_t stream_size)
 {
 	int i, j;
 	const void *ip[n_src];
@@ -52,6 +53,7 @@ static void run_test1(const char *name, const char *impl, mix_func_t func, int n
 	struct mix_ops mix;
 
 	mix.n_channels = 1;
+	mix.stream_size = stream_size;
 
 	for (j = 0; j < n_src; j++)
 		ip[j] = SPA_PTR_ALIGN(&samp_in[j * n_samples * 4], 32, void);
@@ -86,11 +88,20 @@ static void run_test(const char *name, const char *impl, mix_func_t func)
 	for (i = 0; i < SPA_N_ELEMENTS(sample_sizes); i++) {
 		for (j = 0; j < SPA_N_ELEMENTS(src_counts); j++) {
 			run_test1(name, impl, func, src_counts[j],
-				(sample_sizes[i] + (src_counts[j] -1)) / src_counts[j]);
+				(sample_sizes[i] + (src_counts[j] -1)) / src_counts[j],
+				MIX_OPS_STREAM_SIZE);
 		}
 	}
 }
 
+/* many sources of one quantum, with and without non-temporal stores */
+static void run_test_stream(const char *name, const char *impl, const char *stream_impl,
+		mix_func_t func)
+{
+	run_test1(name, impl, func, MAX_SRC, 1024, 0);
+	run_test1(name, stream_impl, func, MAX_SRC, 1024, 1);
+}
+
 static void test_s8(void)
 {
 	run_test("test_s8", "c", mix_s8_c);
@@ -138,6 +149,7 @@ static void test_u32(void)
 static void test_f32(void)
 {
 	run_test("test_f32", "c", mix_f32_c);
+	run_test1("test_f32_many", "c", mix_f32_c, MAX_SRC, 1024, 0);
 #if defined (HAVE_SSE)
 	if (cpu_flags & SPA_CPU_FLAG_SSE) {
 		run_test("test_f32", "sse", mix_f32_sse);
@@ -146,6 +158,18 @@ static void test_f32(void)
 #if defined (HAVE_AVX)
 	if (cpu_flags & SPA_CPU_FLAG_AVX) {
 		run_test("test_f32", "avx", mix_f32_avx);
+		run_test_stream("test_f32_many", "avx", "avx-stream", mix_f32_avx);
+	}
+#endif
+#if defined (HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32", "avx512", mix_f32_avx512);
+		run_test_stream("test_f32_many", "avx512", "avx512-stream", mix_f32_avx512);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_f32", "neon", mix_f32_neon);
 	}
 #endif
 }
@@ -19,7 +19,7 @@ mix_f32_avx(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTR
 	n_samples *= ops->n_channels;
 
 	if (n_src == 0)
-		memset(dst, 0, n_samples * ops->n_channels * sizeof(float));
+		memset(dst, 0, n_samples * sizeof(float));
 	else if (n_src == 1) {
 		if (dst != src[0])
 			spa_memcpy(dst, src[0], n_samples * sizeof(float));
@@ -27,6 +27,7 @@ mix_f32_avx(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTR
 		uint32_t i, n, unrolled;
 		const float **s = (const float **)src;
 		float *d = dst;
+		bool stream;
 
 		if (SPA_LIKELY(SPA_IS_ALIGNED(dst, 32))) {
 			unrolled = n_samples & ~31;
@@ -39,6 +40,8 @@ mix_f32_avx(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTR
 		} else
 			unrolled = 0;
 
+		stream = mix_ops_use_stream(ops, n_src, n_samples, sizeof(float));
+
 		for (n = 0; n < unrolled; n += 32) {
 			__m256 in[4];
 
@@ -52,11 +55,20 @@ mix_f32_avx(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTR
 				in[2] = _mm256_add_ps(in[2], _mm256_load_ps(&s[i][n + 16]));
 				in[3] = _mm256_add_ps(in[3], _mm256_load_ps(&s[i][n + 24]));
 			}
-			_mm256_store_ps(&d[n +  0], in[0]);
-			_mm256_store_ps(&d[n +  8], in[1]);
-			_mm256_store_ps(&d[n + 16], in[2]);
-			_mm256_store_ps(&d[n + 24], in[3]);
+			if (SPA_UNLIKELY(stream)) {
+				_mm256_stream_ps(&d[n +  0], in[0]);
+				_mm256_stream_ps(&d[n +  8], in[1]);
+				_mm256_stream_ps(&d[n + 16], in[2]);
+				_mm256_stream_ps(&d[n + 24], in[3]);
+			} else {
+				_mm256_store_ps(&d[n +  0], in[0]);
+				_mm256_store_ps(&d[n +  8], in[1]);
+				_mm256_store_ps(&d[n + 16], in[2]);
+				_mm256_store_ps(&d[n + 24], in[3]);
+			}
 		}
+		if (stream && unrolled > 0)
+			_mm_sfence();
 		for (; n < n_samples; n++) {
 			__m128 in[1];
 			in[0] = _mm_load_ss(&s[0][n]);
@@ -0,0 +1,58 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <spa/utils/defs.h>
+
+#include "mix-ops.h"
+
+#include <arm_neon.h>
+
+void
+mix_f32_neon(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	n_samples *= ops->n_channels;
+
+	if (n_src == 0)
+		memset(dst, 0, n_samples * sizeof(float));
+	else if (n_src == 1) {
+		if (dst != src[0])
+			spa_memcpy(dst, src[0], n_samples * sizeof(float));
+	} else {
+		uint32_t i, n, unrolled;
+		const float **s = (const float **)src;
+		float *d = dst;
+
+		unrolled = n_samples & ~15;
+
+		for (n = 0; n < unrolled; n += 16) {
+			float32x4_t in[4];
+
+			in[0] = vld1q_f32(&s[0][n +  0]);
+			in[1] = vld1q_f32(&s[0][n +  4]);
+			in[2] = vld1q_f32(&s[0][n +  8]);
+			in[3] = vld1q_f32(&s[0][n + 12]);
+			for (i = 1; i < n_src; i++) {
+				in[0] = vaddq_f32(in[0], vld1q_f32(&s[i][n +  0]));
+				in[1] = vaddq_f32(in[1], vld1q_f32(&s[i][n +  4]));
+				in[2] = vaddq_f32(in[2], vld1q_f32(&s[i][n +  8]));
+				in[3] = vaddq_f32(in[3], vld1q_f32(&s[i][n + 12]));
+			}
+			vst1q_f32(&d[n +  0], in[0]);
+			vst1q_f32(&d[n +  4], in[1]);
+			vst1q_f32(&d[n +  8], in[2]);
+			vst1q_f32(&d[n + 12], in[3]);
+		}
+		for (; n < n_samples; n++) {
+			float t = s[0][n];
+			for (i = 1; i < n_src; i++)
+				t += s[i][n];
+			d[n] = t;
+		}
+	}
+}
@@ -26,6 +26,10 @@ struct mix_info {
 static struct mix_info mix_table[] =
 {
 	/* f32 */
+#if defined(HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_AVX512, 4, mix_f32_avx512 },
+	{ SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_AVX512, 4, mix_f32_avx512 },
+#endif
 #if defined(HAVE_AVX)
 	{ SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_AVX, 4, mix_f32_avx },
 	{ SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_AVX, 4, mix_f32_avx },
@@ -33,6 +37,10 @@ static struct mix_info mix_table[] =
 #if defined (HAVE_SSE)
 	{ SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_SSE, 4, mix_f32_sse },
 	{ SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_SSE, 4, mix_f32_sse },
+#endif
+#if defined (HAVE_NEON)
+	{ SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_NEON, 4, mix_f32_neon },
+	{ SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_NEON, 4, mix_f32_neon },
 #endif
 	{ SPA_AUDIO_FORMAT_F32, 0, 0, 4, mix_f32_c },
 	{ SPA_AUDIO_FORMAT_F32P, 0, 0, 4, mix_f32_c },
@@ -108,6 +116,7 @@ int mix_ops_init(struct mix_ops *ops)
 
 	ops->priv = info;
 	ops->cpu_flags = info->cpu_flags;
+	ops->stream_size = MIX_OPS_STREAM_SIZE;
 	ops->clear = impl_mix_ops_clear;
 	ops->process = info->process;
 	ops->free = impl_mix_ops_free;
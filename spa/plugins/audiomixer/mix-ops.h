@@ -101,6 +101,10 @@ struct mix_ops {
 	uint32_t fmt;
 	uint32_t n_channels;
 	uint32_t cpu_flags;
+	/** mixes that touch at least this many bytes write the destination
+	 * with non-temporal stores, 0 to never use them. Set to
+	 * MIX_OPS_STREAM_SIZE by mix_ops_init() */
+	uint32_t stream_size;
 
 	void (*clear) (struct mix_ops *ops, void * SPA_RESTRICT dst, uint32_t n_samples);
 	void (*process) (struct mix_ops *ops,
@@ -124,6 +128,18 @@ void mix_##name##_##arch(struct mix_ops *ops, void * SPA_RESTRICT dst,	\
 		uint32_t n_samples)						\
 
 #define MIX_OPS_MAX_ALIGN	32u
+/* mixes that read and write at least this many bytes write the destination
+ * with non-temporal stores so that it doesn't evict the sources from the
+ * cache. That is 63 sources of 1024 samples. */
+#define MIX_OPS_STREAM_SIZE	(256u * 1024u)
+
+/* if the mix of n_src sources of n_samples should use non-temporal stores */
+static inline bool mix_ops_use_stream(struct mix_ops *ops, uint32_t n_src,
+		uint32_t n_samples, size_t sample_size)
+{
+	return ops->stream_size > 0 &&
+		(uint64_t)(n_src + 1) * n_samples * sample_size >= ops->stream_size;
+}
 
 DEFINE_FUNCTION(s8, c);
 DEFINE_FUNCTION(u8, c);
@@ -147,3 +163,9 @@ DEFINE_FUNCTION(f64, sse2);
 #if defined(HAVE_AVX)
 DEFINE_FUNCTION(f32, avx);
 #endif
+#if defined(HAVE_AVX512)
+DEFINE_FUNCTION(f32, avx512);
+#endif
+#if defined(HAVE_NEON)
+DEFINE_FUNCTION(f32, neon);
+#endif
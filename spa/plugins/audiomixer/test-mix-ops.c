@@ -227,6 +227,86 @@ static void test_f32(void)
 		run_test("test_f32_4_avx", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_f32_avx);
 	}
 #endif
+#if defined(HAVE_AVX512)
+	if (cpu_flags & SPA_CPU_FLAG_AVX512) {
+		run_test("test_f32_0_avx512", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_f32_avx512);
+		run_test("test_f32_1_avx512", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_f32_avx512);
+		run_test("test_f32_4_avx512", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_f32_avx512);
+	}
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_f32_0_neon", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_f32_neon);
+		run_test("test_f32_1_neon", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_f32_neon);
+		run_test("test_f32_4_neon", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_f32_neon);
+	}
+#endif
+}
+
+#define N_SRC_LARGE	64
+
+static float samp_in_large[N_SRC_LARGE][N_SAMPLES + 16] SPA_ALIGNED(64);
+static float samp_out_large[N_SAMPLES + 16] SPA_ALIGNED(64);
+
+static void run_test_f32_large(uint32_t n_samples, uint32_t offset, mix_func_t mix)
+{
+	/* never, the default and always non-temporal stores */
+	static const uint32_t stream_sizes[] = { 0, MIX_OPS_STREAM_SIZE, 1 };
+	const void *src[N_SRC_LARGE];
+	uint32_t i, k, n_src;
+
+	for (i = 0; i < N_SRC_LARGE; i++)
+		src[i] = &samp_in_large[i][offset];
+
+	for (k = 0; k < SPA_N_ELEMENTS(stream_sizes); k++) {
+		struct mix_ops ops = { .n_channels = 1, .stream_size = stream_sizes[k] };
+
+		for (n_src = 2; n_src <= N_SRC_LARGE; n_src *= 2) {
+			mix_f32_c(&ops, samp_out, src, n_src, n_samples);
+			mix(&ops, samp_out_large, src, n_src, n_samples);
+			compare_mem(n_src, offset, samp_out, samp_out_large, n_samples * sizeof(float));
+		}
+	}
+}
+
+static void test_f32_large(void)
+{
+	static const uint32_t sizes[] = { 1, 63, 64, 1000, N_SAMPLES };
+	struct mix_ops ops;
+	uint32_t i, j, k;
+
+	/* the largest mix reaches the default threshold */
+	ops.stream_size = MIX_OPS_STREAM_SIZE;
+	spa_assert_se(!mix_ops_use_stream(&ops, N_SRC_LARGE / 2, N_SAMPLES, sizeof(float)));
+	spa_assert_se(mix_ops_use_stream(&ops, N_SRC_LARGE, N_SAMPLES, sizeof(float)));
+	ops.stream_size = 0;
+	spa_assert_se(!mix_ops_use_stream(&ops, N_SRC_LARGE, N_SAMPLES, sizeof(float)));
+
+	for (i = 0; i < N_SRC_LARGE; i++)
+		for (j = 0; j < N_SAMPLES + 16; j++)
+			samp_in_large[i][j] = (float)((i * 7 + j * 13) % 101) / 50.0f - 1.0f;
+
+	for (k = 0; k < SPA_N_ELEMENTS(sizes); k++) {
+		for (j = 0; j < 2; j++) {
+			uint32_t offs = j * 3;
+#if defined(HAVE_SSE)
+			if (cpu_flags & SPA_CPU_FLAG_SSE)
+				run_test_f32_large(sizes[k], offs, mix_f32_sse);
+#endif
+#if defined(HAVE_AVX)
+			if (cpu_flags & SPA_CPU_FLAG_AVX)
+				run_test_f32_large(sizes[k], offs, mix_f32_avx);
+#endif
+#if defined(HAVE_AVX512)
+			if (cpu_flags & SPA_CPU_FLAG_AVX512)
+				run_test_f32_large(sizes[k], offs, mix_f32_avx512);
+#endif
+#if defined(HAVE_NEON)
+			if (cpu_flags & SPA_CPU_FLAG_NEON)
+				run_test_f32_large(sizes[k], offs, mix_f32_neon);
+#endif
+		}
+	}
 }
 
 static void test_f64(void)
@@ -267,6 +347,7 @@ int main(int argc, char *argv[])
 	test_s24_32();
 	test_u24_32();
 	test_f32();
+	test_f32_large();
 	test_f64();
 
 	return 0;
@@ -0,0 +1,213 @@
+/* Spa Bluez5 ISO I/O benchmark */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <math.h>
+
+#include <spa/param/audio/format.h>
+
+#include "iso-io-dummy.h"
+
+/* Runs one broadcast ISO group with N streams on a dummy ISO socket and
+ * measures the time to pull and encode all streams of the group, once
+ * with the streams encoded one after the other in the data thread and once
+ * with the encode threads of the group. The codec does the work of a
+ * transform of one LC3 frame of 10ms at 48kHz. */
+
+#define CYCLES		100
+#define RATE		48000
+#define FRAMES		480
+#define COEFFS		120
+
+struct codec_data {
+	float coeffs[COEFFS];
+};
+
+struct stream {
+	float pcm[FRAMES];
+	float phase;
+	uint32_t cycles;
+};
+
+static float window[COEFFS][FRAMES];
+
+static int codec_validate_config(const struct media_codec *codec, uint32_t flags,
+		const void *caps, size_t caps_size, struct spa_audio_info *info)
+{
+	spa_zero(*info);
+	info->media_type = SPA_MEDIA_TYPE_audio;
+	info->media_subtype = SPA_MEDIA_SUBTYPE_raw;
+	info->info.raw.format = SPA_AUDIO_FORMAT_F32;
+	info->info.raw.rate = RATE;
+	info->info.raw.channels = 1;
+	info->info.raw.position[0] = SPA_AUDIO_CHANNEL_MONO;
+	return 0;
+}
+
+static void *codec_init(const struct media_codec *codec, uint32_t flags,
+		void *config, size_t config_size, const struct spa_audio_info *info,
+		void *props, size_t mtu)
+{
+	return calloc(1, sizeof(struct codec_data));
+}
+
+static void codec_deinit(void *data)
+{
+	free(data);
+}
+
+static int codec_get_block_size(void *data)
+{
+	return FRAMES * sizeof(float);
+}
+
+static uint64_t codec_get_interval(void *data)
+{
+	return 10 * SPA_NSEC_PER_MSEC;
+}
+
+static int codec_start_encode(void *data, void *dst, size_t dst_size,
+		uint16_t seqnum, uint32_t timestamp)
+{
+	return 0;
+}
+
+static int codec_encode(void *data, const void *src, size_t src_size,
+		void *dst, size_t dst_size, size_t *dst_out, int *need_flush)
+{
+	struct codec_data *cd = data;
+	const float *s = src;
+	int8_t *d = dst;
+	uint32_t i, k;
+
+	if (src_size < FRAMES * sizeof(float) || dst_size < COEFFS)
+		return -EINVAL;
+
+	for (k = 0; k < COEFFS; k++) {
+		float sum = 0.0f;
+		for (i = 0; i < FRAMES; i++)
+			sum += s[i] * window[k][i];
+		cd->coeffs[k] = sum;
+		d[k] = (int8_t)SPA_CLAMPF(sum * 4.0f, -128.0f, 127.0f);
+	}
+	*dst_out = COEFFS;
+	*need_flush = NEED_FLUSH_ALL;
+	return FRAMES * sizeof(float);
+}
+
+static const struct media_codec bench_codec = {
+	.id = SPA_BLUETOOTH_AUDIO_CODEC_LC3,
+	.kind = MEDIA_CODEC_BAP,
+	.name = "bench",
+	.description = "Benchmark codec",
+	.validate_config = codec_validate_config,
+	.init = codec_init,
+	.deinit = codec_deinit,
+	.get_block_size = codec_get_block_size,
+	.get_interval = codec_get_interval,
+	.start_encode = codec_start_encode,
+	.encode = codec_encode,
+};
+
+static void stream_pull(struct spa_bt_iso_io *io)
+{
+	struct stream *s = io->user_data;
+	size_t out = 0;
+	int res, need_flush = 0;
+	uint32_t i;
+
+	for (i = 0; i < FRAMES; i++) {
+		s->pcm[i] = sinf(s->phase);
+		s->phase += 2.0f * (float)M_PI * 440.0f / RATE;
+	}
+	s->phase = fmodf(s->phase, 2.0f * (float)M_PI);
+
+	res = bench_codec.start_encode(io->codec_data, io->buf, sizeof(io->buf), 0, 0);
+	if (res >= 0)
+		res = bench_codec.encode(io->codec_data, s->pcm, sizeof(s->pcm),
+				io->buf + res, sizeof(io->buf) - res, &out, &need_flush);
+
+	io->size = res < 0 ? 0 : out;
+	io->timestamp += FRAMES;
+	io->resync = false;
+	s->cycles++;
+}
+
+/* the other end of the dummy ISO sockets is the remote device that
+ * drops everything */
+static void drain_streams(struct iso_dummy *d)
+{
+	uint8_t buf[4096];
+	uint32_t i;
+
+	for (i = 0; i < d->n_streams; i++)
+		while (recv(d->streams[i].fd[1], buf, sizeof(buf), MSG_DONTWAIT) > 0);
+}
+
+static int run(struct iso_dummy *d, uint32_t n_streams, uint32_t n_threads)
+{
+	struct stream streams[ISO_DUMMY_MAX_STREAMS];
+	struct spa_bt_iso_io *io;
+	uint32_t i;
+	int res;
+
+	if ((res = iso_dummy_start(d, &bench_codec, n_streams, n_threads, NULL)) < 0)
+		return res;
+
+	/* the loop is not running yet, we are the data thread */
+	for (i = 0; i < d->n_streams; i++) {
+		spa_zero(streams[i]);
+		spa_bt_iso_io_set_cb(d->streams[i].io, stream_pull, &streams[i]);
+	}
+
+	spa_loop_control_enter(d->control);
+	while (streams[0].cycles < CYCLES) {
+		spa_loop_control_iterate(d->control, -1);
+		drain_streams(d);
+	}
+	spa_loop_control_leave(d->control);
+
+	for (i = 0; i < d->n_streams; i++)
+		spa_bt_iso_io_set_cb(d->streams[i].io, NULL, NULL);
+
+	io = d->streams[0].io;
+	printf("%8u %8u %14.1f %14.1f %14.1f\n", n_streams, n_threads,
+			(double)io->encode_time / 1000.0,
+			(double)io->encode_time / n_streams / 1000.0,
+			(double)io->encode_time_max / 1000.0);
+
+	iso_dummy_stop(d);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t counts[] = { 2, 4, 8 };
+	struct iso_dummy d;
+	uint32_t i, k;
+	int res = 0;
+
+	if (iso_dummy_init(&d) < 0)
+		return 1;
+
+	for (k = 0; k < COEFFS; k++)
+		for (i = 0; i < FRAMES; i++)
+			window[k][i] = cosf((float)M_PI / FRAMES * (i + 0.5f) * (k + 0.5f));
+
+	printf("%d intervals of 10 msec, %d samples per stream\n", CYCLES, FRAMES);
+	printf("%8s %8s %14s %14s %14s\n", "streams", "threads",
+			"group usec", "stream usec", "group max");
+
+	SPA_FOR_EACH_ELEMENT_VAR(counts, c) {
+		if ((res = run(&d, *c, 0)) < 0 ||
+		    (res = run(&d, *c, *c - 1)) < 0) {
+			fprintf(stderr, "benchmark failed: %s\n", spa_strerror(res));
+			break;
+		}
+	}
+	iso_dummy_clear(&d);
+
+	return res < 0 ? 1 : 0;
+}
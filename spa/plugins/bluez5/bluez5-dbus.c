@@ -87,6 +87,8 @@ struct spa_bt_monitor {
 	struct spa_system *main_system;
 	struct spa_system *data_system;
 	struct spa_plugin_loader *plugin_loader;
+	struct spa_thread_utils *thread_utils;
+	struct spa_cpu *cpu;
 	struct spa_dbus *dbus;
 	struct spa_dbus_connection *dbus_connection;
 	DBusConnection *conn;
@@ -3837,7 +3839,8 @@ static int transport_create_iso_io(struct spa_bt_transport *transport)
 	}
 
 	spa_log_debug(monitor->log, "transport %p: new ISO IO", transport);
-	transport->iso_io = spa_bt_iso_io_create(transport, monitor->log, monitor->data_loop, monitor->data_system);
+	transport->iso_io = spa_bt_iso_io_create(transport, monitor->log, monitor->data_loop,
+			monitor->data_system, monitor->thread_utils, monitor->cpu);
 	if (transport->iso_io == NULL)
 		return -errno;
 
@@ -6923,6 +6926,8 @@ impl_init(const struct spa_handle_factory *factory,
 	this->main_system = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_System);
 	this->data_system = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataSystem);
 	this->plugin_loader = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_PluginLoader);
+	this->thread_utils = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_ThreadUtils);
+	this->cpu = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_CPU);
 
 	spa_log_topic_init(this->log, &log_topic);
 
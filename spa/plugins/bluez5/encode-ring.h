@@ -0,0 +1,108 @@
+/* Spa Bluez5 encode ring */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef SPA_BLUEZ5_ENCODE_RING_H
+#define SPA_BLUEZ5_ENCODE_RING_H
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/atomic.h>
+#include <spa/utils/ringbuffer.h>
+
+/** The clock of the cycle that queued the samples */
+struct encode_timing {
+	uint64_t time;
+	uint64_t duration;
+	uint64_t rate;
+	double rate_diff;
+	uint64_t resample_delay;
+	uint32_t write_index;
+};
+
+/** The samples that the data thread queues for the encode thread. The
+ * data thread is the only writer and the encode thread the only reader. */
+struct encode_ring {
+	struct spa_ringbuffer ring;
+	uint8_t *data;
+	uint32_t size;
+
+	/* written by the data thread */
+	uint32_t seq;
+	struct encode_timing shared;
+};
+
+static inline int encode_ring_init(struct encode_ring *r, uint32_t min_size)
+{
+	for (r->size = 1; r->size < min_size; r->size <<= 1);
+	if ((r->data = calloc(1, r->size)) == NULL)
+		return -errno;
+	spa_ringbuffer_init(&r->ring);
+	r->seq = 0;
+	spa_zero(r->shared);
+	return 0;
+}
+
+static inline void encode_ring_clear(struct encode_ring *r)
+{
+	free(r->data);
+	r->data = NULL;
+}
+
+/** In the data thread, the free space after \a index */
+static inline uint32_t encode_ring_get_write_index(struct encode_ring *r, uint32_t *index)
+{
+	int32_t filled = spa_ringbuffer_get_write_index(&r->ring, index);
+	return r->size - SPA_CLAMP(filled, 0, (int32_t)r->size);
+}
+
+/** In the data thread, copy \a size bytes to \a index, the space must be free */
+static inline void encode_ring_write(struct encode_ring *r, uint32_t index,
+		const void *data, uint32_t size)
+{
+	spa_ringbuffer_write_data(&r->ring, r->data, r->size,
+			index & (r->size - 1), data, size);
+}
+
+/** In the data thread, make the samples up to \a index available together
+ * with the clock of this cycle */
+static inline void encode_ring_write_update(struct encode_ring *r, uint32_t index,
+		const struct encode_timing *t)
+{
+	spa_ringbuffer_write_update(&r->ring, index);
+
+	SPA_SEQ_WRITE(r->seq);
+	r->shared = *t;
+	r->shared.write_index = index;
+	SPA_SEQ_WRITE(r->seq);
+}
+
+/** In the encode thread, the clock of the last update */
+static inline void encode_ring_get_timing(struct encode_ring *r, struct encode_timing *t)
+{
+	uint32_t seq1, seq2;
+
+	do {
+		seq1 = SPA_SEQ_READ(r->seq);
+		*t = r->shared;
+		seq2 = SPA_SEQ_READ(r->seq);
+	} while (!SPA_SEQ_READ_SUCCESS(seq1, seq2));
+}
+
+/** In the encode thread, the samples after \a index that were queued up to
+ * the update of \a t. Later samples don't match the clock of \a t. */
+static inline int32_t encode_ring_get_read_index(struct encode_ring *r,
+		const struct encode_timing *t, uint32_t *index)
+{
+	int32_t avail = spa_ringbuffer_get_read_index(&r->ring, index);
+	return SPA_MIN(avail, (int32_t)(t->write_index - *index));
+}
+
+static inline void encode_ring_read_update(struct encode_ring *r, uint32_t index)
+{
+	spa_ringbuffer_read_update(&r->ring, index);
+}
+
+#endif
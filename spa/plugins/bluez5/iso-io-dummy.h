@@ -0,0 +1,258 @@
+/* Spa Bluez5 dummy ISO group */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef SPA_BLUEZ5_ISO_IO_DUMMY_H
+#define SPA_BLUEZ5_ISO_IO_DUMMY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/loop.h>
+#include <spa/support/system.h>
+#include <spa/support/thread.h>
+#include <spa/utils/atomic.h>
+#include <spa/utils/dict.h>
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+#include <spa/utils/type.h>
+
+#include "iso-io.h"
+#include "media-codecs.h"
+#include "defs.h"
+
+/* One broadcast ISO group of the tests and benchmarks. The ISO sockets of
+ * the streams are socketpairs, the other end is the remote device. The
+ * process is the data thread of the group. */
+
+#define ISO_DUMMY_MAX_STREAMS	8
+
+struct iso_dummy_stream {
+	struct spa_bt_transport transport;
+	struct spa_bt_iso_io *io;
+	int fd[2];
+};
+
+struct iso_dummy {
+	void *hnd;
+	struct spa_handle *system_handle;
+	struct spa_handle *loop_handle;
+	struct spa_system *system;
+	struct spa_loop *loop;
+	struct spa_loop_control *control;
+
+	struct spa_thread_utils thread_utils;
+	int acquire_rt_result;
+	uint32_t created;
+	uint32_t joined;
+	uint32_t acquired;
+
+	struct spa_bt_adapter adapter;
+	struct spa_bt_device device;
+	struct spa_dict_item items[1];
+	struct spa_dict settings;
+	char threads[16];
+
+	struct iso_dummy_stream streams[ISO_DUMMY_MAX_STREAMS];
+	uint32_t n_streams;
+};
+
+static inline struct spa_thread *iso_dummy_thread_create(void *object,
+		const struct spa_dict *props, void *(*start)(void*), void *arg)
+{
+	struct iso_dummy *d = object;
+	pthread_t pt;
+	int res;
+
+	if ((res = pthread_create(&pt, NULL, start, arg)) != 0) {
+		errno = res;
+		return NULL;
+	}
+	SPA_ATOMIC_INC(d->created);
+	return (struct spa_thread*)pt;
+}
+
+static inline int iso_dummy_thread_join(void *object, struct spa_thread *thread, void **retval)
+{
+	struct iso_dummy *d = object;
+
+	SPA_ATOMIC_INC(d->joined);
+	return -pthread_join((pthread_t)thread, retval);
+}
+
+static inline int iso_dummy_thread_acquire_rt(void *object, struct spa_thread *thread, int priority)
+{
+	struct iso_dummy *d = object;
+
+	SPA_ATOMIC_INC(d->acquired);
+	return d->acquire_rt_result;
+}
+
+static const struct spa_thread_utils_methods iso_dummy_thread_utils_methods = {
+	SPA_VERSION_THREAD_UTILS_METHODS,
+	.create = iso_dummy_thread_create,
+	.join = iso_dummy_thread_join,
+	.acquire_rt = iso_dummy_thread_acquire_rt,
+};
+
+static inline struct spa_handle *iso_dummy_load_handle(struct iso_dummy *d,
+		const struct spa_support *support, uint32_t n_support, const char *name)
+{
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+	uint32_t i;
+	int res;
+
+	if ((enum_func = dlsym(d->hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		fprintf(stderr, "can't find enum function\n");
+		return NULL;
+	}
+	for (i = 0;;) {
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			fprintf(stderr, "can't find factory %s\n", name);
+			return NULL;
+		}
+		if (strcmp(factory->name, name) == 0)
+			break;
+	}
+	handle = calloc(1, spa_handle_factory_get_size(factory, NULL));
+	if ((res = spa_handle_factory_init(factory, handle,
+					NULL, support, n_support)) < 0) {
+		fprintf(stderr, "can't make factory instance %s: %s\n", name, spa_strerror(res));
+		free(handle);
+		return NULL;
+	}
+	return handle;
+}
+
+static inline int iso_dummy_init(struct iso_dummy *d)
+{
+	struct spa_support support[1];
+	const char *str;
+	char path[PATH_MAX];
+	void *iface;
+	int res;
+
+	spa_zero(*d);
+	d->thread_utils.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_ThreadUtils,
+			SPA_VERSION_THREAD_UTILS, &iso_dummy_thread_utils_methods, d);
+
+	if ((str = getenv("SPA_PLUGIN_DIR")) == NULL) {
+		fprintf(stderr, "SPA_PLUGIN_DIR is not set\n");
+		return -ENOENT;
+	}
+	snprintf(path, sizeof(path), "%s/support/libspa-support.so", str);
+
+	if ((d->hnd = dlopen(path, RTLD_NOW)) == NULL) {
+		fprintf(stderr, "can't load %s: %s\n", path, dlerror());
+		return -ENOENT;
+	}
+	if ((d->system_handle = iso_dummy_load_handle(d, NULL, 0, SPA_NAME_SUPPORT_SYSTEM)) == NULL)
+		return -ENOENT;
+	if ((res = spa_handle_get_interface(d->system_handle,
+					SPA_TYPE_INTERFACE_System, &iface)) < 0)
+		return res;
+	d->system = iface;
+	support[0] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_System, iface);
+
+	if ((d->loop_handle = iso_dummy_load_handle(d, support, 1, SPA_NAME_SUPPORT_LOOP)) == NULL)
+		return -ENOENT;
+	if ((res = spa_handle_get_interface(d->loop_handle,
+					SPA_TYPE_INTERFACE_Loop, &iface)) < 0)
+		return res;
+	d->loop = iface;
+	if ((res = spa_handle_get_interface(d->loop_handle,
+					SPA_TYPE_INTERFACE_LoopControl, &iface)) < 0)
+		return res;
+	d->control = iface;
+	return 0;
+}
+
+static inline void iso_dummy_clear(struct iso_dummy *d)
+{
+	spa_handle_clear(d->loop_handle);
+	spa_handle_clear(d->system_handle);
+	free(d->loop_handle);
+	free(d->system_handle);
+	dlclose(d->hnd);
+}
+
+/** Destroy the group */
+static inline void iso_dummy_stop(struct iso_dummy *d)
+{
+	struct iso_dummy_stream *s;
+
+	/* the group is destroyed with its last stream */
+	while (d->n_streams > 0) {
+		s = &d->streams[--d->n_streams];
+		spa_bt_iso_io_destroy(s->io);
+		close(s->fd[0]);
+		close(s->fd[1]);
+	}
+}
+
+/** Make a group of \a n_streams sink streams that uses \a n_threads encode
+ * threads */
+static inline int iso_dummy_start(struct iso_dummy *d, const struct media_codec *codec,
+		uint32_t n_streams, uint32_t n_threads, struct spa_cpu *cpu)
+{
+	struct iso_dummy_stream *s;
+	uint32_t i;
+	int res;
+
+	d->n_streams = 0;
+	spa_zero(d->adapter);
+	spa_zero(d->device);
+	d->device.adapter = &d->adapter;
+
+	snprintf(d->threads, sizeof(d->threads), "%u", n_threads);
+	d->items[0] = SPA_DICT_ITEM_INIT("bluez5.iso.encode-threads", d->threads);
+	d->settings = SPA_DICT_INIT_ARRAY(d->items);
+	d->device.settings = &d->settings;
+
+	for (i = 0; i < SPA_MIN(n_streams, (uint32_t)ISO_DUMMY_MAX_STREAMS); i++) {
+		s = &d->streams[i];
+		spa_zero(*s);
+
+		if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, s->fd) < 0) {
+			res = -errno;
+			goto error;
+		}
+		s->transport.device = &d->device;
+		s->transport.profile = SPA_BT_PROFILE_BAP_BROADCAST_SINK;
+		s->transport.bap_big = 1;
+		s->transport.bap_bis = i;
+		s->transport.media_codec = codec;
+		s->transport.fd = s->fd[0];
+		s->transport.write_mtu = 1024;
+
+		if (i == 0)
+			s->io = spa_bt_iso_io_create(&s->transport, NULL, d->loop, d->system,
+					&d->thread_utils, cpu);
+		else
+			s->io = spa_bt_iso_io_attach(d->streams[0].io, &s->transport);
+		if (s->io == NULL) {
+			res = -errno;
+			close(s->fd[0]);
+			close(s->fd[1]);
+			goto error;
+		}
+		d->n_streams++;
+	}
+	return 0;
+
+error:
+	iso_dummy_stop(d);
+	return res;
+}
+
+#endif
@@ -9,9 +9,13 @@
 #include <stdio.h>
 #include <errno.h>
 #include <limits.h>
+#include <sched.h>
+#include <semaphore.h>
 
 #include <spa/support/loop.h>
 #include <spa/support/log.h>
+#include <spa/support/thread.h>
+#include <spa/utils/atomic.h>
 #include <spa/utils/list.h>
 #include <spa/utils/string.h>
 #include <spa/utils/result.h>
@@ -34,6 +38,28 @@ SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.bluez5.iso");
 #define LATENCY_PERIOD		(1000 * SPA_NSEC_PER_MSEC)
 #define MAX_LATENCY		(50 * SPA_NSEC_PER_MSEC)
 
+#define MAX_ENCODE_THREADS	8
+#define MAX_JOBS		32
+#define JOBS_CLOSED		(1u << 31)
+
+/* Threads that pull the sink streams of the group in parallel. The data
+ * thread takes jobs as well. It never sleeps on the threads, when all jobs
+ * are taken it yields until the jobs of the threads are done. The threads
+ * run with the realtime priority of the data thread so that they are not
+ * starved by it. */
+struct encode_pool {
+	struct spa_thread_utils *thread_utils;
+	struct spa_thread *threads[MAX_ENCODE_THREADS];
+	uint32_t n_threads;
+	sem_t sem;
+	int quit;
+
+	struct stream *jobs[MAX_JOBS];
+	uint32_t n_jobs;
+	uint32_t next_job;		/* JOBS_CLOSED between runs */
+	uint32_t done_jobs;
+};
+
 struct group {
 	struct spa_log *log;
 	struct spa_loop *data_loop;
@@ -46,6 +72,10 @@ struct group {
 	uint64_t duration;
 	bool flush;
 	bool started;
+
+	struct encode_pool *pool;
+	uint64_t encode_time;
+	uint64_t encode_time_max;
 };
 
 struct stream {
@@ -57,6 +87,7 @@ struct stream {
 	bool idle;
 
 	spa_bt_iso_io_pull_t pull;
+	spa_bt_iso_io_done_t done;
 
 	const struct media_codec *codec;
 	uint32_t block_size;
@@ -217,6 +248,173 @@ static bool group_latency_check(struct group *group)
 	return false;
 }
 
+static void stream_pull(struct stream *stream)
+{
+	stream->idle = false;
+	stream->this.now = stream->group->next;
+	stream->pull(&stream->this);
+}
+
+/* take jobs until all are taken */
+static void encode_pool_work(struct encode_pool *pool)
+{
+	uint32_t i;
+
+	while ((i = SPA_ATOMIC_INC(pool->next_job) - 1) < pool->n_jobs) {
+		stream_pull(pool->jobs[i]);
+		SPA_ATOMIC_INC(pool->done_jobs);
+	}
+}
+
+static void *encode_thread(void *data)
+{
+	struct encode_pool *pool = data;
+
+	while (true) {
+		if (sem_wait(&pool->sem) < 0)
+			continue;
+		if (SPA_ATOMIC_LOAD(pool->quit))
+			break;
+		encode_pool_work(pool);
+	}
+	return NULL;
+}
+
+/* in the data thread */
+static void encode_pool_run(struct encode_pool *pool, struct stream **jobs, uint32_t n_jobs)
+{
+	uint32_t i;
+
+	memcpy(pool->jobs, jobs, n_jobs * sizeof(jobs[0]));
+	pool->n_jobs = n_jobs;
+	SPA_ATOMIC_STORE(pool->done_jobs, 0);
+	SPA_ATOMIC_STORE(pool->next_job, 0);
+
+	for (i = 0; i < SPA_MIN(n_jobs - 1, pool->n_threads); i++)
+		sem_post(&pool->sem);
+
+	encode_pool_work(pool);
+	while (SPA_ATOMIC_LOAD(pool->done_jobs) < n_jobs)
+		sched_yield();
+
+	/* a late thread can't take jobs while the next run is set up */
+	SPA_ATOMIC_STORE(pool->next_job, JOBS_CLOSED);
+}
+
+static void group_pull(struct group *group, bool resync)
+{
+	struct encode_pool *pool = group->pool;
+	struct stream *stream;
+	struct stream *jobs[MAX_JOBS];
+	uint32_t n_jobs = 0;
+	uint64_t t;
+
+	t = get_time_ns(group->data_system, CLOCK_MONOTONIC);
+
+	spa_list_for_each(stream, &group->streams, link) {
+		if (!stream->sink)
+			continue;
+
+		if (resync)
+			stream->this.resync = true;
+
+		if (!stream->pull)
+			stream_silence(stream);
+		else if (pool && n_jobs < MAX_JOBS)
+			jobs[n_jobs++] = stream;
+		else
+			stream_pull(stream);
+	}
+
+	if (n_jobs > 1)
+		encode_pool_run(pool, jobs, n_jobs);
+	else if (n_jobs == 1)
+		stream_pull(jobs[0]);
+
+	t = get_time_ns(group->data_system, CLOCK_MONOTONIC) - t;
+	group->encode_time = group->encode_time ? (group->encode_time * 7 + t) / 8 : t;
+	group->encode_time_max = SPA_MAX(group->encode_time_max, t);
+
+	spa_list_for_each(stream, &group->streams, link) {
+		if (!stream->sink)
+			continue;
+		/* back in the data thread, after the pull of all streams */
+		if (stream->pull && stream->done)
+			stream->done(&stream->this);
+		SPA_ATOMIC_STORE(stream->this.encode_time, group->encode_time);
+		SPA_ATOMIC_STORE(stream->this.encode_time_max, group->encode_time_max);
+	}
+
+	spa_log_trace(group->log, "%p: ISO group:%u pulled %u streams in %"PRIu64" ns",
+			group, group->id, n_jobs, t);
+}
+
+static void encode_pool_stop(struct group *group)
+{
+	struct encode_pool *pool = group->pool;
+	uint32_t i;
+
+	if (pool == NULL)
+		return;
+
+	SPA_ATOMIC_STORE(pool->quit, 1);
+	for (i = 0; i < pool->n_threads; i++)
+		sem_post(&pool->sem);
+	for (i = 0; i < pool->n_threads; i++)
+		spa_thread_utils_join(pool->thread_utils, pool->threads[i], NULL);
+
+	sem_destroy(&pool->sem);
+	free(pool);
+	group->pool = NULL;
+}
+
+static int encode_pool_start(struct group *group, struct spa_thread_utils *thread_utils,
+		uint32_t n_threads)
+{
+	struct encode_pool *pool;
+	struct spa_dict_item items[1];
+	char name[32];
+	uint32_t i;
+	int res;
+
+	if (thread_utils == NULL)
+		return -ENOTSUP;
+	if ((pool = calloc(1, sizeof(*pool))) == NULL)
+		return -errno;
+	if (sem_init(&pool->sem, 0, 0) < 0) {
+		res = -errno;
+		free(pool);
+		return res;
+	}
+	pool->thread_utils = thread_utils;
+	pool->next_job = JOBS_CLOSED;
+	group->pool = pool;
+
+	for (i = 0; i < SPA_MIN(n_threads, (uint32_t)MAX_ENCODE_THREADS); i++) {
+		snprintf(name, sizeof(name), "bluez5-iso-%u", i);
+		items[0] = SPA_DICT_ITEM_INIT(SPA_KEY_THREAD_NAME, name);
+		pool->threads[i] = spa_thread_utils_create(thread_utils,
+				&SPA_DICT_INIT_ARRAY(items), encode_thread, pool);
+		if (pool->threads[i] == NULL) {
+			res = -errno;
+			goto error;
+		}
+		pool->n_threads++;
+
+		/* the data thread waits for the jobs of the thread */
+		if ((res = spa_thread_utils_acquire_rt(thread_utils, pool->threads[i], -1)) < 0)
+			goto error;
+	}
+
+	spa_log_info(group->log, "%p: ISO group:%u %u encode threads",
+			group, group->id, pool->n_threads);
+	return 0;
+
+error:
+	encode_pool_stop(group);
+	return res;
+}
+
 static void group_on_timeout(struct spa_source *source)
 {
 	struct group *group = source->data;
@@ -308,30 +506,20 @@ done:
 	/* Pull data for the next interval */
 	group->next += exp * group->duration;
 
-	spa_list_for_each(stream, &group->streams, link) {
-		if (!stream->sink)
-			continue;
-
-		if (resync)
-			stream->this.resync = true;
-
-		if (stream->pull) {
-			stream->idle = false;
-			stream->this.now = group->next;
-			stream->pull(&stream->this);
-		} else {
-			stream_silence(stream);
-		}
-	}
+	group_pull(group, resync);
 
 	set_timeout(group, group->next);
 }
 
 static struct group *group_create(struct spa_bt_transport *t,
-		struct spa_log *log, struct spa_loop *data_loop, struct spa_system *data_system)
+		struct spa_log *log, struct spa_loop *data_loop, struct spa_system *data_system,
+		struct spa_thread_utils *thread_utils, struct spa_cpu *cpu)
 {
 	struct group *group;
+	const char *str;
+	uint32_t n_threads, n_cpus;
 	uint8_t id;
+	int res;
 
 	if (t->profile & (SPA_BT_PROFILE_BAP_SINK | SPA_BT_PROFILE_BAP_SOURCE)) {
 		id = t->bap_cig;
@@ -365,6 +553,19 @@ static struct group *group_create(struct spa_bt_transport *t,
 		return NULL;
 	}
 
+	if (t->device && t->device->settings &&
+	    (str = spa_dict_lookup(t->device->settings, "bluez5.iso.encode-threads")) != NULL &&
+	    spa_atou32(str, &n_threads, 0) && n_threads > 0) {
+		/* the data thread takes jobs too, leave a CPU for it */
+		n_cpus = cpu ? spa_cpu_get_count(cpu) : 0;
+		if (n_cpus > 0)
+			n_threads = SPA_MIN(n_threads, n_cpus - 1);
+		if (n_threads > 0 &&
+		    (res = encode_pool_start(group, thread_utils, n_threads)) < 0)
+			spa_log_warn(group->log, "%p: ISO group:%u can't start encode threads: %s",
+					group, group->id, spa_strerror(res));
+	}
+
 	group->source.data = group;
 	group->source.fd = group->timerfd;
 	group->source.func = group_on_timeout;
@@ -397,6 +598,8 @@ static void group_destroy(struct group *group)
 	res = spa_loop_locked(group->data_loop, do_remove_source, 0, NULL, 0, group);
 	spa_assert_se(res == 0);
 
+	encode_pool_stop(group);
+
 	close(group->timerfd);
 	free(group);
 }
@@ -490,12 +693,13 @@ fail:
 }
 
 struct spa_bt_iso_io *spa_bt_iso_io_create(struct spa_bt_transport *t,
-		struct spa_log *log, struct spa_loop *data_loop, struct spa_system *data_system)
+		struct spa_log *log, struct spa_loop *data_loop, struct spa_system *data_system,
+		struct spa_thread_utils *thread_utils, struct spa_cpu *cpu)
 {
 	struct stream *stream;
 	struct group *group;
 
-	group = group_create(t, log, data_loop, data_system);
+	group = group_create(t, log, data_loop, data_system, thread_utils, cpu);
 	if (group == NULL)
 		return NULL;
 
@@ -585,6 +789,14 @@ void spa_bt_iso_io_set_cb(struct spa_bt_iso_io *this, spa_bt_iso_io_pull_t pull,
 	}
 }
 
+/** Must be called from data thread */
+void spa_bt_iso_io_set_done_cb(struct spa_bt_iso_io *this, spa_bt_iso_io_done_t done)
+{
+	struct stream *stream = SPA_CONTAINER_OF(this, struct stream, this);
+
+	stream->done = done;
+}
+
 /** Must be called from data thread */
 int spa_bt_iso_io_recv_errqueue(struct spa_bt_iso_io *this)
 {
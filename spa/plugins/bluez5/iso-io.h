@@ -8,6 +8,8 @@
 #include <spa/utils/defs.h>
 #include <spa/support/loop.h>
 #include <spa/support/log.h>
+#include <spa/support/thread.h>
+#include <spa/support/cpu.h>
 #include <spa/node/io.h>
 #include <spa/param/audio/format.h>
 
@@ -34,16 +36,28 @@ struct spa_bt_iso_io
 	struct spa_audio_info format;	/**< Audio format */
 	void *codec_data;		/**< Codec data */
 
+	uint64_t encode_time;		/**< Average time to pull all streams of the group,
+					 * in ns (read-only, atomic) */
+	uint64_t encode_time_max;	/**< Maximum time to pull all streams of the group,
+					 * in ns (read-only, atomic) */
+
 	void *user_data;
 };
 
+/** Produce the next packet. With bluez5.iso.encode-threads, the streams of
+ * the group are pulled in parallel and this can be called from an encode
+ * thread while the data thread waits. */
 typedef void (*spa_bt_iso_io_pull_t)(struct spa_bt_iso_io *io);
+/** Called in the data thread after all streams of the group are pulled */
+typedef void (*spa_bt_iso_io_done_t)(struct spa_bt_iso_io *io);
 
 struct spa_bt_iso_io *spa_bt_iso_io_create(struct spa_bt_transport *t,
-		struct spa_log *log, struct spa_loop *data_loop, struct spa_system *data_system);
+		struct spa_log *log, struct spa_loop *data_loop, struct spa_system *data_system,
+		struct spa_thread_utils *thread_utils, struct spa_cpu *cpu);
 struct spa_bt_iso_io *spa_bt_iso_io_attach(struct spa_bt_iso_io *io, struct spa_bt_transport *t);
 void spa_bt_iso_io_destroy(struct spa_bt_iso_io *io);
 void spa_bt_iso_io_set_cb(struct spa_bt_iso_io *io, spa_bt_iso_io_pull_t pull, void *user_data);
+void spa_bt_iso_io_set_done_cb(struct spa_bt_iso_io *io, spa_bt_iso_io_done_t done);
 int spa_bt_iso_io_recv_errqueue(struct spa_bt_iso_io *io);
 
 #endif
@@ -5,6 +5,7 @@
 #include <unistd.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <sched.h>
 #include <arpa/inet.h>
 #include <sys/ioctl.h>
 
@@ -12,10 +13,13 @@
 #include <spa/support/loop.h>
 #include <spa/support/log.h>
 #include <spa/support/system.h>
+#include <spa/support/thread.h>
+#include <spa/utils/atomic.h>
 #include <spa/utils/list.h>
 #include <spa/utils/keys.h>
 #include <spa/utils/names.h>
 #include <spa/utils/result.h>
+#include <spa/utils/ringbuffer.h>
 #include <spa/utils/string.h>
 #include <spa/monitor/device.h>
 
@@ -40,6 +44,7 @@
 #include "media-codecs.h"
 #include "rate-control.h"
 #include "iso-io.h"
+#include "encode-ring.h"
 
 SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.bluez5.sink.media");
 #undef SPA_LOG_TOPIC_DEFAULT
@@ -61,6 +66,10 @@ struct props {
 #define RATE_CTL_DIFF_MAX 0.01
 #define LATENCY_PERIOD		(200 * SPA_NSEC_PER_MSEC)
 
+#define ENCODE_RING_PERIODS	4
+#define DEFAULT_ENCODE_RT_PRIO	80
+#define ENCODE_STATS_INTERVAL	SPA_NSEC_PER_SEC
+
 /* Wait for two cycles before trying to sync ISO. On start/driver reassign,
  * first cycle may have strange number of samples. */
 #define RESYNC_CYCLES 2
@@ -121,6 +130,41 @@ struct spa_bt_asha {
 	unsigned int set_timer:1;
 };
 
+/* The A2DP encoder can run in its own thread. The data thread then only
+ * copies the samples into the ring and the thread encodes and sends the
+ * packets, paced by the flush timer. The timer and the transport fd are
+ * polled by the thread instead of the data loop. */
+struct encode_thread {
+	struct spa_loop loop;
+	struct spa_source wakeup;
+	int poll_fd;
+
+	struct spa_thread *thread;
+	bool thread_running;
+	bool running;
+	int quit;
+	int error;
+
+	struct encode_ring ring;
+
+	/* written by the data thread */
+	uint32_t dropped;
+
+	/* the copy used by the thread */
+	struct encode_timing timing;
+};
+
+/* updated by the thread that encodes, the averages are published to the
+ * main thread with atomics at most once per ENCODE_STATS_INTERVAL */
+struct encode_stats {
+	uint64_t avg_ns;
+	uint64_t max_ns;
+	uint64_t publish_ns;
+
+	uint64_t pub_avg_ns;
+	uint64_t pub_max_ns;
+};
+
 struct impl {
 	struct spa_handle handle;
 	struct spa_node node;
@@ -129,6 +173,7 @@ struct impl {
 	struct spa_loop *data_loop;
 	struct spa_system *data_system;
 	struct spa_loop_utils *loop_utils;
+	struct spa_thread_utils *thread_utils;
 
 	struct spa_hook_list hooks;
 	struct spa_callbacks callbacks;
@@ -155,10 +200,13 @@ struct impl {
 	unsigned int is_output:1;
 	unsigned int flush_pending:1;
 	unsigned int iso_pending:1;
+	uint32_t iso_reuse[MAX_BUFFERS];
+	uint32_t n_iso_reuse;
 	unsigned int own_codec_data:1;
 
 	unsigned int is_duplex:1;
 	unsigned int is_internal:1;
+	unsigned int use_encode_thread:1;
 
 	struct spa_source source;
 	int timerfd;
@@ -182,6 +230,7 @@ struct impl {
 
 	uint64_t packet_delay_ns;
 	struct spa_source *update_delay_event;
+	struct spa_source *encode_stats_event;
 
 	uint32_t encoder_delay;
 
@@ -211,6 +260,11 @@ struct impl {
 	struct spa_list asha_link;
 
 	struct spa_bt_latency tx_latency;
+
+	int encode_rt_prio;
+	struct encode_thread encode;
+	uint64_t encode_time;
+	struct encode_stats encode_stats;
 };
 
 #define CHECK_PORT(this,d,p)	((d) == SPA_DIRECTION_INPUT && (p) == 0)
@@ -275,21 +329,69 @@ static int impl_node_enum_params(void *object, int seq,
 				SPA_PROP_INFO_description, SPA_POD_String("Latency offset (ns)"),
 				SPA_PROP_INFO_type, SPA_POD_CHOICE_RANGE_Long(0LL, INT64_MIN, INT64_MAX));
 			break;
+		case 1:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_PropInfo, id,
+				SPA_PROP_INFO_name, SPA_POD_String("bluez5.encode-time"),
+				SPA_PROP_INFO_description, SPA_POD_String("Average packet encode time (usec)"),
+				SPA_PROP_INFO_type, SPA_POD_Int(0),
+				SPA_PROP_INFO_params, SPA_POD_Bool(true));
+			break;
+		case 2:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_PropInfo, id,
+				SPA_PROP_INFO_name, SPA_POD_String("bluez5.encode-time-max"),
+				SPA_PROP_INFO_description, SPA_POD_String("Maximum packet encode time (usec)"),
+				SPA_PROP_INFO_type, SPA_POD_Int(0),
+				SPA_PROP_INFO_params, SPA_POD_Bool(true));
+			break;
+		case 3:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_PropInfo, id,
+				SPA_PROP_INFO_name, SPA_POD_String("bluez5.iso.encode-time"),
+				SPA_PROP_INFO_description, SPA_POD_String("Average ISO group encode time (usec)"),
+				SPA_PROP_INFO_type, SPA_POD_Int(0),
+				SPA_PROP_INFO_params, SPA_POD_Bool(true));
+			break;
+		case 4:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_PropInfo, id,
+				SPA_PROP_INFO_name, SPA_POD_String("bluez5.iso.encode-time-max"),
+				SPA_PROP_INFO_description, SPA_POD_String("Maximum ISO group encode time (usec)"),
+				SPA_PROP_INFO_type, SPA_POD_Int(0),
+				SPA_PROP_INFO_params, SPA_POD_Bool(true));
+			break;
 		default:
 			enum_codec = true;
-			index_offset = 1;
+			index_offset = 5;
 		}
 		break;
 	}
 	case SPA_PARAM_Props:
 	{
 		struct props *p = &this->props;
+		struct spa_bt_iso_io *iso_io = this->transport ? this->transport->iso_io : NULL;
+		struct spa_pod_frame f[2];
 
 		switch (result.index) {
 		case 0:
-			param = spa_pod_builder_add_object(&b,
-				SPA_TYPE_OBJECT_Props, id,
-				SPA_PROP_latencyOffsetNsec, SPA_POD_Long(p->latency_offset));
+			spa_pod_builder_push_object(&b, &f[0],
+					SPA_TYPE_OBJECT_Props, id);
+			spa_pod_builder_add(&b,
+				SPA_PROP_latencyOffsetNsec, SPA_POD_Long(p->latency_offset),
+				0);
+			spa_pod_builder_prop(&b, SPA_PROP_params, 0);
+			spa_pod_builder_push_struct(&b, &f[1]);
+			spa_pod_builder_string(&b, "bluez5.encode-time");
+			spa_pod_builder_int(&b, SPA_ATOMIC_LOAD(this->encode_stats.pub_avg_ns) / SPA_NSEC_PER_USEC);
+			spa_pod_builder_string(&b, "bluez5.encode-time-max");
+			spa_pod_builder_int(&b, SPA_ATOMIC_LOAD(this->encode_stats.pub_max_ns) / SPA_NSEC_PER_USEC);
+			spa_pod_builder_string(&b, "bluez5.iso.encode-time");
+			spa_pod_builder_int(&b, iso_io ? SPA_ATOMIC_LOAD(iso_io->encode_time) / SPA_NSEC_PER_USEC : 0);
+			spa_pod_builder_string(&b, "bluez5.iso.encode-time-max");
+			spa_pod_builder_int(&b, iso_io ? SPA_ATOMIC_LOAD(iso_io->encode_time_max) / SPA_NSEC_PER_USEC : 0);
+			spa_pod_builder_pop(&b, &f[1]);
+			param = spa_pod_builder_pop(&b, &f[0]);
 			break;
 		default:
 			enum_codec = true;
@@ -519,6 +621,16 @@ static void update_delay_event(void *data, uint64_t count)
 	set_latency(this, true);
 }
 
+static void encode_stats_event(void *data, uint64_t count)
+{
+	struct impl *this = data;
+
+	/* in main loop */
+	this->info.change_mask |= SPA_NODE_CHANGE_MASK_PARAMS;
+	this->params[IDX_Props].flags ^= SPA_PARAM_INFO_SERIAL;
+	emit_node_info(this, false);
+}
+
 static void update_packet_delay(struct impl *this, uint64_t delay)
 {
 	uint64_t old_delay = this->packet_delay_ns;
@@ -593,16 +705,21 @@ static uint32_t get_queued_frames(struct impl *this)
 	uint32_t bytes = 0;
 	struct buffer *b;
 
-	spa_list_for_each(b, &port->ready, link) {
-		struct spa_data *d = b->buf->datas;
+	if (this->encode.running) {
+		/* samples in the ring at the time of the last process */
+		bytes = this->encode.timing.write_index - this->encode.ring.ring.readindex;
+	} else {
+		spa_list_for_each(b, &port->ready, link) {
+			struct spa_data *d = b->buf->datas;
 
-		bytes += d[0].chunk->size;
-	}
+			bytes += d[0].chunk->size;
+		}
 
-	if (bytes > port->ready_offset)
-		bytes -= port->ready_offset;
-	else
-		bytes = 0;
+		if (bytes > port->ready_offset)
+			bytes -= port->ready_offset;
+		else
+			bytes = 0;
+	}
 
 	/* Count (partially) encoded packet */
 	bytes += this->tmp_buffer_used;
@@ -611,12 +728,23 @@ static uint32_t get_queued_frames(struct impl *this)
 	return bytes / port->frame_size;
 }
 
+static uint64_t get_resample_delay(struct impl *this, uint64_t process_rate)
+{
+	struct port *port = &this->port;
+	bool resampling;
+
+	resampling = (port->current_format.info.raw.rate != process_rate) || this->following;
+	if (port->rate_match && this->position && resampling)
+		return (port->rate_match->delay * SPA_NSEC_PER_SEC + port->rate_match->delay_frac)
+			/ port->current_format.info.raw.rate;
+	return 0;
+}
+
 static uint64_t get_reference_time(struct impl *this, uint64_t *duration_ns_ret)
 {
 	struct port *port = &this->port;
 	uint64_t duration_ns;
 	int64_t t;
-	bool resampling;
 
 	if (!this->process_rate || !this->process_duration) {
 		if (this->position) {
@@ -640,11 +768,10 @@ static uint64_t get_reference_time(struct impl *this, uint64_t *duration_ns_ret)
 			/ port->current_format.info.raw.rate);
 
 	/* Account for resampling delay */
-	resampling = (port->current_format.info.raw.rate != this->process_rate) || this->following;
-	if (port->rate_match && this->position && resampling) {
-		t -= (port->rate_match->delay * SPA_NSEC_PER_SEC + port->rate_match->delay_frac)
-			/ port->current_format.info.raw.rate;
-	}
+	if (this->encode.running)
+		t -= this->encode.timing.resample_delay;
+	else
+		t -= get_resample_delay(this, this->process_rate);
 
 	if (this->process_rate_diff > 0)
 		t = (int64_t)(t / this->process_rate_diff);
@@ -652,6 +779,37 @@ static uint64_t get_reference_time(struct impl *this, uint64_t *duration_ns_ret)
 	return this->process_time + t;
 }
 
+static inline uint64_t get_time_ns(struct impl *this)
+{
+	struct timespec ts;
+	spa_system_clock_gettime(this->data_system, CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void update_encode_stats(struct impl *this)
+{
+	struct encode_stats *stats = &this->encode_stats;
+	uint64_t t = this->encode_time, now;
+
+	/* in the data thread or the encode thread */
+	if (t == 0)
+		return;
+
+	stats->avg_ns = stats->avg_ns ? (stats->avg_ns * 7 + t) / 8 : t;
+	stats->max_ns = SPA_MAX(stats->max_ns, t);
+	this->encode_time = 0;
+
+	now = get_time_ns(this);
+	if (now < stats->publish_ns)
+		return;
+	stats->publish_ns = now + ENCODE_STATS_INTERVAL;
+
+	SPA_ATOMIC_STORE(stats->pub_avg_ns, stats->avg_ns);
+	SPA_ATOMIC_STORE(stats->pub_max_ns, stats->max_ns);
+	if (this->encode_stats_event)
+		spa_loop_utils_signal_event(this->loop_utils, this->encode_stats_event);
+}
+
 static int reset_buffer(struct impl *this)
 {
 	if (this->codec_props_changed && this->codec_props
@@ -659,6 +817,8 @@ static int reset_buffer(struct impl *this)
 		this->codec->update_props(this->codec_data, this->codec_props);
 		this->codec_props_changed = false;
 	}
+	update_encode_stats(this);
+
 	this->need_flush = 0;
 	this->block_count = 0;
 	this->fragment = false;
@@ -774,6 +934,7 @@ static int encode_buffer(struct impl *this, const void *data, uint32_t size)
 	struct port *port = &this->port;
 	const void *from_data = data;
 	int from_size = size;
+	uint64_t t;
 
 	spa_log_trace(this->log, "%p: encode %d used %d, %d %d %d",
 			this, size, this->buffer_used, port->frame_size, this->block_size,
@@ -796,11 +957,13 @@ static int encode_buffer(struct impl *this, const void *data, uint32_t size)
 		this->tmp_buffer_used = this->block_size - this->tmp_buffer_used;
 	}
 
+	t = get_time_ns(this);
 	processed = this->codec->encode(this->codec_data,
 				from_data, from_size,
 				this->buffer + this->buffer_used,
 				sizeof(this->buffer) - this->buffer_used,
 				&out_encoded, &this->need_flush);
+	this->encode_time += get_time_ns(this) - t;
 	if (processed < 0)
 		return processed;
 
@@ -821,6 +984,7 @@ static int encode_buffer(struct impl *this, const void *data, uint32_t size)
 static int encode_fragment(struct impl *this)
 {
 	int res;
+	uint64_t t;
 	size_t out_encoded;
 	struct port *port = &this->port;
 
@@ -831,11 +995,13 @@ static int encode_fragment(struct impl *this)
 	if (this->need_flush)
 		return 0;
 
+	t = get_time_ns(this);
 	res = this->codec->encode(this->codec_data,
 				NULL, 0,
 				this->buffer + this->buffer_used,
 				sizeof(this->buffer) - this->buffer_used,
 				&out_encoded, &this->need_flush);
+	this->encode_time += get_time_ns(this) - t;
 	if (res < 0)
 		return res;
 	if (res != 0)
@@ -877,6 +1043,39 @@ static int add_data(struct impl *this, const void *data, uint32_t size)
 	return total;
 }
 
+static int encode_from_ring(struct impl *this)
+{
+	struct encode_thread *e = &this->encode;
+	uint32_t index, offs, l0, l1;
+	int32_t avail;
+	int written, res;
+
+	/* only take the samples of the last process, they match the timing */
+	avail = encode_ring_get_read_index(&e->ring, &e->timing, &index);
+	if (avail <= 0)
+		return 0;
+
+	offs = index & (e->ring.size - 1);
+	l0 = SPA_MIN((uint32_t)avail, e->ring.size - offs);
+	l1 = avail - l0;
+
+	written = add_data(this, e->ring.data + offs, l0);
+	if (written == (int)l0 && l1 > 0) {
+		if ((res = add_data(this, e->ring.data, l1)) > 0)
+			written += res;
+	}
+	if (written <= 0) {
+		if (written < 0 && written != -ENOSPC) {
+			spa_log_warn(this->log, "%p: error %s, drop %d bytes",
+					this, spa_strerror(written), avail);
+			encode_ring_read_update(&e->ring, index + avail);
+		}
+		return written;
+	}
+	encode_ring_read_update(&e->ring, index + written);
+	return written;
+}
+
 static void enable_flush_timer(struct impl *this, bool enabled)
 {
 	struct itimerspec ts;
@@ -894,6 +1093,29 @@ static void enable_flush_timer(struct impl *this, bool enabled)
 	this->flush_pending = enabled;
 }
 
+/* the ISO streams of a group can be pulled in encode threads, their
+ * buffers are given back in the data thread after the pull */
+static void reuse_buffer(struct impl *this, struct buffer *b)
+{
+	if (this->transport->iso_io) {
+		this->iso_reuse[this->n_iso_reuse++] = b->id;
+		return;
+	}
+	this->port.io->buffer_id = b->id;
+	spa_node_call_reuse_buffer(&this->callbacks, 0, b->id);
+}
+
+static void iso_reuse_buffers(struct impl *this)
+{
+	uint32_t i;
+
+	for (i = 0; i < this->n_iso_reuse; i++) {
+		this->port.io->buffer_id = this->iso_reuse[i];
+		spa_node_call_reuse_buffer(&this->callbacks, 0, this->iso_reuse[i]);
+	}
+	this->n_iso_reuse = 0;
+}
+
 static int flush_data(struct impl *this, uint64_t now_time)
 {
 	struct port *port = &this->port;
@@ -929,6 +1151,12 @@ again:
 		}
 	}
 
+	while (this->encode.running && !this->need_flush) {
+		if ((written = encode_from_ring(this)) <= 0)
+			break;
+		total_frames += written / port->frame_size;
+	}
+
 	while (!spa_list_is_empty(&port->ready) && !this->need_flush) {
 		uint8_t *src;
 		uint32_t n_bytes, n_frames;
@@ -959,10 +1187,9 @@ again:
 			if (written < 0 && written != -ENOSPC) {
 				spa_list_remove(&b->link);
 				SPA_FLAG_SET(b->flags, BUFFER_FLAG_OUT);
-				this->port.io->buffer_id = b->id;
 				spa_log_warn(this->log, "%p: error %s, reuse buffer %u",
 						this, spa_strerror(written), b->id);
-				spa_node_call_reuse_buffer(&this->callbacks, 0, b->id);
+				reuse_buffer(this, b);
 				port->ready_offset = 0;
 			}
 			break;
@@ -976,9 +1203,7 @@ again:
 			spa_list_remove(&b->link);
 			SPA_FLAG_SET(b->flags, BUFFER_FLAG_OUT);
 			spa_log_trace(this->log, "%p: reuse buffer %u", this, b->id);
-			this->port.io->buffer_id = b->id;
-
-			spa_node_call_reuse_buffer(&this->callbacks, 0, b->id);
+			reuse_buffer(this, b);
 			port->ready_offset = 0;
 		}
 		total_frames += n_frames;
@@ -1280,6 +1505,14 @@ static void media_iso_pull(struct spa_bt_iso_io *iso_io)
 	flush_data(this, this->current_time);
 }
 
+static void media_iso_done(struct spa_bt_iso_io *iso_io)
+{
+	struct impl *this = iso_io->user_data;
+
+	/* in data thread */
+	iso_reuse_buffers(this);
+}
+
 static void media_on_flush_error(struct spa_source *source)
 {
 	struct impl *this = source->data;
@@ -1303,13 +1536,15 @@ static void media_on_flush_error(struct spa_source *source)
 		spa_log_warn(this->log, "%p: error %d", this, source->rmask);
 		if (this->flush_source.loop) {
 			spa_bt_latency_flush(&this->tx_latency, this->flush_source.fd, this->log);
-			spa_loop_remove_source(this->data_loop, &this->flush_source);
+			spa_loop_remove_source(this->flush_source.loop, &this->flush_source);
 		}
 		enable_flush_timer(this, false);
 		if (this->flush_timer_source.loop)
-			spa_loop_remove_source(this->data_loop, &this->flush_timer_source);
-		if (this->transport && this->transport->iso_io)
+			spa_loop_remove_source(this->flush_timer_source.loop, &this->flush_timer_source);
+		if (this->transport && this->transport->iso_io) {
 			spa_bt_iso_io_set_cb(this->transport->iso_io, NULL, NULL);
+			iso_reuse_buffers(this);
+		}
 		return;
 	}
 }
@@ -1317,7 +1552,7 @@ static void media_on_flush_error(struct spa_source *source)
 static void media_on_flush_timeout(struct spa_source *source)
 {
 	struct impl *this = source->data;
-	uint64_t exp;
+	uint64_t exp, now;
 	int res;
 
 	spa_log_trace(this->log, "%p: flush on timeout", this);
@@ -1333,9 +1568,12 @@ static void media_on_flush_timeout(struct spa_source *source)
 		return;
 	}
 
+	/* in the encode thread, current_time belongs to the data thread */
+	now = this->encode.running ? this->encode.timing.time : this->current_time;
+
 	while (exp-- > 0) {
 		this->flush_pending = false;
-		flush_data(this, this->current_time);
+		flush_data(this, now);
 	}
 }
 
@@ -1481,14 +1719,274 @@ static void media_asha_cb(struct spa_source *source)
 	}
 }
 
+static int encode_loop_add_source(void *object, struct spa_source *source)
+{
+	struct impl *this = object;
+
+	source->loop = &this->encode.loop;
+	return spa_system_pollfd_add(this->data_system, this->encode.poll_fd,
+			source->fd, source->mask, source);
+}
+
+static int encode_loop_update_source(void *object, struct spa_source *source)
+{
+	struct impl *this = object;
+
+	return spa_system_pollfd_mod(this->data_system, this->encode.poll_fd,
+			source->fd, source->mask, source);
+}
+
+static int encode_loop_remove_source(void *object, struct spa_source *source)
+{
+	struct impl *this = object;
+
+	source->loop = NULL;
+	return spa_system_pollfd_del(this->data_system, this->encode.poll_fd, source->fd);
+}
+
+static int encode_loop_invoke(void *object, spa_invoke_func_t func, uint32_t seq,
+		const void *data, size_t size, bool block, void *user_data)
+{
+	return -ENOTSUP;
+}
+
+static const struct spa_loop_methods encode_loop_methods = {
+	SPA_VERSION_LOOP_METHODS,
+	.add_source = encode_loop_add_source,
+	.update_source = encode_loop_update_source,
+	.remove_source = encode_loop_remove_source,
+	.invoke = encode_loop_invoke,
+};
+
+/* in the data thread, copy the queued buffers into the ring and wake up
+ * the encode thread */
+static int encode_thread_push(struct impl *this)
+{
+	struct encode_thread *e = &this->encode;
+	struct port *port = &this->port;
+	struct encode_timing t;
+	uint32_t index, avail;
+	int res;
+
+	/* an error of the last flush, keep the buffers for the next cycle */
+	if ((res = SPA_ATOMIC_XCHG(e->error, 0)) < 0)
+		return res;
+
+	avail = encode_ring_get_write_index(&e->ring, &index);
+
+	while (!spa_list_is_empty(&port->ready)) {
+		struct buffer *b;
+		struct spa_data *d;
+		uint32_t offs, size, l0, l1;
+
+		b = spa_list_first(&port->ready, struct buffer, link);
+		d = b->buf->datas;
+
+		offs = d[0].chunk->offset % d[0].maxsize;
+		size = SPA_MIN(d[0].chunk->size, d[0].maxsize);
+		size = SPA_ROUND_DOWN(size, port->frame_size);
+		if (size > avail) {
+			e->dropped += (size - avail) / port->frame_size;
+			size = SPA_ROUND_DOWN(avail, port->frame_size);
+		}
+		l0 = SPA_MIN(size, d[0].maxsize - offs);
+		l1 = size - l0;
+
+		encode_ring_write(&e->ring, index, SPA_PTROFF(d[0].data, offs, void), l0);
+		if (l1 > 0)
+			encode_ring_write(&e->ring, index + l0, d[0].data, l1);
+		index += size;
+		avail -= size;
+
+		spa_list_remove(&b->link);
+		SPA_FLAG_SET(b->flags, BUFFER_FLAG_OUT);
+		spa_log_trace(this->log, "%p: reuse buffer %u", this, b->id);
+		port->io->buffer_id = b->id;
+		spa_node_call_reuse_buffer(&this->callbacks, 0, b->id);
+	}
+	t.time = this->current_time;
+	if (this->position) {
+		t.duration = this->position->clock.duration;
+		t.rate = this->position->clock.rate.denom;
+		t.rate_diff = this->position->clock.rate_diff;
+	} else {
+		t.duration = 1024;
+		t.rate = 48000;
+		t.rate_diff = 1.0;
+	}
+	t.resample_delay = get_resample_delay(this, t.rate);
+	encode_ring_write_update(&e->ring, index, &t);
+
+	spa_system_eventfd_write(this->data_system, e->wakeup.fd, 1);
+	return 0;
+}
+
+static void encode_on_wakeup(struct spa_source *source)
+{
+	struct impl *this = source->data;
+	struct encode_thread *e = &this->encode;
+	uint64_t count;
+	int res;
+
+	if (spa_system_eventfd_read(this->data_system, source->fd, &count) < 0)
+		return;
+	if (SPA_ATOMIC_LOAD(e->quit))
+		return;
+
+	encode_ring_get_timing(&e->ring, &e->timing);
+
+	this->process_time = e->timing.time;
+	this->process_duration = e->timing.duration;
+	this->process_rate = e->timing.rate;
+	this->process_rate_diff = e->timing.rate_diff;
+
+	if ((res = flush_data(this, e->timing.time)) < 0) {
+		spa_log_debug(this->log, "%p: flush error: %s", this, spa_strerror(res));
+		SPA_ATOMIC_STORE(e->error, res);
+	}
+}
+
+static void *encode_thread_loop(void *data)
+{
+	struct impl *this = data;
+	struct encode_thread *e = &this->encode;
+	struct spa_poll_event ev[4];
+	struct spa_source *s;
+	int i, n;
+
+	while (!SPA_ATOMIC_LOAD(e->quit)) {
+		n = spa_system_pollfd_wait(this->data_system, e->poll_fd,
+				ev, SPA_N_ELEMENTS(ev), -1);
+		if (n < 0) {
+			if (n == -EINTR)
+				continue;
+			spa_log_error(this->log, "%p: encode thread poll: %s",
+					this, spa_strerror(n));
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			s = ev[i].data;
+			s->rmask = ev[i].events;
+		}
+		for (i = 0; i < n; i++) {
+			s = ev[i].data;
+			/* the source can be removed by a previous callback */
+			if (s->rmask && s->loop == &e->loop)
+				s->func(s);
+		}
+	}
+	return NULL;
+}
+
+static int encode_thread_init(struct impl *this)
+{
+	struct encode_thread *e = &this->encode;
+	struct port *port = &this->port;
+	uint32_t size;
+	int res;
+
+	e->loop.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_Loop,
+			SPA_VERSION_LOOP, &encode_loop_methods, this);
+
+	size = this->quantum_limit * port->frame_size * ENCODE_RING_PERIODS;
+	if ((res = encode_ring_init(&e->ring, size)) < 0)
+		return res;
+
+	if ((res = spa_system_pollfd_create(this->data_system, SPA_FD_CLOEXEC)) < 0)
+		goto error_free;
+	e->poll_fd = res;
+
+	if ((res = spa_system_eventfd_create(this->data_system,
+					SPA_FD_CLOEXEC | SPA_FD_NONBLOCK)) < 0)
+		goto error_close;
+	e->wakeup.data = this;
+	e->wakeup.fd = res;
+	e->wakeup.func = encode_on_wakeup;
+	e->wakeup.mask = SPA_IO_IN;
+	e->wakeup.rmask = 0;
+	if ((res = spa_loop_add_source(&e->loop, &e->wakeup)) < 0)
+		goto error_close_wakeup;
+
+	e->error = 0;
+	e->quit = 0;
+	e->dropped = 0;
+	spa_zero(e->timing);
+	e->running = true;
+	return 0;
+
+error_close_wakeup:
+	spa_system_close(this->data_system, e->wakeup.fd);
+error_close:
+	spa_system_close(this->data_system, e->poll_fd);
+error_free:
+	encode_ring_clear(&e->ring);
+	return res;
+}
+
+static int encode_thread_start(struct impl *this)
+{
+	struct encode_thread *e = &this->encode;
+	struct spa_dict_item items[1];
+
+	if (this->thread_utils == NULL)
+		return -ENOTSUP;
+
+	items[0] = SPA_DICT_ITEM_INIT(SPA_KEY_THREAD_NAME, "bluez5-encode");
+	e->thread = spa_thread_utils_create(this->thread_utils,
+			&SPA_DICT_INIT_ARRAY(items), encode_thread_loop, this);
+	if (e->thread == NULL)
+		return -errno;
+	if (this->encode_rt_prio > 0)
+		spa_thread_utils_acquire_rt(this->thread_utils, e->thread,
+				this->encode_rt_prio);
+
+	e->thread_running = true;
+	return 0;
+}
+
+static void encode_thread_stop(struct impl *this)
+{
+	struct encode_thread *e = &this->encode;
+
+	if (!e->thread_running)
+		return;
+
+	SPA_ATOMIC_STORE(e->quit, 1);
+	spa_system_eventfd_write(this->data_system, e->wakeup.fd, 1);
+	spa_thread_utils_join(this->thread_utils, e->thread, NULL);
+	e->thread_running = false;
+}
+
+static void encode_thread_clear(struct impl *this)
+{
+	struct encode_thread *e = &this->encode;
+
+	if (e->ring.data == NULL)
+		return;
+
+	encode_thread_stop(this);
+
+	if (e->wakeup.loop)
+		spa_loop_remove_source(e->wakeup.loop, &e->wakeup);
+	spa_system_close(this->data_system, e->wakeup.fd);
+	spa_system_close(this->data_system, e->poll_fd);
+	encode_ring_clear(&e->ring);
+
+	if (e->dropped > 0)
+		spa_log_warn(this->log, "%p: encode thread dropped %u frames",
+				this, e->dropped);
+}
+
 static int do_start_transport(struct spa_loop *loop, bool async, uint32_t seq,
 		const void *data, size_t size, void *user_data)
 {
 	struct impl *this = user_data;
 
 	this->transport_started = true;
-	if (this->transport->iso_io)
+	if (this->transport->iso_io) {
+		spa_bt_iso_io_set_done_cb(this->transport->iso_io, media_iso_done);
 		spa_bt_iso_io_set_cb(this->transport->iso_io, media_iso_pull, this);
+	}
 	return 0;
 }
 
@@ -1501,6 +1999,7 @@ static int transport_start(struct impl *this)
 	uint32_t flags;
 	bool is_asha;
 	bool is_sco;
+	struct spa_loop *flush_loop;
 
 	if (this->transport_started)
 		return 0;
@@ -1589,6 +2088,7 @@ static int transport_start(struct impl *this)
 	spa_bt_rate_control_init(&port->ratectl, 0);
 
 	this->update_delay_event = spa_loop_utils_add_event(this->loop_utils, update_delay_event, this);
+	this->encode_stats_event = spa_loop_utils_add_event(this->loop_utils, encode_stats_event, this);
 
 	spa_zero(this->tx_latency);
 
@@ -1599,13 +2099,32 @@ static int transport_start(struct impl *this)
 		spa_bt_sco_io_write_start(this->transport->sco_io);
 	}
 
+	flush_loop = this->data_loop;
+	if (this->use_encode_thread && this->codec->kind == MEDIA_CODEC_A2DP &&
+	    !this->transport->iso_io) {
+		int res;
+		if ((res = encode_thread_init(this)) < 0) {
+			spa_log_warn(this->log, "%p: can't create encode thread: %s",
+					this, spa_strerror(res));
+		} else if ((res = encode_thread_start(this)) < 0) {
+			spa_log_warn(this->log, "%p: can't start encode thread: %s",
+					this, spa_strerror(res));
+			this->encode.running = false;
+			encode_thread_clear(this);
+		} else {
+			spa_log_info(this->log, "%p: encoding in thread, prio:%d ring:%u",
+					this, this->encode_rt_prio, this->encode.ring.size);
+			flush_loop = &this->encode.loop;
+		}
+	}
+
 	if (!this->transport->iso_io && !is_asha) {
 		this->flush_timer_source.data = this;
 		this->flush_timer_source.fd = this->flush_timerfd;
 		this->flush_timer_source.func = media_on_flush_timeout;
 		this->flush_timer_source.mask = SPA_IO_IN;
 		this->flush_timer_source.rmask = 0;
-		spa_loop_add_source(this->data_loop, &this->flush_timer_source);
+		spa_loop_add_source(flush_loop, &this->flush_timer_source);
 
 		if (!is_sco)
 			spa_bt_latency_init(&this->tx_latency, this->transport, LATENCY_PERIOD, this->log);
@@ -1617,7 +2136,7 @@ static int transport_start(struct impl *this)
 		this->flush_source.func = media_on_flush_error;
 		this->flush_source.mask = SPA_IO_ERR | SPA_IO_HUP;
 		this->flush_source.rmask = 0;
-		spa_loop_add_source(this->data_loop, &this->flush_source);
+		spa_loop_add_source(flush_loop, &this->flush_source);
 	}
 
 	this->resync = RESYNC_CYCLES;
@@ -1719,6 +2238,10 @@ static int do_remove_source(struct spa_loop *loop,
 		spa_loop_utils_destroy_source(this->loop_utils, this->update_delay_event);
 		this->update_delay_event = NULL;
 	}
+	if (this->encode_stats_event) {
+		spa_loop_utils_destroy_source(this->loop_utils, this->encode_stats_event);
+		this->encode_stats_event = NULL;
+	}
 
 	return 0;
 }
@@ -1736,11 +2259,11 @@ static int do_remove_transport_source(struct spa_loop *loop,
 
 	if (this->flush_source.loop) {
 		spa_bt_latency_flush(&this->tx_latency, this->flush_source.fd, this->log);
-		spa_loop_remove_source(this->data_loop, &this->flush_source);
+		spa_loop_remove_source(this->flush_source.loop, &this->flush_source);
 	}
 
 	if (this->flush_timer_source.loop)
-		spa_loop_remove_source(this->data_loop, &this->flush_timer_source);
+		spa_loop_remove_source(this->flush_timer_source.loop, &this->flush_timer_source);
 	if (this->codec->kind == MEDIA_CODEC_ASHA) {
 		if (this->asha->timer_source.loop)
 			spa_loop_remove_source(this->data_loop, &this->asha->timer_source);
@@ -1749,9 +2272,12 @@ static int do_remove_transport_source(struct spa_loop *loop,
 		spa_list_remove(&this->asha_link);
 	}
 	enable_flush_timer(this, false);
+	this->encode.running = false;
 
-	if (this->transport->iso_io)
+	if (this->transport->iso_io) {
 		spa_bt_iso_io_set_cb(this->transport->iso_io, NULL, NULL);
+		iso_reuse_buffers(this);
+	}
 
 	/* Drop queued data */
 	drop_frames(this, UINT32_MAX);
@@ -1766,8 +2292,12 @@ static void transport_stop(struct impl *this)
 
 	spa_log_trace(this->log, "%p: stop transport", this);
 
+	encode_thread_stop(this);
+
 	spa_loop_locked(this->data_loop, do_remove_transport_source, 0, NULL, 0, this);
 
+	encode_thread_clear(this);
+
 	if (this->codec_data && this->own_codec_data)
 		this->codec->deinit(this->codec_data);
 	this->codec_data = NULL;
@@ -1784,6 +2314,9 @@ static int do_stop(struct impl *this)
 
 	this->start_ready = false;
 
+	/* the encode thread uses the events that are removed with the source */
+	encode_thread_stop(this);
+
 	spa_loop_locked(this->data_loop, do_remove_source, 0, NULL, 0, this);
 
 	transport_stop(this);
@@ -2325,6 +2858,16 @@ static int impl_node_process(void *object)
 		}
 	}
 
+	if (this->encode.running) {
+		setup_matching(this);
+
+		if ((res = encode_thread_push(this)) < 0) {
+			io->status = res;
+			return SPA_STATUS_STOPPED;
+		}
+		return SPA_STATUS_HAVE_DATA;
+	}
+
 	/* Make copies of current position values, so that they can be used later at any
 	 * time without shared memory races
 	 */
@@ -2412,6 +2955,7 @@ static void transport_destroy(void *data)
 {
 	struct impl *this = data;
 	spa_log_debug(this->log, "transport %p destroy", this->transport);
+	encode_thread_stop(this);
 	spa_loop_locked(this->data_loop, do_transport_destroy, 0, NULL, 0, this);
 }
 
@@ -2529,6 +3073,7 @@ impl_init(const struct spa_handle_factory *factory,
 	this->data_loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataLoop);
 	this->data_system = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataSystem);
 	this->loop_utils = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_LoopUtils);
+	this->thread_utils = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_ThreadUtils);
 
 	spa_log_topic_init(this->log, &log_topic);
 
@@ -2594,6 +3139,13 @@ impl_init(const struct spa_handle_factory *factory,
 	if (info && (str = spa_dict_lookup(info, "api.bluez5.internal")) != NULL)
 		this->is_internal = spa_atob(str);
 
+	if (info && (str = spa_dict_lookup(info, "bluez5.encode-thread")) != NULL)
+		this->use_encode_thread = spa_atob(str);
+
+	this->encode_rt_prio = DEFAULT_ENCODE_RT_PRIO;
+	if (info && (str = spa_dict_lookup(info, "bluez5.encode-thread.rt-prio")) != NULL)
+		spa_atoi32(str, &this->encode_rt_prio, 0);
+
 	if (info && (str = spa_dict_lookup(info, SPA_KEY_API_BLUEZ5_TRANSPORT)))
 		sscanf(str, "pointer:%p", &this->transport);
 
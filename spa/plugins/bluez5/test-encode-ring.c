@@ -0,0 +1,138 @@
+/* Spa Bluez5 encode ring test */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <spa/utils/defs.h>
+
+#include "encode-ring.h"
+
+#define N_CYCLES	10000
+#define MAX_SAMPLES	64
+
+struct data {
+	struct encode_ring ring;
+	uint32_t done;
+};
+
+/* a cycle queues a variable number of samples, the clock of the cycle
+ * is derived from the cycle number and the write index */
+static void *writer(void *arg)
+{
+	struct data *d = arg;
+	struct encode_timing t;
+	uint32_t cycle, i, index, avail, n, sample = 0;
+
+	for (cycle = 1; cycle <= N_CYCLES; cycle++) {
+		n = cycle % MAX_SAMPLES;
+
+		while ((avail = encode_ring_get_write_index(&d->ring, &index)) < n * sizeof(uint32_t))
+			sched_yield();
+
+		for (i = 0; i < n; i++, sample++)
+			encode_ring_write(&d->ring, index + i * sizeof(uint32_t),
+					&sample, sizeof(uint32_t));
+		index += n * sizeof(uint32_t);
+
+		spa_zero(t);
+		t.time = cycle;
+		t.duration = index;
+		t.rate = cycle;
+		encode_ring_write_update(&d->ring, index, &t);
+	}
+	SPA_ATOMIC_STORE(d->done, 1);
+	return NULL;
+}
+
+static void test_threads(void)
+{
+	struct data d;
+	struct encode_timing t;
+	pthread_t thread;
+	uint32_t index, sample = 0, value, last_time = 0;
+	int32_t avail, i;
+	bool done = false;
+
+	spa_zero(d);
+	spa_assert_se(encode_ring_init(&d.ring, 200) == 0);
+	/* rounded up to a power of 2 */
+	spa_assert_se(d.ring.size == 256);
+
+	spa_assert_se(pthread_create(&thread, NULL, writer, &d) == 0);
+
+	while (!done) {
+		done = SPA_ATOMIC_LOAD(d.done);
+
+		encode_ring_get_timing(&d.ring, &t);
+		/* the clock is never torn */
+		spa_assert_se(t.time == t.rate);
+		spa_assert_se(t.duration == t.write_index);
+		spa_assert_se(t.time >= last_time);
+		last_time = t.time;
+
+		/* samples up to the write index of the clock, in order */
+		avail = encode_ring_get_read_index(&d.ring, &t, &index);
+		spa_assert_se(avail >= 0);
+		spa_assert_se(index + avail == t.write_index);
+		spa_assert_se(avail % sizeof(uint32_t) == 0);
+		for (i = 0; i < avail; i += sizeof(uint32_t)) {
+			spa_ringbuffer_read_data(&d.ring.ring, d.ring.data, d.ring.size,
+					(index + i) & (d.ring.size - 1), &value, sizeof(value));
+			spa_assert_se(value == sample);
+			sample++;
+		}
+		encode_ring_read_update(&d.ring, index + avail);
+		if (avail == 0)
+			sched_yield();
+	}
+	pthread_join(thread, NULL);
+
+	spa_assert_se(last_time == N_CYCLES);
+	spa_assert_se(sample * sizeof(uint32_t) == d.ring.ring.writeindex);
+
+	encode_ring_clear(&d.ring);
+	spa_assert_se(d.ring.data == NULL);
+}
+
+/* samples written after the last update are not read */
+static void test_partial(void)
+{
+	struct encode_ring ring;
+	struct encode_timing t;
+	uint32_t index;
+	uint8_t data[16] = { 0, };
+
+	spa_assert_se(encode_ring_init(&ring, 32) == 0);
+	spa_assert_se(encode_ring_get_write_index(&ring, &index) == 32);
+
+	spa_zero(t);
+	encode_ring_write(&ring, index, data, 16);
+	encode_ring_write_update(&ring, index + 16, &t);
+	spa_assert_se(encode_ring_get_write_index(&ring, &index) == 16);
+	spa_assert_se(index == 16);
+
+	encode_ring_get_timing(&ring, &t);
+	spa_assert_se(t.write_index == 16);
+
+	/* more samples without an update of the clock */
+	encode_ring_write(&ring, index, data, 8);
+	spa_ringbuffer_write_update(&ring.ring, index + 8);
+
+	spa_assert_se(encode_ring_get_read_index(&ring, &t, &index) == 16);
+	spa_assert_se(index == 0);
+	encode_ring_read_update(&ring, 16);
+
+	spa_assert_se(encode_ring_get_read_index(&ring, &t, &index) == 0);
+	spa_assert_se(index == 16);
+
+	encode_ring_clear(&ring);
+}
+
+int main(int argc, char *argv[])
+{
+	test_partial();
+	test_threads();
+	return 0;
+}
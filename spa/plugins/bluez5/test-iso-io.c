@@ -0,0 +1,276 @@
+/* Spa Bluez5 ISO I/O test */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <spa/support/cpu.h>
+#include <spa/param/audio/format.h>
+
+#include "iso-io-dummy.h"
+
+#define CYCLES		20
+#define N_STREAMS	4
+
+struct stream {
+	struct spa_bt_iso_io *io;
+	uint32_t index;
+	uint32_t pulls;
+	uint32_t dones;
+	uint32_t sent;
+	int busy;
+};
+
+struct data {
+	struct iso_dummy dummy;
+	pthread_t data_thread;
+	struct stream streams[N_STREAMS];
+	uint32_t n_streams;
+	uint32_t thread_pulls;
+	uint32_t n_cpus;
+	struct spa_cpu cpu;
+};
+
+static struct data data;
+
+static int codec_validate_config(const struct media_codec *codec, uint32_t flags,
+		const void *caps, size_t caps_size, struct spa_audio_info *info)
+{
+	spa_zero(*info);
+	info->media_type = SPA_MEDIA_TYPE_audio;
+	info->media_subtype = SPA_MEDIA_SUBTYPE_raw;
+	info->info.raw.format = SPA_AUDIO_FORMAT_S16;
+	info->info.raw.rate = 48000;
+	info->info.raw.channels = 1;
+	info->info.raw.position[0] = SPA_AUDIO_CHANNEL_MONO;
+	return 0;
+}
+
+static void *codec_init(const struct media_codec *codec, uint32_t flags,
+		void *config, size_t config_size, const struct spa_audio_info *info,
+		void *props, size_t mtu)
+{
+	return calloc(1, 1);
+}
+
+static void codec_deinit(void *data)
+{
+	free(data);
+}
+
+static int codec_get_block_size(void *data)
+{
+	return 240 * sizeof(int16_t);
+}
+
+static uint64_t codec_get_interval(void *data)
+{
+	return 5 * SPA_NSEC_PER_MSEC;
+}
+
+static int codec_start_encode(void *data, void *dst, size_t dst_size,
+		uint16_t seqnum, uint32_t timestamp)
+{
+	return 0;
+}
+
+/* the silence of the streams */
+static int codec_encode(void *data, const void *src, size_t src_size,
+		void *dst, size_t dst_size, size_t *dst_out, int *need_flush)
+{
+	memset(dst, 0xff, 2);
+	*dst_out = 2;
+	*need_flush = NEED_FLUSH_ALL;
+	return src_size;
+}
+
+static const struct media_codec test_codec = {
+	.id = SPA_BLUETOOTH_AUDIO_CODEC_LC3,
+	.kind = MEDIA_CODEC_BAP,
+	.name = "test",
+	.description = "Test codec",
+	.validate_config = codec_validate_config,
+	.init = codec_init,
+	.deinit = codec_deinit,
+	.get_block_size = codec_get_block_size,
+	.get_interval = codec_get_interval,
+	.start_encode = codec_start_encode,
+	.encode = codec_encode,
+};
+
+static uint32_t cpu_get_count(void *object)
+{
+	struct data *d = object;
+	return d->n_cpus;
+}
+
+static const struct spa_cpu_methods cpu_methods = {
+	SPA_VERSION_CPU_METHODS,
+	.get_count = cpu_get_count,
+};
+
+/* the packet of a stream is its index and the number of the pull */
+static void stream_pull(struct spa_bt_iso_io *io)
+{
+	struct stream *s = io->user_data;
+
+	/* a stream is pulled by one thread at a time */
+	spa_assert_se(SPA_ATOMIC_INC(s->busy) == 1);
+
+	if (!pthread_equal(pthread_self(), data.data_thread))
+		SPA_ATOMIC_INC(data.thread_pulls);
+
+	/* give the encode threads time to take the other streams */
+	usleep(200);
+
+	s->pulls++;
+	io->buf[0] = s->index;
+	io->buf[1] = s->pulls;
+	io->size = 2;
+	io->timestamp += 240;
+	io->resync = false;
+
+	SPA_ATOMIC_DEC(s->busy);
+}
+
+/* all streams of the group are pulled once before the streams are done */
+static void stream_done(struct spa_bt_iso_io *io)
+{
+	struct stream *s = io->user_data;
+	uint32_t i;
+
+	spa_assert_se(pthread_equal(pthread_self(), data.data_thread));
+
+	s->dones++;
+	for (i = 0; i < data.n_streams; i++)
+		spa_assert_se(data.streams[i].pulls == s->dones);
+}
+
+static void receive(struct data *d)
+{
+	uint8_t buf[16];
+	uint32_t i;
+	ssize_t len;
+
+	for (i = 0; i < d->n_streams; i++) {
+		struct stream *s = &d->streams[i];
+
+		while ((len = recv(d->dummy.streams[i].fd[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+			spa_assert_se(len == 2);
+			spa_assert_se(buf[0] == s->index);
+			/* sent in the order they were pulled */
+			spa_assert_se(buf[1] > s->sent);
+			spa_assert_se(buf[1] <= s->pulls);
+			s->sent = buf[1];
+		}
+	}
+}
+
+static void run(struct data *d, uint32_t n_threads, struct spa_cpu *cpu)
+{
+	struct iso_dummy *dummy = &d->dummy;
+	uint32_t i;
+
+	dummy->created = dummy->joined = dummy->acquired = 0;
+	d->thread_pulls = 0;
+
+	spa_assert_se(iso_dummy_start(dummy, &test_codec, N_STREAMS, n_threads, cpu) == 0);
+	spa_assert_se(dummy->n_streams == N_STREAMS);
+
+	d->n_streams = dummy->n_streams;
+	for (i = 0; i < d->n_streams; i++) {
+		struct stream *s = &d->streams[i];
+
+		spa_zero(*s);
+		s->io = dummy->streams[i].io;
+		s->index = i;
+		spa_bt_iso_io_set_done_cb(s->io, stream_done);
+		spa_bt_iso_io_set_cb(s->io, stream_pull, s);
+	}
+
+	d->data_thread = pthread_self();
+	spa_loop_control_enter(dummy->control);
+	while (d->streams[0].dones < CYCLES) {
+		spa_loop_control_iterate(dummy->control, -1);
+		receive(d);
+	}
+	spa_loop_control_leave(dummy->control);
+
+	for (i = 0; i < d->n_streams; i++) {
+		struct stream *s = &d->streams[i];
+
+		spa_bt_iso_io_set_cb(s->io, NULL, NULL);
+		spa_assert_se(s->pulls == CYCLES);
+		spa_assert_se(s->dones == CYCLES);
+		spa_assert_se(s->sent > 0);
+		spa_assert_se(SPA_ATOMIC_LOAD(s->io->encode_time) > 0);
+		spa_assert_se(s->io->encode_time_max >= s->io->encode_time);
+	}
+}
+
+/* without encode threads the data thread pulls all streams */
+static void test_inline(struct data *d)
+{
+	run(d, 0, NULL);
+	spa_assert_se(d->dummy.created == 0);
+	spa_assert_se(d->thread_pulls == 0);
+	iso_dummy_stop(&d->dummy);
+}
+
+/* the encode threads get the priority of the data thread and take jobs */
+static void test_threads(struct data *d)
+{
+	d->dummy.acquire_rt_result = 0;
+	run(d, N_STREAMS - 1, NULL);
+	spa_assert_se(d->dummy.created == N_STREAMS - 1);
+	spa_assert_se(d->dummy.acquired == N_STREAMS - 1);
+	spa_assert_se(d->dummy.joined == 0);
+	spa_assert_se(d->thread_pulls > 0);
+	iso_dummy_stop(&d->dummy);
+	spa_assert_se(d->dummy.joined == N_STREAMS - 1);
+}
+
+/* threads that can't run with the priority of the data thread are not used */
+static void test_no_rt(struct data *d)
+{
+	d->dummy.acquire_rt_result = -ENOTSUP;
+	run(d, N_STREAMS - 1, NULL);
+	spa_assert_se(d->dummy.created == 1);
+	spa_assert_se(d->dummy.joined == 1);
+	spa_assert_se(d->thread_pulls == 0);
+	iso_dummy_stop(&d->dummy);
+	spa_assert_se(d->dummy.joined == 1);
+}
+
+/* a CPU is left for the data thread */
+static void test_cpu_count(struct data *d)
+{
+	d->dummy.acquire_rt_result = 0;
+	d->cpu.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_CPU,
+			SPA_VERSION_CPU, &cpu_methods, d);
+
+	d->n_cpus = 3;
+	run(d, N_STREAMS - 1, &d->cpu);
+	spa_assert_se(d->dummy.created == 2);
+	iso_dummy_stop(&d->dummy);
+
+	d->n_cpus = 1;
+	run(d, N_STREAMS - 1, &d->cpu);
+	spa_assert_se(d->dummy.created == 0);
+	spa_assert_se(d->thread_pulls == 0);
+	iso_dummy_stop(&d->dummy);
+}
+
+int main(int argc, char *argv[])
+{
+	if (iso_dummy_init(&data.dummy) < 0)
+		return 1;
+
+	test_inline(&data);
+	test_threads(&data);
+	test_no_rt(&data);
+	test_cpu_count(&data);
+
+	iso_dummy_clear(&data.dummy);
+	return 0;
+}
@@ -7,8 +7,13 @@
 #include "convolver.h"
 
 #include <spa/utils/defs.h>
+#include <spa/utils/atomic.h>
 
 #include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <semaphore.h>
 
 struct convolver1 {
 	int blockSize;
@@ -237,12 +242,156 @@ struct convolver
 	float *tailPrecalculated;
 	float *tailInput;
 	int tailInputFill;
+
+	/* when the thread is running, tailConvolver is processed from
+	 * tailThreadInput into tailOutput outside of convolver_run() */
+	float *tailThreadInput;
+	struct spa_thread_utils *thread_utils;
+	struct spa_thread *thread;
+	sem_t sem;
+	bool thread_running;
+	int thread_quit;
+	int thread_pending;		/* set by convolver_run(), cleared by the thread */
+	bool tail_skip;			/* the pending tail was late, drop it */
+
+	struct convolver_stats stats;	/* accessed with atomics */
 };
 
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void *tail_thread(void *data)
+{
+	struct convolver *conv = data;
+	uint64_t t, avg, max;
+
+	while (true) {
+		if (sem_wait(&conv->sem) < 0)
+			continue;
+		if (SPA_ATOMIC_LOAD(conv->thread_quit))
+			break;
+		if (!SPA_ATOMIC_LOAD(conv->thread_pending))
+			continue;
+
+		t = get_time_ns();
+		convolver1_run(conv->dsp, conv->tailConvolver, conv->tailThreadInput,
+				conv->tailOutput, conv->tailBlockSize);
+		t = get_time_ns() - t;
+
+		avg = SPA_ATOMIC_LOAD(conv->stats.avg_ns);
+		max = SPA_ATOMIC_LOAD(conv->stats.max_ns);
+		SPA_ATOMIC_STORE(conv->stats.last_ns, t);
+		SPA_ATOMIC_STORE(conv->stats.avg_ns, avg ? (avg * 7 + t) / 8 : t);
+		SPA_ATOMIC_STORE(conv->stats.max_ns, SPA_MAX(max, t));
+		SPA_ATOMIC_INC(conv->stats.count);
+
+		/* hand tailOutput back to convolver_run() */
+		SPA_ATOMIC_STORE(conv->thread_pending, 0);
+	}
+	return NULL;
+}
+
+/* Called from convolver_run() when a complete tail block was collected.
+ * The previous job had a whole tail block to complete. If it is still
+ * busy we're late. The processing thread never waits for the thread, the
+ * tail of this block and the late tail are dropped instead. */
+static void tail_thread_queue(struct convolver *conv)
+{
+	struct spa_fga_dsp *dsp = conv->dsp;
+
+	if (SPA_ATOMIC_LOAD(conv->thread_pending)) {
+		SPA_ATOMIC_INC(conv->stats.late);
+		spa_fga_dsp_fft_memclear(dsp, conv->tailPrecalculated, conv->tailBlockSize, true);
+		conv->tail_skip = true;
+		return;
+	}
+	SPA_SWAP(conv->tailPrecalculated, conv->tailOutput);
+	if (conv->tail_skip) {
+		spa_fga_dsp_fft_memclear(dsp, conv->tailPrecalculated, conv->tailBlockSize, true);
+		conv->tail_skip = false;
+	}
+	spa_fga_dsp_copy(dsp, conv->tailThreadInput, conv->tailInput, conv->tailBlockSize);
+
+	SPA_ATOMIC_STORE(conv->thread_pending, 1);
+	sem_post(&conv->sem);
+}
+
+/* wait for the thread to complete its job, not called from
+ * convolver_run() */
+static void tail_thread_sync(struct convolver *conv)
+{
+	while (SPA_ATOMIC_LOAD(conv->thread_pending))
+		sched_yield();
+}
+
+int convolver_start_thread(struct convolver *conv, struct spa_thread_utils *utils,
+		int rt_prio)
+{
+	if (conv->tailConvolver == NULL || conv->thread_running)
+		return 0;
+	if (utils == NULL)
+		return -ENOTSUP;
+
+	conv->tailThreadInput = spa_fga_dsp_fft_memalloc(conv->dsp, conv->tailBlockSize, true);
+	if (conv->tailThreadInput == NULL)
+		return -errno;
+
+	if (sem_init(&conv->sem, 0, 0) < 0)
+		goto error;
+
+	conv->thread_utils = utils;
+	conv->thread_quit = 0;
+	conv->thread_pending = 0;
+	conv->thread = spa_thread_utils_create(utils, NULL, tail_thread, conv);
+	if (conv->thread == NULL) {
+		sem_destroy(&conv->sem);
+		goto error;
+	}
+	if (rt_prio > 0)
+		spa_thread_utils_acquire_rt(utils, conv->thread, rt_prio);
+
+	conv->thread_running = true;
+	return 1;
+
+error:
+	spa_fga_dsp_fft_memfree(conv->dsp, conv->tailThreadInput);
+	conv->tailThreadInput = NULL;
+	return -errno;
+}
+
+static void stop_thread(struct convolver *conv)
+{
+	if (!conv->thread_running)
+		return;
+
+	SPA_ATOMIC_STORE(conv->thread_quit, 1);
+	sem_post(&conv->sem);
+	spa_thread_utils_join(conv->thread_utils, conv->thread, NULL);
+	sem_destroy(&conv->sem);
+	conv->thread_running = false;
+}
+
+void convolver_get_stats(struct convolver *conv, struct convolver_stats *stats)
+{
+	stats->count = SPA_ATOMIC_LOAD(conv->stats.count);
+	stats->last_ns = SPA_ATOMIC_LOAD(conv->stats.last_ns);
+	stats->avg_ns = SPA_ATOMIC_LOAD(conv->stats.avg_ns);
+	stats->max_ns = SPA_ATOMIC_LOAD(conv->stats.max_ns);
+	stats->late = SPA_ATOMIC_LOAD(conv->stats.late);
+}
+
 void convolver_reset(struct convolver *conv)
 {
 	struct spa_fga_dsp *dsp = conv->dsp;
 
+	if (conv->thread_running) {
+		tail_thread_sync(conv);
+		conv->tail_skip = false;
+	}
 	if (conv->headConvolver)
 		convolver1_reset(dsp, conv->headConvolver);
 	if (conv->tailConvolver0) {
@@ -256,6 +405,7 @@ void convolver_reset(struct convolver *conv)
 		spa_fga_dsp_fft_memclear(dsp, conv->tailPrecalculated, conv->tailBlockSize, true);
 	}
 	conv->tailInputFill = 0;
+
 }
 
 struct convolver *convolver_new(struct spa_fga_dsp *dsp, int head_block, int tail_block, const float *ir, int irlen)
@@ -328,6 +478,8 @@ void convolver_free(struct convolver *conv)
 {
 	struct spa_fga_dsp *dsp = conv->dsp;
 
+	stop_thread(conv);
+
 	if (conv->headConvolver)
 		convolver1_free(dsp, conv->headConvolver);
 	if (conv->tailConvolver0)
@@ -339,6 +491,7 @@ void convolver_free(struct convolver *conv)
 	spa_fga_dsp_fft_memfree(dsp, conv->tailOutput);
 	spa_fga_dsp_fft_memfree(dsp, conv->tailPrecalculated);
 	spa_fga_dsp_fft_memfree(dsp, conv->tailInput);
+	spa_fga_dsp_fft_memfree(dsp, conv->tailThreadInput);
 	free(conv);
 }
 
@@ -379,9 +532,13 @@ int convolver_run(struct convolver *conv, const float *input, float *output, int
 
 			if (conv->tailPrecalculated &&
 			    conv->tailInputFill == conv->tailBlockSize) {
-				SPA_SWAP(conv->tailPrecalculated, conv->tailOutput);
-				convolver1_run(dsp, conv->tailConvolver, conv->tailInput,
-						conv->tailOutput, conv->tailBlockSize);
+				if (conv->thread_running) {
+					tail_thread_queue(conv);
+				} else {
+					SPA_SWAP(conv->tailPrecalculated, conv->tailOutput);
+					convolver1_run(dsp, conv->tailConvolver, conv->tailInput,
+							conv->tailOutput, conv->tailBlockSize);
+				}
 			}
 			if (conv->tailInputFill == conv->tailBlockSize)
 				conv->tailInputFill = 0;
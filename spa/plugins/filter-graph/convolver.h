@@ -5,10 +5,28 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include <spa/support/thread.h>
+
 #include "audio-dsp.h"
 
+struct convolver_stats {
+	uint64_t count;		/* number of tail blocks processed by the thread */
+	uint64_t last_ns;	/* time to process the last tail block */
+	uint64_t avg_ns;	/* running average of the tail block process time */
+	uint64_t max_ns;	/* max time to process a tail block */
+	uint64_t late;		/* number of tails that were dropped because they were
+				 * not ready in time */
+};
+
 struct convolver *convolver_new(struct spa_fga_dsp *dsp, int block, int tail, const float *ir, int irlen);
 void convolver_free(struct convolver *conv);
 
+/* Process the tail partitions in a separate thread, created with utils and
+ * made realtime with rt_prio when > 0. Returns 0 when there is no tail to
+ * process, 1 when the thread was started or < 0 on error. */
+int convolver_start_thread(struct convolver *conv, struct spa_thread_utils *utils,
+		int rt_prio);
+void convolver_get_stats(struct convolver *conv, struct convolver_stats *stats);
+
 void convolver_reset(struct convolver *conv);
 int convolver_run(struct convolver *conv, const float *input, float *output, int length);
@@ -37,6 +37,7 @@ struct plugin {
 
 	struct spa_fga_dsp *dsp;
 	struct spa_log *log;
+	struct spa_thread_utils *thread_utils;
 };
 
 struct builtin {
@@ -698,7 +699,7 @@ struct convolver_impl {
 	struct spa_log *log;
 	struct spa_fga_dsp *dsp;
 	unsigned long rate;
-	float *port[3];
+	float *port[6];
 	float latency;
 
 	struct convolver *conv;
@@ -941,6 +942,8 @@ static void * convolver_instantiate(const struct spa_fga_plugin *plugin, const s
 	int blocksize = 0, tailsize = 0;
 	int resample_quality = RESAMPLE_DEFAULT_QUALITY;
 	float gain = 1.0f, delay = 0.0f, latency = -1.0f;
+	bool tail_thread = false;
+	int tail_priority = 0, res;
 	unsigned long rate;
 
 	errno = EINVAL;
@@ -1028,6 +1031,18 @@ static void * convolver_instantiate(const struct spa_fga_plugin *plugin, const s
 				return NULL;
 			}
 		}
+		else if (spa_streq(key, "tail_thread")) {
+			if (spa_json_parse_bool(val, len, &tail_thread) <= 0) {
+				spa_log_error(pl->log, "convolver:tail_thread requires a boolean");
+				return NULL;
+			}
+		}
+		else if (spa_streq(key, "tail_priority")) {
+			if (spa_json_parse_int(val, len, &tail_priority) <= 0) {
+				spa_log_error(pl->log, "convolver:tail_priority requires a number");
+				return NULL;
+			}
+		}
 		else {
 			spa_log_warn(pl->log, "convolver: ignoring config key: '%s'", key);
 		}
@@ -1088,6 +1103,15 @@ static void * convolver_instantiate(const struct spa_fga_plugin *plugin, const s
 	if (impl->conv == NULL)
 		goto error;
 
+	if (tail_thread) {
+		if ((res = convolver_start_thread(impl->conv, pl->thread_utils, tail_priority)) < 0)
+			spa_log_warn(pl->log, "convolver: can't start tail thread: %s",
+					spa_strerror(res));
+		else if (res > 0)
+			spa_log_info(pl->log, "convolver: tail thread started, priority:%d",
+					tail_priority);
+	}
+
 	if (latency < 0.0f)
 		impl->latency = n_samples;
 	else
@@ -1131,6 +1155,18 @@ static struct spa_fga_port convolve_ports[] = {
 	  .hint = SPA_FGA_HINT_LATENCY,
 	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_CONTROL,
 	},
+	{ .index = 3,
+	  .name = "Tail Time (s)",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_CONTROL,
+	},
+	{ .index = 4,
+	  .name = "Tail Max Time (s)",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_CONTROL,
+	},
+	{ .index = 5,
+	  .name = "Tail Late",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_CONTROL,
+	},
 };
 
 static void convolver_activate(void * Instance)
@@ -1149,10 +1185,23 @@ static void convolver_deactivate(void * Instance)
 static void convolve_run(void * Instance, unsigned long SampleCount)
 {
 	struct convolver_impl *impl = Instance;
+	struct convolver_stats stats;
+
 	if (impl->port[1] != NULL && impl->port[0] != NULL)
 		convolver_run(impl->conv, impl->port[1], impl->port[0], SampleCount);
 	if (impl->port[2] != NULL)
 		impl->port[2][0] = impl->latency;
+
+	if (impl->port[3] == NULL && impl->port[4] == NULL && impl->port[5] == NULL)
+		return;
+
+	convolver_get_stats(impl->conv, &stats);
+	if (impl->port[3] != NULL)
+		impl->port[3][0] = stats.avg_ns / (float)SPA_NSEC_PER_SEC;
+	if (impl->port[4] != NULL)
+		impl->port[4][0] = stats.max_ns / (float)SPA_NSEC_PER_SEC;
+	if (impl->port[5] != NULL)
+		impl->port[5][0] = stats.late;
 }
 
 static const struct spa_fga_descriptor convolve_desc = {
@@ -3146,6 +3195,7 @@ impl_init(const struct spa_handle_factory *factory,
 
 	impl->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
 	impl->dsp = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_FILTER_GRAPH_AudioDSP);
+	impl->thread_utils = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_ThreadUtils);
 
 	for (uint32_t i = 0; info && i < info->n_items; i++) {
 		const char *k = info->items[i].key;
@@ -0,0 +1,213 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include <spa/support/thread.h>
+#include <spa/utils/defs.h>
+#include <spa/utils/type.h>
+
+#include "audio-dsp-impl.h"
+#include "convolver.h"
+
+#define HEAD_SIZE	64
+#define TAIL_SIZE	1024
+#define IR_SIZE		8192
+#define BLOCK_SIZE	256
+#define N_BLOCKS	64
+
+#define CLOSE_ENOUGH(a,b)	(fabsf((a)-(b)) < 0.0001f)
+
+/* thread utils that can hold back the thread until it is released */
+struct test_utils {
+	struct spa_thread_utils utils;
+	void *(*start)(void *);
+	void *arg;
+	sem_t gate;
+	bool hold;
+	int created;
+	int rt_prio;
+};
+
+static void *gated_start(void *data)
+{
+	struct test_utils *t = data;
+	if (t->hold)
+		sem_wait(&t->gate);
+	return t->start(t->arg);
+}
+
+static struct spa_thread *test_create(void *object, const struct spa_dict *props,
+		void *(*start)(void*), void *arg)
+{
+	struct test_utils *t = object;
+	pthread_t pt;
+
+	t->start = start;
+	t->arg = arg;
+	if (pthread_create(&pt, NULL, gated_start, t) != 0)
+		return NULL;
+	t->created++;
+	return (struct spa_thread*)pt;
+}
+
+static int test_join(void *object, struct spa_thread *thread, void **retval)
+{
+	return -pthread_join((pthread_t)thread, retval);
+}
+
+static int test_acquire_rt(void *object, struct spa_thread *thread, int priority)
+{
+	struct test_utils *t = object;
+	t->rt_prio = priority;
+	return 0;
+}
+
+static const struct spa_thread_utils_methods test_utils_methods = {
+	SPA_VERSION_THREAD_UTILS_METHODS,
+	.create = test_create,
+	.join = test_join,
+	.acquire_rt = test_acquire_rt,
+};
+
+static void test_utils_init(struct test_utils *t, bool hold)
+{
+	spa_zero(*t);
+	t->utils.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_ThreadUtils,
+			SPA_VERSION_THREAD_UTILS, &test_utils_methods, t);
+	t->hold = hold;
+	sem_init(&t->gate, 0, 0);
+}
+
+static float ir[IR_SIZE];
+static float input[N_BLOCKS * BLOCK_SIZE];
+
+static void wait_tails(struct convolver *conv, uint64_t count)
+{
+	struct convolver_stats stats;
+	int timeout = 5000;
+
+	do {
+		convolver_get_stats(conv, &stats);
+		if (stats.count >= count)
+			break;
+		usleep(1000);
+	} while (--timeout > 0);
+	spa_assert_se(stats.count == count);
+}
+
+/* the thread produces the same output as the processing thread when
+ * it keeps up */
+static void test_thread_output(struct spa_fga_dsp *dsp)
+{
+	struct convolver *ref, *conv;
+	struct convolver_stats stats;
+	struct test_utils t;
+	float out1[BLOCK_SIZE], out2[BLOCK_SIZE];
+	uint32_t i, j, processed = 0;
+
+	test_utils_init(&t, false);
+
+	ref = convolver_new(dsp, HEAD_SIZE, TAIL_SIZE, ir, IR_SIZE);
+	conv = convolver_new(dsp, HEAD_SIZE, TAIL_SIZE, ir, IR_SIZE);
+	spa_assert_se(ref != NULL && conv != NULL);
+
+	spa_assert_se(convolver_start_thread(conv, NULL, 0) == -ENOTSUP);
+	spa_assert_se(convolver_start_thread(conv, &t.utils, 20) == 1);
+	spa_assert_se(t.created == 1);
+	spa_assert_se(t.rt_prio == 20);
+	/* only one thread */
+	spa_assert_se(convolver_start_thread(conv, &t.utils, 20) == 0);
+
+	for (i = 0; i < N_BLOCKS; i++) {
+		convolver_run(ref, &input[i * BLOCK_SIZE], out1, BLOCK_SIZE);
+		convolver_run(conv, &input[i * BLOCK_SIZE], out2, BLOCK_SIZE);
+		processed += BLOCK_SIZE;
+		wait_tails(conv, processed / TAIL_SIZE);
+
+		for (j = 0; j < BLOCK_SIZE; j++)
+			spa_assert_se(CLOSE_ENOUGH(out1[j], out2[j]));
+	}
+	convolver_get_stats(conv, &stats);
+	spa_assert_se(stats.late == 0);
+	spa_assert_se(stats.max_ns >= stats.last_ns);
+
+	convolver_free(conv);
+	convolver_free(ref);
+	sem_destroy(&t.gate);
+}
+
+/* the processing thread never waits for a late tail */
+static void test_thread_late(struct spa_fga_dsp *dsp)
+{
+	struct convolver *conv;
+	struct convolver_stats stats;
+	struct test_utils t;
+	float out[BLOCK_SIZE];
+	uint32_t i;
+
+	test_utils_init(&t, true);
+
+	conv = convolver_new(dsp, HEAD_SIZE, TAIL_SIZE, ir, IR_SIZE);
+	spa_assert_se(conv != NULL);
+	spa_assert_se(convolver_start_thread(conv, &t.utils, 0) == 1);
+	spa_assert_se(t.rt_prio == 0);
+
+	/* the thread is held back, the first tail is queued and the next
+	 * three are late */
+	for (i = 0; i < 4 * TAIL_SIZE / BLOCK_SIZE; i++)
+		convolver_run(conv, &input[i * BLOCK_SIZE], out, BLOCK_SIZE);
+
+	convolver_get_stats(conv, &stats);
+	spa_assert_se(stats.count == 0);
+	spa_assert_se(stats.late == 3);
+
+	/* release the thread, it completes the queued tail and a new tail
+	 * is queued on the next tail block */
+	sem_post(&t.gate);
+	wait_tails(conv, 1);
+	for (; i < 5 * TAIL_SIZE / BLOCK_SIZE; i++)
+		convolver_run(conv, &input[i * BLOCK_SIZE], out, BLOCK_SIZE);
+	wait_tails(conv, 2);
+
+	convolver_get_stats(conv, &stats);
+	spa_assert_se(stats.late == 3);
+
+	/* reset and free with a tail in flight */
+	for (; i < 6 * TAIL_SIZE / BLOCK_SIZE; i++)
+		convolver_run(conv, &input[i * BLOCK_SIZE], out, BLOCK_SIZE);
+	convolver_reset(conv);
+	convolver_free(conv);
+	sem_destroy(&t.gate);
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_fga_dsp *dsp;
+	uint32_t i;
+
+	srand48(0);
+	for (i = 0; i < IR_SIZE; i++)
+		ir[i] = (float)(drand48() * 2.0 - 1.0) * expf(-(float)i / 2000.0f);
+	for (i = 0; i < SPA_N_ELEMENTS(input); i++)
+		input[i] = (float)(drand48() * 2.0 - 1.0);
+
+	dsp = spa_fga_dsp_new(0);
+	spa_assert_se(dsp != NULL);
+
+	test_thread_output(dsp);
+	test_thread_late(dsp);
+
+	spa_fga_dsp_free(dsp);
+
+	return 0;
+}
@@ -0,0 +1,1284 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <linux/io_uring.h>
+
+#include <spa/support/log.h>
+#include <spa/support/system.h>
+#include <spa/support/plugin.h>
+#include <spa/utils/atomic.h>
+#include <spa/utils/list.h>
+#include <spa/utils/type.h>
+#include <spa/utils/names.h>
+#include <spa/utils/string.h>
+
+SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.io-uring-system");
+
+#undef SPA_LOG_TOPIC_DEFAULT
+#define SPA_LOG_TOPIC_DEFAULT &log_topic
+
+#ifndef TFD_TIMER_CANCEL_ON_SET
+#  define TFD_TIMER_CANCEL_ON_SET (1 << 1)
+#endif
+
+/*
+ * A System that waits for the fds of a pollfd with io_uring.
+ *
+ * Every fd in the pollfd has a one-shot poll request in the ring. The
+ * requests are prepared when they complete and when the fds are added,
+ * changed or removed, and they are all submitted with the wait for the
+ * next events in one io_uring_enter(). Because a poll request checks the
+ * state of the fd when it is submitted, after the events were dispatched,
+ * the fds are level-triggered like with epoll.
+ *
+ * The eventfds and timerfds that are made with this system and that are
+ * added to one of its pollfds are handled in the ring:
+ *
+ *  - an eventfd has a poll request with a linked read of the counter.
+ *    eventfd_read() returns the value that was read without a syscall.
+ *  - a timer does not use its timerfd but a timeout request in the ring.
+ *    timerfd_settime() replaces the timeout request in the next submit
+ *    and timerfd_read() returns the expirations without a syscall.
+ *
+ * The eventfds and timers are only handled in the ring for the fds and
+ * pollfds of the same system, other fds are polled as usual. An fd can
+ * only be in one pollfd of a system. eventfd_write() is a write() so that
+ * the wakeup of the other thread is not delayed until the next submit.
+ */
+
+#define RING_ENTRIES	256
+
+#define TABLE_SHIFT	8
+#define TABLE_CHUNK	(1u << TABLE_SHIFT)
+#define TABLE_CHUNKS	4096
+
+enum {
+	OP_NONE,
+	OP_POLL,		/* one-shot poll on the fd */
+	OP_EVENT_POLL,		/* poll on the eventfd, linked to the read */
+	OP_EVENT_READ,		/* read of the eventfd counter */
+	OP_TIMEOUT,		/* expiration of a timer */
+	OP_CANCEL,		/* cancel of one of the above */
+};
+
+#define USER_DATA(e,op)		((uint64_t)(uint32_t)(e)->fd | \
+				 ((uint64_t)((e)->gen & 0xffff) << 32) | \
+				 ((uint64_t)((e)->epoch & 0xff) << 48) | \
+				 ((uint64_t)(op) << 56))
+#define USER_DATA_FD(ud)	((int)((ud) & 0xffffffff))
+#define USER_DATA_GEN(ud)	((uint32_t)(((ud) >> 32) & 0xffff))
+#define USER_DATA_EPOCH(ud)	((uint32_t)(((ud) >> 48) & 0xff))
+#define USER_DATA_OP(ud)	((uint32_t)((ud) >> 56))
+
+struct ring;
+
+struct entry {
+	int fd;
+#define TYPE_NONE	0
+#define TYPE_FD		1
+#define TYPE_EVENT	2
+#define TYPE_TIMER	3
+	uint32_t type;
+	struct ring *ring;		/* the pollfd of the fd */
+	uint32_t events;
+	void *data;
+
+	uint32_t gen;			/* changes when the requests are canceled */
+	uint32_t epoch;			/* changes when the fd is closed */
+	uint32_t reported;		/* iteration of the last event */
+	uint64_t armed;			/* user_data of the request in the ring */
+
+	unsigned int semaphore:1;
+	unsigned int reading:1;		/* a read of the eventfd is in the ring */
+	unsigned int virt:1;		/* the timer runs in the ring */
+	unsigned int pending:1;		/* on the pending list */
+	struct spa_list link;
+
+	uint64_t value;			/* eventfd counter or timer expirations */
+	uint64_t buf;			/* for the read of the eventfd */
+
+	int clockid;
+	uint64_t expire;		/* absolute expiration, 0 is disarmed */
+	uint64_t interval;
+	struct __kernel_timespec ts;
+};
+
+struct ring {
+	struct spa_list link;
+	int fd;
+	bool waiting;
+	uint32_t iteration;
+
+	void *sq_ptr;
+	size_t sq_size;
+	void *cq_ptr;
+	size_t cq_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	uint32_t *sq_head;
+	uint32_t *sq_tail;
+	uint32_t *sq_array;
+	uint32_t sq_mask;
+	uint32_t sq_entries;
+
+	uint32_t *cq_head;
+	uint32_t *cq_tail;
+	uint32_t cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/* eventfds and timers with a value that was not read */
+	struct spa_list pending;
+};
+
+struct impl {
+	struct spa_handle handle;
+	struct spa_system system;
+        struct spa_log *log;
+
+	pthread_mutex_t lock;
+	struct spa_list rings;
+	uint32_t setup_flags;
+	bool skip_success;
+
+	struct entry *table[TABLE_CHUNKS];
+};
+
+static inline int sys_io_uring_setup(uint32_t entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int sys_io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete,
+		uint32_t flags, void *arg, size_t argsz)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static struct entry *find_entry(struct impl *impl, int fd, bool create)
+{
+	uint32_t chunk = (uint32_t)fd >> TABLE_SHIFT, i;
+	struct entry *entries;
+
+	if (fd < 0 || chunk >= TABLE_CHUNKS)
+		return NULL;
+
+	entries = SPA_ATOMIC_LOAD(impl->table[chunk]);
+	if (entries == NULL) {
+		if (!create)
+			return NULL;
+		if ((entries = calloc(TABLE_CHUNK, sizeof(struct entry))) == NULL)
+			return NULL;
+		for (i = 0; i < TABLE_CHUNK; i++)
+			entries[i].fd = (chunk << TABLE_SHIFT) + i;
+		SPA_ATOMIC_STORE(impl->table[chunk], entries);
+	}
+	return &entries[fd & (TABLE_CHUNK - 1)];
+}
+
+static struct ring *find_ring(struct impl *impl, int pfd)
+{
+	struct ring *r;
+	spa_list_for_each(r, &impl->rings, link)
+		if (r->fd == pfd)
+			return r;
+	return NULL;
+}
+
+static inline uint64_t clock_now(int clockid)
+{
+	struct timespec ts;
+	clock_gettime(clockid, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static inline uint64_t ts_to_nsec(const struct timespec *ts)
+{
+	return SPA_TIMESPEC_TO_NSEC(ts);
+}
+
+static inline void nsec_to_ts(uint64_t nsec, struct timespec *ts)
+{
+	ts->tv_sec = nsec / SPA_NSEC_PER_SEC;
+	ts->tv_nsec = nsec % SPA_NSEC_PER_SEC;
+}
+
+/* the sqes that were not submitted yet */
+static inline uint32_t ring_pending(struct ring *r)
+{
+	return *r->sq_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+}
+
+static int ring_flush(struct ring *r)
+{
+	uint32_t pending = ring_pending(r);
+
+	if (pending == 0)
+		return 0;
+	if (sys_io_uring_enter(r->fd, pending, 0, 0, NULL, 0) < 0)
+		return -errno;
+	return 0;
+}
+
+static struct io_uring_sqe *ring_get_sqe(struct impl *impl, struct ring *r)
+{
+	struct io_uring_sqe *sqe;
+	int res;
+
+	if (ring_pending(r) >= r->sq_entries) {
+		/* the ring is full, submit what we have to make room */
+		if ((res = ring_flush(r)) < 0) {
+			spa_log_warn(impl->log, "%p: submit failed: %s", impl, strerror(-res));
+			return NULL;
+		}
+		if (ring_pending(r) >= r->sq_entries)
+			return NULL;
+	}
+	sqe = &r->sqes[*r->sq_tail & r->sq_mask];
+	spa_zero(*sqe);
+	return sqe;
+}
+
+static void ring_push_sqe(struct ring *r)
+{
+	__atomic_store_n(r->sq_tail, *r->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+/* prepare the requests of the entry, the lock is held */
+static int entry_arm(struct impl *impl, struct entry *e)
+{
+	struct ring *r = e->ring;
+	struct io_uring_sqe *sqe;
+
+	if (r == NULL || e->armed != 0 || e->events == 0)
+		return 0;
+
+	if (e->type == TYPE_TIMER && e->virt) {
+		if (e->expire == 0 || !(e->events & SPA_IO_IN))
+			return 0;
+		if ((sqe = ring_get_sqe(impl, r)) == NULL)
+			return -EBUSY;
+		e->ts.tv_sec = e->expire / SPA_NSEC_PER_SEC;
+		e->ts.tv_nsec = e->expire % SPA_NSEC_PER_SEC;
+		sqe->opcode = IORING_OP_TIMEOUT;
+		sqe->fd = -1;
+		sqe->addr = (uintptr_t)&e->ts;
+		sqe->len = 1;
+		sqe->off = 0;
+		sqe->timeout_flags = IORING_TIMEOUT_ABS;
+		if (e->clockid == CLOCK_REALTIME)
+			sqe->timeout_flags |= IORING_TIMEOUT_REALTIME;
+		else if (e->clockid == CLOCK_BOOTTIME)
+			sqe->timeout_flags |= IORING_TIMEOUT_BOOTTIME;
+		sqe->user_data = e->armed = USER_DATA(e, OP_TIMEOUT);
+		ring_push_sqe(r);
+	}
+	else if (e->type == TYPE_EVENT && !e->semaphore &&
+	    (e->events & ~(SPA_IO_ERR | SPA_IO_HUP)) == SPA_IO_IN) {
+		/* the read buffer is in use until the read completes, the
+		 * completion will arm the entry again */
+		if (e->reading)
+			return 0;
+		if (ring_pending(r) + 2 > r->sq_entries && ring_flush(r) < 0)
+			return -EBUSY;
+		if ((sqe = ring_get_sqe(impl, r)) == NULL)
+			return -EBUSY;
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = e->fd;
+		sqe->poll32_events = POLLIN;
+		sqe->flags = IOSQE_IO_LINK;
+		if (impl->skip_success)
+			sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+		sqe->user_data = e->armed = USER_DATA(e, OP_EVENT_POLL);
+		ring_push_sqe(r);
+
+		sqe = ring_get_sqe(impl, r);
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = e->fd;
+		sqe->addr = (uintptr_t)&e->buf;
+		sqe->len = sizeof(uint64_t);
+		sqe->off = (uint64_t)-1;
+		sqe->user_data = USER_DATA(e, OP_EVENT_READ);
+		ring_push_sqe(r);
+		e->reading = true;
+	}
+	else {
+		if ((sqe = ring_get_sqe(impl, r)) == NULL)
+			return -EBUSY;
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = e->fd;
+		sqe->poll32_events = e->events;
+		sqe->user_data = e->armed = USER_DATA(e, OP_POLL);
+		ring_push_sqe(r);
+	}
+	return 0;
+}
+
+/* cancel the requests of the entry, the lock is held */
+static void entry_cancel(struct impl *impl, struct entry *e)
+{
+	struct io_uring_sqe *sqe;
+
+	if (e->armed != 0 && e->ring != NULL &&
+	    (sqe = ring_get_sqe(impl, e->ring)) != NULL) {
+		if (USER_DATA_OP(e->armed) == OP_TIMEOUT)
+			sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+		else
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = e->armed;
+		if (impl->skip_success)
+			sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+		sqe->user_data = USER_DATA(e, OP_CANCEL);
+		ring_push_sqe(e->ring);
+	}
+	e->armed = 0;
+	e->gen++;
+}
+
+static void entry_set_pending(struct entry *e)
+{
+	if (!e->pending && e->ring != NULL) {
+		spa_list_append(&e->ring->pending, &e->link);
+		e->pending = true;
+	}
+}
+
+static void entry_clear_pending(struct entry *e)
+{
+	if (e->pending) {
+		spa_list_remove(&e->link);
+		e->pending = false;
+	}
+}
+
+/* move the timer from the timerfd to the ring */
+static void timer_virtualize(struct impl *impl, struct entry *e)
+{
+	struct itimerspec its;
+	struct pollfd pfd;
+	uint64_t exp;
+
+	if (e->clockid != CLOCK_MONOTONIC && e->clockid != CLOCK_REALTIME &&
+	    e->clockid != CLOCK_BOOTTIME)
+		return;
+
+	spa_zero(its);
+	if (timerfd_gettime(e->fd, &its) < 0)
+		return;
+
+	/* expirations that were not read yet */
+	pfd.fd = e->fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 0) > 0 && read(e->fd, &exp, sizeof(exp)) == sizeof(exp))
+		__atomic_add_fetch(&e->value, exp, __ATOMIC_SEQ_CST);
+
+	if (its.it_value.tv_sec != 0 || its.it_value.tv_nsec != 0) {
+		e->expire = clock_now(e->clockid) + ts_to_nsec(&its.it_value);
+		e->interval = ts_to_nsec(&its.it_interval);
+		spa_zero(its);
+		timerfd_settime(e->fd, 0, &its, NULL);
+	} else {
+		e->expire = 0;
+		e->interval = 0;
+	}
+	e->virt = true;
+}
+
+/* move the timer from the ring back to the timerfd */
+static void timer_devirtualize(struct impl *impl, struct entry *e)
+{
+	struct itimerspec its;
+
+	if (!e->virt)
+		return;
+
+	entry_cancel(impl, e);
+	e->virt = false;
+
+	spa_zero(its);
+	if (e->expire != 0) {
+		nsec_to_ts(e->expire, &its.it_value);
+		nsec_to_ts(e->interval, &its.it_interval);
+		timerfd_settime(e->fd, TFD_TIMER_ABSTIME, &its, NULL);
+	}
+}
+
+static ssize_t impl_read(void *object, int fd, void *buf, size_t count)
+{
+	ssize_t res = read(fd, buf, count);
+	return res < 0 ? -errno : res;
+}
+
+static ssize_t impl_write(void *object, int fd, const void *buf, size_t count)
+{
+	ssize_t res = write(fd, buf, count);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_ioctl(void *object, int fd, unsigned long request, ...)
+{
+	int res;
+	va_list ap;
+	long arg;
+
+	va_start(ap, request);
+	arg = va_arg(ap, long);
+	res = ioctl(fd, request, arg);
+	va_end(ap);
+
+	return res < 0 ? -errno : res;
+}
+
+static void ring_free(struct impl *impl, struct ring *r);
+
+static int impl_close(void *object, int fd)
+{
+	struct impl *impl = object;
+	struct entry *e;
+	struct ring *r;
+	int res;
+
+	pthread_mutex_lock(&impl->lock);
+	if ((r = find_ring(impl, fd)) != NULL) {
+		ring_free(impl, r);
+	} else if ((e = find_entry(impl, fd, false)) != NULL && e->type != TYPE_NONE) {
+		if (e->ring) {
+			entry_cancel(impl, e);
+			entry_clear_pending(e);
+			ring_flush(e->ring);
+			e->ring = NULL;
+		}
+		e->type = TYPE_NONE;
+		e->virt = false;
+		e->epoch++;
+		SPA_ATOMIC_STORE(e->value, 0);
+	}
+	pthread_mutex_unlock(&impl->lock);
+
+	res = close(fd);
+	spa_log_debug(impl->log, "%p: close fd:%d", impl, fd);
+	return res < 0 ? -errno : res;
+}
+
+/* clock */
+static int impl_clock_gettime(void *object,
+			int clockid, struct timespec *value)
+{
+	int res = clock_gettime(clockid, value);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_clock_getres(void *object,
+			int clockid, struct timespec *res)
+{
+	int r = clock_getres(clockid, res);
+	return r < 0 ? -errno : r;
+}
+
+/* poll */
+static void ring_free(struct impl *impl, struct ring *r)
+{
+	struct entry *e;
+	uint32_t i, j;
+
+	spa_list_consume(e, &r->pending, link)
+		entry_clear_pending(e);
+
+	for (i = 0; i < TABLE_CHUNKS; i++) {
+		if (impl->table[i] == NULL)
+			continue;
+		for (j = 0; j < TABLE_CHUNK; j++) {
+			e = &impl->table[i][j];
+			if (e->ring != r)
+				continue;
+			e->ring = NULL;
+			e->armed = 0;
+			e->reading = false;
+			e->gen++;
+			if (e->type == TYPE_FD)
+				e->type = TYPE_NONE;
+		}
+	}
+
+	spa_list_remove(&r->link);
+	if (r->sqes != MAP_FAILED)
+		munmap(r->sqes, r->sqes_size);
+	if (r->cq_ptr != MAP_FAILED && r->cq_ptr != r->sq_ptr)
+		munmap(r->cq_ptr, r->cq_size);
+	if (r->sq_ptr != MAP_FAILED)
+		munmap(r->sq_ptr, r->sq_size);
+	free(r);
+}
+
+static int impl_pollfd_create(void *object, int flags)
+{
+	struct impl *impl = object;
+	struct io_uring_params p;
+	struct ring *r;
+	uint32_t i;
+	int fd, res;
+
+	if ((r = calloc(1, sizeof(*r))) == NULL)
+		return -errno;
+
+	r->sq_ptr = r->cq_ptr = r->sqes = MAP_FAILED;
+	spa_list_init(&r->pending);
+
+	spa_zero(p);
+	p.flags = impl->setup_flags;
+	if ((fd = sys_io_uring_setup(RING_ENTRIES, &p)) < 0) {
+		res = -errno;
+		spa_log_error(impl->log, "%p: io_uring_setup failed: %m", impl);
+		goto error;
+	}
+	r->fd = fd;
+
+	if (!(p.features & IORING_FEAT_EXT_ARG)) {
+		spa_log_error(impl->log, "%p: io_uring is missing the features we need", impl);
+		res = -ENOTSUP;
+		goto error_close;
+	}
+	if (!(flags & SPA_FD_CLOEXEC))
+		fcntl(fd, F_SETFD, 0);
+
+	r->sq_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+	r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		r->sq_size = r->cq_size = SPA_MAX(r->sq_size, r->cq_size);
+
+	r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (r->sq_ptr == MAP_FAILED)
+		goto error_mmap;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		r->cq_ptr = r->sq_ptr;
+	} else {
+		r->cq_ptr = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (r->cq_ptr == MAP_FAILED)
+			goto error_mmap;
+	}
+	r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED)
+		goto error_mmap;
+
+	r->sq_head = SPA_PTROFF(r->sq_ptr, p.sq_off.head, uint32_t);
+	r->sq_tail = SPA_PTROFF(r->sq_ptr, p.sq_off.tail, uint32_t);
+	r->sq_mask = *SPA_PTROFF(r->sq_ptr, p.sq_off.ring_mask, uint32_t);
+	r->sq_array = SPA_PTROFF(r->sq_ptr, p.sq_off.array, uint32_t);
+	r->sq_entries = p.sq_entries;
+	/* the sqes are used in the order of the ring */
+	for (i = 0; i < p.sq_entries; i++)
+		r->sq_array[i] = i;
+
+	r->cq_head = SPA_PTROFF(r->cq_ptr, p.cq_off.head, uint32_t);
+	r->cq_tail = SPA_PTROFF(r->cq_ptr, p.cq_off.tail, uint32_t);
+	r->cq_mask = *SPA_PTROFF(r->cq_ptr, p.cq_off.ring_mask, uint32_t);
+	r->cqes = SPA_PTROFF(r->cq_ptr, p.cq_off.cqes, struct io_uring_cqe);
+
+	pthread_mutex_lock(&impl->lock);
+	spa_list_append(&impl->rings, &r->link);
+	pthread_mutex_unlock(&impl->lock);
+
+	spa_log_debug(impl->log, "%p: new fd:%d entries:%u/%u", impl, fd,
+			p.sq_entries, p.cq_entries);
+	return fd;
+
+error_mmap:
+	res = -errno;
+	spa_log_error(impl->log, "%p: can't map io_uring: %m", impl);
+error_close:
+	close(fd);
+error:
+	spa_list_init(&r->link);
+	ring_free(impl, r);
+	return res;
+}
+
+static int impl_pollfd_add(void *object, int pfd, int fd, uint32_t events, void *data)
+{
+	struct impl *impl = object;
+	struct ring *r;
+	struct entry *e;
+	int res = 0;
+
+	pthread_mutex_lock(&impl->lock);
+	if ((r = find_ring(impl, pfd)) == NULL) {
+		res = -EBADF;
+		goto done;
+	}
+	if ((e = find_entry(impl, fd, true)) == NULL) {
+		res = -ENOMEM;
+		goto done;
+	}
+	if (e->ring != NULL) {
+		res = -EEXIST;
+		goto done;
+	}
+	if (e->type == TYPE_NONE)
+		e->type = TYPE_FD;
+	e->ring = r;
+	/* there is no exclusive wakeup in io_uring, an fd is only in one
+	 * ring of this System so there is nothing else to wake up */
+	e->events = events & ~SPA_IO_EXCLUSIVE;
+	e->data = data;
+	if (e->type == TYPE_TIMER)
+		timer_virtualize(impl, e);
+	if (SPA_ATOMIC_LOAD(e->value) != 0)
+		entry_set_pending(e);
+
+	res = entry_arm(impl, e);
+	if (r->waiting)
+		ring_flush(r);
+done:
+	pthread_mutex_unlock(&impl->lock);
+	return res;
+}
+
+static int impl_pollfd_mod(void *object, int pfd, int fd, uint32_t events, void *data)
+{
+	struct impl *impl = object;
+	struct ring *r;
+	struct entry *e;
+	int res = 0;
+
+	pthread_mutex_lock(&impl->lock);
+	if ((r = find_ring(impl, pfd)) == NULL) {
+		res = -EBADF;
+		goto done;
+	}
+	/* like epoll, an exclusive fd can't be modified */
+	if (events & SPA_IO_EXCLUSIVE) {
+		res = -EINVAL;
+		goto done;
+	}
+	if ((e = find_entry(impl, fd, false)) == NULL || e->ring != r) {
+		res = -ENOENT;
+		goto done;
+	}
+	if (e->events != events) {
+		entry_cancel(impl, e);
+		e->events = events;
+	}
+	e->data = data;
+
+	res = entry_arm(impl, e);
+	if (r->waiting)
+		ring_flush(r);
+done:
+	pthread_mutex_unlock(&impl->lock);
+	return res;
+}
+
+static int impl_pollfd_del(void *object, int pfd, int fd)
+{
+	struct impl *impl = object;
+	struct ring *r;
+	struct entry *e;
+	int res = 0;
+
+	pthread_mutex_lock(&impl->lock);
+	if ((r = find_ring(impl, pfd)) == NULL) {
+		res = -EBADF;
+		goto done;
+	}
+	if ((e = find_entry(impl, fd, false)) == NULL || e->ring != r) {
+		res = -ENOENT;
+		goto done;
+	}
+	if (e->type == TYPE_TIMER)
+		timer_devirtualize(impl, e);
+	entry_cancel(impl, e);
+	entry_clear_pending(e);
+	/* the poll request keeps a reference to the file, submit the cancel
+	 * now so that the fd can be closed */
+	ring_flush(r);
+	e->ring = NULL;
+	e->events = 0;
+	e->data = NULL;
+	if (e->type == TYPE_FD)
+		e->type = TYPE_NONE;
+done:
+	pthread_mutex_unlock(&impl->lock);
+	return res;
+}
+
+static inline bool entry_report(struct ring *r, struct entry *e, uint32_t events,
+		struct spa_poll_event *ev, int *n_ev)
+{
+	if (e->reported == r->iteration) {
+		/* already reported in this iteration, merge the events */
+		int i;
+		for (i = 0; i < *n_ev; i++) {
+			if (ev[i].data == e->data) {
+				ev[i].events |= events;
+				break;
+			}
+		}
+		return true;
+	}
+	ev[*n_ev].events = events;
+	ev[*n_ev].data = e->data;
+	(*n_ev)++;
+	e->reported = r->iteration;
+	return true;
+}
+
+static void timer_expired(struct impl *impl, struct entry *e, uint64_t now)
+{
+	uint64_t n = 1;
+
+	if (e->interval > 0) {
+		if (now > e->expire)
+			n += (now - e->expire) / e->interval;
+		e->expire += n * e->interval;
+	} else {
+		e->expire = 0;
+	}
+	__atomic_add_fetch(&e->value, n, __ATOMIC_SEQ_CST);
+}
+
+/* handle a completion, returns true when it produced an event */
+static bool ring_complete(struct impl *impl, struct ring *r, const struct io_uring_cqe *cqe,
+		struct spa_poll_event *ev, int *n_ev)
+{
+	uint64_t ud = cqe->user_data;
+	uint32_t op = USER_DATA_OP(ud);
+	struct entry *e;
+	bool current;
+
+	if (op == OP_CANCEL || op == OP_NONE)
+		return false;
+	if ((e = find_entry(impl, USER_DATA_FD(ud), false)) == NULL)
+		return false;
+
+	if (op == OP_EVENT_READ) {
+		/* the buffer is free again */
+		e->reading = false;
+		if (USER_DATA_EPOCH(ud) == (e->epoch & 0xff) && cqe->res == sizeof(uint64_t))
+			__atomic_add_fetch(&e->value, e->buf, __ATOMIC_SEQ_CST);
+	}
+
+	current = e->ring == r && e->armed != 0 &&
+		USER_DATA_GEN(ud) == (e->gen & 0xffff) &&
+		USER_DATA_EPOCH(ud) == (e->epoch & 0xff);
+
+	if (!current) {
+		/* a stale read might have kept a new one from being made */
+		if (op == OP_EVENT_READ && e->ring == r) {
+			if (e->armed == 0)
+				entry_arm(impl, e);
+			if (SPA_ATOMIC_LOAD(e->value) != 0)
+				entry_set_pending(e);
+		}
+		return false;
+	}
+
+	switch (op) {
+	case OP_POLL:
+		e->armed = 0;
+		if (cqe->res < 0) {
+			if (cqe->res == -ECANCELED) {
+				entry_arm(impl, e);
+				return false;
+			}
+			return entry_report(r, e, SPA_IO_ERR, ev, n_ev);
+		}
+		entry_arm(impl, e);
+		return entry_report(r, e, cqe->res, ev, n_ev);
+
+	case OP_EVENT_POLL:
+		/* the linked read completes the request */
+		if (cqe->res < 0 && cqe->res != -ECANCELED) {
+			e->armed = 0;
+			return entry_report(r, e, SPA_IO_ERR, ev, n_ev);
+		}
+		return false;
+
+	case OP_EVENT_READ:
+		e->armed = 0;
+		entry_arm(impl, e);
+		if (cqe->res == sizeof(uint64_t)) {
+			entry_set_pending(e);
+			return entry_report(r, e, SPA_IO_IN, ev, n_ev);
+		}
+		/* someone else read the counter or the poll failed */
+		if (cqe->res == -EAGAIN || cqe->res == -ECANCELED)
+			return false;
+		return entry_report(r, e, SPA_IO_ERR, ev, n_ev);
+
+	case OP_TIMEOUT:
+		e->armed = 0;
+		if (cqe->res != -ETIME)
+			return false;
+		timer_expired(impl, e, clock_now(e->clockid));
+		entry_arm(impl, e);
+		entry_set_pending(e);
+		return entry_report(r, e, SPA_IO_IN, ev, n_ev);
+	}
+	return false;
+}
+
+static int ring_reap(struct impl *impl, struct ring *r, struct spa_poll_event *ev, int n_ev)
+{
+	uint32_t head, tail;
+	int n = 0;
+
+	head = *r->cq_head;
+	tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+
+	/* we might merge events of an fd so stop when there is no room for
+	 * a new one */
+	while (head != tail && n < n_ev) {
+		ring_complete(impl, r, &r->cqes[head & r->cq_mask], ev, &n);
+		head++;
+	}
+	__atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+	return n;
+}
+
+static int impl_pollfd_wait(void *object, int pfd,
+		struct spa_poll_event *ev, int n_ev, int timeout)
+{
+	struct impl *impl = object;
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	struct entry *e, *t;
+	struct ring *r;
+	uint32_t to_submit, min_complete, flags;
+	int n = 0, res;
+
+	pthread_mutex_lock(&impl->lock);
+	if ((r = find_ring(impl, pfd)) == NULL) {
+		pthread_mutex_unlock(&impl->lock);
+		return -EBADF;
+	}
+	r->iteration++;
+
+	/* values that were not read are reported again, like a level
+	 * triggered fd */
+	spa_list_for_each_safe(e, t, &r->pending, link) {
+		if (n >= n_ev)
+			break;
+		if (SPA_ATOMIC_LOAD(e->value) == 0 || !(e->events & SPA_IO_IN))
+			entry_clear_pending(e);
+		else
+			entry_report(r, e, SPA_IO_IN, ev, &n);
+	}
+	n += ring_reap(impl, r, ev + n, n_ev - n);
+	if (n > 0)
+		timeout = 0;
+
+	to_submit = ring_pending(r);
+	if (to_submit == 0 && timeout == 0) {
+		pthread_mutex_unlock(&impl->lock);
+		return n;
+	}
+	r->waiting = timeout != 0;
+	pthread_mutex_unlock(&impl->lock);
+
+	spa_zero(arg);
+	flags = IORING_ENTER_EXT_ARG;
+	min_complete = 0;
+	if (timeout != 0) {
+		flags |= IORING_ENTER_GETEVENTS;
+		min_complete = 1;
+		if (timeout > 0) {
+			ts.tv_sec = timeout / 1000;
+			ts.tv_nsec = (timeout % 1000) * SPA_NSEC_PER_MSEC;
+			arg.ts = (uintptr_t)&ts;
+		}
+	}
+	res = sys_io_uring_enter(r->fd, to_submit, min_complete, flags, &arg, sizeof(arg));
+	if (res < 0)
+		res = -errno;
+
+	pthread_mutex_lock(&impl->lock);
+	r->waiting = false;
+	if (res < 0 && res != -ETIME && res != -EINTR)
+		spa_log_warn(impl->log, "%p: io_uring_enter failed: %s", impl, strerror(-res));
+	n += ring_reap(impl, r, ev + n, n_ev - n);
+	pthread_mutex_unlock(&impl->lock);
+
+	if (n == 0 && res == -EINTR)
+		return res;
+	return n;
+}
+
+/* timers */
+static int impl_timerfd_create(void *object, int clockid, int flags)
+{
+	struct impl *impl = object;
+	struct entry *e;
+	int fl = 0, res;
+	if (flags & SPA_FD_CLOEXEC)
+		fl |= TFD_CLOEXEC;
+	if (flags & SPA_FD_NONBLOCK)
+		fl |= TFD_NONBLOCK;
+	res = timerfd_create(clockid, fl);
+	spa_log_debug(impl->log, "%p: new fd:%d", impl, res);
+	if (res < 0)
+		return -errno;
+
+	pthread_mutex_lock(&impl->lock);
+	if ((e = find_entry(impl, res, true)) != NULL) {
+		e->type = TYPE_TIMER;
+		e->clockid = clockid;
+		e->expire = e->interval = 0;
+	}
+	pthread_mutex_unlock(&impl->lock);
+	return res;
+}
+
+static inline struct entry *find_virtual_timer(struct impl *impl, int fd)
+{
+	struct entry *e = find_entry(impl, fd, false);
+	return e && e->type == TYPE_TIMER && e->virt ? e : NULL;
+}
+
+static void timer_get(struct entry *e, uint64_t now, struct itimerspec *value)
+{
+	spa_zero(*value);
+	if (e->expire != 0)
+		nsec_to_ts(e->expire > now ? e->expire - now : 1, &value->it_value);
+	nsec_to_ts(e->interval, &value->it_interval);
+}
+
+static int impl_timerfd_settime(void *object,
+			int fd, int flags,
+			const struct itimerspec *new_value,
+			struct itimerspec *old_value)
+{
+	struct impl *impl = object;
+	struct entry *e;
+	uint64_t now;
+	int fl = 0, res;
+
+	pthread_mutex_lock(&impl->lock);
+	if ((e = find_virtual_timer(impl, fd)) != NULL) {
+		if (flags & SPA_FD_TIMER_CANCEL_ON_SET) {
+			/* only the timerfd knows when the clock was set */
+			timer_devirtualize(impl, e);
+			ring_flush(e->ring);
+		} else {
+			now = clock_now(e->clockid);
+			if (old_value)
+				timer_get(e, now, old_value);
+
+			entry_cancel(impl, e);
+			SPA_ATOMIC_STORE(e->value, 0);
+			entry_clear_pending(e);
+
+			e->expire = ts_to_nsec(&new_value->it_value);
+			e->interval = ts_to_nsec(&new_value->it_interval);
+			if (e->expire != 0 && !(flags & SPA_FD_TIMER_ABSTIME))
+				e->expire += now;
+
+			res = entry_arm(impl, e);
+			if (e->ring->waiting)
+				ring_flush(e->ring);
+			pthread_mutex_unlock(&impl->lock);
+			return res;
+		}
+	}
+	pthread_mutex_unlock(&impl->lock);
+
+	if (flags & SPA_FD_TIMER_ABSTIME)
+		fl |= TFD_TIMER_ABSTIME;
+	if (flags & SPA_FD_TIMER_CANCEL_ON_SET)
+		fl |= TFD_TIMER_CANCEL_ON_SET;
+	res = timerfd_settime(fd, fl, new_value, old_value);
+	return res < 0 ? -errno : res;
+}
+
+static int impl_timerfd_gettime(void *object,
+			int fd, struct itimerspec *curr_value)
+{
+	struct impl *impl = object;
+	struct entry *e;
+	int res;
+
+	pthread_mutex_lock(&impl->lock);
+	if ((e = find_virtual_timer(impl, fd)) != NULL) {
+		timer_get(e, clock_now(e->clockid), curr_value);
+		pthread_mutex_unlock(&impl->lock);
+		return 0;
+	}
+	pthread_mutex_unlock(&impl->lock);
+
+	res = timerfd_gettime(fd, curr_value);
+	return res < 0 ? -errno : res;
+
+}
+static int impl_timerfd_read(void *object, int fd, uint64_t *expirations)
+{
+	struct impl *impl = object;
+	struct entry *e;
+	uint64_t val;
+
+	if ((e = find_entry(impl, fd, false)) != NULL && e->type == TYPE_TIMER) {
+		if ((val = SPA_ATOMIC_XCHG(e->value, 0)) != 0) {
+			*expirations = val;
+			return 0;
+		}
+		if (e->virt)
+			return -EAGAIN;
+	}
+	if (read(fd, expirations, sizeof(uint64_t)) != sizeof(uint64_t))
+		return -errno;
+	return 0;
+}
+
+/* events */
+static int impl_eventfd_create(void *object, int flags)
+{
+	struct impl *impl = object;
+	struct entry *e;
+	int fl = 0, res, err;
+	if (flags & SPA_FD_CLOEXEC)
+		fl |= EFD_CLOEXEC;
+	if (flags & SPA_FD_NONBLOCK)
+		fl |= EFD_NONBLOCK;
+	if (flags & SPA_FD_EVENT_SEMAPHORE)
+		fl |= EFD_SEMAPHORE;
+	res = eventfd(0, fl);
+	err = -errno; /* save errno in case it is overwritten before return */
+	spa_log_debug(impl->log, "%p: new fd:%d", impl, res);
+	if (res < 0)
+		return err;
+
+	pthread_mutex_lock(&impl->lock);
+	if ((e = find_entry(impl, res, true)) != NULL) {
+		e->type = TYPE_EVENT;
+		e->semaphore = SPA_FLAG_IS_SET(flags, SPA_FD_EVENT_SEMAPHORE);
+	}
+	pthread_mutex_unlock(&impl->lock);
+	return res;
+}
+
+static int impl_eventfd_write(void *object, int fd, uint64_t count)
+{
+	if (write(fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
+		return -errno;
+	return 0;
+}
+
+static int impl_eventfd_read(void *object, int fd, uint64_t *count)
+{
+	struct impl *impl = object;
+	struct entry *e;
+	uint64_t val;
+
+	if ((e = find_entry(impl, fd, false)) != NULL && e->type == TYPE_EVENT &&
+	    (val = SPA_ATOMIC_XCHG(e->value, 0)) != 0) {
+		*count = val;
+		return 0;
+	}
+	if (read(fd, count, sizeof(uint64_t)) != sizeof(uint64_t))
+		return -errno;
+	return 0;
+}
+
+/* signals */
+static int impl_signalfd_create(void *object, int signal, int flags)
+{
+	struct impl *impl = object;
+	sigset_t mask;
+	int res, fl = 0;
+
+	if (flags & SPA_FD_CLOEXEC)
+		fl |= SFD_CLOEXEC;
+	if (flags & SPA_FD_NONBLOCK)
+		fl |= SFD_NONBLOCK;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, signal);
+	res = signalfd(-1, &mask, fl);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	spa_log_debug(impl->log, "%p: new fd:%d", impl, res);
+
+	return res < 0 ? -errno : res;
+}
+
+static int impl_signalfd_read(void *object, int fd, int *signal)
+{
+	struct signalfd_siginfo signal_info;
+	int len;
+
+	len = read(fd, &signal_info, sizeof signal_info);
+	if (!(len == -1 && errno == EAGAIN) && len != sizeof signal_info)
+		return -errno;
+
+	*signal = signal_info.ssi_signo;
+
+	return 0;
+}
+
+static const struct spa_system_methods impl_system = {
+	SPA_VERSION_SYSTEM_METHODS,
+	.read = impl_read,
+	.write = impl_write,
+	.ioctl = impl_ioctl,
+	.close = impl_close,
+	.clock_gettime = impl_clock_gettime,
+	.clock_getres = impl_clock_getres,
+	.pollfd_create = impl_pollfd_create,
+	.pollfd_add = impl_pollfd_add,
+	.pollfd_mod = impl_pollfd_mod,
+	.pollfd_del = impl_pollfd_del,
+	.pollfd_wait = impl_pollfd_wait,
+	.timerfd_create = impl_timerfd_create,
+	.timerfd_settime = impl_timerfd_settime,
+	.timerfd_gettime = impl_timerfd_gettime,
+	.timerfd_read = impl_timerfd_read,
+	.eventfd_create = impl_eventfd_create,
+	.eventfd_write = impl_eventfd_write,
+	.eventfd_read = impl_eventfd_read,
+	.signalfd_create = impl_signalfd_create,
+	.signalfd_read = impl_signalfd_read,
+};
+
+static int impl_get_interface(struct spa_handle *handle, const char *type, void **interface)
+{
+	struct impl *impl;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+	spa_return_val_if_fail(interface != NULL, -EINVAL);
+
+	impl = (struct impl *) handle;
+
+	if (spa_streq(type, SPA_TYPE_INTERFACE_System))
+		*interface = &impl->system;
+	else
+		return -ENOENT;
+
+	return 0;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	struct impl *impl;
+	struct ring *r;
+	uint32_t i;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	impl = (struct impl *) handle;
+
+	spa_list_consume(r, &impl->rings, link) {
+		close(r->fd);
+		ring_free(impl, r);
+	}
+	for (i = 0; i < TABLE_CHUNKS; i++)
+		free(impl->table[i]);
+	pthread_mutex_destroy(&impl->lock);
+	return 0;
+}
+
+static size_t
+impl_get_size(const struct spa_handle_factory *factory,
+	      const struct spa_dict *params)
+{
+	return sizeof(struct impl);
+}
+
+static int
+impl_init(const struct spa_handle_factory *factory,
+	  struct spa_handle *handle,
+	  const struct spa_dict *info,
+	  const struct spa_support *support,
+	  uint32_t n_support)
+{
+	struct impl *impl;
+	struct io_uring_params p;
+	int fd;
+
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	impl = (struct impl *) handle;
+	impl->system.iface = SPA_INTERFACE_INIT(
+			SPA_TYPE_INTERFACE_System,
+			SPA_VERSION_SYSTEM,
+			&impl_system, impl);
+
+	impl->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
+	spa_log_topic_init(impl->log, &log_topic);
+
+	/* probe the kernel */
+	spa_zero(p);
+	p.flags = IORING_SETUP_SUBMIT_ALL;
+	if ((fd = sys_io_uring_setup(1, &p)) < 0) {
+		spa_zero(p);
+		if ((fd = sys_io_uring_setup(1, &p)) < 0) {
+			spa_log_error(impl->log, "%p: io_uring is not available: %m", impl);
+			return -errno;
+		}
+	}
+	close(fd);
+	if (!(p.features & IORING_FEAT_EXT_ARG)) {
+		spa_log_error(impl->log, "%p: io_uring does not support wait timeouts", impl);
+		return -ENOTSUP;
+	}
+	impl->setup_flags = p.flags;
+	impl->skip_success = SPA_FLAG_IS_SET(p.features, IORING_FEAT_CQE_SKIP);
+
+	pthread_mutex_init(&impl->lock, NULL);
+	spa_list_init(&impl->rings);
+
+	spa_log_debug(impl->log, "%p: initialized features:%08x", impl, p.features);
+
+	return 0;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE_INTERFACE_System,},
+};
+
+static int
+impl_enum_interface_info(const struct spa_handle_factory *factory,
+			 const struct spa_interface_info **info,
+			 uint32_t *index)
+{
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+
+	if (*index >= SPA_N_ELEMENTS(impl_interfaces))
+		return 0;
+
+	*info = &impl_interfaces[(*index)++];
+	return 1;
+}
+
+const struct spa_handle_factory spa_support_io_uring_system_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	SPA_NAME_SUPPORT_SYSTEM_IO_URING,
+	NULL,
+	impl_get_size,
+	impl_init,
+	impl_enum_interface_info
+};
@@ -103,6 +103,7 @@ struct impl {
 	int recurse;
 
 	struct spa_source *wakeup;
+	int wakeup_pending;
 
 	uint32_t count;
 	uint32_t flush_count;
@@ -472,7 +473,11 @@ again:
 
 		res = item->res;
 	} else {
-		loop_signal_event(impl, impl->wakeup);
+		/* only signal the loop when there is no wakeup pending yet. The
+		 * loop clears the flag before it flushes the queues so our item
+		 * is either flushed by the pending wakeup or we signal again. */
+		if (SPA_ATOMIC_XCHG(impl->wakeup_pending, 1) == 0)
+			loop_signal_event(impl, impl->wakeup);
 
 		if (block && queue->ack_fd != -1) {
 			uint64_t count = 1;
@@ -527,6 +532,7 @@ xrun:
 static void wakeup_func(void *data, uint64_t count)
 {
 	struct impl *impl = data;
+	SPA_ATOMIC_STORE(impl->wakeup_pending, 0);
 	flush_all_queues(impl);
 }
 
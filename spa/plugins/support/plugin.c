@@ -14,6 +14,9 @@ extern const struct spa_handle_factory spa_support_cpu_factory;
 extern const struct spa_handle_factory spa_support_loop_factory;
 extern const struct spa_handle_factory spa_support_node_driver_factory;
 extern const struct spa_handle_factory spa_support_null_audio_sink_factory;
+#ifdef HAVE_IO_URING
+extern const struct spa_handle_factory spa_support_io_uring_system_factory;
+#endif
 
 SPA_LOG_TOPIC_ENUM_DEFINE_REGISTERED;
 
@@ -42,6 +45,11 @@ int spa_handle_factory_enum(const struct spa_handle_factory **factory, uint32_t
 	case 5:
 		*factory = &spa_support_null_audio_sink_factory;
 		break;
+#ifdef HAVE_IO_URING
+	case 6:
+		*factory = &spa_support_io_uring_system_factory;
+		break;
+#endif
 	default:
 		return 0;
 	}
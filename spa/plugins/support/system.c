@@ -21,6 +21,10 @@
 #include <spa/utils/names.h>
 #include <spa/utils/string.h>
 
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE 0
+#endif
+
 SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.system");
 
 #undef SPA_LOG_TOPIC_DEFAULT
@@ -97,13 +101,20 @@ static int impl_pollfd_create(void *object, int flags)
 	return res < 0 ? -errno : res;
 }
 
+static inline uint32_t to_epoll_events(uint32_t events)
+{
+	/* the SPA_IO events have the same values as the EPOLL events */
+	return (events & ~SPA_IO_EXCLUSIVE) |
+		(events & SPA_IO_EXCLUSIVE ? EPOLLEXCLUSIVE : 0);
+}
+
 static int impl_pollfd_add(void *object, int pfd, int fd, uint32_t events, void *data)
 {
 	struct epoll_event ep;
 	int res;
 
 	spa_zero(ep);
-	ep.events = events;
+	ep.events = to_epoll_events(events);
 	ep.data.ptr = data;
 
 	res = epoll_ctl(pfd, EPOLL_CTL_ADD, fd, &ep);
@@ -116,6 +127,10 @@ static int impl_pollfd_mod(void *object, int pfd, int fd, uint32_t events, void
 	int res;
 
 	spa_zero(ep);
+	/* an exclusive fd can't be modified, EPOLLEXCLUSIVE is only valid for
+	 * EPOLL_CTL_ADD */
+	if (events & SPA_IO_EXCLUSIVE)
+		return -EINVAL;
 	ep.events = events;
 	ep.data.ptr = data;
 
@@ -80,6 +80,8 @@ struct port {
 	bool alloc_buffers;
 	bool probed_expbuf;
 	bool have_expbuf;
+	bool have_dmabuf;
+	bool use_expbuf;
 	bool first_buffer;
 	uint32_t max_buffers;
 
@@ -99,6 +101,7 @@ struct port {
 	struct v4l2_format fmt;
 	enum v4l2_buf_type type;
 	enum v4l2_memory memtype;
+	uint32_t copy_bytes;
 
 	struct control controls[MAX_CONTROLS];
 	uint32_t n_controls;
@@ -163,19 +166,45 @@ struct impl {
 
 #include "v4l2-utils.c"
 
+static const char *io_mode_name(struct port *port)
+{
+	switch (port->memtype) {
+	case V4L2_MEMORY_MMAP:
+		if (port->use_expbuf)
+			return "expbuf";
+		return port->copy_bytes ? "mmap-copy" : "mmap";
+	case V4L2_MEMORY_USERPTR:
+		return "userptr";
+	case V4L2_MEMORY_DMABUF:
+		return "dmabuf";
+	default:
+		return "unknown";
+	}
+}
+
 static void emit_node_info(struct impl *this, bool full)
 {
-	static const struct spa_dict_item info_items[] = {
-		{ SPA_KEY_DEVICE_API, "v4l2" },
-		{ SPA_KEY_MEDIA_CLASS, "Video/Source" },
-		{ SPA_KEY_MEDIA_ROLE, "Camera" },
-		{ SPA_KEY_NODE_DRIVER, "true" },
-	};
+	struct port *port = GET_OUT_PORT(this, 0);
+	struct spa_dict_item items[6];
+	uint32_t n_items = 0;
+	char copy_bytes[16];
 	uint64_t old = full ? this->info.change_mask : 0;
+
 	if (full)
 		this->info.change_mask = this->info_all;
 	if (this->info.change_mask) {
-		this->info.props = &SPA_DICT_INIT_ARRAY(info_items);
+		items[n_items++] = SPA_DICT_ITEM_INIT(SPA_KEY_DEVICE_API, "v4l2");
+		items[n_items++] = SPA_DICT_ITEM_INIT(SPA_KEY_MEDIA_CLASS, "Video/Source");
+		items[n_items++] = SPA_DICT_ITEM_INIT(SPA_KEY_MEDIA_ROLE, "Camera");
+		items[n_items++] = SPA_DICT_ITEM_INIT(SPA_KEY_NODE_DRIVER, "true");
+		if (port->n_buffers > 0) {
+			snprintf(copy_bytes, sizeof(copy_bytes), "%u", port->copy_bytes);
+			items[n_items++] = SPA_DICT_ITEM_INIT(SPA_KEY_API_V4L2_IO_MODE,
+					io_mode_name(port));
+			items[n_items++] = SPA_DICT_ITEM_INIT(SPA_KEY_API_V4L2_COPY_BYTES,
+					copy_bytes);
+		}
+		this->info.props = &SPA_DICT_INIT(items, n_items);
 		spa_node_emit_info(&this->hooks, &this->info);
 		this->info.change_mask = old;
 	}
@@ -595,21 +624,38 @@ static int impl_node_port_enum_params(void *object, int seq,
 			return res;
 		break;
 	case SPA_PARAM_Buffers:
+	{
+		bool dmabuf = port->have_dmabuf && port->have_modifier;
+
 		if (!port->have_format)
 			return -EIO;
-		if (result.index > 0)
+		if (result.index > (dmabuf ? 1u : 0u))
 			return 0;
 		if (port->max_buffers == 0)
 			return -EIO;
 
-		param = spa_pod_builder_add_object(&b.b,
-			SPA_TYPE_OBJECT_ParamBuffers, id,
-			SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(SPA_MIN(4u, port->max_buffers),
-				1, port->max_buffers),
-			SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(1),
-			SPA_PARAM_BUFFERS_size,    SPA_POD_Int(port->fmt.fmt.pix.sizeimage),
-			SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(port->fmt.fmt.pix.bytesperline));
+		if (dmabuf && result.index == 0) {
+			/* the driver can capture directly into linear DmaBuf
+			 * memory allocated by the peer, prefer this */
+			param = spa_pod_builder_add_object(&b.b,
+				SPA_TYPE_OBJECT_ParamBuffers, id,
+				SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(SPA_MIN(4u, port->max_buffers),
+					1, port->max_buffers),
+				SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(1),
+				SPA_PARAM_BUFFERS_size,    SPA_POD_Int(port->fmt.fmt.pix.sizeimage),
+				SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(port->fmt.fmt.pix.bytesperline),
+				SPA_PARAM_BUFFERS_dataType, SPA_POD_CHOICE_FLAGS_Int(1<<SPA_DATA_DmaBuf));
+		} else {
+			param = spa_pod_builder_add_object(&b.b,
+				SPA_TYPE_OBJECT_ParamBuffers, id,
+				SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(SPA_MIN(4u, port->max_buffers),
+					1, port->max_buffers),
+				SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(1),
+				SPA_PARAM_BUFFERS_size,    SPA_POD_Int(port->fmt.fmt.pix.sizeimage),
+				SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(port->fmt.fmt.pix.bytesperline));
+		}
 		break;
+	}
 
 	case SPA_PARAM_Meta:
 		switch (result.index) {
@@ -840,6 +886,10 @@ static int impl_node_port_use_buffers(void *object,
 	} else {
 		res = spa_v4l2_use_buffers(this, buffers, n_buffers);
 	}
+	if (res >= 0) {
+		this->info.change_mask |= SPA_NODE_CHANGE_MASK_PROPS;
+		emit_node_info(this, false);
+	}
 	return res;
 }
 
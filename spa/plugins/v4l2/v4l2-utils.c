@@ -1145,6 +1145,11 @@ static int probe_expbuf(struct impl *this)
 		return -errno;
 	}
 	port->max_buffers = reqbuf.count;
+#ifdef V4L2_BUF_CAP_SUPPORTS_DMABUF
+	port->have_dmabuf = SPA_FLAG_IS_SET(reqbuf.capabilities, V4L2_BUF_CAP_SUPPORTS_DMABUF);
+#endif
+	spa_log_info(this->log, "'%s' DMABUF import %ssupported", this->props.device,
+			port->have_dmabuf ? "" : "not ");
 
 	spa_zero(expbuf);
 	expbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -1706,8 +1711,10 @@ static int mmap_read(struct impl *this)
 	if (buf.flags & V4L2_BUF_FLAG_ERROR)
 		d[0].chunk->flags |= SPA_CHUNK_FLAG_CORRUPTED;
 
-	if (b->mmap_ptr && b->ptr)
+	if (b->mmap_ptr && b->ptr) {
 		memcpy(b->ptr, b->mmap_ptr, d[0].chunk->size);
+		spa_log_trace(this->log, "v4l2 %p: copied %u bytes", this, d[0].chunk->size);
+	}
 
 	spa_list_append(&port->queue, &b->link);
 	return 0;
@@ -1793,12 +1800,15 @@ static int spa_v4l2_use_buffers(struct impl *this, struct spa_buffer **buffers,
 	reqbuf.count = n_buffers;
 
 	if (xioctl(dev->fd, VIDIOC_REQBUFS, &reqbuf) < 0) {
-		if (port->memtype != V4L2_MEMORY_USERPTR) {
+		if (port->memtype == V4L2_MEMORY_DMABUF && (n_buffers == 0 ||
+		    !SPA_FLAG_IS_SET(buffers[0]->datas[0].flags, SPA_DATA_FLAG_MAPPABLE))) {
 			spa_log_error(this->log, "'%s' VIDIOC_REQBUFS %m", this->props.device);
 			return -errno;
 		}
-		/* some drivers (v4l2loopback) don't support USERPTR
+		/* some drivers (v4l2loopback) don't support USERPTR or DMABUF
 		 * and so we need to try again with MMAP and memcpy */
+		spa_log_warn(this->log, "'%s' can't import buffers (%m), using MMAP and memcpy",
+				this->props.device);
 		port->memtype = V4L2_MEMORY_MMAP;
 		spa_zero(reqbuf);
 		reqbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -1811,6 +1821,8 @@ static int spa_v4l2_use_buffers(struct impl *this, struct spa_buffer **buffers,
 		}
 	}
 	spa_log_debug(this->log, "got %d buffers", reqbuf.count);
+	port->use_expbuf = false;
+	port->copy_bytes = port->memtype == V4L2_MEMORY_MMAP ? port->fmt.fmt.pix.sizeimage : 0;
 	if (reqbuf.count < n_buffers) {
 		spa_log_error(this->log, "'%s' can't allocate enough buffers %d < %d",
 				this->props.device, reqbuf.count, n_buffers);
@@ -1881,6 +1893,7 @@ static int spa_v4l2_use_buffers(struct impl *this, struct spa_buffer **buffers,
 		}
 		else if (port->memtype == V4L2_MEMORY_DMABUF) {
 			b->v4l2_buffer.m.fd = d[0].fd;
+			b->v4l2_buffer.length = d[0].maxsize;
 		}
 		else {
 			spa_log_error(this->log, "%s: invalid port memory %d",
@@ -2028,6 +2041,9 @@ again:
 	spa_log_info(this->log, "%s: have %u buffers using %s", dev->path, n_buffers,
 			use_expbuf ? "EXPBUF" : "MMAP");
 
+	port->use_expbuf = use_expbuf;
+	port->copy_bytes = 0;
+
 	port->n_buffers = n_buffers;
 
 	return 0;
@@ -0,0 +1,69 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef SPA_VIDEOCONVERT_STATS_H
+#define SPA_VIDEOCONVERT_STATS_H
+
+#include <spa/utils/defs.h>
+#include <spa/utils/atomic.h>
+
+/* Conversion time stats. They are written by the data thread and can be
+ * read as a consistent snapshot from any thread with convert_stats_get(). */
+struct convert_stats {
+	uint32_t seq;
+	uint64_t count;
+	uint64_t last_ns;
+	uint64_t avg_ns;
+	uint64_t max_ns;
+	uint64_t report_time;		/* only used by the writer */
+};
+
+#define CONVERT_STATS_INTERVAL	SPA_NSEC_PER_SEC
+
+/* Only call this when the data thread is not updating the stats. */
+static inline void convert_stats_reset(struct convert_stats *stats)
+{
+	SPA_SEQ_WRITE(stats->seq);
+	stats->count = 0;
+	stats->last_ns = 0;
+	stats->avg_ns = 0;
+	stats->max_ns = 0;
+	stats->report_time = 0;
+	SPA_SEQ_WRITE(stats->seq);
+}
+
+/* Add a conversion time t at time now. Returns true when the stats should
+ * be reported, at most once every CONVERT_STATS_INTERVAL. */
+static inline bool convert_stats_update(struct convert_stats *stats, uint64_t now, uint64_t t)
+{
+	SPA_SEQ_WRITE(stats->seq);
+	stats->count++;
+	stats->last_ns = t;
+	stats->avg_ns = stats->avg_ns ? (stats->avg_ns * 7 + t) / 8 : t;
+	stats->max_ns = SPA_MAX(stats->max_ns, t);
+	SPA_SEQ_WRITE(stats->seq);
+
+	if (now < stats->report_time + CONVERT_STATS_INTERVAL)
+		return false;
+	stats->report_time = now;
+	return true;
+}
+
+static inline void convert_stats_get(struct convert_stats *stats, struct convert_stats *res)
+{
+	uint32_t seq1, seq2;
+
+	do {
+		seq1 = SPA_SEQ_READ(stats->seq);
+		res->count = stats->count;
+		res->last_ns = stats->last_ns;
+		res->avg_ns = stats->avg_ns;
+		res->max_ns = stats->max_ns;
+		seq2 = SPA_SEQ_READ(stats->seq);
+	} while (!SPA_SEQ_READ_SUCCESS(seq1, seq2));
+	res->seq = seq2;
+	res->report_time = 0;
+}
+
+#endif /* SPA_VIDEOCONVERT_STATS_H */
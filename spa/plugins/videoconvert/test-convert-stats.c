@@ -0,0 +1,96 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include <spa/utils/defs.h>
+
+#include "convert-stats.h"
+
+#define N_UPDATES	200000
+
+static void test_update(void)
+{
+	struct convert_stats stats, res;
+	uint64_t now = 10 * CONVERT_STATS_INTERVAL;
+
+	spa_zero(stats);
+
+	spa_assert_se(convert_stats_update(&stats, now, 800));
+	convert_stats_get(&stats, &res);
+	spa_assert_se(res.count == 1);
+	spa_assert_se(res.last_ns == 800);
+	spa_assert_se(res.avg_ns == 800);
+	spa_assert_se(res.max_ns == 800);
+
+	/* reported at most once per interval */
+	now += CONVERT_STATS_INTERVAL / 2;
+	spa_assert_se(!convert_stats_update(&stats, now, 1600));
+	convert_stats_get(&stats, &res);
+	spa_assert_se(res.count == 2);
+	spa_assert_se(res.last_ns == 1600);
+	spa_assert_se(res.avg_ns == 900);
+	spa_assert_se(res.max_ns == 1600);
+
+	now += CONVERT_STATS_INTERVAL / 2;
+	spa_assert_se(convert_stats_update(&stats, now, 400));
+	now += 1;
+	spa_assert_se(!convert_stats_update(&stats, now, 400));
+
+	convert_stats_get(&stats, &res);
+	spa_assert_se(res.count == 4);
+	spa_assert_se(res.max_ns == 1600);
+
+	convert_stats_reset(&stats);
+	convert_stats_get(&stats, &res);
+	spa_assert_se(res.count == 0);
+	spa_assert_se(res.avg_ns == 0);
+	spa_assert_se(res.max_ns == 0);
+	/* the next update is reported again */
+	spa_assert_se(convert_stats_update(&stats, now, 400));
+}
+
+static void *writer_thread(void *data)
+{
+	struct convert_stats *stats = data;
+	uint64_t i;
+
+	/* all fields of one update are derived from the count */
+	for (i = 1; i <= N_UPDATES; i++)
+		convert_stats_update(stats, i, i);
+	return NULL;
+}
+
+/* a snapshot is never a mix of two updates */
+static void test_snapshot(void)
+{
+	struct convert_stats stats, res;
+	pthread_t thread;
+	uint32_t reads = 0;
+
+	spa_zero(stats);
+	spa_assert_se(pthread_create(&thread, NULL, writer_thread, &stats) == 0);
+
+	do {
+		convert_stats_get(&stats, &res);
+		spa_assert_se((res.seq & 1) == 0);
+		spa_assert_se(res.last_ns == res.count);
+		spa_assert_se(res.max_ns == res.count);
+		spa_assert_se(res.avg_ns <= res.max_ns);
+		reads++;
+	} while (res.count < N_UPDATES);
+
+	pthread_join(thread, NULL);
+	spa_assert_se(reads > 0);
+}
+
+int main(int argc, char *argv[])
+{
+	test_update();
+	test_snapshot();
+	return 0;
+}
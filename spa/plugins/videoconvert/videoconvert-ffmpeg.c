@@ -6,12 +6,14 @@
 #include <string.h>
 #include <stdio.h>
 #include <limits.h>
+#include <time.h>
 #include <sys/mman.h>
 
 #include <libavcodec/avcodec.h>
 #include <libswscale/swscale.h>
 #include <libavutil/pixfmt.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
 
 #include <spa/support/plugin.h>
 #include <spa/support/cpu.h>
@@ -39,6 +41,8 @@
 #include <spa/debug/log.h>
 #include <spa/control/ump-utils.h>
 
+#include "convert-stats.h"
+
 #undef SPA_LOG_TOPIC_DEFAULT
 #define SPA_LOG_TOPIC_DEFAULT &log_topic
 SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.videoconvert.ffmpeg");
@@ -48,13 +52,16 @@ SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.videoconvert.ffmpeg");
 #define MAX_DATAS	4
 #define MAX_PORTS	(1+1)
 
+#define DEFAULT_THREADS	1
+#define MAX_THREADS	64
+
 struct props {
-	unsigned int dummy:1;
+	int threads;
 };
 
 static void props_reset(struct props *props)
 {
-	props->dummy = false;
+	props->threads = DEFAULT_THREADS;
 }
 
 struct buffer {
@@ -140,6 +147,7 @@ struct impl {
 
 	struct spa_log *log;
 	struct spa_cpu *cpu;
+	struct spa_loop *main_loop;
 	struct spa_loop *data_loop;
 
 	uint32_t cpu_flags;
@@ -187,6 +195,7 @@ struct impl {
 		struct SwsContext *context;
 		AVFrame *frame;
 	} convert;
+	struct convert_stats stats;
 	struct {
 		AVCodecContext *context;
 		AVFrame *frame;
@@ -582,6 +591,70 @@ static int node_param_port_config(struct impl *this, uint32_t id, uint32_t index
 	return 0;
 }
 
+static int node_param_prop_info(struct impl *this, uint32_t id, uint32_t index,
+		struct spa_pod **param, struct spa_pod_builder *b)
+{
+	switch (index) {
+	case 0:
+		*param = spa_pod_builder_add_object(b,
+			SPA_TYPE_OBJECT_PropInfo, id,
+			SPA_PROP_INFO_name, SPA_POD_String("convert.threads"),
+			SPA_PROP_INFO_description, SPA_POD_String("Conversion threads, 0 is one per CPU"),
+			SPA_PROP_INFO_type, SPA_POD_CHOICE_RANGE_Int(this->props.threads,
+				0, MAX_THREADS),
+			SPA_PROP_INFO_params, SPA_POD_Bool(true));
+		break;
+	case 1:
+		*param = spa_pod_builder_add_object(b,
+			SPA_TYPE_OBJECT_PropInfo, id,
+			SPA_PROP_INFO_name, SPA_POD_String("convert.latency"),
+			SPA_PROP_INFO_description, SPA_POD_String("Average frame conversion time (usec)"),
+			SPA_PROP_INFO_type, SPA_POD_Int(0),
+			SPA_PROP_INFO_params, SPA_POD_Bool(true));
+		break;
+	case 2:
+		*param = spa_pod_builder_add_object(b,
+			SPA_TYPE_OBJECT_PropInfo, id,
+			SPA_PROP_INFO_name, SPA_POD_String("convert.latency-max"),
+			SPA_PROP_INFO_description, SPA_POD_String("Maximum frame conversion time (usec)"),
+			SPA_PROP_INFO_type, SPA_POD_Int(0),
+			SPA_PROP_INFO_params, SPA_POD_Bool(true));
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+static int node_param_props(struct impl *this, uint32_t id, uint32_t index,
+		struct spa_pod **param, struct spa_pod_builder *b)
+{
+	struct spa_pod_frame f[2];
+	struct convert_stats stats;
+
+	switch (index) {
+	case 0:
+		convert_stats_get(&this->stats, &stats);
+
+		spa_pod_builder_push_object(b, &f[0],
+				SPA_TYPE_OBJECT_Props, id);
+		spa_pod_builder_prop(b, SPA_PROP_params, 0);
+		spa_pod_builder_push_struct(b, &f[1]);
+		spa_pod_builder_string(b, "convert.threads");
+		spa_pod_builder_int(b, this->props.threads);
+		spa_pod_builder_string(b, "convert.latency");
+		spa_pod_builder_int(b, stats.avg_ns / SPA_NSEC_PER_USEC);
+		spa_pod_builder_string(b, "convert.latency-max");
+		spa_pod_builder_int(b, stats.max_ns / SPA_NSEC_PER_USEC);
+		spa_pod_builder_pop(b, &f[1]);
+		*param = spa_pod_builder_pop(b, &f[0]);
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
 static int impl_node_enum_params(void *object, int seq,
 				 uint32_t id, uint32_t start, uint32_t num,
 				 const struct spa_pod *filter)
@@ -613,10 +686,10 @@ static int impl_node_enum_params(void *object, int seq,
 		res = node_param_port_config(this, id, result.index, &param, &b);
 		break;
 	case SPA_PARAM_PropInfo:
-		res = 0;
+		res = node_param_prop_info(this, id, result.index, &param, &b);
 		break;
 	case SPA_PARAM_Props:
-		res = 0;
+		res = node_param_props(this, id, result.index, &param, &b);
 		break;
 	default:
 		return 0;
@@ -655,6 +728,14 @@ static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
 
 static int videoconvert_set_param(struct impl *this, const char *k, const char *s)
 {
+	if (spa_streq(k, "convert.threads")) {
+		int threads;
+		if (!spa_atoi32(s, &threads, 0) || threads < 0 || threads > (int)MAX_THREADS)
+			return 0;
+		/* takes effect on the next format change */
+		this->props.threads = threads;
+		return 1;
+	}
 	return 0;
 }
 
@@ -837,7 +918,10 @@ static int node_set_param_props(struct impl *this, uint32_t flags,
 	if (param == NULL)
 		return 0;
 
-	apply_props(this, param);
+	if (apply_props(this, param) > 0) {
+		this->info.change_mask |= SPA_NODE_CHANGE_MASK_PARAMS;
+		this->params[IDX_Props].user++;
+	}
 	return 0;
 }
 static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
@@ -990,6 +1074,9 @@ static int setup_convert(struct impl *this)
 			return -EIO;
 
 		this->decoder.context->flags2 |= AV_CODEC_FLAG2_FAST;
+		/* we need a frame out for each packet in, so only slice threads */
+		this->decoder.context->thread_count = this->props.threads;
+		this->decoder.context->thread_type = FF_THREAD_SLICE;
 
 		if (avcodec_open2(this->decoder.context, codec, NULL) < 0) {
 			spa_log_error(this->log, "failed to open decoder codec");
@@ -1020,6 +1107,8 @@ static int setup_convert(struct impl *this)
 		this->encoder.context->width = out->size.width;
 		this->encoder.context->height = out->size.height;
 		this->encoder.context->pix_fmt = out->pix_fmt;
+		this->encoder.context->thread_count = this->props.threads;
+		this->encoder.context->thread_type = FF_THREAD_SLICE;
 
 		if (avcodec_open2(this->encoder.context, codec, NULL) < 0) {
 			spa_log_error(this->log, "failed to open encoder codec");
@@ -1034,6 +1123,7 @@ static int setup_convert(struct impl *this)
 	av_frame_free(&this->convert.frame);
 	if ((this->convert.frame = av_frame_alloc()) == NULL)
 		return -EIO;
+	convert_stats_reset(&this->stats);
 
 	this->setup = true;
 
@@ -2272,6 +2362,50 @@ static int impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t
 	return 0;
 }
 
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static int do_stats_update(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct impl *this = user_data;
+
+	this->info.change_mask |= SPA_NODE_CHANGE_MASK_PARAMS;
+	this->params[IDX_Props].user++;
+	emit_node_info(this, false);
+	return 0;
+}
+
+static struct SwsContext *create_scaler(struct impl *this, int src_w, int src_h,
+		enum AVPixelFormat src_fmt, int dst_w, int dst_h, enum AVPixelFormat dst_fmt)
+{
+	struct SwsContext *ctx;
+
+	if ((ctx = sws_alloc_context()) == NULL)
+		return NULL;
+
+	av_opt_set_int(ctx, "srcw", src_w, 0);
+	av_opt_set_int(ctx, "srch", src_h, 0);
+	av_opt_set_int(ctx, "src_format", src_fmt, 0);
+	av_opt_set_int(ctx, "dstw", dst_w, 0);
+	av_opt_set_int(ctx, "dsth", dst_h, 0);
+	av_opt_set_int(ctx, "dst_format", dst_fmt, 0);
+	/* libswscale splits the frame in slices and converts them with
+	 * a pool of threads, 0 means one thread per CPU */
+	if (av_opt_set_int(ctx, "threads", this->props.threads, 0) < 0)
+		spa_log_warn(this->log, "%p: threaded conversion not supported", this);
+
+	if (sws_init_context(ctx, NULL, NULL) < 0) {
+		sws_freeContext(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
 static int impl_node_process(void *object)
 {
 	struct impl *this = object;
@@ -2282,6 +2416,7 @@ static int impl_node_process(void *object)
 	struct AVFrame *f;
 	void *datas[8];
 	uint32_t sizes[8], strides[8];
+	uint64_t t1, t2;
 	int res;
 
 	spa_return_val_if_fail(this != NULL, -EINVAL);
@@ -2328,6 +2463,8 @@ static int impl_node_process(void *object)
 			dbuf->buf->datas[0].chunk, sbuf->buf->datas[0].chunk->size,
 			sbuf->id, dbuf->id);
 
+	t1 = get_time_ns();
+
 	/* do decoding */
 	if (this->decoder.context) {
 		this->decoder.packet->data = sbuf->datas[0];
@@ -2375,13 +2512,16 @@ static int impl_node_process(void *object)
 		if (this->convert.context == NULL) {
 			const AVPixFmtDescriptor *in_fmt = av_pix_fmt_desc_get(f->format);
 			const AVPixFmtDescriptor *out_fmt = av_pix_fmt_desc_get(out->pix_fmt);
-			this->convert.context = sws_getContext(
-					f->width, f->height, f->format,
-					out->size.width, out->size.height, out->pix_fmt,
-					0, NULL, NULL, NULL);
-			spa_log_info(this->log, "%p: using convert %dx%d:%s -> %dx%d:%s",
+			if ((this->convert.context = create_scaler(this, f->width, f->height,
+					f->format, out->size.width, out->size.height,
+					out->pix_fmt)) == NULL) {
+				spa_log_error(this->log, "%p: can't create converter", this);
+				return -EIO;
+			}
+			spa_log_info(this->log, "%p: using convert %dx%d:%s -> %dx%d:%s threads:%d",
 					this, f->width, f->height, in_fmt->name,
-					out->size.width, out->size.height, out_fmt->name);
+					out->size.width, out->size.height, out_fmt->name,
+					this->props.threads);
 		}
 		spa_log_trace(this->log, "convert");
 		sws_scale_frame(this->convert.context, this->convert.frame, f);
@@ -2408,6 +2548,11 @@ static int impl_node_process(void *object)
 		spa_log_trace(this->log, "encode %p %d", datas[0], sizes[0]);
 	}
 
+	t2 = get_time_ns();
+	if (convert_stats_update(&this->stats, t2, t2 - t1) && this->main_loop)
+		spa_loop_invoke(this->main_loop, do_stats_update, 0,
+				NULL, 0, false, this);
+
 	/* write to output */
 	for (uint32_t i = 0; i < dbuf->buf->n_datas; ++i) {
 		if (SPA_FLAG_IS_SET(dbuf->buf->datas[i].flags, SPA_DATA_FLAG_DYNAMIC))
@@ -2485,8 +2630,12 @@ static int impl_clear(struct spa_handle *handle)
 
 	this = (struct impl *) handle;
 
+	if (this->main_loop)
+		spa_loop_invoke(this->main_loop, NULL, 0, NULL, 0, true, NULL);
+
 	free_decoder(this);
 	free_encoder(this);
+	sws_freeContext(this->convert.context);
 	av_frame_free(&this->decoder.frame);
 	av_frame_free(&this->convert.frame);
 
@@ -2520,6 +2669,7 @@ impl_init(const struct spa_handle_factory *factory,
 
 	this = (struct impl *) handle;
 
+	this->main_loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Loop);
 	this->data_loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataLoop);
 	this->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
 	spa_log_topic_init(this->log, &log_topic);
@@ -0,0 +1,353 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/ptrace.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/loop.h>
+#include <spa/support/system.h>
+#include <spa/utils/atomic.h>
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+#include <spa/utils/type.h>
+
+/* Runs a loop like a driver: a timer wakes up the loop every period, the
+ * timer is set again and an event is signaled that is handled in the same
+ * loop, like the wakeup of a follower node. It measures the wakeup latency
+ * of the timer and the syscalls per cycle and then the latency of an event
+ * that is signaled from another thread, once with the epoll system and
+ * once with the io_uring system. */
+
+#define CYCLES		2000
+#define PERIOD_NSEC	(250 * SPA_NSEC_PER_USEC)
+#define EVENTS		2000
+
+struct data {
+	void *hnd;
+	struct spa_handle *system_handle;
+	struct spa_handle *loop_handle;
+	struct spa_system *system;
+	struct spa_loop *loop;
+	struct spa_loop_control *control;
+	struct spa_loop_utils *utils;
+
+	struct spa_source *timer;
+	struct spa_source *event;
+	struct spa_source *xevent;
+
+	uint64_t target;
+	uint32_t cycles;
+	uint32_t events;
+	uint64_t wake_total;
+	uint64_t wake_max;
+
+	uint64_t signal_time;
+	uint64_t xwake_total;
+	uint64_t xwake_max;
+	uint32_t xevents;
+	bool running;
+};
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static struct spa_handle *load_handle(struct data *d, const struct spa_support *support,
+		uint32_t n_support, const char *name)
+{
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+	uint32_t i;
+	int res;
+
+	if ((enum_func = dlsym(d->hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		fprintf(stderr, "can't find enum function\n");
+		return NULL;
+	}
+	for (i = 0;;) {
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			fprintf(stderr, "can't find factory %s\n", name);
+			return NULL;
+		}
+		if (strcmp(factory->name, name) == 0)
+			break;
+	}
+	handle = calloc(1, spa_handle_factory_get_size(factory, NULL));
+	if ((res = spa_handle_factory_init(factory, handle,
+					NULL, support, n_support)) < 0) {
+		fprintf(stderr, "can't make factory instance %s: %s\n", name, spa_strerror(res));
+		free(handle);
+		return NULL;
+	}
+	return handle;
+}
+
+static void set_timer(struct data *d)
+{
+	struct timespec value, interval = { 0, 0 };
+
+	d->target = get_time_ns() + PERIOD_NSEC;
+	value.tv_sec = d->target / SPA_NSEC_PER_SEC;
+	value.tv_nsec = d->target % SPA_NSEC_PER_SEC;
+	spa_loop_utils_update_timer(d->utils, d->timer, &value, &interval, true);
+}
+
+static void on_timer(void *data, uint64_t expirations)
+{
+	struct data *d = data;
+	uint64_t wake = get_time_ns() - d->target;
+
+	d->wake_total += wake;
+	d->wake_max = SPA_MAX(d->wake_max, wake);
+	d->cycles++;
+
+	/* wake up the next node */
+	spa_loop_utils_signal_event(d->utils, d->event);
+	if (d->cycles < CYCLES)
+		set_timer(d);
+}
+
+static void on_event(void *data, uint64_t count)
+{
+	struct data *d = data;
+	d->events += count;
+}
+
+static void on_xevent(void *data, uint64_t count)
+{
+	struct data *d = data;
+	uint64_t wake = get_time_ns() - SPA_ATOMIC_LOAD(d->signal_time);
+
+	d->xwake_total += wake;
+	d->xwake_max = SPA_MAX(d->xwake_max, wake);
+	SPA_ATOMIC_INC(d->xevents);
+}
+
+static int init_loop(struct data *d, const char *system)
+{
+	struct spa_support support[1];
+	const char *str;
+	char path[PATH_MAX];
+	void *iface;
+	int res;
+
+	spa_zero(*d);
+	if ((str = getenv("SPA_PLUGIN_DIR")) == NULL) {
+		fprintf(stderr, "SPA_PLUGIN_DIR is not set\n");
+		return -ENOENT;
+	}
+	snprintf(path, sizeof(path), "%s/support/libspa-support.so", str);
+
+	if ((d->hnd = dlopen(path, RTLD_NOW)) == NULL) {
+		fprintf(stderr, "can't load %s: %s\n", path, dlerror());
+		return -ENOENT;
+	}
+	if ((d->system_handle = load_handle(d, NULL, 0, system)) == NULL)
+		return -ENOENT;
+	if ((res = spa_handle_get_interface(d->system_handle,
+					SPA_TYPE_INTERFACE_System, &iface)) < 0)
+		return res;
+	d->system = iface;
+	support[0] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_System, iface);
+
+	if ((d->loop_handle = load_handle(d, support, 1, SPA_NAME_SUPPORT_LOOP)) == NULL)
+		return -ENOENT;
+	if ((res = spa_handle_get_interface(d->loop_handle,
+					SPA_TYPE_INTERFACE_Loop, &iface)) < 0)
+		return res;
+	d->loop = iface;
+	if ((res = spa_handle_get_interface(d->loop_handle,
+					SPA_TYPE_INTERFACE_LoopControl, &iface)) < 0)
+		return res;
+	d->control = iface;
+	if ((res = spa_handle_get_interface(d->loop_handle,
+					SPA_TYPE_INTERFACE_LoopUtils, &iface)) < 0)
+		return res;
+	d->utils = iface;
+
+	d->timer = spa_loop_utils_add_timer(d->utils, on_timer, d);
+	d->event = spa_loop_utils_add_event(d->utils, on_event, d);
+	d->xevent = spa_loop_utils_add_event(d->utils, on_xevent, d);
+	return 0;
+}
+
+static void clear_loop(struct data *d)
+{
+	spa_loop_utils_destroy_source(d->utils, d->timer);
+	spa_loop_utils_destroy_source(d->utils, d->event);
+	spa_loop_utils_destroy_source(d->utils, d->xevent);
+	spa_handle_clear(d->loop_handle);
+	spa_handle_clear(d->system_handle);
+	free(d->loop_handle);
+	free(d->system_handle);
+	dlclose(d->hnd);
+}
+
+static void run_cycles(struct data *d)
+{
+	d->cycles = d->events = 0;
+	d->wake_total = d->wake_max = 0;
+
+	set_timer(d);
+	spa_loop_control_enter(d->control);
+	while (d->cycles < CYCLES || d->events < CYCLES)
+		spa_loop_control_iterate(d->control, -1);
+	spa_loop_control_leave(d->control);
+}
+
+/* the syscalls of the cycles, counted in a traced child between two
+ * getppid() calls */
+static double count_syscalls(const char *system)
+{
+	struct ptrace_syscall_info info;
+	struct data d;
+	uint64_t count = 0;
+	bool counting = false, entry = true;
+	pid_t pid;
+	int status;
+
+	if ((pid = fork()) < 0)
+		return -1.0;
+	if (pid == 0) {
+		if (init_loop(&d, system) < 0)
+			_exit(1);
+		if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) < 0)
+			_exit(1);
+		raise(SIGSTOP);
+		getppid();
+		run_cycles(&d);
+		getppid();
+		clear_loop(&d);
+		_exit(0);
+	}
+	if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status))
+		goto error;
+	ptrace(PTRACE_SETOPTIONS, pid, NULL, PTRACE_O_TRACESYSGOOD);
+
+	while (true) {
+		if (ptrace(PTRACE_SYSCALL, pid, NULL, NULL) < 0 ||
+		    waitpid(pid, &status, 0) < 0)
+			goto error;
+		if (WIFEXITED(status))
+			break;
+		if (!WIFSTOPPED(status) || WSTOPSIG(status) != (SIGTRAP | 0x80))
+			continue;
+		/* every syscall stops on entry and exit */
+		if (entry) {
+			if (ptrace(PTRACE_GET_SYSCALL_INFO, pid, sizeof(info), &info) > 0 &&
+			    info.op == PTRACE_SYSCALL_INFO_ENTRY &&
+			    info.entry.nr == SYS_getppid)
+				counting = !counting;
+			else if (counting)
+				count++;
+		}
+		entry = !entry;
+	}
+	if (WEXITSTATUS(status) != 0)
+		return -1.0;
+	return (double)count / CYCLES;
+error:
+	kill(pid, SIGKILL);
+	waitpid(pid, &status, 0);
+	return -1.0;
+}
+
+static void *loop_thread(void *arg)
+{
+	struct data *d = arg;
+
+	spa_loop_control_enter(d->control);
+	while (d->running)
+		spa_loop_control_iterate(d->control, -1);
+	spa_loop_control_leave(d->control);
+	return NULL;
+}
+
+static int do_stop(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct data *d = user_data;
+	d->running = false;
+	return 0;
+}
+
+static void run_events(struct data *d)
+{
+	pthread_t thread;
+	uint32_t i;
+
+	d->xevents = 0;
+	d->xwake_total = d->xwake_max = 0;
+	d->running = true;
+	pthread_create(&thread, NULL, loop_thread, d);
+
+	for (i = 0; i < EVENTS; i++) {
+		/* let the loop go to sleep */
+		usleep(100);
+		SPA_ATOMIC_STORE(d->signal_time, get_time_ns());
+		spa_loop_utils_signal_event(d->utils, d->xevent);
+		while (SPA_ATOMIC_LOAD(d->xevents) <= i)
+			usleep(10);
+	}
+	spa_loop_invoke(d->loop, do_stop, SPA_ID_INVALID, NULL, 0, true, d);
+	pthread_join(thread, NULL);
+}
+
+static int run(const char *name, const char *system)
+{
+	struct data d;
+	double syscalls;
+	char sys[32];
+
+	if (init_loop(&d, system) < 0) {
+		printf("%-10s not available\n", name);
+		return 0;
+	}
+	run_cycles(&d);
+	run_events(&d);
+	clear_loop(&d);
+
+	syscalls = count_syscalls(system);
+	if (syscalls < 0)
+		snprintf(sys, sizeof(sys), "n/a");
+	else
+		snprintf(sys, sizeof(sys), "%.2f", syscalls);
+
+	printf("%-10s %14s %14.1f %14.1f %14.1f %14.1f\n", name, sys,
+			(double)d.wake_total / CYCLES / 1000.0,
+			(double)d.wake_max / 1000.0,
+			(double)d.xwake_total / EVENTS / 1000.0,
+			(double)d.xwake_max / 1000.0);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	printf("%d cycles of %d usec, %d events from another thread\n",
+			CYCLES, (int)(PERIOD_NSEC / SPA_NSEC_PER_USEC), EVENTS);
+	printf("%-10s %14s %14s %14s %14s %14s\n", "system", "syscalls/cycle",
+			"timer usec", "timer max", "event usec", "event max");
+
+	run("epoll", SPA_NAME_SUPPORT_SYSTEM);
+	run("io-uring", SPA_NAME_SUPPORT_SYSTEM_IO_URING);
+
+	return 0;
+}
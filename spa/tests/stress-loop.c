@@ -0,0 +1,213 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <pthread.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/loop.h>
+#include <spa/support/system.h>
+#include <spa/utils/atomic.h>
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+#include <spa/utils/type.h>
+
+#define MAX_THREADS	16
+#define N_INVOKES	100000
+#define BLOCK_INTERVAL	64
+
+static const uint32_t thread_counts[] = { 1, 2, 4, 8, 16 };
+
+struct data {
+	void *hnd;
+	struct spa_handle *system_handle;
+	struct spa_handle *loop_handle;
+	struct spa_loop *loop;
+	struct spa_loop_control *control;
+
+	pthread_t loop_thread;
+	bool running;
+
+	uint64_t n_invokes;
+	uint64_t n_wakeups;
+};
+
+static struct spa_handle *load_handle(struct data *d, const struct spa_support *support,
+		uint32_t n_support, const char *name)
+{
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+	uint32_t i;
+	int res;
+
+	if ((enum_func = dlsym(d->hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		fprintf(stderr, "can't find enum function\n");
+		return NULL;
+	}
+	for (i = 0;;) {
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			fprintf(stderr, "can't find factory %s\n", name);
+			return NULL;
+		}
+		if (strcmp(factory->name, name) == 0)
+			break;
+	}
+	handle = calloc(1, spa_handle_factory_get_size(factory, NULL));
+	if ((res = spa_handle_factory_init(factory, handle,
+					NULL, support, n_support)) < 0) {
+		fprintf(stderr, "can't make factory instance: %s\n", spa_strerror(res));
+		free(handle);
+		return NULL;
+	}
+	return handle;
+}
+
+static int init_loop(struct data *d)
+{
+	struct spa_support support[1];
+	const char *str;
+	char path[PATH_MAX];
+	void *iface;
+	int res;
+
+	if ((str = getenv("SPA_PLUGIN_DIR")) == NULL) {
+		fprintf(stderr, "SPA_PLUGIN_DIR is not set\n");
+		return -ENOENT;
+	}
+	snprintf(path, sizeof(path), "%s/support/libspa-support.so", str);
+
+	if ((d->hnd = dlopen(path, RTLD_NOW)) == NULL) {
+		fprintf(stderr, "can't load %s: %s\n", path, dlerror());
+		return -ENOENT;
+	}
+	if ((d->system_handle = load_handle(d, NULL, 0, SPA_NAME_SUPPORT_SYSTEM)) == NULL)
+		return -ENOENT;
+	if ((res = spa_handle_get_interface(d->system_handle,
+					SPA_TYPE_INTERFACE_System, &iface)) < 0)
+		return res;
+	support[0] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_System, iface);
+
+	if ((d->loop_handle = load_handle(d, support, 1, SPA_NAME_SUPPORT_LOOP)) == NULL)
+		return -ENOENT;
+	if ((res = spa_handle_get_interface(d->loop_handle,
+					SPA_TYPE_INTERFACE_Loop, &iface)) < 0)
+		return res;
+	d->loop = iface;
+	if ((res = spa_handle_get_interface(d->loop_handle,
+					SPA_TYPE_INTERFACE_LoopControl, &iface)) < 0)
+		return res;
+	d->control = iface;
+	return 0;
+}
+
+static int do_invoke(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct data *d = user_data;
+	d->n_invokes++;
+	return 0;
+}
+
+static int do_stop(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct data *d = user_data;
+	d->running = false;
+	return 0;
+}
+
+static void *loop_thread(void *arg)
+{
+	struct data *d = arg;
+
+	spa_loop_control_enter(d->control);
+	while (d->running) {
+		if (spa_loop_control_iterate(d->control, -1) > 0)
+			d->n_wakeups++;
+	}
+	spa_loop_control_leave(d->control);
+	return NULL;
+}
+
+static void *producer_thread(void *arg)
+{
+	struct data *d = arg;
+	uint32_t i;
+
+	for (i = 1; i <= N_INVOKES; i++) {
+		/* block now and then so that the queues don't grow without
+		 * bounds, like a real producer that waits for a result */
+		spa_loop_invoke(d->loop, do_invoke, SPA_ID_INVALID, NULL, 0,
+				i % BLOCK_INTERVAL == 0, d);
+	}
+	return NULL;
+}
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void run_test(struct data *d, uint32_t n_threads)
+{
+	pthread_t threads[MAX_THREADS];
+	uint64_t t1, t2;
+	double secs;
+	uint32_t i;
+
+	d->n_invokes = 0;
+	d->n_wakeups = 0;
+	d->running = true;
+	pthread_create(&d->loop_thread, NULL, loop_thread, d);
+
+	t1 = get_time_ns();
+	for (i = 0; i < n_threads; i++)
+		pthread_create(&threads[i], NULL, producer_thread, d);
+	for (i = 0; i < n_threads; i++)
+		pthread_join(threads[i], NULL);
+	spa_loop_invoke(d->loop, do_stop, SPA_ID_INVALID, NULL, 0, true, d);
+	t2 = get_time_ns();
+
+	pthread_join(d->loop_thread, NULL);
+
+	secs = (t2 - t1) / (double)SPA_NSEC_PER_SEC;
+	spa_assert(d->n_invokes == (uint64_t)n_threads * N_INVOKES);
+
+	printf("producers %2u: %10.0f invokes/sec %10.0f wakeups/sec %8.2f invokes/wakeup\n",
+			n_threads, d->n_invokes / secs, d->n_wakeups / secs,
+			d->n_wakeups ? (double)d->n_invokes / d->n_wakeups : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data;
+	uint32_t i;
+
+	spa_zero(data);
+
+	if (init_loop(&data) < 0)
+		return EXIT_FAILURE;
+
+	printf("starting loop invoke stress test, %d invokes per producer\n", N_INVOKES);
+
+	for (i = 0; i < SPA_N_ELEMENTS(thread_counts); i++)
+		run_test(&data, thread_counts[i]);
+
+	spa_handle_clear(data.loop_handle);
+	spa_handle_clear(data.system_handle);
+	free(data.loop_handle);
+	free(data.system_handle);
+	dlclose(data.hnd);
+
+	return 0;
+}
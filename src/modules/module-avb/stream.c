@@ -88,8 +88,7 @@ static int flush_write(struct stream *stream, uint64_t current_time)
 	int32_t avail;
 	uint32_t index;
         uint64_t ptime, txtime;
-	int pdu_count;
-	ssize_t n;
+	int i, n, pdu_count, n_pdus;
 	struct avb_frame_header *h = (void*)stream->pdu;
 	struct avb_packet_iec61883 *p = SPA_PTROFF(h, sizeof(*h), void);
 	uint8_t dbc;
@@ -102,29 +101,43 @@ static int flush_write(struct stream *stream, uint64_t current_time)
 	ptime = txtime + stream->mtt;
 	dbc = stream->dbc;
 
-	while (pdu_count--) {
-		*(uint64_t*)CMSG_DATA(stream->cmsg) = txtime;
+	while (pdu_count > 0) {
+		n_pdus = SPA_MIN(pdu_count, MAX_PDU_BATCH);
 
-		set_iovec(&stream->ring,
-			stream->buffer_data,
-			stream->buffer_size,
-			index % stream->buffer_size,
-			&stream->iov[1], stream->payload_size);
+		for (i = 0; i < n_pdus; i++) {
+			struct stream_pdu *pdu = &stream->pdus[i];
 
-		p->seq_num = stream->pdu_seq++;
-		p->tv = 1;
-		p->timestamp = ptime;
-		p->dbc = dbc;
+			p->seq_num = stream->pdu_seq++;
+			p->tv = 1;
+			p->timestamp = ptime;
+			p->dbc = dbc;
+			memcpy(pdu->hdr, stream->pdu, stream->hdr_size);
 
-		n = sendmsg(stream->source->fd, &stream->msg, MSG_NOSIGNAL);
-		if (n < 0 || n != (ssize_t)stream->pdu_size) {
-			pw_log_error("sendmsg() failed %zd != %zd: %m",
-					n, stream->pdu_size);
+			*(uint64_t*)CMSG_DATA(pdu->cmsg) = txtime;
+
+			set_iovec(&stream->ring,
+				stream->buffer_data,
+				stream->buffer_size,
+				index % stream->buffer_size,
+				&pdu->iov[1], stream->payload_size);
+
+			txtime += stream->pdu_period;
+			ptime += stream->pdu_period;
+			index += stream->payload_size;
+			dbc += stream->frames_per_pdu;
 		}
-		txtime += stream->pdu_period;
-		ptime += stream->pdu_period;
-		index += stream->payload_size;
-		dbc += stream->frames_per_pdu;
+
+		n = sendmmsg(stream->source->fd, stream->msgs, n_pdus, MSG_NOSIGNAL);
+		if (n < 0 || n != n_pdus) {
+			pw_log_error("sendmmsg() failed %d != %d: %m", n, n_pdus);
+		} else {
+			for (i = 0; i < n; i++) {
+				if (stream->msgs[i].msg_len != stream->pdu_size)
+					pw_log_error("sendmmsg() short write %u != %zd",
+							stream->msgs[i].msg_len, stream->pdu_size);
+			}
+		}
+		pdu_count -= n_pdus;
 	}
 	stream->dbc = dbc;
 	spa_ringbuffer_read_update(&stream->ring, index);
@@ -210,22 +223,33 @@ static void setup_pdu(struct stream *stream)
 
 static int setup_msg(struct stream *stream)
 {
-	stream->iov[0].iov_base = stream->pdu;
-	stream->iov[0].iov_len = stream->hdr_size;
-	stream->iov[1].iov_base = SPA_PTROFF(stream->pdu, stream->hdr_size, void);
-	stream->iov[1].iov_len = stream->payload_size;
-	stream->iov[2].iov_base = SPA_PTROFF(stream->pdu, stream->hdr_size, void);
-	stream->iov[2].iov_len = 0;
-	stream->msg.msg_name = &stream->sock_addr;
-	stream->msg.msg_namelen = sizeof(stream->sock_addr);
-	stream->msg.msg_iov = stream->iov;
-	stream->msg.msg_iovlen = 3;
-	stream->msg.msg_control = stream->control;
-	stream->msg.msg_controllen = sizeof(stream->control);
-	stream->cmsg = CMSG_FIRSTHDR(&stream->msg);
-	stream->cmsg->cmsg_level = SOL_SOCKET;
-	stream->cmsg->cmsg_type = SCM_TXTIME;
-	stream->cmsg->cmsg_len = CMSG_LEN(sizeof(__u64));
+	int i;
+
+	if (stream->hdr_size > sizeof(stream->pdus[0].hdr))
+		return -EINVAL;
+
+	for (i = 0; i < MAX_PDU_BATCH; i++) {
+		struct stream_pdu *pdu = &stream->pdus[i];
+		struct msghdr *msg = &stream->msgs[i].msg_hdr;
+
+		pdu->iov[0].iov_base = pdu->hdr;
+		pdu->iov[0].iov_len = stream->hdr_size;
+		pdu->iov[1].iov_base = SPA_PTROFF(stream->pdu, stream->hdr_size, void);
+		pdu->iov[1].iov_len = stream->payload_size;
+		pdu->iov[2].iov_base = SPA_PTROFF(stream->pdu, stream->hdr_size, void);
+		pdu->iov[2].iov_len = 0;
+		spa_zero(*msg);
+		msg->msg_name = &stream->sock_addr;
+		msg->msg_namelen = sizeof(stream->sock_addr);
+		msg->msg_iov = pdu->iov;
+		msg->msg_iovlen = 3;
+		msg->msg_control = pdu->control;
+		msg->msg_controllen = sizeof(pdu->control);
+		pdu->cmsg = CMSG_FIRSTHDR(msg);
+		pdu->cmsg->cmsg_level = SOL_SOCKET;
+		pdu->cmsg->cmsg_type = SCM_TXTIME;
+		pdu->cmsg->cmsg_len = CMSG_LEN(sizeof(__u64));
+	}
 	return 0;
 }
 
@@ -334,7 +358,8 @@ struct stream *server_create_stream(struct server *server,
                           stream->info.info.raw.rate;
 
 	setup_pdu(stream);
-	setup_msg(stream);
+	if ((res = setup_msg(stream)) < 0)
+		goto error_free_stream;
 
 	stream->listener_attr = avb_msrp_attribute_new(server->msrp,
 			AVB_MSRP_ATTRIBUTE_TYPE_LISTENER);
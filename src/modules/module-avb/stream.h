@@ -18,6 +18,16 @@
 #define BUFFER_SIZE	(1u<<16)
 #define BUFFER_MASK	(BUFFER_SIZE-1)
 
+/* max number of PDUs sent with one sendmmsg() */
+#define MAX_PDU_BATCH	32
+
+struct stream_pdu {
+	uint8_t hdr[128];
+	struct iovec iov[3];
+	char control[CMSG_SPACE(sizeof(uint64_t))];
+	struct cmsghdr *cmsg;
+};
+
 struct stream {
 	struct spa_list link;
 
@@ -50,11 +60,9 @@ struct stream {
 	uint8_t prev_seq;
 	uint8_t dbc;
 
-	struct iovec iov[3];
 	struct sockaddr_ll sock_addr;
-	struct msghdr msg;
-	char control[CMSG_SPACE(sizeof(uint64_t))];
-	struct cmsghdr *cmsg;
+	struct stream_pdu pdus[MAX_PDU_BATCH];
+	struct mmsghdr msgs[MAX_PDU_BATCH];
 
 	struct spa_ringbuffer ring;
 	void *buffer_data;
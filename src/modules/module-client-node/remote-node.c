@@ -202,6 +202,11 @@ static int client_node_transport(void *_data,
 	pw_impl_node_set_io(node, SPA_IO_Position,
 			&node->rt.target.activation->position,
 			sizeof(struct spa_io_position));
+	/* older servers have no meter in the activation */
+	if (size >= offsetof(struct pw_node_activation, meter) + sizeof(struct spa_io_meter))
+		pw_impl_node_set_io(node, SPA_IO_Meter,
+				&node->rt.target.activation->meter,
+				sizeof(struct spa_io_meter));
 
 	pw_log_debug("remote-node %p: fds:%d %d node:%u activation:%p",
 		proxy, readfd, writefd, data->remote_id, data->activation->ptr);
@@ -842,8 +847,13 @@ client_node_set_activation(void *_data,
 		link->target.activation = ptr;
 		link->target.system = data->data_system;
 		link->target.fd = signalfd;
-		link->target.trigger = link->target.activation->server_version < 1 ?
-			trigger_target_v0 : trigger_target_v1;
+		if (link->target.activation->server_version < 1)
+			link->target.trigger = trigger_target_v0;
+		else if (link->target.activation->server_version < 2)
+			link->target.trigger = trigger_target_v1;
+		else
+			/* the peer might share the wakeup of its data loop */
+			link->target.trigger = trigger_target_v2;
 		spa_list_append(&data->links, &link->link);
 
 		pw_impl_node_add_target(node, &link->target);
@@ -382,6 +382,8 @@ extern struct spa_handle_factory spa_filter_graph_factory;
  *                 channel = ...
  *                 resample_quality = ...
  *                 latency = ...
+ *                 tail_thread = ...
+ *                 tail_priority = ...
  *             }
  *             ...
  *         }
@@ -415,6 +417,19 @@ extern struct spa_handle_factory spa_filter_graph_factory;
  *                      samplerate.
  * - `latency`  The extra latency in seconds to report. When left unspecified (or < 0.0)
  *              the convolver latency will be the length of the IR.
+ * - `tail_thread` Process the large tail partitions of the IR in a separate thread
+ *              instead of in the processing thread. The tail of a block has to be
+ *              ready one tail block later, this spreads the cost of long IRs
+ *              over the whole tail block and avoids CPU spikes in the processing
+ *              thread. Default false.
+ * - `tail_priority` When > 0, ask the RT module to run the tail thread with this
+ *              realtime priority. Default 0, the thread is not realtime.
+ *
+ * The convolver has "Tail Time (s)", "Tail Max Time (s)" and "Tail Late" output
+ * control ports with the average and maximum time spent processing a tail block
+ * in the tail thread and the number of tail blocks that were not ready in time.
+ * The processing thread never waits for the tail thread, a late tail block is
+ * dropped.
  *
  * ### Delay
  *
@@ -0,0 +1,317 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include <spa/utils/atomic.h>
+#include <spa/utils/json.h>
+#include <spa/node/io.h>
+
+#include <pipewire/impl.h>
+#include <pipewire/private.h>
+
+/** \page page_module_meter Meter
+ *
+ * The meter module publishes the loudness meter results of the nodes in the
+ * `meter` metadata.
+ *
+ * Nodes with `meter.enable` set write their results in the shared memory
+ * of the node from the data thread, without waking up the main loop or
+ * changing the params of the node. This module reads the results of all
+ * nodes a few times per second and updates the metadata when they changed.
+ * Only the clients that bind the `meter` metadata receive the updates.
+ *
+ * The metadata has a `meter` key for each metered node with the node id as
+ * subject and a JSON object as value:
+ *
+ *\code{.unparsed}
+ * { "momentary": -23.1, "short-term": -22.8, "true-peak": -1.2 }
+ *\endcode
+ *
+ * The loudness is in LUFS and the true-peak, the maximum since the previous
+ * update, in dBTP. The key is removed when the node stops updating it or
+ * is removed.
+ *
+ * ## Module Name
+ *
+ * `libpipewire-module-meter`
+ *
+ * ## Module Options
+ *
+ * - `meter.interval.ms`: The interval between updates. Default 100
+ *
+ * ## Example configuration
+ *
+ *\code{.unparsed}
+ * context.modules = [
+ * { name = libpipewire-module-meter
+ *   args = {
+ *       #meter.interval.ms = 100
+ *   }
+ * }
+ * ]
+ *\endcode
+ *
+ * ## See also
+ *
+ * - `pw-metadata -n meter`: show the meter results
+ */
+
+#define NAME "meter"
+
+PW_LOG_TOPIC(mod_topic, "mod." NAME);
+#define PW_LOG_TOPIC_DEFAULT mod_topic
+
+#define DEFAULT_INTERVAL	100
+/* remove the results of a node after this many intervals without update */
+#define STALE_INTERVALS		20
+
+#define MODULE_USAGE	"( meter.interval.ms=<interval between updates (in ms)> ) "
+
+static const struct spa_dict_item module_props[] = {
+	{ PW_KEY_MODULE_AUTHOR, "Wim Taymans <wim.taymans@gmail.com>" },
+	{ PW_KEY_MODULE_DESCRIPTION, "Publish the loudness meter results of nodes" },
+	{ PW_KEY_MODULE_USAGE, MODULE_USAGE },
+	{ PW_KEY_MODULE_VERSION, PACKAGE_VERSION },
+};
+
+struct meter {
+	struct spa_list link;
+	uint32_t id;
+	uint32_t seq;
+	uint32_t stale;
+	unsigned int seen:1;
+	unsigned int published:1;
+};
+
+struct impl {
+	struct pw_context *context;
+	struct pw_properties *properties;
+	struct pw_loop *main_loop;
+
+	struct spa_hook module_listener;
+
+	struct pw_impl_metadata *metadata;
+	struct spa_hook metadata_listener;
+
+	struct spa_source *timer;
+	uint32_t interval;
+
+	struct spa_list meter_list;
+};
+
+static struct meter *find_meter(struct impl *impl, uint32_t id)
+{
+	struct meter *m;
+	spa_list_for_each(m, &impl->meter_list, link) {
+		if (m->id == id)
+			return m;
+	}
+	return NULL;
+}
+
+static void clear_meter(struct impl *impl, struct meter *m)
+{
+	if (m->published && impl->metadata != NULL)
+		pw_impl_metadata_set_property(impl->metadata, m->id, NAME, NULL, NULL);
+	m->published = false;
+}
+
+static void free_meter(struct impl *impl, struct meter *m)
+{
+	clear_meter(impl, m);
+	spa_list_remove(&m->link);
+	free(m);
+}
+
+static void publish_meter(struct impl *impl, struct meter *m, const struct spa_io_meter *io)
+{
+	char momentary[64], short_term[64], true_peak[64];
+
+	if (impl->metadata == NULL)
+		return;
+
+	m->published = true;
+	pw_impl_metadata_set_propertyf(impl->metadata, m->id, NAME, "Spa:String:JSON",
+			"{ \"momentary\": %s, \"short-term\": %s, \"true-peak\": %s }",
+			spa_json_format_float(momentary, sizeof(momentary), io->momentary),
+			spa_json_format_float(short_term, sizeof(short_term), io->short_term),
+			spa_json_format_float(true_peak, sizeof(true_peak), io->true_peak));
+}
+
+static void update_node(struct impl *impl, struct pw_impl_node *node)
+{
+	struct pw_node_activation *a = node->rt.target.activation;
+	struct spa_io_meter io;
+	struct meter *m;
+	uint32_t seq1, seq2;
+
+	if (a == NULL || !node->registered)
+		return;
+
+	/* the node writes the meter from its data thread, get a consistent
+	 * copy */
+	do {
+		seq1 = SPA_SEQ_READ(a->meter.seq);
+		io = a->meter;
+		seq2 = SPA_SEQ_READ(a->meter.seq);
+	} while (!SPA_SEQ_READ_SUCCESS(seq1, seq2));
+
+	m = find_meter(impl, node->info.id);
+	if (m == NULL) {
+		/* the meter was never written */
+		if (seq2 == 0)
+			return;
+		if ((m = calloc(1, sizeof(*m))) == NULL)
+			return;
+		m->id = node->info.id;
+		m->seq = seq2 - 2;
+		spa_list_append(&impl->meter_list, &m->link);
+	}
+	m->seen = true;
+
+	if (m->seq == seq2) {
+		/* the meter was disabled or the node is not running */
+		if (++m->stale == STALE_INTERVALS)
+			clear_meter(impl, m);
+		return;
+	}
+	m->seq = seq2;
+	m->stale = 0;
+	publish_meter(impl, m, &io);
+}
+
+static void on_timeout(void *data, uint64_t expirations)
+{
+	struct impl *impl = data;
+	struct pw_impl_node *node;
+	struct meter *m, *t;
+
+	spa_list_for_each(m, &impl->meter_list, link)
+		m->seen = false;
+
+	spa_list_for_each(node, &impl->context->node_list, link)
+		update_node(impl, node);
+
+	spa_list_for_each_safe(m, t, &impl->meter_list, link) {
+		if (!m->seen) {
+			pw_log_debug("%p: remove meter of node %u", impl, m->id);
+			free_meter(impl, m);
+		}
+	}
+}
+
+static void metadata_destroy(void *data)
+{
+	struct impl *impl = data;
+	spa_hook_remove(&impl->metadata_listener);
+	impl->metadata = NULL;
+	if (impl->timer)
+		pw_loop_update_timer(impl->main_loop, impl->timer, NULL, NULL, false);
+}
+
+static const struct pw_impl_metadata_events metadata_events = {
+	PW_VERSION_IMPL_METADATA_EVENTS,
+	.destroy = metadata_destroy,
+};
+
+static void impl_free(struct impl *impl)
+{
+	struct meter *m;
+
+	if (impl->timer)
+		pw_loop_destroy_source(impl->main_loop, impl->timer);
+	spa_list_consume(m, &impl->meter_list, link)
+		free_meter(impl, m);
+	if (impl->metadata) {
+		spa_hook_remove(&impl->metadata_listener);
+		pw_impl_metadata_destroy(impl->metadata);
+	}
+	pw_properties_free(impl->properties);
+	free(impl);
+}
+
+static void module_destroy(void *data)
+{
+	struct impl *impl = data;
+	spa_hook_remove(&impl->module_listener);
+	impl_free(impl);
+}
+
+static const struct pw_impl_module_events module_events = {
+	PW_VERSION_IMPL_MODULE_EVENTS,
+	.destroy = module_destroy,
+};
+
+SPA_EXPORT
+int pipewire__module_init(struct pw_impl_module *module, const char *args)
+{
+	struct pw_context *context = pw_impl_module_get_context(module);
+	struct pw_properties *props;
+	struct impl *impl;
+	struct timespec value, interval;
+	int res;
+
+	PW_LOG_TOPIC_INIT(mod_topic);
+
+	impl = calloc(1, sizeof(struct impl));
+	if (impl == NULL)
+		return -errno;
+
+	spa_list_init(&impl->meter_list);
+
+	pw_log_debug("module %p: new %s", impl, args);
+
+	if (args)
+		props = pw_properties_new_string(args);
+	else
+		props = pw_properties_new(NULL, NULL);
+	if (props == NULL) {
+		res = -errno;
+		goto error;
+	}
+
+	impl->context = context;
+	impl->properties = props;
+	impl->main_loop = pw_context_get_main_loop(context);
+
+	pw_context_conf_update_props(context, "module."NAME".args", props);
+
+	impl->interval = SPA_MAX(pw_properties_get_uint32(props, "meter.interval.ms",
+				DEFAULT_INTERVAL), 10u);
+
+	impl->metadata = pw_context_create_metadata(context, NAME, NULL, 0);
+	if (impl->metadata == NULL) {
+		res = -errno;
+		goto error;
+	}
+	pw_impl_metadata_add_listener(impl->metadata,
+			&impl->metadata_listener, &metadata_events, impl);
+
+	if ((res = pw_impl_metadata_register(impl->metadata, NULL)) < 0)
+		goto error;
+
+	impl->timer = pw_loop_add_timer(impl->main_loop, on_timeout, impl);
+	if (impl->timer == NULL) {
+		res = -errno;
+		goto error;
+	}
+	value.tv_sec = interval.tv_sec = impl->interval / SPA_MSEC_PER_SEC;
+	value.tv_nsec = interval.tv_nsec = (impl->interval % SPA_MSEC_PER_SEC) * SPA_NSEC_PER_MSEC;
+	pw_loop_update_timer(impl->main_loop, impl->timer, &value, &interval, false);
+
+	pw_impl_module_add_listener(module, &impl->module_listener, &module_events, impl);
+
+	pw_impl_module_update_properties(module, &SPA_DICT_INIT_ARRAY(module_props));
+
+	return 0;
+
+error:
+	impl_free(impl);
+	return res;
+}
@@ -23,6 +23,9 @@
 #include <pipewire/impl.h>
 #include <pipewire/extensions/profiler.h>
 
+#include "module-profiler/histogram.h"
+#include "module-profiler/ring.h"
+
 /** \page page_module_profiler Profiler
  *
  * The profiler module provides a Profiler interface for applications that
@@ -31,6 +34,15 @@
  * Use tools like pw-top and pw-profiler to collect profiling information
  * about the pipewire graph.
  *
+ * The wait and busy times of all nodes are collected in histograms in every
+ * cycle and their percentiles are reported once per second, also when
+ * `profile.interval.ms` is used.
+ *
+ * The data thread of each driver writes the profiling data in a shared
+ * memory ring without locking or waking up the main loop. Clients that bind
+ * version 4 or later of the interface receive the rings and read them
+ * directly. Older clients receive the data in profile events.
+ *
  * ## Module Name
  *
  * `libpipewire-module-profiler`
@@ -40,6 +52,8 @@
  * - `profile.interval.ms`: Can be used to avoid gathering profiling information
  *			    on every processing cycle. This allows trading off
  *			    CPU usage for profiling accuracy. Default 0
+ * - `profile.ring.size`: The size in bytes of the ring of each driver, rounded
+ *			  up to a power of 2. Default 262144
  *
  * ## Config override
  *
@@ -51,6 +65,7 @@
  *
  * module.profiler.args = {
  *     #profile.interval.ms = 10
+ *     #profile.ring.size = 262144
  * }
  *\endcode
  *
@@ -63,6 +78,7 @@
  * { name = libpipewire-module-profiler
  *   args = {
  *       #profile.interval.ms = 0
+ *       #profile.ring.size = 262144
  *   }
  * }
  * ]
@@ -80,8 +96,16 @@ PW_LOG_TOPIC(mod_topic, "mod." NAME);
 #define PW_LOG_TOPIC_DEFAULT mod_topic
 
 #define TMP_BUFFER		(16 * 1024)
-#define DATA_BUFFER		(32 * 1024)
+#define MIN_RING_SIZE		(4u * TMP_BUFFER)
 #define FLUSH_BUFFER		(8 * 1024)
+#define MAX_WORKERS		64
+#define MIN_STATS		8u
+#define MAX_STATS		256u
+#define STATS_INTERVAL		SPA_NSEC_PER_SEC
+#define STATS_PER_OBJECT	64
+#define STATS_STALE		60
+/* upper bound of the size of one followerStats property */
+#define STATS_ITEM_SIZE		256
 
 int pw_protocol_native_ext_profiler_init(struct pw_context *context);
 
@@ -90,10 +114,17 @@ int pw_protocol_native_ext_profiler_init(struct pw_context *context);
 
 #define pw_profiler_resource_profile(r,...)        \
         pw_profiler_resource(r,profile,0,__VA_ARGS__)
+#define pw_profiler_resource_ring(r,...)        \
+        pw_profiler_resource(r,ring,1,__VA_ARGS__)
 
 #define DEFAULT_INTERVAL	0
+#define DEFAULT_RING_SIZE	(256 * 1024)
 
-#define MODULE_USAGE	"( profile.interval.ms=<minimum interval for sampling data (in ms) ) "
+/* clients binding this version or later read the rings */
+#define RING_VERSION		4
+
+#define MODULE_USAGE	"( profile.interval.ms=<minimum interval for sampling data (in ms) ) "	\
+			"( profile.ring.size=<size of the ring of a driver (in bytes) ) "
 
 static const struct spa_dict_item module_props[] = {
 	{ PW_KEY_MODULE_AUTHOR, "Wim Taymans <wim.taymans@gmail.com>" },
@@ -102,6 +133,21 @@ static const struct spa_dict_item module_props[] = {
 	{ PW_KEY_MODULE_VERSION, PACKAGE_VERSION },
 };
 
+struct node_stats {
+	uint32_t id;
+	int64_t last;
+	struct histogram wait;
+	struct histogram busy;
+};
+
+/* the histograms of one interval, filled by the data thread */
+struct stats_set {
+	uint32_t max_stats;
+	uint32_t n_stats;
+	bool overflow;
+	struct node_stats stats[];
+};
+
 struct node {
 	struct spa_list link;
 	struct impl *impl;
@@ -110,9 +156,34 @@ struct node {
 	struct spa_hook node_rt_listener;
 
 	int64_t count;
-	struct spa_ringbuffer buffer;
 	uint8_t tmp[TMP_BUFFER];
-	uint8_t data[DATA_BUFFER];
+
+	struct pw_memblock *mem;
+	struct ring_writer *ring;	/* points to writer when allocated */
+	struct ring_writer writer;
+	struct pw_profiler_ring_reader flush;
+
+	/* The data thread fills the active set and swaps it with the empty
+	 * set every STATS_INTERVAL. The main thread merges the full set into
+	 * the totals, computes the percentiles and hands the set back. */
+	struct stats_set *active;	/* data thread */
+	struct stats_set *empty;	/* taken by the data thread */
+	struct stats_set *full;		/* taken by the main thread */
+	uint32_t stats_pos;
+	uint64_t last_stats_time;
+
+	/* main thread */
+	struct node_stats *totals;
+	uint32_t n_totals;
+	uint32_t max_totals;
+	int64_t report_count;
+
+	/* objects with the percentiles, written to the ring by the data
+	 * thread when report_ready is set */
+	uint8_t *report;
+	uint32_t report_size;
+	uint32_t report_alloc;
+	int report_ready;
 
 	unsigned enabled:1;
 };
@@ -132,7 +203,9 @@ struct impl {
 	struct spa_list node_list;
 
 	uint32_t busy;
+	uint32_t n_legacy;
 	struct spa_source *flush_event;
+	struct spa_source *stats_event;
 	unsigned int listening:1;
 
 	uint8_t *flush;
@@ -140,6 +213,8 @@ struct impl {
 
 	uint32_t interval;
 	uint64_t last_signal_time;
+
+	uint32_t ring_size;
 };
 
 struct resource_data {
@@ -156,44 +231,49 @@ static void do_flush_event(void *data, uint64_t count)
 	struct node *n;
 	uint32_t total = 0;
 	struct spa_pod_struct *p;
+	int res;
 
 	p = (struct spa_pod_struct *)impl->flush;
 
 	spa_list_for_each(n, &impl->node_list, link) {
-		int32_t avail;
-		uint32_t idx;
-
-		avail = spa_ringbuffer_get_read_index(&n->buffer, &idx);
-
-		pw_log_trace("%p: avail %d", impl, avail);
+		if (n->ring == NULL)
+			continue;
 
-		if (avail > 0) {
-			size_t size = total + avail + sizeof(struct spa_pod_struct);
+		while (true) {
+			size_t size = total + TMP_BUFFER + sizeof(struct spa_pod_struct);
 			if (size > impl->flush_size) {
 				uint8_t *flush;
 				flush = realloc(impl->flush, size);
 				if (flush == NULL) {
 					pw_log_warn("%p: failed to realloc flush size %zu", impl, impl->flush_size);
-					continue;
+					break;
 				}
 				impl->flush = flush;
 				impl->flush_size = size;
 				pw_log_debug("%p: new flush buffer size %zu", impl, impl->flush_size);
 				p = (struct spa_pod_struct *)impl->flush;
 			}
-			spa_ringbuffer_read_data(&n->buffer, n->data, DATA_BUFFER,
-					idx % DATA_BUFFER,
+			res = pw_profiler_ring_read(&n->flush,
 					SPA_PTROFF(p, sizeof(struct spa_pod_struct) + total, void),
-					avail);
-			total += avail;
-			spa_ringbuffer_read_update(&n->buffer, idx + avail);
+					TMP_BUFFER);
+			if (res == -EPIPE) {
+				pw_log_warn("%p: queue xrun", impl);
+				continue;
+			}
+			if (res <= 0)
+				break;
+			total += res;
 		}
 	}
 
+	pw_log_trace("%p: flush %u", impl, total);
+
 	*p = SPA_POD_INIT_Struct(total);
 
-	spa_list_for_each(resource, &impl->global->resource_list, link)
-		pw_profiler_resource_profile(resource, &p->pod);
+	spa_list_for_each(resource, &impl->global->resource_list, link) {
+		if (resource->version < RING_VERSION)
+			pw_profiler_resource_profile(resource, &p->pod);
+	}
 }
 
 static void update_denom(struct spa_fraction *frac, uint32_t denom)
@@ -203,6 +283,271 @@ static void update_denom(struct spa_fraction *frac, uint32_t denom)
 	frac->denom = denom;
 }
 
+static struct stats_set *stats_set_new(uint32_t max_stats)
+{
+	struct stats_set *set;
+
+	set = calloc(1, sizeof(*set) + max_stats * sizeof(struct node_stats));
+	if (set != NULL)
+		set->max_stats = max_stats;
+	return set;
+}
+
+static struct node_stats *find_stats(struct node *n, uint32_t id)
+{
+	struct stats_set *set = n->active;
+	struct node_stats *found;
+	uint32_t i;
+
+	/* the targets are usually visited in the same order every cycle */
+	if (n->stats_pos < set->n_stats && set->stats[n->stats_pos].id == id)
+		return &set->stats[n->stats_pos++];
+
+	for (i = 0; i < set->n_stats; i++) {
+		if (set->stats[i].id == id) {
+			n->stats_pos = i + 1;
+			return &set->stats[i];
+		}
+	}
+	if (set->n_stats == set->max_stats) {
+		/* the main thread gives us a bigger set next time */
+		set->overflow = true;
+		return NULL;
+	}
+	found = &set->stats[set->n_stats];
+	found->id = id;
+	n->stats_pos = ++set->n_stats;
+	return found;
+}
+
+static void update_stats(struct node *n, uint32_t id, uint64_t base,
+		uint64_t signal, uint64_t awake, uint64_t finish)
+{
+	struct node_stats *s;
+
+	/* skip nodes that did not run in this cycle */
+	if (signal < base || awake < signal)
+		return;
+	if ((s = find_stats(n, id)) == NULL)
+		return;
+
+	hist_add(&s->wait, awake - signal);
+	if (finish >= awake)
+		hist_add(&s->busy, finish - awake);
+}
+
+static void write_data(struct node *n, const void *data, uint32_t size)
+{
+	struct impl *impl = n->impl;
+
+	if (n->ring == NULL || ring_writer_write(n->ring, data, size) < 0)
+		return;
+
+	if (impl->n_legacy > 0)
+		pw_loop_signal_event(impl->main_loop, impl->flush_event);
+}
+
+static void write_profile(struct node *n, struct spa_pod_builder *b)
+{
+	if (b->state.offset > b->size)
+		return;
+	write_data(n, b->data, b->state.offset);
+}
+
+static void add_stats(struct spa_pod_builder *b, struct node_stats *s)
+{
+	spa_pod_builder_prop(b, SPA_PROFILER_followerStats, 0);
+	spa_pod_builder_add_struct(b,
+		SPA_POD_Int(s->id),
+		SPA_POD_Long(s->wait.count),
+		SPA_POD_Long(hist_percentile(&s->wait, 5000)),
+		SPA_POD_Long(hist_percentile(&s->wait, 9900)),
+		SPA_POD_Long(hist_percentile(&s->wait, 9990)),
+		SPA_POD_Long(s->wait.max),
+		SPA_POD_Long(hist_percentile(&s->busy, 5000)),
+		SPA_POD_Long(hist_percentile(&s->busy, 9900)),
+		SPA_POD_Long(hist_percentile(&s->busy, 9990)),
+		SPA_POD_Long(s->busy.max));
+}
+
+static struct node_stats *find_totals(struct node *n, uint32_t id)
+{
+	struct node_stats *t;
+	uint32_t i;
+
+	for (i = 0; i < n->n_totals; i++) {
+		if (n->totals[i].id == id)
+			return &n->totals[i];
+	}
+	if (n->n_totals == n->max_totals) {
+		uint32_t max = SPA_MAX(MIN_STATS, n->max_totals * 2);
+		if ((t = reallocarray(n->totals, max, sizeof(*t))) == NULL)
+			return NULL;
+		n->totals = t;
+		n->max_totals = max;
+	}
+	t = &n->totals[n->n_totals++];
+	spa_zero(*t);
+	t->id = id;
+	return t;
+}
+
+/* make the objects with the percentiles of the nodes that ran since the
+ * last report */
+static void build_report(struct node *n)
+{
+	struct spa_pod_builder b;
+	struct spa_pod_frame f;
+	uint32_t i, n_items = 0, n_report = 0, size;
+
+	for (i = 0; i < n->n_totals; i++)
+		if (n->totals[i].last == n->report_count)
+			n_report++;
+
+	n->report_size = 0;
+	if (n_report == 0)
+		return;
+
+	size = n_report * STATS_ITEM_SIZE +
+		(n_report / STATS_PER_OBJECT + 1) * sizeof(struct spa_pod_object);
+	if (size > n->report_alloc) {
+		uint8_t *report = realloc(n->report, size);
+		if (report == NULL)
+			return;
+		n->report = report;
+		n->report_alloc = size;
+	}
+	spa_pod_builder_init(&b, n->report, n->report_alloc);
+
+	for (i = 0; i < n->n_totals; i++) {
+		struct node_stats *s = &n->totals[i];
+
+		if (s->last != n->report_count)
+			continue;
+
+		if (n_items == 0)
+			spa_pod_builder_push_object(&b, &f,
+					SPA_TYPE_OBJECT_Profiler, 0);
+		add_stats(&b, s);
+
+		if (++n_items == STATS_PER_OBJECT) {
+			spa_pod_builder_pop(&b, &f);
+			n_items = 0;
+		}
+	}
+	if (n_items > 0)
+		spa_pod_builder_pop(&b, &f);
+
+	if (b.state.offset <= b.size)
+		n->report_size = b.state.offset;
+}
+
+static void process_stats(struct node *n)
+{
+	struct stats_set *set;
+	struct node_stats *t;
+	uint32_t i, max_stats;
+
+	if ((set = SPA_ATOMIC_XCHG(n->full, NULL)) == NULL)
+		return;
+
+	n->report_count++;
+	for (i = 0; i < set->n_stats; i++) {
+		struct node_stats *s = &set->stats[i];
+
+		if ((t = find_totals(n, s->id)) == NULL)
+			continue;
+		hist_merge(&t->wait, &s->wait);
+		hist_merge(&t->busy, &s->busy);
+		t->last = n->report_count;
+	}
+	/* forget the nodes that did not run for a while */
+	for (i = 0; i < n->n_totals;) {
+		if (n->report_count - n->totals[i].last > STATS_STALE)
+			n->totals[i] = n->totals[--n->n_totals];
+		else
+			i++;
+	}
+
+	/* the data thread is still writing the previous report otherwise */
+	if (!SPA_ATOMIC_LOAD(n->report_ready)) {
+		build_report(n);
+		if (n->report_size > 0)
+			SPA_ATOMIC_STORE(n->report_ready, 1);
+	}
+
+	max_stats = set->max_stats;
+	if (set->overflow && max_stats < MAX_STATS) {
+		struct stats_set *s;
+		max_stats = SPA_MIN(max_stats * 2, MAX_STATS);
+		if ((s = stats_set_new(max_stats)) != NULL) {
+			free(set);
+			set = s;
+		}
+	}
+	memset(set->stats, 0, set->max_stats * sizeof(struct node_stats));
+	set->n_stats = 0;
+	set->overflow = false;
+	SPA_ATOMIC_STORE(n->empty, set);
+}
+
+static void do_stats_event(void *data, uint64_t count)
+{
+	struct impl *impl = data;
+	struct node *n;
+
+	spa_list_for_each(n, &impl->node_list, link)
+		process_stats(n);
+}
+
+/* called from the data thread */
+static void collect_stats(struct node *n)
+{
+	struct impl *impl = n->impl;
+	struct pw_impl_node *node = n->node;
+	struct pw_node_activation *a = node->rt.target.activation;
+	struct pw_node_target *t;
+	struct stats_set *set;
+
+	/* collect the timings of all nodes in every cycle */
+	spa_list_for_each(t, &node->rt.target_list, link) {
+		struct pw_node_activation *na = t->activation;
+
+		if (t->node != NULL && t->node->async)
+			update_stats(n, t->id, a->prev_signal_time, na->prev_signal_time,
+					na->prev_awake_time, na->prev_finish_time);
+		else
+			update_stats(n, t->id, a->signal_time, na->signal_time,
+					na->awake_time, na->finish_time);
+	}
+
+	if (SPA_ATOMIC_LOAD(n->report_ready)) {
+		uint32_t offs = 0;
+		while (offs + sizeof(struct spa_pod) <= n->report_size) {
+			struct spa_pod *pod = SPA_PTROFF(n->report, offs, struct spa_pod);
+			uint32_t size = SPA_ROUND_UP_N(SPA_POD_SIZE(pod), 8);
+			write_data(n, pod, size);
+			offs += size;
+		}
+		SPA_ATOMIC_STORE(n->report_ready, 0);
+	}
+
+	if (a->signal_time - n->last_stats_time < STATS_INTERVAL)
+		return;
+
+	/* hand the histograms to the main thread when it is done with the
+	 * previous ones, else keep on collecting */
+	if (SPA_ATOMIC_LOAD(n->full) != NULL ||
+	    (set = SPA_ATOMIC_XCHG(n->empty, NULL)) == NULL)
+		return;
+
+	SPA_ATOMIC_STORE(n->full, n->active);
+	n->active = set;
+	n->stats_pos = 0;
+	n->last_stats_time = a->signal_time;
+	pw_loop_signal_event(impl->main_loop, impl->stats_event);
+}
+
 static void context_do_profile(void *data)
 {
 	struct node *n = data;
@@ -214,12 +559,15 @@ static void context_do_profile(void *data)
 	struct pw_node_activation *a = node->rt.target.activation;
 	struct spa_io_position *pos = &a->position;
 	struct pw_node_target *t;
-	int32_t filled;
-	uint32_t idx, avail;
+	uint32_t i, n_workers;
+	struct pw_loop_pool_stats workers[MAX_WORKERS];
 
 	if (SPA_FLAG_IS_SET(pos->clock.flags, SPA_IO_CLOCK_FLAG_FREEWHEEL))
 		return;
 
+	if (n->active != NULL)
+		collect_stats(n);
+
 	if (a->signal_time - impl->last_signal_time < impl->interval)
 		goto done;
 
@@ -265,6 +613,15 @@ static void context_do_profile(void *data)
 			SPA_POD_Fraction(&node->latency),
 			SPA_POD_Int(a->xrun_count));
 
+	n_workers = pw_context_get_loop_pool_stats(impl->context, workers, SPA_N_ELEMENTS(workers));
+	for (i = 0; i < n_workers; i++) {
+		spa_pod_builder_prop(&b, SPA_PROFILER_workerBlock, 0);
+		spa_pod_builder_add_struct(&b,
+			SPA_POD_Int(i),
+			SPA_POD_String(workers[i].name),
+			SPA_POD_Long(workers[i].count));
+	}
+
 	spa_list_for_each(t, &node->rt.target_list, link) {
 		struct pw_impl_node *n = t->node;
 		struct pw_node_activation *na;
@@ -317,26 +674,7 @@ static void context_do_profile(void *data)
 	}
 	spa_pod_builder_pop(&b, &f[0]);
 
-	if (b.state.offset > sizeof(n->tmp))
-		goto done;
-
-	filled = spa_ringbuffer_get_write_index(&n->buffer, &idx);
-	if (filled < 0 || filled > DATA_BUFFER) {
-		pw_log_warn("%p: queue xrun %d", impl, filled);
-		goto done;
-	}
-	avail = DATA_BUFFER - filled;
-	if (avail < b.state.offset) {
-		pw_log_warn("%p: queue full %d < %d", impl, avail, b.state.offset);
-		goto done;
-	}
-	spa_ringbuffer_write_data(&n->buffer,
-			n->data, DATA_BUFFER,
-			idx % DATA_BUFFER,
-			b.data, b.state.offset);
-	spa_ringbuffer_write_update(&n->buffer, idx + b.state.offset);
-
-	pw_loop_signal_event(impl->main_loop, impl->flush_event);
+	write_profile(n, &b);
 done:
 	n->count++;
 }
@@ -347,14 +685,111 @@ static const struct pw_impl_node_rt_events node_rt_events = {
 	.incomplete = context_do_profile,
 };
 
+static void send_ring(struct node *n, struct pw_resource *resource)
+{
+	struct pw_impl_client *client = pw_resource_get_client(resource);
+	struct pw_memblock *m;
+
+	if (n->mem == NULL || resource->version < RING_VERSION)
+		return;
+
+	m = pw_mempool_import_block(pw_impl_client_get_mempool(client), n->mem);
+	if (m == NULL) {
+		pw_log_warn("%p: can't import ring: %m", n->impl);
+		return;
+	}
+	pw_log_debug("%p: node %u ring mem_id:%u", n->impl, n->node->info.id, m->id);
+
+	pw_profiler_resource_ring(resource, n->node->info.id, m->id, 0, n->mem->size);
+}
+
+static void remove_ring(struct node *n, struct pw_resource *resource, bool notify)
+{
+	struct pw_impl_client *client = pw_resource_get_client(resource);
+	struct pw_memblock *m;
+
+	if (n->mem == NULL || resource->version < RING_VERSION)
+		return;
+
+	m = pw_mempool_find_fd(pw_impl_client_get_mempool(client), n->mem->fd);
+	if (m == NULL)
+		return;
+
+	if (notify)
+		pw_profiler_resource_ring(resource, n->node->info.id, SPA_ID_INVALID, 0, 0);
+	pw_memblock_unref(m);
+}
+
+static int alloc_ring(struct node *n)
+{
+	struct impl *impl = n->impl;
+	struct pw_resource *resource;
+
+	n->mem = pw_mempool_alloc(impl->context->pool,
+			PW_MEMBLOCK_FLAG_READWRITE |
+			PW_MEMBLOCK_FLAG_SEAL |
+			PW_MEMBLOCK_FLAG_MAP,
+			SPA_DATA_MemFd, sizeof(struct pw_profiler_ring) + impl->ring_size);
+	if (n->mem == NULL)
+		return -errno;
+
+	ring_writer_init(&n->writer, n->mem->map->ptr, impl->ring_size, TMP_BUFFER);
+	ring_writer_reader(&n->writer, &n->flush);
+	n->ring = &n->writer;
+
+	spa_list_for_each(resource, &impl->global->resource_list, link)
+		send_ring(n, resource);
+	return 0;
+}
+
+static void free_ring(struct node *n)
+{
+	struct impl *impl = n->impl;
+	struct pw_resource *resource;
+
+	if (n->mem == NULL)
+		return;
+
+	if (impl->global != NULL) {
+		spa_list_for_each(resource, &impl->global->resource_list, link)
+			remove_ring(n, resource, true);
+	}
+	pw_memblock_unref(n->mem);
+	n->mem = NULL;
+	n->ring = NULL;
+}
+
 static void enable_node_profiling(struct node *n, bool enabled)
 {
 	if (enabled && !n->enabled) {
+		if (alloc_ring(n) < 0)
+			pw_log_warn("%p: can't allocate ring: %m", n->impl);
+		n->active = stats_set_new(MIN_STATS);
+		n->empty = stats_set_new(MIN_STATS);
+		n->stats_pos = 0;
+		if (n->active == NULL || n->empty == NULL) {
+			pw_log_warn("%p: can't allocate stats: %m", n->impl);
+			free(n->active);
+			free(n->empty);
+			n->active = n->empty = NULL;
+		}
 		SPA_FLAG_SET(n->node->rt.target.activation->flags, PW_NODE_ACTIVATION_FLAG_PROFILER);
 		pw_impl_node_add_rt_listener(n->node, &n->node_rt_listener, &node_rt_events, n);
 	} else if (!enabled && n->enabled) {
 		SPA_FLAG_CLEAR(n->node->rt.target.activation->flags, PW_NODE_ACTIVATION_FLAG_PROFILER);
 		pw_impl_node_remove_rt_listener(n->node, &n->node_rt_listener);
+		free(n->active);
+		free(n->empty);
+		free(n->full);
+		n->active = n->empty = n->full = NULL;
+		free(n->totals);
+		n->totals = NULL;
+		n->n_totals = n->max_totals = 0;
+		free(n->report);
+		n->report = NULL;
+		n->report_size = n->report_alloc = 0;
+		n->report_ready = 0;
+		free_ring(n);
 	}
 	n->enabled = enabled;
 }
@@ -378,7 +813,6 @@ static void context_driver_added(void *data, struct pw_impl_node *node)
 	n->impl = impl;
 	n->node = node;
 	spa_list_append(&impl->node_list, &n->link);
-	spa_ringbuffer_init(&n->buffer);
 
 	if (impl->busy > 0)
 		enable_node_profiling(n, true);
@@ -424,7 +858,15 @@ static void stop_listener(struct impl *impl)
 
 static void resource_destroy(void *data)
 {
-	struct impl *impl = data;
+	struct resource_data *d = data;
+	struct impl *impl = d->impl;
+	struct node *n;
+
+	if (d->resource->version < RING_VERSION)
+		impl->n_legacy--;
+	spa_list_for_each(n, &impl->node_list, link)
+		remove_ring(n, d->resource, false);
+
 	if (--impl->busy == 0) {
 		pw_log_info("%p: stopping profiler", impl);
 		stop_listener(impl);
@@ -444,6 +886,7 @@ global_bind(void *object, struct pw_impl_client *client, uint32_t permissions,
 	struct pw_global *global = impl->global;
 	struct pw_resource *resource;
 	struct resource_data *data;
+	struct node *n;
 
 	resource = pw_resource_new(client, id, permissions,
 			PW_TYPE_INTERFACE_Profiler, version, sizeof(*data));
@@ -456,12 +899,18 @@ global_bind(void *object, struct pw_impl_client *client, uint32_t permissions,
 	pw_global_add_resource(global, resource);
 
 	pw_resource_add_listener(resource, &data->resource_listener,
-			&resource_events, impl);
+			&resource_events, data);
+
+	if (version < RING_VERSION)
+		impl->n_legacy++;
 
 	if (++impl->busy == 1) {
 		pw_log_info("%p: starting profiler", impl);
 		enable_profiling(impl, true);
 		impl->listening = true;
+	} else {
+		spa_list_for_each(n, &impl->node_list, link)
+			send_ring(n, resource);
 	}
 	return 0;
 }
@@ -479,6 +928,7 @@ static void module_destroy(void *data)
 	pw_properties_free(impl->properties);
 
 	pw_loop_destroy_source(impl->main_loop, impl->flush_event);
+	pw_loop_destroy_source(impl->main_loop, impl->stats_event);
 
 	free(impl->flush);
 	free(impl);
@@ -542,6 +992,10 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 	impl->interval = SPA_NSEC_PER_MSEC *
 		pw_properties_get_uint32(props, "profile.interval.ms", DEFAULT_INTERVAL);
 	impl->last_signal_time = 0;
+	impl->ring_size = SPA_CLAMP(pw_properties_get_uint32(props, "profile.ring.size",
+				DEFAULT_RING_SIZE), MIN_RING_SIZE, 1u << 30);
+	/* round up to a power of 2 so that the indexes can wrap */
+	impl->ring_size = 1u << (32 - __builtin_clz(impl->ring_size - 1));
 
 	impl->global = pw_global_new(context,
 			PW_TYPE_INTERFACE_Profiler,
@@ -559,6 +1013,7 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 			pw_global_get_serial(impl->global));
 
 	impl->flush_event = pw_loop_add_event(impl->main_loop, do_flush_event, impl);
+	impl->stats_event = pw_loop_add_event(impl->main_loop, do_stats_event, impl);
 
 	pw_impl_module_add_listener(module, &impl->module_listener, &module_events, impl);
 
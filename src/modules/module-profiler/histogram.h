@@ -0,0 +1,80 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef PIPEWIRE_PROFILER_HISTOGRAM_H
+#define PIPEWIRE_PROFILER_HISTOGRAM_H
+
+#include <stdint.h>
+
+#include <spa/utils/defs.h>
+
+/* log-linear histogram of nanosecond values up to 2^32, each power of
+ * two is split in HIST_SUB buckets, giving 12.5% precision */
+#define HIST_SUB_BITS		3
+#define HIST_SUB		(1u << HIST_SUB_BITS)
+#define HIST_BUCKETS		((33u - HIST_SUB_BITS) << HIST_SUB_BITS)
+
+struct histogram {
+	uint64_t count;
+	uint64_t max;
+	uint32_t buckets[HIST_BUCKETS];
+};
+
+static inline uint32_t hist_index(uint64_t val)
+{
+	uint32_t e;
+	if (val < HIST_SUB)
+		return val;
+	val = SPA_MIN(val, UINT32_MAX);
+	e = 63 - __builtin_clzll(val) - HIST_SUB_BITS;
+	return ((e + 1) << HIST_SUB_BITS) | ((val >> e) & (HIST_SUB - 1));
+}
+
+/* upper bound of the values in bucket idx */
+static inline uint64_t hist_value(uint32_t idx)
+{
+	uint32_t e;
+	if (idx < HIST_SUB)
+		return idx;
+	e = (idx >> HIST_SUB_BITS) - 1;
+	return (((uint64_t)(HIST_SUB | (idx & (HIST_SUB - 1))) + 1) << e) - 1;
+}
+
+static inline void hist_add(struct histogram *h, uint64_t val)
+{
+	h->buckets[hist_index(val)]++;
+	h->max = SPA_MAX(h->max, val);
+	h->count++;
+}
+
+static inline void hist_merge(struct histogram *h, const struct histogram *o)
+{
+	uint32_t i;
+
+	if (o->count == 0)
+		return;
+	for (i = 0; i < HIST_BUCKETS; i++)
+		h->buckets[i] += o->buckets[i];
+	h->max = SPA_MAX(h->max, o->max);
+	h->count += o->count;
+}
+
+/* value below which perm/100 percent of the samples fall */
+static inline uint64_t hist_percentile(const struct histogram *h, uint32_t perm)
+{
+	uint64_t target, sum = 0;
+	uint32_t i;
+
+	if (h->count == 0)
+		return 0;
+	target = (h->count * perm + 9999) / 10000;
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		sum += h->buckets[i];
+		if (sum >= target)
+			return SPA_MIN(hist_value(i), h->max);
+	}
+	return h->max;
+}
+
+#endif /* PIPEWIRE_PROFILER_HISTOGRAM_H */
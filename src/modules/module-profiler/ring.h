@@ -0,0 +1,71 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef PIPEWIRE_PROFILER_RING_H
+#define PIPEWIRE_PROFILER_RING_H
+
+#include <errno.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/ringbuffer.h>
+
+#include <pipewire/extensions/profiler.h>
+
+/* The writer of a pw_profiler_ring in shared memory. Clients can write to
+ * the memory so the size, mask and write index are kept here and only
+ * published to the header, they are never read back from it. */
+struct ring_writer {
+	struct pw_profiler_ring *ring;
+	void *data;
+	uint32_t size;
+	uint32_t mask;
+	uint32_t max_record;
+	uint32_t index;
+};
+
+/* size is the size of the data area after the header, a power of 2 */
+static inline void ring_writer_init(struct ring_writer *w, struct pw_profiler_ring *ring,
+		uint32_t size, uint32_t max_record)
+{
+	w->ring = ring;
+	w->data = PW_PROFILER_RING_DATA(ring);
+	w->size = size;
+	w->mask = size - 1;
+	w->max_record = SPA_MIN(max_record, size);
+	w->index = 0;
+
+	ring->version = 0;
+	ring->size = w->size;
+	ring->max_record = w->max_record;
+	spa_ringbuffer_init(&ring->ring);
+}
+
+static inline int ring_writer_write(struct ring_writer *w, const void *data, uint32_t size)
+{
+	uint32_t idx = w->index;
+
+	if (size > w->max_record)
+		return -ENOSPC;
+
+	spa_ringbuffer_write_data(NULL, w->data, w->size, idx & w->mask, data, size);
+	idx += size;
+	__atomic_store_n(&w->index, idx, __ATOMIC_RELEASE);
+	__atomic_store_n(&w->ring->ring.writeindex, idx, __ATOMIC_RELEASE);
+	/* readers must see the new index before the next write overwrites
+	 * older data */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	return 0;
+}
+
+/* a reader that only uses the private values of the writer */
+static inline void ring_writer_reader(struct ring_writer *w, struct pw_profiler_ring_reader *rd)
+{
+	rd->data = w->data;
+	rd->writeindex = &w->index;
+	rd->size = w->size;
+	rd->max_record = w->max_record;
+	rd->index = __atomic_load_n(&w->index, __ATOMIC_ACQUIRE);
+}
+
+#endif /* PIPEWIRE_PROFILER_RING_H */
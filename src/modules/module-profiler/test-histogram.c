@@ -0,0 +1,90 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <spa/utils/defs.h>
+
+#include "histogram.h"
+
+/* every value falls in a bucket with an upper bound that is at most
+ * 12.5% higher */
+static void test_buckets(void)
+{
+	uint64_t val;
+	uint32_t idx, last = 0;
+
+	for (val = 0; val < (1ull << 33); val = val < 64 ? val + 1 : val + val / 7) {
+		idx = hist_index(val);
+		spa_assert_se(idx < HIST_BUCKETS);
+		spa_assert_se(idx >= last);
+		last = idx;
+		if (val <= UINT32_MAX) {
+			spa_assert_se(hist_value(idx) >= val);
+			spa_assert_se(hist_value(idx) <= val + val / HIST_SUB);
+		}
+		if (idx > 0)
+			spa_assert_se(hist_value(idx - 1) < SPA_MIN(val, (uint64_t)UINT32_MAX));
+	}
+	spa_assert_se(hist_index(UINT64_MAX) == HIST_BUCKETS - 1);
+}
+
+static void test_percentile(void)
+{
+	struct histogram h;
+	uint64_t p;
+	uint32_t i;
+
+	spa_zero(h);
+	spa_assert_se(hist_percentile(&h, 5000) == 0);
+
+	/* 1000 samples of 1..1000 usec */
+	for (i = 1; i <= 1000; i++)
+		hist_add(&h, i * 1000ull);
+	spa_assert_se(h.count == 1000);
+	spa_assert_se(h.max == 1000000);
+
+	p = hist_percentile(&h, 5000);
+	spa_assert_se(p >= 500000 && p <= 500000 + 500000 / HIST_SUB);
+	p = hist_percentile(&h, 9900);
+	spa_assert_se(p >= 990000 && p <= 1000000);
+	/* never more than the max */
+	spa_assert_se(hist_percentile(&h, 9990) <= h.max);
+	spa_assert_se(hist_percentile(&h, 10000) == h.max);
+}
+
+/* merging the histograms of the intervals gives the same result as one
+ * histogram of all samples */
+static void test_merge(void)
+{
+	struct histogram total, all, interval;
+	uint32_t i, j;
+
+	spa_zero(total);
+	spa_zero(all);
+
+	for (i = 0; i < 10; i++) {
+		spa_zero(interval);
+		for (j = 0; j < 100; j++) {
+			uint64_t val = (i * 7919 + j * 104729) % 5000000;
+			hist_add(&interval, val);
+			hist_add(&all, val);
+		}
+		hist_merge(&total, &interval);
+	}
+	spa_zero(interval);
+	hist_merge(&total, &interval);
+
+	spa_assert_se(memcmp(&total, &all, sizeof(total)) == 0);
+	spa_assert_se(hist_percentile(&total, 9900) == hist_percentile(&all, 9900));
+}
+
+int main(int argc, char *argv[])
+{
+	test_buckets();
+	test_percentile();
+	test_merge();
+	return 0;
+}
@@ -0,0 +1,304 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <spa/utils/defs.h>
+#include <spa/pod/builder.h>
+
+#include "ring.h"
+
+#define RING_SIZE	256
+#define MAX_RECORD	64
+#define GUARD		64
+#define N_RECORDS	200000
+
+struct mem {
+	struct pw_profiler_ring ring;
+	uint8_t data[RING_SIZE];
+	uint8_t guard[GUARD];
+};
+
+/* a record of size bytes, the body is filled with val */
+static void write_record(struct ring_writer *w, uint32_t size, uint8_t val)
+{
+	uint8_t buf[MAX_RECORD * 2];
+	struct spa_pod *pod = (struct spa_pod *)buf;
+
+	spa_assert_se(size >= sizeof(*pod) && size <= sizeof(buf) && (size & 7) == 0);
+	*pod = SPA_POD_INIT(size - sizeof(*pod), SPA_TYPE_Bytes);
+	memset(SPA_PTROFF(buf, sizeof(*pod), void), val, size - sizeof(*pod));
+	spa_assert_se(ring_writer_write(w, buf, size) == 0);
+}
+
+static void check_record(const void *data, int res, uint32_t size, uint8_t val)
+{
+	const struct spa_pod *pod = data;
+	const uint8_t *body = SPA_PTROFF(data, sizeof(*pod), const uint8_t);
+	uint32_t i;
+
+	spa_assert_se(res == (int)size);
+	spa_assert_se(SPA_POD_SIZE(pod) == size);
+	spa_assert_se(SPA_POD_TYPE(pod) == SPA_TYPE_Bytes);
+	for (i = 0; i < size - sizeof(*pod); i++)
+		spa_assert_se(body[i] == val);
+}
+
+static void init_mem(struct mem *m, struct ring_writer *w)
+{
+	memset(m, 0xaa, sizeof(*m));
+	ring_writer_init(w, &m->ring, RING_SIZE, MAX_RECORD);
+}
+
+static void check_guard(struct mem *m)
+{
+	uint32_t i;
+	for (i = 0; i < GUARD; i++)
+		spa_assert_se(m->guard[i] == 0xaa);
+}
+
+static void test_read(void)
+{
+	struct mem m;
+	struct ring_writer w;
+	struct pw_profiler_ring_reader rd;
+	uint8_t buf[MAX_RECORD];
+
+	init_mem(&m, &w);
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == 0);
+	spa_assert_se(rd.size == RING_SIZE);
+	spa_assert_se(rd.max_record == MAX_RECORD);
+
+	spa_assert_se(pw_profiler_ring_read(&rd, buf, sizeof(buf)) == 0);
+
+	write_record(&w, 16, 1);
+	write_record(&w, 64, 2);
+	write_record(&w, 8, 3);
+	check_record(buf, pw_profiler_ring_read(&rd, buf, sizeof(buf)), 16, 1);
+	check_record(buf, pw_profiler_ring_read(&rd, buf, sizeof(buf)), 64, 2);
+	check_record(buf, pw_profiler_ring_read(&rd, buf, sizeof(buf)), 8, 3);
+	spa_assert_se(pw_profiler_ring_read(&rd, buf, sizeof(buf)) == 0);
+
+	/* records larger than max_record are not written */
+	spa_assert_se(ring_writer_write(&w, buf, MAX_RECORD + 8) == -ENOSPC);
+	spa_assert_se(pw_profiler_ring_read(&rd, buf, sizeof(buf)) == 0);
+	check_guard(&m);
+}
+
+/* records are split over the end of the data area */
+static void test_wrap(void)
+{
+	struct mem m;
+	struct ring_writer w;
+	struct pw_profiler_ring_reader rd;
+	uint8_t buf[MAX_RECORD];
+	uint32_t i;
+
+	init_mem(&m, &w);
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == 0);
+
+	for (i = 0; i < 100; i++) {
+		uint32_t size = 40 + (i % 3) * 8;
+		write_record(&w, size, i);
+		check_record(buf, pw_profiler_ring_read(&rd, buf, sizeof(buf)), size, i);
+	}
+	spa_assert_se(rd.index == w.index);
+	spa_assert_se(w.index > 4 * RING_SIZE);
+	check_guard(&m);
+
+	/* the write index wraps around 32 bits */
+	init_mem(&m, &w);
+	w.index = UINT32_MAX - 23;
+	m.ring.ring.writeindex = w.index;
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == 0);
+	for (i = 0; i < 8; i++) {
+		write_record(&w, 32, i);
+		check_record(buf, pw_profiler_ring_read(&rd, buf, sizeof(buf)), 32, i);
+	}
+	spa_assert_se(w.index < UINT32_MAX - 23);
+}
+
+/* the reader falls behind and data is overwritten */
+static void test_overrun(void)
+{
+	struct mem m;
+	struct ring_writer w;
+	struct pw_profiler_ring_reader rd;
+	uint8_t buf[MAX_RECORD];
+	uint32_t i;
+
+	init_mem(&m, &w);
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == 0);
+
+	/* up to size - max_record bytes can be read back */
+	for (i = 0; i < (RING_SIZE - MAX_RECORD) / 32; i++)
+		write_record(&w, 32, i);
+	for (i = 0; i < (RING_SIZE - MAX_RECORD) / 32; i++)
+		check_record(buf, pw_profiler_ring_read(&rd, buf, sizeof(buf)), 32, i);
+
+	for (i = 0; i < (RING_SIZE - MAX_RECORD) / 32 + 1; i++)
+		write_record(&w, 32, i);
+	spa_assert_se(pw_profiler_ring_read(&rd, buf, sizeof(buf)) == -EPIPE);
+	spa_assert_se(rd.index == w.index);
+	spa_assert_se(pw_profiler_ring_read(&rd, buf, sizeof(buf)) == 0);
+
+	/* reading continues with the next record */
+	write_record(&w, 24, 7);
+	check_record(buf, pw_profiler_ring_read(&rd, buf, sizeof(buf)), 24, 7);
+
+	/* a buffer that is too small also skips the data */
+	write_record(&w, 64, 8);
+	spa_assert_se(pw_profiler_ring_read(&rd, buf, 32) == -EPIPE);
+	spa_assert_se(pw_profiler_ring_read(&rd, buf, sizeof(buf)) == 0);
+	check_guard(&m);
+}
+
+/* the shared memory can be changed by clients, the writer and the reader
+ * must stay inside the memory */
+static void test_corrupt(void)
+{
+	struct mem m;
+	struct ring_writer w;
+	struct pw_profiler_ring_reader rd, flush;
+	uint8_t buf[MAX_RECORD];
+	uint32_t i;
+
+	init_mem(&m, &w);
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == 0);
+	ring_writer_reader(&w, &flush);
+
+	m.ring.size = UINT32_MAX;
+	m.ring.max_record = UINT32_MAX;
+	m.ring.ring.writeindex = 0x7fffff00;
+	m.ring.ring.readindex = 0x12345678;
+
+	for (i = 0; i < 100; i++) {
+		write_record(&w, 48, i);
+		/* the reader of the writer only uses the private index */
+		check_record(buf, pw_profiler_ring_read(&flush, buf, sizeof(buf)), 48, i);
+		m.ring.ring.writeindex = i * 0x01010101;
+	}
+	spa_assert_se(rd.size == RING_SIZE);
+	spa_assert_se(rd.max_record == MAX_RECORD);
+	check_guard(&m);
+
+	/* records with a bad size are not copied */
+	init_mem(&m, &w);
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == 0);
+	write_record(&w, 32, 1);
+	write_record(&w, 32, 2);
+	((struct spa_pod *)m.data)->size = 4096;
+	spa_assert_se(pw_profiler_ring_read(&rd, buf, sizeof(buf)) == -EPIPE);
+	spa_assert_se(rd.index == w.index);
+	spa_assert_se(pw_profiler_ring_read(&rd, buf, sizeof(buf)) == 0);
+
+	/* a bad writeindex points to data that is not a valid record */
+	m.ring.ring.writeindex = w.index + 16;
+	spa_assert_se(pw_profiler_ring_read(&rd, buf, sizeof(buf)) == -EPIPE);
+	m.ring.ring.writeindex = rd.index - 16;
+	spa_assert_se(pw_profiler_ring_read(&rd, buf, sizeof(buf)) == -EPIPE);
+	m.ring.ring.writeindex = rd.index + RING_SIZE;
+	spa_assert_se(pw_profiler_ring_read(&rd, buf, sizeof(buf)) == -EPIPE);
+	check_guard(&m);
+}
+
+static void test_invalid(void)
+{
+	struct mem m;
+	struct ring_writer w;
+	struct pw_profiler_ring_reader rd;
+
+	init_mem(&m, &w);
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == 0);
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring,
+				sizeof(m.ring) + RING_SIZE) == 0);
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring,
+				sizeof(m.ring) + RING_SIZE - 1) == -EINVAL);
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, 16) == -EINVAL);
+
+	m.ring.version = 1;
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == -EINVAL);
+	m.ring.version = 0;
+
+	m.ring.size = 0;
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == -EINVAL);
+	m.ring.size = RING_SIZE - 8;
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == -EINVAL);
+	m.ring.size = RING_SIZE * 2;
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == -EINVAL);
+	m.ring.size = RING_SIZE;
+
+	m.ring.max_record = 4;
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == -EINVAL);
+	m.ring.max_record = RING_SIZE * 2;
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == -EINVAL);
+	m.ring.max_record = MAX_RECORD;
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == 0);
+}
+
+static void *writer_thread(void *data)
+{
+	struct ring_writer *w = data;
+	uint32_t i;
+
+	for (i = 1; i <= N_RECORDS; i++) {
+		write_record(w, 8 + (i % 8) * 8, i);
+		/* let the reader run with one CPU */
+		if ((i & 3) == 0)
+			sched_yield();
+	}
+	return NULL;
+}
+
+/* a record that is read while the writer runs is never torn */
+static void test_concurrent(void)
+{
+	static struct mem m;
+	struct ring_writer w;
+	struct pw_profiler_ring_reader rd;
+	uint8_t buf[MAX_RECORD];
+	pthread_t thread;
+	uint32_t end = 0, reads = 0;
+	int res;
+
+	init_mem(&m, &w);
+	spa_assert_se(pw_profiler_ring_reader_init(&rd, &m.ring, sizeof(m)) == 0);
+	for (res = 0; res < N_RECORDS; res++) {
+		uint32_t size = 8 + ((res + 1) % 8) * 8;
+		end += size;
+	}
+
+	spa_assert_se(pthread_create(&thread, NULL, writer_thread, &w) == 0);
+	while (rd.index != end) {
+		const uint8_t *body = SPA_PTROFF(buf, sizeof(struct spa_pod), uint8_t);
+		uint32_t i;
+
+		res = pw_profiler_ring_read(&rd, buf, sizeof(buf));
+		if (res <= 0) {
+			sched_yield();
+			continue;
+		}
+		spa_assert_se(SPA_POD_SIZE(buf) == (uint32_t)res);
+		for (i = 1; i < res - sizeof(struct spa_pod); i++)
+			spa_assert_se(body[i] == body[0]);
+		reads++;
+	}
+	pthread_join(thread, NULL);
+	spa_assert_se(reads > 0);
+	check_guard(&m);
+}
+
+int main(int argc, char *argv[])
+{
+	test_read();
+	test_wrap();
+	test_overrun();
+	test_corrupt();
+	test_invalid();
+	test_concurrent();
+	return 0;
+}
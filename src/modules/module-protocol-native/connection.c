@@ -30,11 +30,24 @@ PW_LOG_TOPIC_EXTERN(mod_topic_connection);
 #define MAX_BUFFER_SIZE (1024 * 32)
 #define MAX_FDS 1024u
 #define MAX_FDS_MSG 28
+#define MAX_IOV 64
 
 #define HDR_SIZE_V0	8
 #define HDR_SIZE	16
 
+/* a chunk of the output queue, messages are never split over segments */
+struct segment {
+	struct spa_list link;
+	size_t offset;			/* bytes sent */
+	size_t size;			/* bytes queued */
+	size_t maxsize;
+	uint8_t data[];
+};
+
 struct buffer {
+	struct spa_list segments;	/* output only */
+	struct segment *spare;
+
 	uint8_t *buffer_data;
 	size_t buffer_size;
 	size_t buffer_maxsize;
@@ -159,6 +172,74 @@ static void *connection_ensure_size(struct pw_protocol_native_connection *conn,
 	return (uint8_t *) buf->buffer_data + buf->buffer_size;
 }
 
+static struct segment *alloc_segment(struct buffer *buf, size_t size)
+{
+	struct segment *seg;
+
+	size = SPA_ROUND_UP_N(SPA_MAX(size, 1u), MAX_BUFFER_SIZE);
+	if (size == MAX_BUFFER_SIZE && buf->spare != NULL) {
+		seg = buf->spare;
+		buf->spare = NULL;
+	} else if ((seg = malloc(sizeof(*seg) + size)) == NULL) {
+		return NULL;
+	}
+	seg->offset = seg->size = 0;
+	seg->maxsize = size;
+	spa_list_append(&buf->segments, &seg->link);
+	return seg;
+}
+
+static void free_segment(struct buffer *buf, struct segment *seg)
+{
+	spa_list_remove(&seg->link);
+	if (seg->maxsize == MAX_BUFFER_SIZE && buf->spare == NULL)
+		buf->spare = seg;
+	else
+		free(seg);
+}
+
+static void clear_segments(struct buffer *buf)
+{
+	struct segment *seg;
+
+	spa_list_consume(seg, &buf->segments, link)
+		free_segment(buf, seg);
+}
+
+/* make room for size bytes after the queued output. When a new segment is
+ * needed, the keep bytes of the message that is being written are moved
+ * along to it. */
+static void *out_ensure_size(struct pw_protocol_native_connection *conn, struct buffer *buf,
+		size_t size, size_t keep)
+{
+	struct segment *seg, *last = NULL;
+	int res;
+
+	if (!spa_list_is_empty(&buf->segments)) {
+		last = spa_list_last(&buf->segments, struct segment, link);
+		if (last->size + size <= last->maxsize)
+			return last->data + last->size;
+	}
+
+	if ((seg = alloc_segment(buf, size)) == NULL) {
+		res = -errno;
+		spa_hook_list_call(&conn->listener_list,
+				struct pw_protocol_native_connection_events,
+				error, 0, res);
+		errno = -res;
+		return NULL;
+	}
+	if (last != NULL) {
+		if (keep > 0)
+			memcpy(seg->data, last->data + last->size, keep);
+		if (last->offset == last->size)
+			free_segment(buf, last);
+	}
+	pw_log_debug("connection %p: new segment %zd %zd", conn, size, seg->maxsize);
+
+	return seg->data;
+}
+
 static void handle_connection_error(struct pw_protocol_native_connection *conn, int res)
 {
 	if (res == EPIPE || res == ECONNRESET)
@@ -433,14 +514,13 @@ struct pw_protocol_native_connection *pw_protocol_native_connection_new(struct p
 	impl->hdr_size = HDR_SIZE;
 	impl->version = 3;
 
-	impl->out.buffer_data = calloc(1, MAX_BUFFER_SIZE);
-	impl->out.buffer_maxsize = MAX_BUFFER_SIZE;
+	spa_list_init(&impl->out.segments);
 	impl->in.buffer_data = calloc(1, MAX_BUFFER_SIZE);
 	impl->in.buffer_maxsize = MAX_BUFFER_SIZE;
 
 	reenter_item = calloc(1, sizeof(struct reenter_item));
 
-	if (impl->out.buffer_data == NULL || impl->in.buffer_data == NULL || reenter_item == NULL)
+	if (impl->in.buffer_data == NULL || reenter_item == NULL)
 		goto no_mem;
 
 	spa_list_init(&impl->reenter_stack);
@@ -449,7 +529,6 @@ struct pw_protocol_native_connection *pw_protocol_native_connection_new(struct p
 	return this;
 
 no_mem:
-	free(impl->out.buffer_data);
 	free(impl->in.buffer_data);
 	free(reenter_item);
 	free(impl);
@@ -481,7 +560,8 @@ void pw_protocol_native_connection_destroy(struct pw_protocol_native_connection
 
 	clear_buffer(&impl->out, true);
 	clear_buffer(&impl->in, true);
-	free(impl->out.buffer_data);
+	clear_segments(&impl->out);
+	free(impl->out.spare);
 	free(impl->in.buffer_data);
 
 	while (!spa_list_is_empty(&impl->reenter_stack))
@@ -642,10 +722,11 @@ struct spa_pod *pw_protocol_native_connection_get_footer(struct pw_protocol_nati
 static inline void *begin_write(struct pw_protocol_native_connection *conn, uint32_t size)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
-	uint32_t *p;
+	uint32_t *p, offset = impl->builder.state.offset;
 	struct buffer *buf = &impl->out;
-	/* header and size for payload */
-	if ((p = connection_ensure_size(conn, buf, impl->hdr_size + size)) == NULL)
+	/* header and size for payload, keep what the builder already wrote */
+	if ((p = out_ensure_size(conn, buf, impl->hdr_size + size,
+					offset > 0 ? impl->hdr_size + offset : 0)) == NULL)
 		return NULL;
 
 	return SPA_PTROFF(p, impl->hdr_size, void);
@@ -700,9 +781,11 @@ pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
 	uint32_t *p, size = builder->state.offset;
 	struct buffer *buf = &impl->out;
+	struct segment *seg;
 	int res;
 
-	if ((p = connection_ensure_size(conn, buf, impl->hdr_size + size)) == NULL)
+	if ((p = out_ensure_size(conn, buf, impl->hdr_size + size,
+					impl->hdr_size + size)) == NULL)
 		return -errno;
 
 	p[0] = buf->msg.id;
@@ -712,7 +795,8 @@ pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
 		p[3] = buf->msg.n_fds;
 	}
 
-	buf->buffer_size += impl->hdr_size + size;
+	seg = spa_list_last(&buf->segments, struct segment, link);
+	seg->size += impl->hdr_size + size;
 	if (impl->version >= 3)
 		buf->n_fds += buf->msg.n_fds;
 	else
@@ -749,42 +833,53 @@ pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
 int pw_protocol_native_connection_flush(struct pw_protocol_native_connection *conn)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
-	ssize_t sent, outsize;
+	ssize_t sent;
 	struct msghdr msg = { 0 };
-	struct iovec iov[1];
+	struct iovec iov[MAX_IOV];
 	struct cmsghdr *cmsg;
 	union {
 		char cmsgbuf[CMSG_SPACE(MAX_FDS_MSG * sizeof(int))];
 		struct cmsghdr align;
 	} cmsgbuf;
 	int res = 0, *fds;
-	uint32_t fds_len, to_close, n_fds, outfds, i;
+	uint32_t fds_len, to_close, n_fds, outfds, n_iov, i;
 	struct buffer *buf;
-	void *data;
+	struct segment *seg, *t;
 	size_t size;
 
 	buf = &impl->out;
-	data = buf->buffer_data;
-	size = buf->buffer_size;
 	fds = buf->fds;
 	n_fds = buf->n_fds;
 	to_close = 0;
 
-	while (size > 0) {
+	while (true) {
+		/* send as many segments as we can in one go */
+		n_iov = 0;
+		size = 0;
+		spa_list_for_each(seg, &buf->segments, link) {
+			if (seg->offset == seg->size)
+				continue;
+			iov[n_iov].iov_base = seg->data + seg->offset;
+			iov[n_iov].iov_len = seg->size - seg->offset;
+			size += iov[n_iov].iov_len;
+			if (++n_iov == MAX_IOV)
+				break;
+		}
+		if (size == 0)
+			break;
+
 		if (n_fds > MAX_FDS_MSG) {
 			outfds = MAX_FDS_MSG;
-			outsize = SPA_MIN(sizeof(uint32_t), size);
+			n_iov = 1;
+			iov[0].iov_len = SPA_MIN(sizeof(uint32_t), iov[0].iov_len);
 		} else {
 			outfds = n_fds;
-			outsize = size;
 		}
 
 		fds_len = outfds * sizeof(int);
 
-		iov[0].iov_base = data;
-		iov[0].iov_len = outsize;
 		msg.msg_iov = iov;
-		msg.msg_iovlen = 1;
+		msg.msg_iovlen = n_iov;
 
 		if (outfds > 0) {
 			msg.msg_control = &cmsgbuf;
@@ -812,22 +907,32 @@ int pw_protocol_native_connection_flush(struct pw_protocol_native_connection *co
 			}
 			break;
 		}
-		pw_log_trace("connection %p: %d written %zd bytes and %u fds", conn, conn->fd, sent,
-			     outfds);
+		pw_log_trace("connection %p: %d written %zd bytes in %u segments and %u fds",
+				conn, conn->fd, sent, n_iov, outfds);
 
-		size -= sent;
-		data = SPA_PTROFF(data, sent, void);
 		n_fds -= outfds;
 		fds += outfds;
 		to_close += outfds;
+
+		/* release the segments that were completely sent, the last
+		 * one is kept for new messages */
+		spa_list_for_each_safe(seg, t, &buf->segments, link) {
+			size_t len = SPA_MIN((size_t)sent, seg->size - seg->offset);
+
+			seg->offset += len;
+			sent -= len;
+			if (seg->offset < seg->size)
+				break;
+			if (seg->link.next == &buf->segments)
+				seg->offset = seg->size = 0;
+			else
+				free_segment(buf, seg);
+		}
 	}
 
 	res = 0;
 
 exit:
-	if (size > 0)
-		memmove(buf->buffer_data, data, size);
-	buf->buffer_size = size;
 	for (i = 0; i < to_close; i++) {
 		pw_log_debug("%p: close fd:%d", conn, buf->fds[i]);
 		close(buf->fds[i]);
@@ -855,6 +960,7 @@ int pw_protocol_native_connection_clear(struct pw_protocol_native_connection *co
 
 	clear_buffer(&impl->out, true);
 	clear_buffer(&impl->in, true);
+	clear_segments(&impl->out);
 
 	return 0;
 }
@@ -2,11 +2,15 @@
 /* SPDX-FileCopyrightText: Copyright © 2019 Wim Taymans */
 /* SPDX-License-Identifier: MIT */
 
+#include <stdio.h>
+#include <time.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 
 #include <spa/pod/builder.h>
 #include <spa/pod/parser.h>
 #include <spa/utils/result.h>
+#include <spa/utils/string.h>
 
 #include <pipewire/pipewire.h>
 
@@ -165,6 +169,166 @@ static void test_reentering(struct pw_protocol_native_connection *in,
 	}
 }
 
+static void write_data(struct pw_protocol_native_connection *conn, uint32_t size, uint8_t seed)
+{
+	struct spa_pod_builder *b;
+	struct spa_pod_frame f;
+	uint8_t data[4096];
+	uint32_t i, len;
+	int res;
+
+	b = pw_protocol_native_connection_begin(conn, 2, 7, NULL);
+	spa_assert_se(b != NULL);
+
+	spa_pod_builder_push_struct(b, &f);
+	spa_pod_builder_int(b, size);
+	for (i = 0; i < size; i += len) {
+		uint32_t j;
+		len = SPA_MIN(size - i, sizeof(data));
+		for (j = 0; j < len; j++)
+			data[j] = seed + i + j;
+		spa_pod_builder_bytes(b, data, len);
+	}
+	spa_pod_builder_pop(b, &f);
+
+	res = pw_protocol_native_connection_end(conn, b);
+	spa_assert_se(SPA_RESULT_IS_ASYNC(res));
+}
+
+static int read_data(struct pw_protocol_native_connection *conn, uint8_t seed)
+{
+	const struct pw_protocol_native_message *msg;
+	struct spa_pod_parser prs;
+	struct spa_pod_frame f;
+	uint32_t i, j, len;
+	int32_t size;
+	const void *data;
+	int res;
+
+	if ((res = pw_protocol_native_connection_get_next(conn, &msg)) != 1)
+		return res;
+
+	spa_assert_se(msg->opcode == 7);
+	spa_assert_se(msg->id == 2);
+
+	spa_pod_parser_init(&prs, msg->data, msg->size);
+	spa_assert_se(spa_pod_parser_push_struct(&prs, &f) == 0);
+	spa_assert_se(spa_pod_parser_get_int(&prs, &size) == 0);
+	for (i = 0; i < (uint32_t)size; i += len) {
+		spa_assert_se(spa_pod_parser_get_bytes(&prs, &data, &len) == 0);
+		for (j = 0; j < len; j++)
+			spa_assert_se(((const uint8_t*)data)[j] == (uint8_t)(seed + i + j));
+	}
+	spa_assert_se(i == (uint32_t)size);
+	return 0;
+}
+
+static void test_large(struct pw_protocol_native_connection *in,
+		struct pw_protocol_native_connection *out)
+{
+	static const uint32_t sizes[] = { 0, 100, 30000, 40000, 100000, 1000000 };
+	uint32_t i, n_read;
+	int res;
+
+	/* queue messages of all sizes, this needs more than one segment and
+	 * more than one sendmsg */
+	for (i = 0; i < 200; i++)
+		write_data(out, sizes[i % SPA_N_ELEMENTS(sizes)], i);
+
+	n_read = 0;
+	while (n_read < 200) {
+		res = pw_protocol_native_connection_flush(out);
+		spa_assert_se(res == 0 || res == -EAGAIN);
+
+		while ((res = read_data(in, n_read)) == 0)
+			n_read++;
+		spa_assert_se(res == -EAGAIN);
+	}
+	spa_assert_se(pw_protocol_native_connection_flush(out) == 0);
+	spa_assert_se(read_data(in, 0) == -EAGAIN);
+}
+
+static void test_many_fds(struct pw_protocol_native_connection *in,
+		struct pw_protocol_native_connection *out)
+{
+	int i, fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+	spa_assert_se(fd >= 0);
+
+	/* more fds than can be sent in one sendmsg */
+	for (i = 0; i < 100; i++)
+		write_message(out, fd);
+	spa_assert_se(pw_protocol_native_connection_flush(out) == 0);
+	for (i = 0; i < 100; i++)
+		spa_assert_se(read_message(in, NULL) == 0);
+	spa_assert_se(read_message(in, NULL) == -1);
+
+	close(fd);
+}
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void write_bytes(struct pw_protocol_native_connection *conn,
+		const void *data, uint32_t size)
+{
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_connection_begin(conn, 2, 7, NULL);
+	spa_assert_se(b != NULL);
+	spa_pod_builder_add_struct(b, SPA_POD_Bytes(data, size));
+	spa_assert_se(SPA_RESULT_IS_ASYNC(pw_protocol_native_connection_end(conn, b)));
+}
+
+static void run_benchmark(struct pw_protocol_native_connection *in,
+		struct pw_protocol_native_connection *out,
+		uint32_t size, uint32_t n_messages)
+{
+	static uint8_t data[1024 * 1024];
+	const struct pw_protocol_native_message *msg;
+	uint32_t n_sent = 0, n_read = 0, batch;
+	uint64_t bytes = 0, t1, t2;
+	double secs;
+	int res;
+
+	/* queue batches of up to 4MB, like the replies to an enum_params */
+	batch = SPA_CLAMP(4u * 1024 * 1024 / SPA_MAX(size, 1u), 1u, 512u);
+
+	t1 = get_time_ns();
+	while (n_read < n_messages) {
+		while (n_sent < n_messages && n_sent - n_read < batch) {
+			write_bytes(out, data, SPA_MIN(size, sizeof(data)));
+			n_sent++;
+		}
+		res = pw_protocol_native_connection_flush(out);
+		spa_assert_se(res == 0 || res == -EAGAIN);
+
+		while (pw_protocol_native_connection_get_next(in, &msg) == 1) {
+			bytes += msg->size;
+			n_read++;
+		}
+	}
+	t2 = get_time_ns();
+
+	secs = (t2 - t1) / (double)SPA_NSEC_PER_SEC;
+	fprintf(stdout, "size %7u: %10.0f messages/sec %8.1f MB/sec\n",
+			size, n_messages / secs, bytes / secs / (1024 * 1024));
+}
+
+static void test_benchmark(struct pw_protocol_native_connection *in,
+		struct pw_protocol_native_connection *out)
+{
+	run_benchmark(in, out, 32, 1000000);
+	run_benchmark(in, out, 512, 500000);
+	run_benchmark(in, out, 4096, 200000);
+	run_benchmark(in, out, 65536, 50000);
+	run_benchmark(in, out, 1024 * 1024, 2000);
+}
+
 int main(int argc, char *argv[])
 {
 	struct pw_main_loop *loop;
@@ -195,6 +359,11 @@ int main(int argc, char *argv[])
 	test_create(out);
 	test_read_write(in, out);
 	test_reentering(in, out);
+	test_large(in, out);
+	test_many_fds(in, out);
+
+	if (argc > 1 && spa_streq(argv[1], "--benchmark"))
+		test_benchmark(in, out);
 
 	pw_protocol_native_connection_destroy(in);
 	pw_protocol_native_connection_destroy(out);
@@ -44,6 +44,7 @@ struct client *client_new(struct server *server)
 	client->server = server;
 	client->impl = server->impl;
 	client->connect_tag = SPA_ID_INVALID;
+	client->in_channel = SPA_ID_INVALID;
 
 	pw_map_init(&client->streams, 16, 16);
 	spa_list_init(&client->out_messages);
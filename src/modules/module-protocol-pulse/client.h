@@ -66,6 +66,8 @@ struct client {
 	uint32_t out_index;
 	struct descriptor desc;
 	struct message *message;
+	uint32_t in_channel;		/**< memblock channel received in the stream ring */
+	uint32_t in_ring_index;
 
 	struct pw_map streams;
 	struct spa_list out_messages;
@@ -19,10 +19,13 @@
 
 #include "client.h"
 #include "collect.h"
+#include "internal.h"
 #include "log.h"
 #include "manager.h"
 #include "module.h"
 #include "message-handler.h"
+#include "server.h"
+#include "stream.h"
 
 static int bluez_card_object_message_handler(struct client *client, struct pw_manager_object *o, const char *message, const char *params, FILE *response)
 {
@@ -89,6 +92,28 @@ static int bluez_card_object_message_handler(struct client *client, struct pw_ma
 	return 0;
 }
 
+struct stream_stats_data {
+	FILE *response;
+	bool first;
+};
+
+static int do_stream_stats(void *item, void *data)
+{
+	struct stream *stream = item;
+	struct stream_stats_data *d = data;
+	char name[256];
+
+	if (spa_json_encode_string(name, sizeof(name),
+			stream->client->name ? stream->client->name : "") >= (int)sizeof(name))
+		snprintf(name, sizeof(name), "\"\"");
+	fprintf(d->response, "%s{\"id\":%u,\"client\":%s,\"channel\":%u,"
+			"\"bytes-received\":%"PRIu64",\"bytes-copied\":%"PRIu64"}",
+			d->first ? "" : ",", stream->id, name,
+			stream->channel, stream->bytes_received, stream->bytes_copied);
+	d->first = false;
+	return 0;
+}
+
 static int core_object_message_handler(struct client *client, struct pw_manager_object *o, const char *message, const char *params, FILE *response)
 {
 	pw_log_debug(": core %p object message:'%s' params:'%s'", o, message, params);
@@ -106,6 +131,16 @@ static int core_object_message_handler(struct client *client, struct pw_manager_
 			}
 		}
 		fputc(']', response);
+	} else if (spa_streq(message, "pipewire-pulse:stream-stats")) {
+		struct stream_stats_data d = { .response = response, .first = true };
+		struct server *s;
+		struct client *c;
+
+		fputc('[', response);
+		spa_list_for_each(s, &client->impl->servers, link)
+			spa_list_for_each(c, &s->clients, link)
+				pw_map_for_each(&c->streams, do_stream_stats, &d);
+		fputc(']', response);
 #ifdef HAVE_MALLOC_INFO
 	} else if (spa_streq(message, "pipewire-pulse:malloc-info")) {
 		malloc_info(0, response);
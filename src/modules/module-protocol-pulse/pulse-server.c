@@ -1245,6 +1245,7 @@ struct process_data {
 	uint32_t playing_for;
 	uint32_t minreq;
 	uint32_t quantum;
+	uint32_t copied;
 	unsigned int underrun:1;
 	unsigned int idle:1;
 };
@@ -1261,6 +1262,7 @@ do_process_done(struct spa_loop *loop,
 	int32_t avail;
 
 	stream->timestamp = pd->pwt.now;
+	stream->bytes_copied += pd->copied;
 	stream->delay = pd->pwt.buffered * SPA_USEC_PER_SEC / stream->ss.rate;
 	if (pd->pwt.rate.denom > 0)
 		stream->delay += pd->pwt.delay * SPA_USEC_PER_SEC * pd->pwt.rate.num / pd->pwt.rate.denom;
@@ -1344,6 +1346,7 @@ do_process_done(struct spa_loop *loop,
 						stream->buffer, MAXLENGTH,
 						index % MAXLENGTH,
 						msg->data, towrite);
+				stream->bytes_copied += towrite;
 
 				client_queue_message(client, msg);
 
@@ -1417,6 +1420,7 @@ static void stream_process(void *data)
 						stream->buffer, MAXLENGTH,
 						index % MAXLENGTH,
 						p, avail);
+					pd.copied += avail;
 					empty = false;
 				}
 				index += size;
@@ -1447,6 +1451,7 @@ static void stream_process(void *data)
 					stream->buffer, MAXLENGTH,
 					index % MAXLENGTH,
 					p, size);
+			pd.copied += size;
 
 			index += size;
 			pd.read_inc += size;
@@ -1485,6 +1490,7 @@ static void stream_process(void *data)
 				index % MAXLENGTH,
 				SPA_PTROFF(p, offs, void),
 				SPA_MIN(size, MAXLENGTH));
+		pd.copied += SPA_MIN(size, MAXLENGTH);
 
 		index += size;
 		pd.write_inc = size;
@@ -112,13 +112,12 @@ static void stream_clear_data(struct stream *stream,
 		sample_spec_silence(&stream->ss, stream->buffer, l1);
 }
 
-static int handle_memblock(struct client *client, struct message *msg)
+static int seek_memblock(struct client *client, struct stream *stream,
+		uint32_t length, uint32_t *index)
 {
-	struct stream *stream;
-	uint32_t channel, flags, index;
+	uint32_t channel, flags;
 	int64_t offset, diff;
 	int32_t filled;
-	int res = 0;
 
 	channel = ntohl(client->desc.channel);
 	offset = (int64_t) (
@@ -126,19 +125,9 @@ static int handle_memblock(struct client *client, struct message *msg)
 		(((uint64_t) ntohl(client->desc.offset_lo))));
 	flags = ntohl(client->desc.flags);
 
-	pw_log_debug("client %p: received memblock channel:%d offset:%" PRIi64 " flags:%08x size:%u",
-		     client, channel, offset, flags, msg->length);
-
-	stream = pw_map_lookup(&client->streams, channel);
-	if (stream == NULL || stream->type == STREAM_TYPE_RECORD) {
-		pw_log_info("client %p [%s]: received memblock for unknown channel %d",
-			    client, client->name, channel);
-		goto finish;
-	}
-
-	filled = spa_ringbuffer_get_write_index(&stream->ring, &index);
-	pw_log_debug("new block %p %p/%u filled:%d index:%d flags:%02x offset:%" PRIu64,
-		     msg, msg->data, msg->length, filled, index, flags, offset);
+	filled = spa_ringbuffer_get_write_index(&stream->ring, index);
+	pw_log_debug("client %p: new block channel:%d size:%u filled:%d index:%d flags:%02x offset:%" PRIi64,
+		     client, channel, length, filled, *index, flags, offset);
 
 	switch (flags & FLAG_SEEKMASK) {
 	case SEEK_RELATIVE:
@@ -154,8 +143,7 @@ static int handle_memblock(struct client *client, struct message *msg)
 	default:
 		pw_log_warn("client %p [%s]: received memblock frame with invalid seek mode: %" PRIu32,
 			    client, client->name, (uint32_t)(flags & FLAG_SEEKMASK));
-		res = -EPROTO;
-		goto finish;
+		return -EPROTO;
 	}
 
 	if (diff > 0) {
@@ -164,10 +152,10 @@ static int handle_memblock(struct client *client, struct message *msg)
 		 * play back old data. FIXME, if the write pointer goes backwards and
 		 * forwards, this might clear valid data. We should probably keep track of
 		 * the highest write pointer and only clear when we go past that one. */
-		stream_clear_data(stream, index % MAXLENGTH, SPA_MIN(diff, MAXLENGTH));
+		stream_clear_data(stream, *index % MAXLENGTH, SPA_MIN(diff, MAXLENGTH));
 	}
 
-	index += diff;
+	*index += diff;
 	filled += diff;
 	stream->write_index += diff;
 	if ((flags & FLAG_SEEKMASK) == SEEK_RELATIVE)
@@ -175,10 +163,46 @@ static int handle_memblock(struct client *client, struct message *msg)
 
 	if (filled < 0) {
 		/* underrun, reported on reader side */
-	} else if (filled + msg->length > stream->attr.maxlength) {
+	} else if (filled + length > stream->attr.maxlength) {
 		/* overrun */
 		stream_send_overflow(stream);
 	}
+	return 0;
+}
+
+static void commit_memblock(struct stream *stream, uint32_t index, uint32_t length)
+{
+	spa_ringbuffer_write_update(&stream->ring, index + length);
+
+	stream->write_index += length;
+	stream->requested -= length;
+
+	stream_send_request(stream);
+
+	if (stream->is_paused && !stream->corked)
+		stream_set_paused(stream, false, "new data");
+}
+
+static int handle_memblock(struct client *client, struct message *msg)
+{
+	struct stream *stream;
+	uint32_t channel, index;
+	int res = 0;
+
+	channel = ntohl(client->desc.channel);
+
+	pw_log_debug("client %p: received memblock channel:%d flags:%08x size:%u",
+		     client, channel, ntohl(client->desc.flags), msg->length);
+
+	stream = pw_map_lookup(&client->streams, channel);
+	if (stream == NULL || stream->type == STREAM_TYPE_RECORD) {
+		pw_log_info("client %p [%s]: received memblock for unknown channel %d",
+			    client, client->name, channel);
+		goto finish;
+	}
+
+	if ((res = seek_memblock(client, stream, msg->length, &index)) < 0)
+		goto finish;
 
 	/* always write data to ringbuffer, we expect the other side
 	 * to recover */
@@ -187,32 +211,108 @@ static int handle_memblock(struct client *client, struct message *msg)
 			index % MAXLENGTH,
 			msg->data,
 			SPA_MIN(msg->length, MAXLENGTH));
-	index += msg->length;
-	spa_ringbuffer_write_update(&stream->ring, index);
-
-	stream->write_index += msg->length;
-	stream->requested -= msg->length;
+	stream->bytes_copied += SPA_MIN(msg->length, MAXLENGTH);
 
-	stream_send_request(stream);
-
-	if (stream->is_paused && !stream->corked)
-		stream_set_paused(stream, false, "new data");
+	commit_memblock(stream, index, msg->length);
 
 finish:
 	message_free(msg, false, false);
 	return res;
 }
 
+/* memblocks for playback streams are received straight into the
+ * ringbuffer of the stream so that the data is only copied once,
+ * from the ringbuffer into the pw_stream buffers */
+static int start_memblock(struct client *client, uint32_t channel, uint32_t length)
+{
+	struct stream *stream;
+	uint32_t index;
+	int res;
+
+	stream = pw_map_lookup(&client->streams, channel);
+	if (stream == NULL || stream->type == STREAM_TYPE_RECORD ||
+	    stream->buffer == NULL || length > MAXLENGTH)
+		return 0;
+
+	if ((res = seek_memblock(client, stream, length, &index)) < 0)
+		return res;
+
+	client->in_channel = channel;
+	client->in_ring_index = index;
+	return 1;
+}
+
+static ssize_t do_recv(struct client *client, void *data, size_t size)
+{
+	while (true) {
+		ssize_t r = recv(client->source->fd, data, size, MSG_DONTWAIT);
+
+		if (r == 0 && size != 0) {
+			return -EPIPE;
+		} else if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			r = -errno;
+			if (r != -EAGAIN && r != -EWOULDBLOCK &&
+			    r != -EPIPE && r != -ECONNRESET)
+				pw_log_warn("recv client:%p res %zd: %m", client, r);
+		}
+		return r;
+	}
+}
+
+static int do_read_memblock(struct client *client)
+{
+	uint32_t idx = client->in_index - sizeof(client->desc);
+	uint32_t length = ntohl(client->desc.length);
+	struct stream *stream;
+	uint8_t scratch[4096];
+	void *data;
+	size_t size;
+	ssize_t r;
+
+	stream = pw_map_lookup(&client->streams, client->in_channel);
+	if (stream == NULL || stream->buffer == NULL) {
+		/* the stream went away, drop the data */
+		stream = NULL;
+		data = scratch;
+		size = SPA_MIN(length - idx, sizeof(scratch));
+	} else {
+		uint32_t offs = (client->in_ring_index + idx) % MAXLENGTH;
+		data = SPA_PTROFF(stream->buffer, offs, void);
+		size = SPA_MIN(length - idx, MAXLENGTH - offs);
+	}
+
+	if ((r = do_recv(client, data, size)) < 0)
+		return r;
+
+	client->in_index += r;
+
+	if (client->in_index >= length + sizeof(client->desc)) {
+		client->in_index = 0;
+		client->in_channel = SPA_ID_INVALID;
+
+		if (stream != NULL) {
+			stream->bytes_received += length;
+			commit_memblock(stream, client->in_ring_index, length);
+		}
+	}
+	return 0;
+}
+
 static int do_read(struct client *client)
 {
 	struct impl * const impl = client->impl;
 	size_t size;
+	ssize_t r;
 	int res = 0;
 	void *data;
 
 	if (client->in_index < sizeof(client->desc)) {
 		data = SPA_PTROFF(&client->desc, client->in_index, void);
 		size = sizeof(client->desc) - client->in_index;
+	} else if (client->in_channel != SPA_ID_INVALID) {
+		return do_read_memblock(client);
 	} else {
 		uint32_t idx = client->in_index - sizeof(client->desc);
 
@@ -225,26 +325,13 @@ static int do_read(struct client *client)
 		size = client->message->length - idx;
 	}
 
-	while (true) {
-		ssize_t r = recv(client->source->fd, data, size, MSG_DONTWAIT);
-
-		if (r == 0 && size != 0) {
-			res = -EPIPE;
-			goto exit;
-		} else if (r < 0) {
-			if (errno == EINTR)
-				continue;
-			res = -errno;
-			if (res != -EAGAIN && res != -EWOULDBLOCK &&
-			    res != -EPIPE && res != -ECONNRESET)
-				pw_log_warn("recv client:%p res %zd: %m", client, r);
-			goto exit;
-		}
-
-		client->in_index += r;
-		break;
+	if ((r = do_recv(client, data, size)) < 0) {
+		res = r;
+		goto exit;
 	}
 
+	client->in_index += r;
+
 	if (client->in_index == sizeof(client->desc)) {
 		uint32_t flags, length, channel;
 
@@ -274,6 +361,14 @@ static int do_read(struct client *client)
 
 		if (client->message)
 			message_free(client->message, false, false);
+		client->message = NULL;
+
+		if (channel != (uint32_t) -1 &&
+		    (res = start_memblock(client, channel, length)) != 0) {
+			if (res > 0)
+				res = 0;
+			goto exit;
+		}
 
 		client->message = message_alloc(impl, channel, length);
 	} else if (client->message &&
@@ -104,7 +104,9 @@ void stream_free(struct stream *stream)
 	struct client *client = stream->client;
 	struct impl *impl = client->impl;
 
-	pw_log_debug("client %p: stream %p channel:%d", client, stream, stream->channel);
+	pw_log_debug("client %p: stream %p channel:%d received:%"PRIu64" copied:%"PRIu64,
+			client, stream, stream->channel, stream->bytes_received,
+			stream->bytes_copied);
 
 	if (stream->drain_tag)
 		reply_error(client, -1, stream->drain_tag, -ENOENT);
@@ -64,6 +64,10 @@ struct stream {
 	uint64_t idle_time;
 	int64_t delay;
 
+	/* reported with the pipewire-pulse:stream-stats message */
+	uint64_t bytes_received;	/* received from the client directly in the ring */
+	uint64_t bytes_copied;		/* copied between the ring and buffers/messages */
+
 	uint32_t last_quantum;
 	int64_t requested;
 
@@ -63,6 +63,9 @@
  * - `sap.max-sessions = <int>`: maximum number of concurrent send/receive sessions to track
  * - `sap.preamble-extra = [strings]`: extra attributes to add to the atomic SDP preamble
  * - `sap.end-extra = [strings]`: extra attributes to add to the end of the SDP message
+ * - `net.recv-mode = <str>`: the receive mode of the created sources, see \ref page_module_rtp_source
+ * - `net.shared-socket = <bool>`: let the created sources on the same port share one
+ *       socket, see \ref page_module_rtp_source, default false
  *
  * ## General options
  *
@@ -84,6 +87,8 @@
  *         #source.ip = "0.0.0.0"
  *         #net.ttl = 1
  *         #net.loop = false
+ *         #net.recv-mode = "mmsg"
+ *         #net.shared-socket = false
  *         stream.rules = [
  *             {   matches = [
  *                     # any of the items in matches needs to match, if one does,
@@ -1117,6 +1122,12 @@ static int session_load_source(struct session *session, struct pw_properties *pr
 	if ((str = pw_properties_get(props, "cleanup.sec")) != NULL) {
 		fprintf(f, "\"cleanup.sec\" = \"%s\", ", str);
 	}
+	if ((str = pw_properties_get(props, "net.recv-mode")) != NULL ||
+	    (str = pw_properties_get(impl->props, "net.recv-mode")) != NULL)
+		fprintf(f, "\"net.recv-mode\" = \"%s\", ", str);
+	if ((str = pw_properties_get(props, "net.shared-socket")) != NULL ||
+	    (str = pw_properties_get(impl->props, "net.shared-socket")) != NULL)
+		fprintf(f, "\"net.shared-socket\" = %s, ", str);
 
 	if (spa_streq(media, "audio")) {
 		const char *mime;
@@ -28,6 +28,7 @@
 
 #include <module-rtp/stream.h>
 #include "network-utils.h"
+#include "network-batch.h"
 
 #ifndef IPTOS_DSCP
 #define IPTOS_DSCP_MASK 0xfc
@@ -54,6 +55,15 @@
  * - `net.mtu = <int>`: MTU to use, default 1280
  * - `net.ttl = <int>`: TTL to use, default 1
  * - `net.loop = <bool>`: loopback multicast, default false
+ * - `net.send-mode = <str>`: how packets are sent, `single` uses a sendmsg() per
+ *       packet, `mmsg` sends all packets of a cycle with one sendmmsg(), `gso`
+ *       sends packets of the same size as one buffer that is split by the kernel
+ *       (UDP_SEGMENT), default `single`
+ * - `net.txtime = <bool>`: give packets a launch time with SO_TXTIME, packets
+ *       sent at the same time are spread out over the packet time. This needs
+ *       a qdisc that supports this, such as etf. default false
+ * - `net.txtime-delay = <int>`: the delay in microseconds between sending and
+ *       the launch time of the first packet, default 1000
  * - `sess.min-ptime = <float>`: minimum packet time in milliseconds, default 2
  * - `sess.max-ptime = <float>`: maximum packet time in milliseconds, default 20
  * - `sess.name = <str>`: a session name
@@ -100,6 +110,7 @@
  *         #net.mtu = 1280
  *         #net.ttl = 1
  *         #net.loop = false
+ *         #net.send-mode = "single"
  *         #sess.min-ptime = 2
  *         #sess.max-ptime = 20
  *         #sess.name = "PipeWire RTP stream"
@@ -116,6 +127,11 @@
  *]
  *\endcode
  *
+ * ## Statistics
+ *
+ * The module properties `net.syscalls-per-sec` and `net.packets-per-sec` are
+ * updated periodically with the number of send calls and packets per second.
+ *
  * \since 0.3.60
  */
 
@@ -131,6 +147,9 @@ PW_LOG_TOPIC(mod_topic, "mod." NAME);
 #define DEFAULT_TTL		1
 #define DEFAULT_LOOP		false
 #define DEFAULT_DSCP		34 /* Default to AES-67 AF41 (34) */
+#define DEFAULT_SEND_MODE	"single"
+#define DEFAULT_TXTIME_DELAY	1000
+
 
 #define DEFAULT_TS_OFFSET	-1
 
@@ -142,6 +161,9 @@ PW_LOG_TOPIC(mod_topic, "mod." NAME);
 		"( net.ttl=<desired TTL, default:"SPA_STRINGIFY(DEFAULT_TTL)"> ) "			\
 		"( net.loop=<desired loopback, default:"SPA_STRINGIFY(DEFAULT_LOOP)"> ) "		\
 		"( net.dscp=<desired DSCP, default:"SPA_STRINGIFY(DEFAULT_DSCP)"> ) "			\
+		"( net.send-mode=<single|mmsg|gso, default:"DEFAULT_SEND_MODE"> ) "			\
+		"( net.txtime=<launch time with SO_TXTIME, default:false> ) "				\
+		"( net.txtime-delay=<launch delay in usec, default:"SPA_STRINGIFY(DEFAULT_TXTIME_DELAY)"> ) "	\
 		"( sess.name=<a name for the session> ) "						\
 		"( sess.min-ptime=<minimum packet time in milliseconds, default:2> ) "			\
 		"( sess.max-ptime=<maximum packet time in milliseconds, default:20> ) "			\
@@ -194,6 +216,10 @@ struct impl {
 	socklen_t dst_len;
 
 	int rtp_fd;
+	struct pw_net_tx *tx;
+
+	struct spa_source *stats_timer;
+	struct pw_net_stats last_stats;
 };
 
 static bool is_multicast(struct sockaddr *sa, socklen_t salen)
@@ -289,25 +315,30 @@ static inline uint64_t get_time_ns(void)
 	return SPA_TIMESPEC_TO_NSEC(&ts);
 }
 
+static void send_error(struct impl *impl, int res)
+{
+	int suppressed;
+	if ((suppressed = spa_ratelimit_test(&impl->rate_limit, get_time_ns())) >= 0)
+		pw_log_warn("(%d suppressed) sendmsg() failed: %s", suppressed,
+				spa_strerror(res));
+}
+
 static void stream_send_packet(void *data, struct iovec *iov, size_t iovlen)
 {
 	struct impl *impl = data;
-	struct msghdr msg;
 	ssize_t n;
 
-	spa_zero(msg);
-	msg.msg_iov = iov;
-	msg.msg_iovlen = iovlen;
-	msg.msg_control = NULL;
-	msg.msg_controllen = 0;
-	msg.msg_flags = 0;
-
-	n = sendmsg(impl->rtp_fd, &msg, MSG_NOSIGNAL);
-	if (n < 0) {
-		int suppressed;
-		if ((suppressed = spa_ratelimit_test(&impl->rate_limit, get_time_ns())) >= 0)
-			pw_log_warn("(%d suppressed) sendmsg() failed: %m", suppressed);
-	}
+	if ((n = pw_net_tx_send(impl->tx, iov, iovlen)) < 0)
+		send_error(impl, n);
+}
+
+static void stream_flush_packets(void *data)
+{
+	struct impl *impl = data;
+	ssize_t n;
+
+	if ((n = pw_net_tx_flush(impl->tx)) < 0)
+		send_error(impl, n);
 }
 
 static void stream_state_changed(void *data, bool started, const char *error)
@@ -329,7 +360,12 @@ static void stream_state_changed(void *data, bool started, const char *error)
 			return;
 		}
 		impl->rtp_fd = res;
+
+		impl->tx->txtime_period = rtp_stream_get_ptime(impl->stream);
+		if ((res = pw_net_tx_set_fd(impl->tx, impl->rtp_fd)) < 0)
+			pw_log_warn("can't enable txtime: %s", spa_strerror(res));
 	} else {
+		pw_net_tx_set_fd(impl->tx, -1);
 		close(impl->rtp_fd);
 		impl->rtp_fd = -1;
 	}
@@ -420,8 +456,15 @@ static const struct rtp_stream_events stream_events = {
 	.state_changed = stream_state_changed,
 	.param_changed = stream_param_changed,
 	.send_packet = stream_send_packet,
+	.flush_packets = stream_flush_packets,
 };
 
+static void on_stats_timer_event(void *data, uint64_t expirations)
+{
+	struct impl *impl = data;
+	pw_net_stats_update_module(&impl->tx->stats, &impl->last_stats, impl->module);
+}
+
 static void core_destroy(void *d)
 {
 	struct impl *impl = d;
@@ -442,8 +485,13 @@ static void impl_destroy(struct impl *impl)
 	if (impl->core && impl->do_disconnect)
 		pw_core_disconnect(impl->core);
 
+	if (impl->stats_timer)
+		pw_loop_destroy_source(impl->loop, impl->stats_timer);
+
 	if (impl->rtp_fd != -1)
 		close(impl->rtp_fd);
+	if (impl->tx)
+		pw_net_tx_free(impl->tx);
 
 	pw_properties_free(impl->stream_props);
 	pw_properties_free(impl->props);
@@ -501,6 +549,8 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 	int64_t ts_offset;
 	int res = 0;
 	uint32_t header_size;
+	enum pw_net_batch_mode send_mode;
+	struct timespec value, interval;
 
 	PW_LOG_TOPIC_INIT(mod_topic);
 
@@ -596,6 +646,21 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 	impl->mcast_loop = pw_properties_get_bool(props, "net.loop", DEFAULT_LOOP);
 	impl->dscp = pw_properties_get_uint32(props, "net.dscp", DEFAULT_DSCP);
 
+	str = pw_properties_get(props, "net.send-mode");
+	if ((res = pw_net_batch_mode_from_string(str, &send_mode)) < 0) {
+		pw_log_error("invalid net.send-mode %s", str);
+		goto out;
+	}
+	impl->tx = pw_net_tx_new(send_mode);
+	if (impl->tx == NULL) {
+		res = -errno;
+		pw_log_error("can't create sender: %m");
+		goto out;
+	}
+	impl->tx->txtime = pw_properties_get_bool(props, "net.txtime", false);
+	impl->tx->txtime_delay = pw_properties_get_uint32(props, "net.txtime-delay",
+			DEFAULT_TXTIME_DELAY) * SPA_NSEC_PER_USEC;
+
 	ts_offset = pw_properties_get_int64(props, "sess.ts-offset", DEFAULT_TS_OFFSET);
 	if (ts_offset == -1)
 		ts_offset = pw_rand32();
@@ -645,6 +710,16 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 		goto out;
 	}
 
+	impl->stats_timer = pw_loop_add_timer(impl->loop, on_stats_timer_event, impl);
+	if (impl->stats_timer == NULL) {
+		res = -errno;
+		pw_log_error("can't create timer source: %m");
+		goto out;
+	}
+	value.tv_sec = interval.tv_sec = PW_NET_STATS_INTERVAL_SEC;
+	value.tv_nsec = interval.tv_nsec = 0;
+	pw_loop_update_timer(impl->loop, impl->stats_timer, &value, &interval, false);
+
 	pw_impl_module_add_listener(module, &impl->module_listener, &module_events, impl);
 
 	pw_impl_module_update_properties(module, &SPA_DICT_INIT_ARRAY(module_info));
@@ -31,7 +31,9 @@
 #include <pipewire/impl.h>
 
 #include <module-rtp/stream.h>
+#include <module-rtp/demux.h>
 #include "network-utils.h"
+#include "network-batch.h"
 
 /** \page page_module_rtp_source RTP source
  *
@@ -60,6 +62,11 @@
  * - `sess.ts-direct = <bool>`: directly synchronize output against the current
  *                graph driver time, using the RTP timestamps, default false
  * - `stream.may-pause = <bool>`: pause the stream when no data is reveived, default false
+ * - `net.recv-mode = <str>`: how packets are received, `single` uses a recv() per
+ *       packet, `mmsg` receives all pending packets with one recvmmsg(), `gro` lets
+ *       the kernel coalesce packets (UDP_GRO) and splits them again, default `single`
+ * - `net.shared-socket = <bool>`: receive on a socket that is shared with the other
+ *       RTP sources on the same port and interface, default false
  * - `stream.props = {}`: properties to be passed to the stream
  *
  * Set `sess.ts-direct` to true if receivers shall play precisely in sync with the sender even
@@ -70,6 +77,13 @@
  * the receivers and senders have synchronized clocks. In PTP, the reference clocks must then
  * be the same. Otherwise, senders and receives will be out of sync.
  *
+ * With `net.shared-socket`, all RTP sources on the same port, interface and
+ * data loop receive from one socket with one wakeup and one recvmmsg() for all
+ * streams. The packets are passed to the stream by their destination multicast
+ * group or sender address and, when `rtp.receiver-ssrc` is set, their SSRC. The
+ * shared socket uses `mmsg` when `net.recv-mode` is `single`. This reduces the
+ * CPU usage when receiving many streams, for example from \ref page_module_rtp_sap.
+ *
  * ## General options
  *
  * Options with well-known behavior:
@@ -114,6 +128,11 @@
  * ]
  *\endcode
  *
+ * ## Statistics
+ *
+ * The module properties `net.syscalls-per-sec` and `net.packets-per-sec` are
+ * updated periodically with the number of receive calls and packets per second.
+ *
  * \since 0.3.60
  */
 
@@ -126,12 +145,16 @@ PW_LOG_TOPIC(mod_topic, "mod." NAME);
 #define DEFAULT_SOURCE_IP		"224.0.0.56"
 
 #define DEFAULT_TS_OFFSET		-1
+#define DEFAULT_RECV_MODE		"single"
+
 
 #define USAGE   "( local.ifname=<local interface name to use> ) "						\
 		"( source.ip=<source IP address, default:"DEFAULT_SOURCE_IP"> ) "				\
  		"source.port=<int, source port> "								\
 		"( sess.latency.msec=<target network latency, default "SPA_STRINGIFY(DEFAULT_SESS_LATENCY)"> ) "\
 		"( sess.ignore-ssrc=<to ignore SSRC, default false> ) "\
+		"( net.recv-mode=<single|mmsg|gro, default:"DEFAULT_RECV_MODE"> ) "				\
+		"( net.shared-socket=<bool, share the socket with other sources, default false> ) "		\
  		"( sess.media=<string, the media type audio|midi|opus, default audio> ) "			\
 		"( audio.format=<format, default:"DEFAULT_FORMAT"> ) "						\
 		"( audio.rate=<sample rate, default:"SPA_STRINGIFY(DEFAULT_RATE)"> ) "				\
@@ -146,6 +169,8 @@ static const struct spa_dict_item module_info[] = {
 	{ PW_KEY_MODULE_VERSION, PACKAGE_VERSION },
 };
 
+struct receiver;
+
 struct impl {
 	struct pw_impl_module *module;
 	struct spa_hook module_listener;
@@ -179,8 +204,15 @@ struct impl {
 	socklen_t src_len;
 	struct spa_source *source;
 
-	uint8_t *buffer;
-	size_t buffer_size;
+	enum pw_net_batch_mode recv_mode;
+	struct pw_net_rx *rx;
+	struct spa_source *stats_timer;
+	struct pw_net_stats last_stats;
+
+	bool shared_socket;
+	struct receiver *receiver;
+	struct spa_list receiver_link;
+	struct rtp_demux_entry entry;
 
 	bool receiving;
 	bool may_pause;
@@ -216,41 +248,82 @@ static int do_start(struct spa_loop *loop, bool async, uint32_t seq, const void
 	return 0;
 }
 
-static void
-on_rtp_io(void *data, int fd, uint32_t mask)
+static int
+on_rtp_packet(void *data, uint8_t *buffer, size_t len,
+		const struct sockaddr_storage *sa, socklen_t salen)
 {
 	struct impl *impl = data;
-	ssize_t len;
-	int suppressed;
-
-	if (mask & SPA_IO_IN) {
-		if ((len = recv(fd, impl->buffer, impl->buffer_size, 0)) < 0)
-			goto receive_error;
+	int res, suppressed;
 
-		if (len < 12)
-			goto short_packet;
+	if (len < 12)
+		goto short_packet;
 
-		if (SPA_LIKELY(impl->stream)) {
-			if (rtp_stream_receive_packet(impl->stream, impl->buffer, len) < 0)
-				goto receive_error;
-		}
+	if (SPA_LIKELY(impl->stream)) {
+		if ((res = rtp_stream_receive_packet(impl->stream, buffer, len)) < 0)
+			goto receive_error;
+	}
 
-		if (!impl->receiving) {
-			impl->receiving = true;
-			pw_loop_invoke(impl->main_loop, do_start, 1, NULL, 0, false, impl);
-		}
+	if (!impl->receiving) {
+		impl->receiving = true;
+		pw_loop_invoke(impl->main_loop, do_start, 1, NULL, 0, false, impl);
 	}
-	return;
+	return 0;
 
 receive_error:
 	if ((suppressed = spa_ratelimit_test(&impl->rate_limit, get_time_ns())) >= 0)
-		pw_log_warn("(%d suppressed) recv() error: %m", suppressed);
-	return;
+		pw_log_warn("(%d suppressed) recv() error: %s", suppressed,
+				spa_strerror(res));
+	return -EINVAL;
 short_packet:
 	if ((suppressed = spa_ratelimit_test(&impl->rate_limit, get_time_ns())) >= 0)
 		pw_log_warn("(%d suppressed) short packet of len %zd received",
 				suppressed, len);
-	return;
+	return -EINVAL;
+}
+
+static void
+on_rtp_io(void *data, int fd, uint32_t mask)
+{
+	struct impl *impl = data;
+	int res, suppressed;
+
+	if (mask & SPA_IO_IN) {
+		if ((res = pw_net_rx_read(impl->rx, fd, on_rtp_packet, impl)) < 0 &&
+		    res != -EAGAIN) {
+			if ((suppressed = spa_ratelimit_test(&impl->rate_limit, get_time_ns())) >= 0)
+				pw_log_warn("(%d suppressed) recv() error: %s", suppressed,
+						spa_strerror(res));
+		}
+	}
+}
+
+static int mcast_membership(int fd, const struct sockaddr *sa, int ifindex, bool join)
+{
+	char addr[128];
+	int res;
+
+	pw_net_get_ip((struct sockaddr_storage*)sa, addr, sizeof(addr), NULL, NULL);
+	if (sa->sa_family == AF_INET) {
+		struct ip_mreqn mr4;
+		memset(&mr4, 0, sizeof(mr4));
+		mr4.imr_multiaddr = ((struct sockaddr_in*)sa)->sin_addr;
+		mr4.imr_ifindex = ifindex;
+		pw_log_info("%s IPv4 group: %s", join ? "join" : "leave", addr);
+		res = setsockopt(fd, IPPROTO_IP, join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP,
+				&mr4, sizeof(mr4));
+	} else if (sa->sa_family == AF_INET6) {
+		struct ipv6_mreq mr6;
+		memset(&mr6, 0, sizeof(mr6));
+		mr6.ipv6mr_multiaddr = ((struct sockaddr_in6*)sa)->sin6_addr;
+		mr6.ipv6mr_interface = ifindex;
+		pw_log_info("%s IPv6 group: %s", join ? "join" : "leave", addr);
+		res = setsockopt(fd, IPPROTO_IPV6, join ? IPV6_JOIN_GROUP : IPV6_LEAVE_GROUP,
+				&mr6, sizeof(mr6));
+	} else {
+		errno = EINVAL;
+		res = -1;
+	}
+	return res < 0 ? -errno : 0;
 }
 
 static int make_socket(const struct sockaddr* sa, socklen_t salen, char *ifname)
@@ -259,7 +332,6 @@ static int make_socket(const struct sockaddr* sa, socklen_t salen, char *ifname)
 	struct ifreq req;
 	struct sockaddr_storage ba = *(struct sockaddr_storage *)sa;
 	bool do_connect = false;
-	char addr[128];
 
 	af = sa->sa_family;
 	if ((fd = socket(af, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0) {
@@ -294,13 +366,7 @@ static int make_socket(const struct sockaddr* sa, socklen_t salen, char *ifname)
 		static const uint32_t ipv4_mcast_mask = 0xe0000000;
 		struct sockaddr_in *sa4 = (struct sockaddr_in*)sa;
 		if ((ntohl(sa4->sin_addr.s_addr) & ipv4_mcast_mask) == ipv4_mcast_mask) {
-			struct ip_mreqn mr4;
-			memset(&mr4, 0, sizeof(mr4));
-			mr4.imr_multiaddr = sa4->sin_addr;
-			mr4.imr_ifindex = req.ifr_ifindex;
-			pw_net_get_ip((struct sockaddr_storage*)sa, addr, sizeof(addr), NULL, NULL);
-			pw_log_info("join IPv4 group: %s", addr);
-			res = setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mr4, sizeof(mr4));
+			res = mcast_membership(fd, sa, req.ifr_ifindex, true);
 		} else {
 			struct sockaddr_in *ba4 = (struct sockaddr_in*)&ba;
 			if (ba4->sin_addr.s_addr != INADDR_ANY) {
@@ -311,13 +377,7 @@ static int make_socket(const struct sockaddr* sa, socklen_t salen, char *ifname)
 	} else if (af == AF_INET6) {
 		struct sockaddr_in6 *sa6 = (struct sockaddr_in6*)sa;
 		if (sa6->sin6_addr.s6_addr[0] == 0xff) {
-			struct ipv6_mreq mr6;
-			memset(&mr6, 0, sizeof(mr6));
-			mr6.ipv6mr_multiaddr = sa6->sin6_addr;
-			mr6.ipv6mr_interface = req.ifr_ifindex;
-			pw_net_get_ip((struct sockaddr_storage*)sa, addr, sizeof(addr), NULL, NULL);
-			pw_log_info("join IPv6 group: %s", addr);
-			res = setsockopt(fd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mr6, sizeof(mr6));
+			res = mcast_membership(fd, sa, req.ifr_ifindex, true);
 		} else {
 			struct sockaddr_in6 *ba6 = (struct sockaddr_in6*)&ba;
 			ba6->sin6_addr = in6addr_any;
@@ -328,8 +388,7 @@ static int make_socket(const struct sockaddr* sa, socklen_t salen, char *ifname)
 	}
 
 	if (res < 0) {
-		res = -errno;
-		pw_log_error("join mcast failed: %m");
+		pw_log_error("join mcast failed: %s", spa_strerror(res));
 		goto error;
 	}
 
@@ -351,6 +410,300 @@ error:
 	return res;
 }
 
+/* A socket that is shared by all sources on the same port, interface and
+ * data loop. The packets are passed to the sources with the demuxer. The
+ * receiver is created and destroyed from the main thread, the demuxer is
+ * updated with the data loop locked. */
+struct receiver {
+	struct spa_list link;
+	int ref;
+
+	struct pw_loop *data_loop;
+	char *ifname;
+	int family;
+	uint16_t port;
+	int ifindex;
+
+	int fd;
+	struct spa_source *source;
+	struct pw_net_rx *rx;
+	struct rtp_demux demux;
+	struct spa_list members;
+
+	struct spa_ratelimit rate_limit;
+};
+
+static struct spa_list receivers = SPA_LIST_INIT(&receivers);
+
+static int
+on_receiver_packet(void *data, uint8_t *buffer, size_t len,
+		const struct sockaddr_storage *sa, socklen_t salen)
+{
+	struct receiver *r = data;
+	struct sockaddr_storage dst;
+	struct rtp_demux_entry *e;
+	uint32_t ssrc;
+	bool have_dst;
+	int suppressed;
+
+	if (len < 12) {
+		if ((suppressed = spa_ratelimit_test(&r->rate_limit, get_time_ns())) >= 0)
+			pw_log_warn("(%d suppressed) short packet of len %zd received",
+					suppressed, len);
+		return -EINVAL;
+	}
+	memcpy(&ssrc, &buffer[8], sizeof(ssrc));
+	ssrc = ntohl(ssrc);
+
+	have_dst = pw_net_rx_get_dst(r->rx, &dst) == 0;
+
+	e = rtp_demux_find(&r->demux, have_dst ? &dst : NULL, sa, ssrc);
+	if (SPA_UNLIKELY(e == NULL)) {
+		if ((suppressed = spa_ratelimit_test(&r->rate_limit, get_time_ns())) >= 0)
+			pw_log_info("(%d suppressed) no source for packet with SSRC %u",
+					suppressed, ssrc);
+		return 0;
+	}
+	return on_rtp_packet(e->data, buffer, len, sa, salen);
+}
+
+static void
+on_receiver_io(void *data, int fd, uint32_t mask)
+{
+	struct receiver *r = data;
+	int res, suppressed;
+
+	if (mask & SPA_IO_IN) {
+		if ((res = pw_net_rx_read(r->rx, fd, on_receiver_packet, r)) < 0 &&
+		    res != -EAGAIN) {
+			if ((suppressed = spa_ratelimit_test(&r->rate_limit, get_time_ns())) >= 0)
+				pw_log_warn("(%d suppressed) recv() error: %s", suppressed,
+						spa_strerror(res));
+		}
+	}
+}
+
+static int make_shared_socket(int family, uint16_t port, const char *ifname, int *ifindex)
+{
+	struct sockaddr_storage ba;
+	struct ifreq req;
+	socklen_t salen;
+	int fd, val, res;
+
+	if ((fd = socket(family, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0) {
+		res = -errno;
+		pw_log_error("socket failed: %m");
+		return res;
+	}
+	val = 1;
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val)) < 0) {
+		res = -errno;
+		pw_log_error("setsockopt failed: %m");
+		goto error;
+	}
+	if ((res = pw_net_rx_enable_pktinfo(fd, family)) < 0) {
+		pw_log_error("can't enable packet info: %s", spa_strerror(res));
+		goto error;
+	}
+
+	spa_zero(req);
+	if (ifname) {
+		snprintf(req.ifr_name, sizeof(req.ifr_name), "%s", ifname);
+		if (ioctl(fd, SIOCGIFINDEX, &req) < 0)
+			pw_log_warn("SIOCGIFINDEX %s failed: %m", ifname);
+	}
+	*ifindex = req.ifr_ifindex;
+
+	spa_zero(ba);
+	if (family == AF_INET) {
+		struct sockaddr_in *ba4 = (struct sockaddr_in*)&ba;
+		ba4->sin_family = AF_INET;
+		ba4->sin_port = htons(port);
+		ba4->sin_addr.s_addr = INADDR_ANY;
+		salen = sizeof(*ba4);
+	} else if (family == AF_INET6) {
+		struct sockaddr_in6 *ba6 = (struct sockaddr_in6*)&ba;
+		ba6->sin6_family = AF_INET6;
+		ba6->sin6_port = htons(port);
+		ba6->sin6_addr = in6addr_any;
+		salen = sizeof(*ba6);
+	} else {
+		res = -EINVAL;
+		goto error;
+	}
+	if (bind(fd, (struct sockaddr*)&ba, salen) < 0) {
+		res = -errno;
+		pw_log_error("bind() failed: %m");
+		goto error;
+	}
+	return fd;
+error:
+	close(fd);
+	return res;
+}
+
+static void receiver_unref(struct receiver *r)
+{
+	if (--r->ref > 0)
+		return;
+
+	pw_log_info("destroy shared RTP receiver on port %u", r->port);
+	spa_list_remove(&r->link);
+	if (r->source)
+		pw_loop_destroy_source(r->data_loop, r->source);
+	if (r->fd >= 0)
+		close(r->fd);
+	if (r->rx)
+		pw_net_rx_free(r->rx);
+	free(r->ifname);
+	free(r);
+}
+
+static struct receiver *receiver_ref(struct impl *impl)
+{
+	struct receiver *r;
+	int family = impl->src_addr.ss_family;
+	enum pw_net_batch_mode mode;
+	int res;
+
+	spa_list_for_each(r, &receivers, link) {
+		if (r->data_loop == impl->data_loop && r->family == family &&
+		    r->port == impl->src_port && spa_streq(r->ifname, impl->ifname)) {
+			r->ref++;
+			return r;
+		}
+	}
+
+	if ((r = calloc(1, sizeof(*r))) == NULL)
+		return NULL;
+
+	r->ref = 1;
+	r->data_loop = impl->data_loop;
+	r->ifname = impl->ifname ? strdup(impl->ifname) : NULL;
+	r->family = family;
+	r->port = impl->src_port;
+	r->fd = -1;
+	r->rate_limit.interval = 2 * SPA_NSEC_PER_SEC;
+	r->rate_limit.burst = 1;
+	rtp_demux_init(&r->demux);
+	spa_list_init(&r->members);
+	spa_list_append(&receivers, &r->link);
+
+	if ((res = make_shared_socket(family, r->port, r->ifname, &r->ifindex)) < 0)
+		goto error;
+	r->fd = res;
+
+	/* the point of sharing is to receive many packets at once */
+	mode = impl->recv_mode == PW_NET_BATCH_SINGLE ? PW_NET_BATCH_MMSG : impl->recv_mode;
+	if ((r->rx = pw_net_rx_new(mode, rtp_stream_get_mtu(impl->stream))) == NULL) {
+		res = -errno;
+		goto error;
+	}
+	if (pw_net_rx_set_fd(r->rx, r->fd) < 0)
+		pw_log_warn("can't enable UDP_GRO, using recvmmsg()");
+
+	r->source = pw_loop_add_io(r->data_loop, r->fd,
+				SPA_IO_IN, false, on_receiver_io, r);
+	if (r->source == NULL) {
+		res = -errno;
+		pw_log_error("can't create io source: %m");
+		goto error;
+	}
+	pw_log_info("created shared RTP receiver on port %u", r->port);
+	return r;
+error:
+	receiver_unref(r);
+	errno = -res;
+	return NULL;
+}
+
+static bool receiver_has_group(struct receiver *r, struct impl *impl)
+{
+	struct impl *i;
+	spa_list_for_each(i, &r->members, receiver_link) {
+		if (i != impl && rtp_demux_addr_equal(&i->src_addr, &impl->src_addr))
+			return true;
+	}
+	return false;
+}
+
+static int do_add_entry(struct spa_loop *loop, bool async, uint32_t seq, const void *data,
+		size_t size, void *user_data)
+{
+	struct impl *impl = user_data;
+	struct receiver *r = impl->receiver;
+	int res;
+
+	/* the streams on the socket can have a different MTU, make room for
+	 * the packets of all of them */
+	if ((res = pw_net_rx_resize(r->rx, rtp_stream_get_mtu(impl->stream))) < 0)
+		return res;
+	rtp_demux_add(&r->demux, &impl->entry);
+	return 0;
+}
+
+static int do_remove_entry(struct spa_loop *loop, bool async, uint32_t seq, const void *data,
+		size_t size, void *user_data)
+{
+	struct impl *impl = user_data;
+	rtp_demux_remove(&impl->receiver->demux, &impl->entry);
+	return 0;
+}
+
+static int receiver_join(struct impl *impl)
+{
+	struct receiver *r;
+	int res;
+
+	if ((r = receiver_ref(impl)) == NULL)
+		return -errno;
+
+	if (rtp_demux_addr_is_multicast(&impl->src_addr) && !receiver_has_group(r, impl)) {
+		if ((res = mcast_membership(r->fd, (struct sockaddr*)&impl->src_addr,
+						r->ifindex, true)) < 0) {
+			pw_log_error("join mcast failed: %s", spa_strerror(res));
+			receiver_unref(r);
+			errno = -res;
+			return res;
+		}
+	}
+
+	impl->receiver = r;
+	impl->entry.addr = impl->src_addr;
+	impl->entry.data = impl;
+	if ((res = pw_loop_locked(r->data_loop, do_add_entry, 0, NULL, 0, impl)) < 0) {
+		pw_log_error("can't add stream to shared receiver: %s", spa_strerror(res));
+		if (rtp_demux_addr_is_multicast(&impl->src_addr) && !receiver_has_group(r, impl))
+			mcast_membership(r->fd, (struct sockaddr*)&impl->src_addr, r->ifindex, false);
+		impl->receiver = NULL;
+		receiver_unref(r);
+		errno = -res;
+		return res;
+	}
+	spa_list_append(&r->members, &impl->receiver_link);
+
+	pw_log_info("joined shared RTP receiver on port %u, %u streams",
+			r->port, r->demux.n_entries);
+	return 0;
+}
+
+static void receiver_leave(struct impl *impl)
+{
+	struct receiver *r = impl->receiver;
+
+	if (r == NULL)
+		return;
+
+	pw_loop_locked(r->data_loop, do_remove_entry, 0, NULL, 0, impl);
+	spa_list_remove(&impl->receiver_link);
+
+	if (rtp_demux_addr_is_multicast(&impl->src_addr) && !receiver_has_group(r, impl))
+		mcast_membership(r->fd, (struct sockaddr*)&impl->src_addr, r->ifindex, false);
+
+	impl->receiver = NULL;
+	receiver_unref(r);
+}
+
 static int stream_start(struct impl *impl);
 
 static void on_stream_start_retry_timer_event(void *data, uint64_t expirations)
@@ -370,15 +723,19 @@ static void destroy_stream_start_retry_timer(struct impl *impl)
 
 static int stream_start(struct impl *impl)
 {
-	int fd;
+	int fd, res;
 
-	if (impl->source != NULL)
+	if (impl->source != NULL || impl->receiver != NULL)
 		return 0;
 
 	pw_log_info("starting RTP listener");
 
-	if ((fd = make_socket((const struct sockaddr *)&impl->src_addr,
-					impl->src_len, impl->ifname)) < 0) {
+	if (impl->shared_socket)
+		res = fd = receiver_join(impl);
+	else
+		res = fd = make_socket((const struct sockaddr *)&impl->src_addr,
+					impl->src_len, impl->ifname);
+	if (res < 0) {
 		/* If make_socket() tries to create a socket and join to a multicast
 		 * group while the network interfaces are not ready yet to do so
 		 * (usually because a network manager component is still setting up
@@ -426,6 +783,12 @@ static int stream_start(struct impl *impl)
 	 * the socket creation succeeded. */
 	destroy_stream_start_retry_timer(impl);
 
+	if (impl->shared_socket)
+		return 0;
+
+	if (pw_net_rx_set_fd(impl->rx, fd) < 0)
+		pw_log_warn("can't enable UDP_GRO, using recvmmsg()");
+
 	impl->source = pw_loop_add_io(impl->data_loop, fd,
 				SPA_IO_IN, true, on_rtp_io, impl);
 	if (impl->source == NULL) {
@@ -438,15 +801,17 @@ static int stream_start(struct impl *impl)
 
 static void stream_stop(struct impl *impl)
 {
-	if (!impl->source)
+	if (!impl->source && !impl->receiver)
 		return;
 
 	pw_log_info("stopping RTP listener");
 
 	destroy_stream_start_retry_timer(impl);
 
-	pw_loop_destroy_source(impl->data_loop, impl->source);
+	if (impl->source)
+		pw_loop_destroy_source(impl->data_loop, impl->source);
 	impl->source = NULL;
+	receiver_leave(impl);
 }
 
 static void stream_destroy(void *d)
@@ -542,6 +907,15 @@ static const struct rtp_stream_events stream_events = {
 	.param_changed = stream_param_changed,
 };
 
+static void on_stats_timer_event(void *data, uint64_t expirations)
+{
+	struct impl *impl = data;
+	struct pw_net_rx *rx = impl->receiver ? impl->receiver->rx : impl->rx;
+
+	if (rx != NULL)
+		pw_net_stats_update_module(&rx->stats, &impl->last_stats, impl->module);
+}
+
 static void on_standby_timer_event(void *data, uint64_t expirations)
 {
 	struct impl *impl = data;
@@ -588,12 +962,15 @@ static void impl_destroy(struct impl *impl)
 		rtp_stream_destroy(impl->stream);
 	if (impl->source)
 		pw_loop_destroy_source(impl->data_loop, impl->source);
+	receiver_leave(impl);
 
 	if (impl->core && impl->do_disconnect)
 		pw_core_disconnect(impl->core);
 
 	if (impl->standby_timer)
 		pw_loop_destroy_source(impl->main_loop, impl->standby_timer);
+	if (impl->stats_timer)
+		pw_loop_destroy_source(impl->main_loop, impl->stats_timer);
 
 	destroy_stream_start_retry_timer(impl);
 
@@ -603,7 +980,8 @@ static void impl_destroy(struct impl *impl)
 	pw_properties_free(impl->stream_props);
 	pw_properties_free(impl->props);
 
-	free(impl->buffer);
+	if (impl->rx)
+		pw_net_rx_free(impl->rx);
 	free(impl->ifname);
 	free(impl);
 }
@@ -807,13 +1185,31 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 		goto out;
 	}
 
-	impl->buffer_size = rtp_stream_get_mtu(impl->stream);
-	impl->buffer = calloc(1, impl->buffer_size);
-	if (impl->buffer == NULL) {
+	str = pw_properties_get(props, "net.recv-mode");
+	if ((res = pw_net_batch_mode_from_string(str, &impl->recv_mode)) < 0) {
+		pw_log_error("invalid net.recv-mode %s", str);
+		goto out;
+	}
+	impl->shared_socket = pw_properties_get_bool(props, "net.shared-socket", false);
+	impl->entry.have_ssrc = pw_properties_fetch_uint32(props, "rtp.receiver-ssrc",
+			&impl->entry.ssrc) == 0;
+
+	if (!impl->shared_socket &&
+	    (impl->rx = pw_net_rx_new(impl->recv_mode, rtp_stream_get_mtu(impl->stream))) == NULL) {
 		res = -errno;
-		pw_log_error("can't create packet buffer of size %zd: %m", impl->buffer_size);
+		pw_log_error("can't create packet buffers: %m");
+		goto out;
+	}
+
+	impl->stats_timer = pw_loop_add_timer(impl->main_loop, on_stats_timer_event, impl);
+	if (impl->stats_timer == NULL) {
+		res = -errno;
+		pw_log_error("can't create timer source: %m");
 		goto out;
 	}
+	value.tv_sec = interval.tv_sec = PW_NET_STATS_INTERVAL_SEC;
+	value.tv_nsec = interval.tv_nsec = 0;
+	pw_loop_update_timer(impl->main_loop, impl->stats_timer, &value, &interval, false);
 
 	pw_impl_module_add_listener(module, &impl->module_listener, &module_events, impl);
 
@@ -285,6 +285,7 @@ static void rtp_audio_flush_packets(struct impl *impl, uint32_t num_packets, uin
 		avail -= tosend;
 		num_packets--;
 	}
+	rtp_stream_emit_flush_packets(impl);
 	spa_ringbuffer_read_update(&impl->ring, timestamp);
 done:
 	if (impl->timer_running) {
@@ -0,0 +1,268 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/ringbuffer.h>
+
+#include "../network-batch.h"
+#include "demux.h"
+
+/* Replays synthetic RTP streams over the loopback interface and measures
+ * the receive cost per packet with one socket per stream and with one
+ * shared socket that demultiplexes on the SSRC. */
+
+#define MAX_STREAMS	64
+#define PAYLOAD_SIZE	288	/* 1ms of 48KHz stereo S24 */
+#define PACKET_SIZE	(12 + PAYLOAD_SIZE)
+#define RING_SIZE	(64 * 1024)
+#define RING_MASK	(RING_SIZE - 1)
+#define ROUNDS		2000
+
+struct stream {
+	struct spa_ringbuffer ring;
+	uint8_t buffer[RING_SIZE];
+	uint32_t ssrc;
+	uint64_t packets;
+	struct rtp_demux_entry entry;
+	int fd;
+	struct sockaddr_in addr;
+};
+
+static struct stream streams[MAX_STREAMS];
+static uint8_t packet[PACKET_SIZE];
+static uint64_t syscalls;
+
+static uint64_t get_cpu_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void stream_write(struct stream *s, const uint8_t *data, size_t len)
+{
+	uint32_t index;
+
+	spa_ringbuffer_get_write_index(&s->ring, &index);
+	spa_ringbuffer_write_data(&s->ring, s->buffer, RING_SIZE,
+			index & RING_MASK, data + 12, len - 12);
+	index += len - 12;
+	spa_ringbuffer_write_update(&s->ring, index);
+	/* the consumer keeps up */
+	spa_ringbuffer_read_update(&s->ring, index);
+	s->packets++;
+}
+
+static int make_socket(struct sockaddr_in *addr)
+{
+	socklen_t len = sizeof(*addr);
+	int fd, val = 4 * 1024 * 1024;
+
+	if ((fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0)
+		return -errno;
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &val, sizeof(val));
+
+	spa_zero(*addr);
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr*)addr, sizeof(*addr)) < 0 ||
+	    getsockname(fd, (struct sockaddr*)addr, &len) < 0) {
+		close(fd);
+		return -errno;
+	}
+	return fd;
+}
+
+static void send_round(int fd, uint32_t n_streams, bool shared, struct sockaddr_in *shared_addr)
+{
+	uint32_t i, ssrc;
+
+	for (i = 0; i < n_streams; i++) {
+		struct stream *s = &streams[i];
+		struct sockaddr_in *to = shared ? shared_addr : &s->addr;
+
+		ssrc = htonl(s->ssrc);
+		memcpy(&packet[8], &ssrc, sizeof(ssrc));
+		if (sendto(fd, packet, PACKET_SIZE, 0, (struct sockaddr*)to, sizeof(*to)) < 0)
+			perror("sendto");
+	}
+}
+
+static uint64_t run_per_stream(int tx, uint32_t n_streams)
+{
+	struct pollfd pfd[MAX_STREAMS];
+	uint8_t buffer[2048];
+	uint64_t t, total = 0;
+	uint32_t i, r, n;
+	ssize_t len;
+
+	for (i = 0; i < n_streams; i++) {
+		streams[i].fd = make_socket(&streams[i].addr);
+		pfd[i].fd = streams[i].fd;
+		pfd[i].events = POLLIN;
+	}
+	for (r = 0; r < ROUNDS; r++) {
+		send_round(tx, n_streams, false, NULL);
+
+		t = get_cpu_time_ns();
+		for (n = 0; n < n_streams;) {
+			if (poll(pfd, n_streams, 1000) <= 0)
+				break;
+			syscalls++;
+			/* every socket is a wakeup and a recv() */
+			for (i = 0; i < n_streams; i++) {
+				if (!(pfd[i].revents & POLLIN))
+					continue;
+				len = recv(pfd[i].fd, buffer, sizeof(buffer), 0);
+				syscalls++;
+				if (len >= 12) {
+					stream_write(&streams[i], buffer, len);
+					n++;
+				}
+			}
+		}
+		total += get_cpu_time_ns() - t;
+	}
+	for (i = 0; i < n_streams; i++)
+		close(streams[i].fd);
+	return total;
+}
+
+struct shared {
+	struct pw_net_rx *rx;
+	struct rtp_demux demux;
+	uint32_t n;
+};
+
+static int on_packet(void *data, uint8_t *buffer, size_t len,
+		const struct sockaddr_storage *sa, socklen_t salen)
+{
+	struct shared *sh = data;
+	struct sockaddr_storage dst;
+	struct rtp_demux_entry *e;
+	uint32_t ssrc;
+	bool have_dst;
+
+	if (len < 12)
+		return -EINVAL;
+	memcpy(&ssrc, &buffer[8], sizeof(ssrc));
+	have_dst = pw_net_rx_get_dst(sh->rx, &dst) == 0;
+	if ((e = rtp_demux_find(&sh->demux, have_dst ? &dst : NULL, sa, ntohl(ssrc))) == NULL)
+		return 0;
+	stream_write(e->data, buffer, len);
+	sh->n++;
+	return 0;
+}
+
+static uint64_t run_shared(int tx, uint32_t n_streams)
+{
+	struct sockaddr_in addr;
+	struct pollfd pfd;
+	struct shared sh;
+	uint64_t t, total = 0;
+	uint32_t i, r;
+	int fd, res;
+
+	fd = make_socket(&addr);
+	pw_net_rx_enable_pktinfo(fd, AF_INET);
+
+	sh.rx = pw_net_rx_new(PW_NET_BATCH_MMSG, PACKET_SIZE);
+	rtp_demux_init(&sh.demux);
+	for (i = 0; i < n_streams; i++) {
+		struct stream *s = &streams[i];
+		spa_zero(s->entry);
+		s->entry.addr.ss_family = AF_INET;
+		s->entry.ssrc = s->ssrc;
+		s->entry.have_ssrc = true;
+		s->entry.data = s;
+		rtp_demux_add(&sh.demux, &s->entry);
+	}
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	for (r = 0; r < ROUNDS; r++) {
+		send_round(tx, n_streams, true, &addr);
+
+		t = get_cpu_time_ns();
+		for (sh.n = 0; sh.n < n_streams;) {
+			if (poll(&pfd, 1, 1000) <= 0)
+				break;
+			syscalls++;
+			/* one wakeup and one recvmmsg() for all streams */
+			res = pw_net_rx_read(sh.rx, fd, on_packet, &sh);
+			syscalls++;
+			if (res < 0 && res != -EAGAIN)
+				break;
+		}
+		total += get_cpu_time_ns() - t;
+	}
+	pw_net_rx_free(sh.rx);
+	close(fd);
+	return total;
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t counts[] = { 1, 4, 16, 64 };
+	struct sockaddr_in addr;
+	uint64_t t;
+	uint32_t i, j;
+	int tx;
+
+	if ((tx = make_socket(&addr)) < 0) {
+		fprintf(stderr, "can't make socket: %s\n", strerror(-tx));
+		return 77;
+	}
+	packet[0] = 0x80;
+	packet[1] = 96;
+	for (i = 0; i < MAX_STREAMS; i++)
+		streams[i].ssrc = 0x10000 + i * 7919;
+
+	printf("%8s %12s %12s %12s %12s\n", "streams",
+			"ns/pkt", "sys/pkt", "shared ns/pkt", "sys/pkt");
+
+	SPA_FOR_EACH_ELEMENT_VAR(counts, c) {
+		uint32_t n_streams = *c;
+		double packets = (double)n_streams * ROUNDS;
+		double per_stream, per_stream_sys, shared, shared_sys;
+
+		for (j = 0; j < n_streams; j++) {
+			spa_ringbuffer_init(&streams[j].ring);
+			streams[j].packets = 0;
+		}
+
+		syscalls = 0;
+		t = run_per_stream(tx, n_streams);
+		per_stream = t / packets;
+		per_stream_sys = syscalls / packets;
+
+		syscalls = 0;
+		t = run_shared(tx, n_streams);
+		shared = t / packets;
+		shared_sys = syscalls / packets;
+
+		for (j = 0; j < n_streams; j++) {
+			if (streams[j].packets != 2 * ROUNDS)
+				fprintf(stderr, "stream %u: received %"PRIu64" of %u packets\n",
+						j, streams[j].packets, 2 * ROUNDS);
+		}
+
+		printf("%8u %12.1f %12.2f %12.1f %12.2f\n", n_streams,
+				per_stream, per_stream_sys, shared, shared_sys);
+	}
+	close(tx);
+	return 0;
+}
@@ -0,0 +1,171 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef PIPEWIRE_RTP_DEMUX_H
+#define PIPEWIRE_RTP_DEMUX_H
+
+#include <string.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/list.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Demultiplex packets from one socket to the streams that receive them.
+ *
+ * An entry matches on an address and optionally on an SSRC. A multicast
+ * address is compared with the destination address of the packet, any
+ * other address with the sender address. An entry with the any address
+ * matches all packets.
+ *
+ * Entries with an SSRC are looked up first, then entries on the address
+ * and then the entries with the any address. Adding and removing entries
+ * is not thread-safe with rtp_demux_find().
+ */
+
+#define RTP_DEMUX_BUCKETS	64
+
+struct rtp_demux_entry {
+	struct spa_list link;
+	struct sockaddr_storage addr;
+	uint32_t ssrc;
+	unsigned int have_ssrc:1;
+	void *data;
+};
+
+struct rtp_demux {
+	struct spa_list ssrc[RTP_DEMUX_BUCKETS];
+	struct spa_list addr[RTP_DEMUX_BUCKETS];
+	struct spa_list any;
+	uint32_t n_entries;
+};
+
+static inline void rtp_demux_init(struct rtp_demux *demux)
+{
+	uint32_t i;
+	for (i = 0; i < RTP_DEMUX_BUCKETS; i++) {
+		spa_list_init(&demux->ssrc[i]);
+		spa_list_init(&demux->addr[i]);
+	}
+	spa_list_init(&demux->any);
+	demux->n_entries = 0;
+}
+
+static inline bool rtp_demux_addr_is_any(const struct sockaddr_storage *sa)
+{
+	if (sa->ss_family == AF_INET)
+		return ((const struct sockaddr_in*)sa)->sin_addr.s_addr == INADDR_ANY;
+	if (sa->ss_family == AF_INET6)
+		return IN6_IS_ADDR_UNSPECIFIED(&((const struct sockaddr_in6*)sa)->sin6_addr);
+	return true;
+}
+
+static inline bool rtp_demux_addr_is_multicast(const struct sockaddr_storage *sa)
+{
+	if (sa->ss_family == AF_INET)
+		return IN_MULTICAST(ntohl(((const struct sockaddr_in*)sa)->sin_addr.s_addr));
+	if (sa->ss_family == AF_INET6)
+		return IN6_IS_ADDR_MULTICAST(&((const struct sockaddr_in6*)sa)->sin6_addr);
+	return false;
+}
+
+/* compare the addresses, not the ports */
+static inline bool rtp_demux_addr_equal(const struct sockaddr_storage *a,
+		const struct sockaddr_storage *b)
+{
+	if (a->ss_family != b->ss_family)
+		return false;
+	if (a->ss_family == AF_INET)
+		return ((const struct sockaddr_in*)a)->sin_addr.s_addr ==
+			((const struct sockaddr_in*)b)->sin_addr.s_addr;
+	if (a->ss_family == AF_INET6)
+		return IN6_ARE_ADDR_EQUAL(&((const struct sockaddr_in6*)a)->sin6_addr,
+				&((const struct sockaddr_in6*)b)->sin6_addr);
+	return false;
+}
+
+static inline uint32_t rtp_demux_addr_hash(const struct sockaddr_storage *sa)
+{
+	uint32_t h = 0;
+	if (sa->ss_family == AF_INET) {
+		h = ((const struct sockaddr_in*)sa)->sin_addr.s_addr;
+	} else if (sa->ss_family == AF_INET6) {
+		const uint32_t *a = (const uint32_t*)&((const struct sockaddr_in6*)sa)->sin6_addr;
+		h = a[0] ^ a[1] ^ a[2] ^ a[3];
+	}
+	return (h * 0x9e3779b1u) >> 26;
+}
+
+static inline uint32_t rtp_demux_ssrc_hash(uint32_t ssrc)
+{
+	return (ssrc * 0x9e3779b1u) >> 26;
+}
+
+static inline void rtp_demux_add(struct rtp_demux *demux, struct rtp_demux_entry *entry)
+{
+	if (entry->have_ssrc)
+		spa_list_append(&demux->ssrc[rtp_demux_ssrc_hash(entry->ssrc)], &entry->link);
+	else if (rtp_demux_addr_is_any(&entry->addr))
+		spa_list_append(&demux->any, &entry->link);
+	else
+		spa_list_append(&demux->addr[rtp_demux_addr_hash(&entry->addr)], &entry->link);
+	demux->n_entries++;
+}
+
+static inline void rtp_demux_remove(struct rtp_demux *demux, struct rtp_demux_entry *entry)
+{
+	spa_list_remove(&entry->link);
+	demux->n_entries--;
+}
+
+static inline bool rtp_demux_entry_match(const struct rtp_demux_entry *e,
+		const struct sockaddr_storage *dst, const struct sockaddr_storage *src)
+{
+	if (rtp_demux_addr_is_any(&e->addr))
+		return true;
+	if (rtp_demux_addr_is_multicast(&e->addr))
+		return dst != NULL && rtp_demux_addr_equal(&e->addr, dst);
+	return rtp_demux_addr_equal(&e->addr, src);
+}
+
+/* Find the entry for a packet. dst is the destination address of the
+ * packet or NULL when unknown, src the sender address and ssrc the SSRC
+ * in host byte order. */
+static inline struct rtp_demux_entry *rtp_demux_find(struct rtp_demux *demux,
+		const struct sockaddr_storage *dst, const struct sockaddr_storage *src,
+		uint32_t ssrc)
+{
+	struct rtp_demux_entry *e;
+
+	spa_list_for_each(e, &demux->ssrc[rtp_demux_ssrc_hash(ssrc)], link)
+		if (e->ssrc == ssrc && rtp_demux_entry_match(e, dst, src))
+			return e;
+
+	if (dst != NULL && rtp_demux_addr_is_multicast(dst)) {
+		spa_list_for_each(e, &demux->addr[rtp_demux_addr_hash(dst)], link)
+			if (rtp_demux_addr_equal(&e->addr, dst))
+				return e;
+	}
+	spa_list_for_each(e, &demux->addr[rtp_demux_addr_hash(src)], link)
+		if (rtp_demux_addr_equal(&e->addr, src))
+			return e;
+
+	spa_list_for_each(e, &demux->any, link)
+		return e;
+
+	return NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PIPEWIRE_RTP_DEMUX_H */
@@ -469,8 +469,10 @@ static void rtp_midi_flush_packets(struct impl *impl,
 			len = 0;
 		}
 		if (size > BUFFER_SIZE || len > BUFFER_SIZE - size) {
+			/* send what we have, the packets of this cycle are
+			 * flushed below */
 			pw_log_error("Buffer overflow prevented!");
-			return; // FIXME: what to do instead?
+			break;
 		}
 		if (len == 0) {
 			/* start new packet */
@@ -504,6 +506,7 @@ static void rtp_midi_flush_packets(struct impl *impl,
 		rtp_stream_emit_send_packet(impl, iov, 3);
 		impl->seq++;
 	}
+	rtp_stream_emit_flush_packets(impl);
 }
 
 static void rtp_midi_process_capture(void *data)
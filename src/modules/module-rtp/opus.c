@@ -255,6 +255,7 @@ static void rtp_opus_flush_packets(struct impl *impl)
 		offset += tosend;
 		avail -= tosend;
 	}
+	rtp_stream_emit_flush_packets(impl);
 
 	pw_log_trace("move %d offset:%d", avail, offset);
 	memmove(impl->buffer, &impl->buffer[offset * stride], avail * stride);
@@ -41,6 +41,7 @@ PW_LOG_TOPIC_EXTERN(mod_topic);
 #define rtp_stream_emit_param_changed(s,i,p)	rtp_stream_emit(s, param_changed,0,i,p)
 #define rtp_stream_emit_send_packet(s,i,l)	rtp_stream_emit(s, send_packet,0,i,l)
 #define rtp_stream_emit_send_feedback(s,seq)	rtp_stream_emit(s, send_feedback,0,seq)
+#define rtp_stream_emit_flush_packets(s)	rtp_stream_emit(s, flush_packets,0)
 
 struct impl {
 	struct spa_audio_info info;
@@ -681,6 +682,14 @@ size_t rtp_stream_get_mtu(struct rtp_stream *s)
 	return impl->mtu;
 }
 
+uint64_t rtp_stream_get_ptime(struct rtp_stream *s)
+{
+	struct impl *impl = (struct impl*)s;
+	if (impl->rate == 0)
+		return 0;
+	return (uint64_t)impl->psamples * SPA_NSEC_PER_SEC / impl->rate;
+}
+
 void rtp_stream_set_first(struct rtp_stream *s)
 {
 	struct impl *impl = (struct impl*)s;
@@ -42,6 +42,9 @@ struct rtp_stream_events {
 	void (*send_packet) (void *data, struct iovec *iov, size_t iovlen);
 
 	void (*send_feedback) (void *data, uint32_t seqnum);
+
+	/* all packets of a flush were emitted with send_packet */
+	void (*flush_packets) (void *data);
 };
 
 struct rtp_stream *rtp_stream_new(struct pw_core *core,
@@ -60,6 +63,9 @@ uint16_t rtp_stream_get_seq(struct rtp_stream *s);
 
 size_t rtp_stream_get_mtu(struct rtp_stream *s);
 
+/* time between two packets in nanoseconds */
+uint64_t rtp_stream_get_ptime(struct rtp_stream *s);
+
 void rtp_stream_set_first(struct rtp_stream *s);
 
 int rtp_stream_set_active(struct rtp_stream *s, bool active);
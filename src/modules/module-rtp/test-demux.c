@@ -0,0 +1,146 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdio.h>
+
+#include <spa/utils/defs.h>
+
+#include "demux.h"
+
+static void make_addr(struct sockaddr_storage *sa, const char *addr)
+{
+	spa_zero(*sa);
+	if (strchr(addr, ':') != NULL) {
+		struct sockaddr_in6 *sa6 = (struct sockaddr_in6*)sa;
+		sa6->sin6_family = AF_INET6;
+		spa_assert_se(inet_pton(AF_INET6, addr, &sa6->sin6_addr) == 1);
+	} else {
+		struct sockaddr_in *sa4 = (struct sockaddr_in*)sa;
+		sa4->sin_family = AF_INET;
+		spa_assert_se(inet_pton(AF_INET, addr, &sa4->sin_addr) == 1);
+	}
+}
+
+static void make_entry(struct rtp_demux_entry *e, const char *addr,
+		bool have_ssrc, uint32_t ssrc)
+{
+	spa_zero(*e);
+	make_addr(&e->addr, addr);
+	e->have_ssrc = have_ssrc;
+	e->ssrc = ssrc;
+	e->data = e;
+}
+
+static struct rtp_demux_entry *find(struct rtp_demux *demux, const char *dst,
+		const char *src, uint32_t ssrc)
+{
+	struct sockaddr_storage d, s;
+
+	make_addr(&s, src);
+	if (dst == NULL)
+		return rtp_demux_find(demux, NULL, &s, ssrc);
+	make_addr(&d, dst);
+	return rtp_demux_find(demux, &d, &s, ssrc);
+}
+
+/* unicast streams are found by their sender */
+static void test_unicast(void)
+{
+	struct rtp_demux demux;
+	struct rtp_demux_entry a, b, a6;
+
+	rtp_demux_init(&demux);
+	spa_assert_se(find(&demux, NULL, "192.168.1.10", 1) == NULL);
+
+	make_entry(&a, "192.168.1.10", false, 0);
+	make_entry(&b, "192.168.1.11", false, 0);
+	make_entry(&a6, "fe80::10", false, 0);
+	rtp_demux_add(&demux, &a);
+	rtp_demux_add(&demux, &b);
+	rtp_demux_add(&demux, &a6);
+	spa_assert_se(demux.n_entries == 3);
+
+	spa_assert_se(find(&demux, NULL, "192.168.1.10", 1) == &a);
+	spa_assert_se(find(&demux, "192.168.1.1", "192.168.1.10", 2) == &a);
+	spa_assert_se(find(&demux, NULL, "192.168.1.11", 1) == &b);
+	spa_assert_se(find(&demux, NULL, "fe80::10", 1) == &a6);
+	spa_assert_se(find(&demux, NULL, "192.168.1.12", 1) == NULL);
+
+	rtp_demux_remove(&demux, &a);
+	spa_assert_se(demux.n_entries == 2);
+	spa_assert_se(find(&demux, NULL, "192.168.1.10", 1) == NULL);
+	spa_assert_se(find(&demux, NULL, "192.168.1.11", 1) == &b);
+}
+
+/* multicast streams are found by the group the packet was sent to */
+static void test_multicast(void)
+{
+	struct rtp_demux demux;
+	struct rtp_demux_entry g1, g2, g6;
+
+	rtp_demux_init(&demux);
+	make_entry(&g1, "239.0.0.1", false, 0);
+	make_entry(&g2, "239.0.0.2", false, 0);
+	make_entry(&g6, "ff02::1234", false, 0);
+	rtp_demux_add(&demux, &g1);
+	rtp_demux_add(&demux, &g2);
+	rtp_demux_add(&demux, &g6);
+
+	spa_assert_se(find(&demux, "239.0.0.1", "192.168.1.10", 1) == &g1);
+	spa_assert_se(find(&demux, "239.0.0.2", "192.168.1.10", 1) == &g2);
+	spa_assert_se(find(&demux, "ff02::1234", "fe80::10", 1) == &g6);
+	/* not sent to a group that we receive */
+	spa_assert_se(find(&demux, "239.0.0.3", "192.168.1.10", 1) == NULL);
+	/* without the destination the group is unknown */
+	spa_assert_se(find(&demux, NULL, "192.168.1.10", 1) == NULL);
+}
+
+/* streams with an SSRC are found first and only receive their SSRC, the
+ * any address receives what is left */
+static void test_ssrc(void)
+{
+	struct rtp_demux demux;
+	struct rtp_demux_entry s1, s2, g, any;
+	uint32_t i;
+
+	rtp_demux_init(&demux);
+	make_entry(&s1, "192.168.1.10", true, 1000);
+	make_entry(&s2, "239.0.0.1", true, 2000);
+	make_entry(&g, "239.0.0.1", false, 0);
+	make_entry(&any, "0.0.0.0", false, 0);
+	rtp_demux_add(&demux, &any);
+	rtp_demux_add(&demux, &g);
+	rtp_demux_add(&demux, &s1);
+	rtp_demux_add(&demux, &s2);
+
+	spa_assert_se(find(&demux, NULL, "192.168.1.10", 1000) == &s1);
+	/* the same SSRC from another sender */
+	spa_assert_se(find(&demux, NULL, "192.168.1.11", 1000) == &any);
+	/* another SSRC from the same sender */
+	spa_assert_se(find(&demux, NULL, "192.168.1.10", 1001) == &any);
+
+	spa_assert_se(find(&demux, "239.0.0.1", "192.168.1.10", 2000) == &s2);
+	spa_assert_se(find(&demux, "239.0.0.1", "192.168.1.10", 2001) == &g);
+	spa_assert_se(find(&demux, "239.0.0.2", "192.168.1.10", 2000) == &any);
+
+	/* SSRCs in the same bucket don't match each other */
+	for (i = 0; i < 1000; i++) {
+		struct rtp_demux_entry *e = find(&demux, NULL, "192.168.1.10", 5000 + i);
+		spa_assert_se(e == &any);
+	}
+
+	rtp_demux_remove(&demux, &any);
+	spa_assert_se(find(&demux, NULL, "192.168.1.11", 1000) == NULL);
+	rtp_demux_remove(&demux, &s1);
+	spa_assert_se(find(&demux, NULL, "192.168.1.10", 1000) == NULL);
+	spa_assert_se(demux.n_entries == 2);
+}
+
+int main(int argc, char *argv[])
+{
+	test_unicast();
+	test_multicast();
+	test_ssrc();
+	return 0;
+}
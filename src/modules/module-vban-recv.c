@@ -32,6 +32,7 @@
 #include <module-vban/stream.h>
 #include <module-vban/vban.h>
 #include "network-utils.h"
+#include "network-batch.h"
 
 /** \page page_module_vban_recv VBAN receiver
  *
@@ -54,6 +55,9 @@
  * - `source.port = <int>`: the source port to listen on, default 6980
  * - `node.always-process = <bool>`: true to receive even when not running
  * - `sess.latency.msec = <str>`: target network latency in milliseconds, default 100
+ * - `net.recv-mode = <str>`: how packets are received, `single` uses a recv() per
+ *       packet, `mmsg` receives all pending packets with one recvmmsg(), `gro` lets
+ *       the kernel coalesce packets (UDP_GRO) and splits them again, default `single`
  * - `stream.props = {}`: properties to be passed to all the stream
  * - `stream.rules` = <rules>: match rules, use create-stream actions.
  *
@@ -130,6 +134,11 @@
  * ]
  *\endcode
  *
+ * ## Statistics
+ *
+ * The module properties `net.syscalls-per-sec` and `net.packets-per-sec` are
+ * updated periodically with the number of receive calls and packets per second.
+ *
  * \since 0.3.76
  */
 
@@ -141,6 +150,9 @@ PW_LOG_TOPIC_STATIC(mod_topic, "mod." NAME);
 #define DEFAULT_CLEANUP_SEC		60
 #define DEFAULT_SOURCE_IP		"127.0.0.1"
 #define DEFAULT_SOURCE_PORT		6980
+#define DEFAULT_RECV_MODE		"single"
+
+#define MAX_PACKET_SIZE			2048
 
 #define DEFAULT_CREATE_RULES	\
         "[ { matches = [ { sess.name = \"~.*\" } ] actions = { create-stream = { } } } ] "
@@ -149,6 +161,7 @@ PW_LOG_TOPIC_STATIC(mod_topic, "mod." NAME);
 		"( source.ip=<source IP address, default:"DEFAULT_SOURCE_IP"> ) "				\
  		"( source.port=<int, source port, default:"SPA_STRINGIFY(DEFAULT_SOURCE_PORT)"> "		\
 		"( sess.latency.msec=<target network latency, default "SPA_STRINGIFY(DEFAULT_SESS_LATENCY)"> ) "\
+		"( net.recv-mode=<single|mmsg|gro, default:"DEFAULT_RECV_MODE"> ) "				\
 		"( audio.position=<channel map, default:"DEFAULT_POSITION"> ) "					\
 		"( stream.props= { key=value ... } ) "								\
 		"( stream.rules=<rules>, use create-stream actions )"
@@ -186,6 +199,10 @@ struct impl {
 	struct sockaddr_storage src_addr;
 	socklen_t src_len;
 	struct spa_source *source;
+	struct pw_net_rx *rx;
+
+	struct spa_source *stats_timer;
+	struct pw_net_stats last_stats;
 
 	struct spa_list streams;
 };
@@ -443,7 +460,7 @@ error:
 }
 
 static struct stream *make_stream(struct impl *impl, const struct vban_header *hdr,
-		struct sockaddr_storage *sa, socklen_t salen)
+		const struct sockaddr_storage *sa, socklen_t salen)
 {
 	struct stream *stream;
 
@@ -472,49 +489,49 @@ static struct stream *find_stream(struct impl *impl, const char *name)
 	return NULL;
 }
 
-static void
-on_vban_io(void *data, int fd, uint32_t mask)
+static int
+on_vban_packet(void *data, uint8_t *buffer, size_t len,
+		const struct sockaddr_storage *sa, socklen_t salen)
 {
 	struct impl *impl = data;
-	ssize_t len;
-	uint8_t buffer[2048];
+	struct vban_header *hdr;
+	struct stream *s;
 
-	if (mask & SPA_IO_IN) {
-		struct vban_header *hdr;
-		struct stream *s;
-		struct sockaddr_storage sa;
-		socklen_t salen = sizeof(sa);
-
-		if ((len = recvfrom(fd, buffer, sizeof(buffer), 0,
-						(struct sockaddr*)&sa, &salen)) < 0)
-			goto receive_error;
-
-		if (len < VBAN_HEADER_SIZE)
-			goto short_packet;
-
-		hdr = (struct vban_header *)buffer;
-		if (strncmp(hdr->vban, "VBAN", 4))
-			goto invalid_version;
-
-		s = find_stream(impl, hdr->stream_name);
-		if (SPA_UNLIKELY(s == NULL))
-			s = make_stream(impl, hdr, &sa, salen);
-		if (SPA_LIKELY(s != NULL && s->active)) {
-			s->receiving = true;
-			vban_stream_receive_packet(s->stream, buffer, len);
-		}
+	if (len < VBAN_HEADER_SIZE)
+		goto short_packet;
+
+	hdr = (struct vban_header *)buffer;
+	if (strncmp(hdr->vban, "VBAN", 4))
+		goto invalid_version;
+
+	s = find_stream(impl, hdr->stream_name);
+	if (SPA_UNLIKELY(s == NULL))
+		s = make_stream(impl, hdr, sa, salen);
+	if (SPA_LIKELY(s != NULL && s->active)) {
+		s->receiving = true;
+		vban_stream_receive_packet(s->stream, buffer, len);
 	}
-	return;
+	return 0;
 
-receive_error:
-	pw_log_warn("recv error: %m");
-	return;
 short_packet:
 	pw_log_warn("short packet received");
-	return;
+	return -EINVAL;
 invalid_version:
 	pw_log_warn("invalid VBAN version");
-	return;
+	return -EINVAL;
+}
+
+static void
+on_vban_io(void *data, int fd, uint32_t mask)
+{
+	struct impl *impl = data;
+	int res;
+
+	if (mask & SPA_IO_IN) {
+		if ((res = pw_net_rx_read(impl->rx, fd, on_vban_packet, impl)) < 0 &&
+		    res != -EAGAIN)
+			pw_log_warn("recv error: %s", spa_strerror(res));
+	}
 }
 
 static int listen_start(struct impl *impl)
@@ -531,6 +548,8 @@ static int listen_start(struct impl *impl)
 		pw_log_error("failed to create socket: %m");
 		return fd;
 	}
+	if (pw_net_rx_set_fd(impl->rx, fd) < 0)
+		pw_log_warn("can't enable UDP_GRO, using recvmmsg()");
 
 	impl->source = pw_loop_add_io(impl->data_loop, fd,
 				SPA_IO_IN, true, on_vban_io, impl);
@@ -578,6 +597,12 @@ static void on_timer_event(void *data, uint64_t expirations)
 	}
 }
 
+static void on_stats_timer_event(void *data, uint64_t expirations)
+{
+	struct impl *impl = data;
+	pw_net_stats_update_module(&impl->rx->stats, &impl->last_stats, impl->module);
+}
+
 static void core_destroy(void *d)
 {
 	struct impl *impl = d;
@@ -604,6 +629,10 @@ static void impl_destroy(struct impl *impl)
 
 	if (impl->timer)
 		pw_loop_destroy_source(impl->main_loop, impl->timer);
+	if (impl->stats_timer)
+		pw_loop_destroy_source(impl->main_loop, impl->stats_timer);
+	if (impl->rx)
+		pw_net_rx_free(impl->rx);
 
 	if (impl->data_loop)
 		pw_context_release_loop(impl->context, impl->data_loop);
@@ -659,6 +688,7 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 	struct impl *impl;
 	const char *str;
 	struct timespec value, interval;
+	enum pw_net_batch_mode recv_mode;
 	struct pw_properties *props, *stream_props;
 	int res = 0;
 
@@ -724,6 +754,18 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 	impl->cleanup_interval = pw_properties_get_uint32(props,
 			"cleanup.sec", DEFAULT_CLEANUP_SEC);
 
+	str = pw_properties_get(props, "net.recv-mode");
+	if ((res = pw_net_batch_mode_from_string(str, &recv_mode)) < 0) {
+		pw_log_error("invalid net.recv-mode %s", str);
+		goto out;
+	}
+	impl->rx = pw_net_rx_new(recv_mode, MAX_PACKET_SIZE);
+	if (impl->rx == NULL) {
+		res = -errno;
+		pw_log_error("can't create packet buffers: %m");
+		goto out;
+	}
+
 	impl->core = pw_context_get_object(impl->context, PW_TYPE_INTERFACE_Core);
 	if (impl->core == NULL) {
 		str = pw_properties_get(props, PW_KEY_REMOTE_NAME);
@@ -759,6 +801,16 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 	interval.tv_nsec = 0;
 	pw_loop_update_timer(impl->main_loop, impl->timer, &value, &interval, false);
 
+	impl->stats_timer = pw_loop_add_timer(impl->main_loop, on_stats_timer_event, impl);
+	if (impl->stats_timer == NULL) {
+		res = -errno;
+		pw_log_error("can't create timer source: %m");
+		goto out;
+	}
+	value.tv_sec = interval.tv_sec = PW_NET_STATS_INTERVAL_SEC;
+	value.tv_nsec = interval.tv_nsec = 0;
+	pw_loop_update_timer(impl->main_loop, impl->stats_timer, &value, &interval, false);
+
 	if ((res = listen_start(impl)) < 0) {
 		pw_log_error("failed to start VBAN stream: %s", spa_strerror(res));
 		goto out;
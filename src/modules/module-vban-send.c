@@ -28,6 +28,7 @@
 #include <module-vban/stream.h>
 #include <module-vban/vban.h>
 #include "network-utils.h"
+#include "network-batch.h"
 
 #ifndef IPTOS_DSCP
 #define IPTOS_DSCP_MASK 0xfc
@@ -54,6 +55,10 @@
  * - `net.mtu = <int>`: MTU to use, default 1500
  * - `net.ttl = <int>`: TTL to use, default 1
  * - `net.loop = <bool>`: loopback multicast, default false
+ * - `net.send-mode = <str>`: how packets are sent, `single` uses a sendmsg() per
+ *       packet, `mmsg` sends all packets of a cycle with one sendmmsg(), `gso`
+ *       sends packets of the same size as one buffer that is split by the kernel
+ *       (UDP_SEGMENT), default `single`
  * - `sess.min-ptime = <int>`: minimum packet time in milliseconds, default 2
  * - `sess.max-ptime = <int>`: maximum packet time in milliseconds, default 20
  * - `sess.name = <str>`: a session name
@@ -91,6 +96,7 @@
  *         #net.mtu = 1500
  *         #net.ttl = 1
  *         #net.loop = false
+ *         #net.send-mode = "single"
  *         #sess.min-ptime = 2
  *         #sess.max-ptime = 20
  *         #sess.name = "PipeWire VBAN stream"
@@ -107,6 +113,11 @@
  *]
  *\endcode
  *
+ * ## Statistics
+ *
+ * The module properties `net.syscalls-per-sec` and `net.packets-per-sec` are
+ * updated periodically with the number of send calls and packets per second.
+ *
  * \since 0.3.76
  */
 
@@ -121,6 +132,8 @@ PW_LOG_TOPIC_STATIC(mod_topic, "mod." NAME);
 #define DEFAULT_TTL		1
 #define DEFAULT_LOOP		false
 #define DEFAULT_DSCP		34 /* Default to AES-67 AF41 (34) */
+#define DEFAULT_SEND_MODE	"single"
+
 
 #define USAGE	"( source.ip=<source IP address, default:"DEFAULT_SOURCE_IP"> ) "			\
 		"( destination.ip=<destination IP address, default:"DEFAULT_DESTINATION_IP"> ) "	\
@@ -130,6 +143,7 @@ PW_LOG_TOPIC_STATIC(mod_topic, "mod." NAME);
 		"( net.ttl=<desired TTL, default:"SPA_STRINGIFY(DEFAULT_TTL)"> ) "			\
 		"( net.loop=<desired loopback, default:"SPA_STRINGIFY(DEFAULT_LOOP)"> ) "		\
 		"( net.dscp=<desired DSCP, default:"SPA_STRINGIFY(DEFAULT_DSCP)"> ) "			\
+		"( net.send-mode=<single|mmsg|gso, default:"DEFAULT_SEND_MODE"> ) "			\
 		"( sess.name=<a name for the session> ) "						\
 		"( sess.min-ptime=<minimum packet time in milliseconds, default:2> ) "			\
 		"( sess.max-ptime=<maximum packet time in milliseconds, default:20> ) "			\
@@ -179,6 +193,10 @@ struct impl {
 	socklen_t dst_len;
 
 	int vban_fd;
+	struct pw_net_tx *tx;
+
+	struct spa_source *stats_timer;
+	struct pw_net_stats last_stats;
 };
 
 static void stream_destroy(void *d)
@@ -190,19 +208,19 @@ static void stream_destroy(void *d)
 static void stream_send_packet(void *data, struct iovec *iov, size_t iovlen)
 {
 	struct impl *impl = data;
-	struct msghdr msg;
 	ssize_t n;
 
-	spa_zero(msg);
-	msg.msg_iov = iov;
-	msg.msg_iovlen = iovlen;
-	msg.msg_control = NULL;
-	msg.msg_controllen = 0;
-	msg.msg_flags = 0;
+	if ((n = pw_net_tx_send(impl->tx, iov, iovlen)) < 0)
+		pw_log_debug("sendmsg() failed: %s", spa_strerror(n));
+}
+
+static void stream_flush_packets(void *data)
+{
+	struct impl *impl = data;
+	ssize_t n;
 
-	n = sendmsg(impl->vban_fd, &msg, MSG_NOSIGNAL);
-	if (n < 0)
-		pw_log_debug("sendmsg() failed: %m");
+	if ((n = pw_net_tx_flush(impl->tx)) < 0)
+		pw_log_debug("sendmmsg() failed: %s", spa_strerror(n));
 }
 
 static void stream_state_changed(void *data, bool started, const char *error)
@@ -220,8 +238,15 @@ static const struct vban_stream_events stream_events = {
 	.destroy = stream_destroy,
 	.state_changed = stream_state_changed,
 	.send_packet = stream_send_packet,
+	.flush_packets = stream_flush_packets,
 };
 
+static void on_stats_timer_event(void *data, uint64_t expirations)
+{
+	struct impl *impl = data;
+	pw_net_stats_update_module(&impl->tx->stats, &impl->last_stats, impl->module);
+}
+
 static bool is_multicast(struct sockaddr *sa, socklen_t salen)
 {
 	if (sa->sa_family == AF_INET) {
@@ -303,8 +328,13 @@ static void impl_destroy(struct impl *impl)
 	if (impl->core && impl->do_disconnect)
 		pw_core_disconnect(impl->core);
 
+	if (impl->stats_timer)
+		pw_loop_destroy_source(impl->loop, impl->stats_timer);
+
 	if (impl->vban_fd != -1)
 		close(impl->vban_fd);
+	if (impl->tx)
+		pw_net_tx_free(impl->tx);
 
 	pw_properties_free(impl->stream_props);
 	pw_properties_free(impl->props);
@@ -361,6 +391,8 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 	char addr[64];
 	const char *str, *sess_name;
 	int res = 0;
+	enum pw_net_batch_mode send_mode;
+	struct timespec value, interval;
 
 	PW_LOG_TOPIC_INIT(mod_topic);
 
@@ -456,6 +488,18 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 	impl->mcast_loop = pw_properties_get_bool(props, "net.loop", DEFAULT_LOOP);
 	impl->dscp = pw_properties_get_uint32(props, "net.dscp", DEFAULT_DSCP);
 
+	str = pw_properties_get(props, "net.send-mode");
+	if ((res = pw_net_batch_mode_from_string(str, &send_mode)) < 0) {
+		pw_log_error("invalid net.send-mode %s", str);
+		goto out;
+	}
+	impl->tx = pw_net_tx_new(send_mode);
+	if (impl->tx == NULL) {
+		res = -errno;
+		pw_log_error("can't create sender: %m");
+		goto out;
+	}
+
 	pw_net_get_ip(&impl->src_addr, addr, sizeof(addr), NULL, NULL);
 	pw_properties_set(stream_props, "vban.source.ip", addr);
 	pw_net_get_ip(&impl->dst_addr, addr, sizeof(addr), NULL, NULL);
@@ -494,6 +538,7 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 		goto out;
 	}
 	impl->vban_fd = res;
+	pw_net_tx_set_fd(impl->tx, impl->vban_fd);
 
 	impl->stream = vban_stream_new(impl->core,
 			PW_DIRECTION_INPUT, pw_properties_copy(stream_props),
@@ -504,6 +549,16 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 		goto out;
 	}
 
+	impl->stats_timer = pw_loop_add_timer(impl->loop, on_stats_timer_event, impl);
+	if (impl->stats_timer == NULL) {
+		res = -errno;
+		pw_log_error("can't create timer source: %m");
+		goto out;
+	}
+	value.tv_sec = interval.tv_sec = PW_NET_STATS_INTERVAL_SEC;
+	value.tv_nsec = interval.tv_nsec = 0;
+	pw_loop_update_timer(impl->loop, impl->stats_timer, &value, &interval, false);
+
 	pw_impl_module_add_listener(module, &impl->module_listener, &module_events, impl);
 
 	pw_impl_module_update_properties(module, &SPA_DICT_INIT_ARRAY(module_info));
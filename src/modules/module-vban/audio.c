@@ -195,6 +195,7 @@ static void vban_audio_flush_packets(struct impl *impl)
 		avail -= tosend;
 		header.n_frames++;
 	}
+	vban_stream_emit_flush_packets(impl);
 	impl->header.n_frames = header.n_frames;
 	spa_ringbuffer_read_update(&impl->ring, timestamp);
 }
@@ -267,6 +267,7 @@ static void vban_midi_flush_packets(struct impl *impl,
 		pw_log_debug("sending %d", len);
 		vban_stream_emit_send_packet(impl, iov, 2);
 	}
+	vban_stream_emit_flush_packets(impl);
 	impl->header.n_frames = header.n_frames;
 }
 
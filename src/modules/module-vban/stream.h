@@ -34,6 +34,9 @@ struct vban_stream_events {
 	void (*send_packet) (void *data, struct iovec *iov, size_t iovlen);
 
 	void (*send_feedback) (void *data, uint32_t senum);
+
+	/* all packets of a flush were emitted with send_packet */
+	void (*flush_packets) (void *data);
 };
 
 struct vban_stream *vban_stream_new(struct pw_core *core,
@@ -0,0 +1,595 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef NETWORK_BATCH_H
+#define NETWORK_BATCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#ifdef __linux__
+#include <linux/net_tstamp.h>
+#endif
+
+#include <spa/utils/defs.h>
+#include <spa/utils/atomic.h>
+#include <spa/utils/string.h>
+
+#include <pipewire/impl-module.h>
+
+/*
+ * Batched transmission and reception of UDP packets.
+ *
+ * On transmit, packets are collected with pw_net_tx_add() and sent with
+ * one sendmmsg() in pw_net_tx_flush(). With UDP_SEGMENT (GSO), a run of
+ * equally sized packets is passed to the kernel as one buffer and split
+ * into packets there. With SO_TXTIME, each packet gets a launch time so
+ * that a burst of packets is paced out on the wire.
+ *
+ * On receive, pw_net_rx_read() fetches multiple packets with recvmmsg().
+ * With UDP_GRO, the kernel coalesces packets of the same flow into one
+ * buffer that is split again into packets here. When the socket has
+ * packet info enabled, the destination address of each packet can be
+ * retrieved from the callback so that packets for multiple multicast
+ * groups can be received on one socket.
+ */
+
+/* max packets in a batch, this is also the max number of UDP_SEGMENT
+ * segments the kernel accepts in one buffer */
+#define PW_NET_BATCH_MAX	64
+/* max bytes in a batch, a GSO batch is sent as one datagram so it needs to
+ * fit in the max UDP payload of 65507 bytes */
+#define PW_NET_BATCH_SIZE	(63u * 1024u)
+/* max size of a GRO coalesced buffer */
+#define PW_NET_GRO_SIZE		(64u * 1024u)
+
+/* seconds between two updates of the stats properties */
+#define PW_NET_STATS_INTERVAL_SEC	4
+
+enum pw_net_batch_mode {
+	PW_NET_BATCH_SINGLE,	/* one syscall per packet */
+	PW_NET_BATCH_MMSG,	/* sendmmsg()/recvmmsg() */
+	PW_NET_BATCH_GSO,	/* UDP_SEGMENT/UDP_GRO, falls back to mmsg */
+};
+
+static inline int pw_net_batch_mode_from_string(const char *str, enum pw_net_batch_mode *mode)
+{
+	if (str == NULL || spa_streq(str, "single"))
+		*mode = PW_NET_BATCH_SINGLE;
+	else if (spa_streq(str, "mmsg"))
+		*mode = PW_NET_BATCH_MMSG;
+	else if (spa_streq(str, "gso") || spa_streq(str, "gro"))
+		*mode = PW_NET_BATCH_GSO;
+	else
+		return -EINVAL;
+	return 0;
+}
+
+/* counters are updated from the data thread and can be read from any
+ * thread with pw_net_stats_get() */
+struct pw_net_stats {
+	uint64_t syscalls;
+	uint64_t packets;
+};
+
+static inline void pw_net_stats_get(struct pw_net_stats *stats, struct pw_net_stats *res)
+{
+	res->syscalls = SPA_ATOMIC_LOAD(stats->syscalls);
+	res->packets = SPA_ATOMIC_LOAD(stats->packets);
+}
+
+static inline void pw_net_stats_add(struct pw_net_stats *stats, uint64_t syscalls, uint64_t packets)
+{
+	SPA_ATOMIC_STORE(stats->syscalls, stats->syscalls + syscalls);
+	SPA_ATOMIC_STORE(stats->packets, stats->packets + packets);
+}
+
+/* Update the net.syscalls-per-sec and net.packets-per-sec properties of
+ * module with the rates since the last update. Call this from the main
+ * thread every PW_NET_STATS_INTERVAL_SEC. The rates drop to 0 when the
+ * traffic stops. */
+static inline void pw_net_stats_update_module(struct pw_net_stats *stats,
+		struct pw_net_stats *last, struct pw_impl_module *module)
+{
+	struct pw_net_stats now;
+	struct spa_dict_item items[2];
+	char syscalls[32], packets[32];
+
+	pw_net_stats_get(stats, &now);
+
+	snprintf(syscalls, sizeof(syscalls), "%"PRIu64,
+			(now.syscalls - last->syscalls) / PW_NET_STATS_INTERVAL_SEC);
+	snprintf(packets, sizeof(packets), "%"PRIu64,
+			(now.packets - last->packets) / PW_NET_STATS_INTERVAL_SEC);
+	*last = now;
+
+	items[0] = SPA_DICT_ITEM_INIT("net.syscalls-per-sec", syscalls);
+	items[1] = SPA_DICT_ITEM_INIT("net.packets-per-sec", packets);
+	pw_impl_module_update_properties(module, &SPA_DICT_INIT_ARRAY(items));
+}
+
+union pw_net_cmsg {
+	char buf[CMSG_SPACE(sizeof(uint64_t))];
+	struct cmsghdr align;
+};
+
+struct pw_net_tx {
+	int fd;
+	enum pw_net_batch_mode mode;
+	bool txtime;
+	uint64_t txtime_delay;		/* ns added to the current time for the first packet */
+	uint64_t txtime_period;		/* ns between two packets */
+
+	uint32_t n_packets;
+	size_t size;
+	uint8_t data[PW_NET_BATCH_SIZE];
+	struct iovec iov[PW_NET_BATCH_MAX];
+	struct mmsghdr msg[PW_NET_BATCH_MAX];
+	union pw_net_cmsg control[PW_NET_BATCH_MAX];
+
+	struct pw_net_stats stats;
+};
+
+static inline struct pw_net_tx *pw_net_tx_new(enum pw_net_batch_mode mode)
+{
+	struct pw_net_tx *tx;
+
+	if ((tx = calloc(1, sizeof(*tx))) == NULL)
+		return NULL;
+	tx->fd = -1;
+	tx->mode = mode;
+	return tx;
+}
+
+static inline void pw_net_tx_free(struct pw_net_tx *tx)
+{
+	free(tx);
+}
+
+/* Configure the socket for the tx options, must be called on a new socket. */
+static inline int pw_net_tx_set_fd(struct pw_net_tx *tx, int fd)
+{
+	tx->fd = fd;
+	tx->n_packets = 0;
+	tx->size = 0;
+	if (fd < 0)
+		return 0;
+#ifdef SO_TXTIME
+	if (tx->txtime) {
+		struct sock_txtime cfg;
+		spa_zero(cfg);
+		cfg.clockid = CLOCK_TAI;
+		cfg.flags = 0;
+		if (setsockopt(fd, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)) < 0) {
+			tx->txtime = false;
+			return -errno;
+		}
+	}
+#else
+	if (tx->txtime) {
+		tx->txtime = false;
+		return -ENOTSUP;
+	}
+#endif
+	return 0;
+}
+
+static inline uint64_t pw_net_tx_launch_time(struct pw_net_tx *tx)
+{
+#ifdef SO_TXTIME
+	struct timespec ts;
+	clock_gettime(CLOCK_TAI, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts) + tx->txtime_delay;
+#else
+	return 0;
+#endif
+}
+
+static inline void pw_net_tx_set_txtime(struct pw_net_tx *tx, struct msghdr *msg,
+		union pw_net_cmsg *control, uint64_t txtime)
+{
+#ifdef SO_TXTIME
+	struct cmsghdr *cmsg;
+
+	msg->msg_control = control->buf;
+	msg->msg_controllen = sizeof(control->buf);
+	cmsg = CMSG_FIRSTHDR(msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_TXTIME;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+	memcpy(CMSG_DATA(cmsg), &txtime, sizeof(uint64_t));
+#endif
+}
+
+/* Check if the queued packets are a run of equally sized packets, the last
+ * one can be smaller, that can be segmented by the kernel. */
+static inline bool pw_net_tx_can_gso(struct pw_net_tx *tx)
+{
+	size_t gso_size = tx->iov[0].iov_len;
+	uint32_t i;
+
+	for (i = 1; i < tx->n_packets; i++) {
+		if (tx->iov[i].iov_len > gso_size ||
+		    (i + 1 < tx->n_packets && tx->iov[i].iov_len != gso_size))
+			return false;
+	}
+	return true;
+}
+
+/* Send the queued packets as one buffer that is segmented by the kernel.
+ * Returns -ENOTSUP when not possible. */
+static inline ssize_t pw_net_tx_send_gso(struct pw_net_tx *tx)
+{
+#ifdef UDP_SEGMENT
+	union {
+		char buf[CMSG_SPACE(sizeof(uint16_t))];
+		struct cmsghdr align;
+	} control;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	uint16_t gso_size;
+	ssize_t res;
+
+	if (!pw_net_tx_can_gso(tx))
+		return -ENOTSUP;
+
+	gso_size = tx->iov[0].iov_len;
+	iov.iov_base = tx->data;
+	iov.iov_len = tx->size;
+
+	spa_zero(msg);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_UDP;
+	cmsg->cmsg_type = UDP_SEGMENT;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+	memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(uint16_t));
+
+	res = sendmsg(tx->fd, &msg, MSG_NOSIGNAL);
+	if (res < 0) {
+		res = -errno;
+		pw_net_stats_add(&tx->stats, 1, 0);
+		return res;
+	}
+	pw_net_stats_add(&tx->stats, 1, tx->n_packets);
+	return tx->n_packets;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+/* Send all queued packets. Returns the number of packets sent or < 0 on error. */
+static inline ssize_t pw_net_tx_flush(struct pw_net_tx *tx)
+{
+	uint32_t i, sent = 0;
+	uint64_t txtime = 0;
+	ssize_t res = 0;
+
+	if (tx->n_packets == 0)
+		return 0;
+	if (tx->fd < 0) {
+		res = -EBADF;
+		goto done;
+	}
+	if (tx->mode == PW_NET_BATCH_GSO && !tx->txtime && tx->n_packets > 1 &&
+	    pw_net_tx_can_gso(tx)) {
+		/* the kernel would give all segments the same launch time so
+		 * this is only done without txtime */
+		res = pw_net_tx_send_gso(tx);
+		if (res >= 0 || res == -EAGAIN)
+			goto done;
+		if (res == -ENOTSUP || res == -EINVAL)
+			/* not supported by the socket or device, use mmsg from now on */
+			tx->mode = PW_NET_BATCH_MMSG;
+		/* other errors only make this batch go out with mmsg */
+		res = 0;
+	}
+	if (tx->txtime)
+		txtime = pw_net_tx_launch_time(tx);
+
+	for (i = 0; i < tx->n_packets; i++) {
+		struct msghdr *msg = &tx->msg[i].msg_hdr;
+		spa_zero(*msg);
+		msg->msg_iov = &tx->iov[i];
+		msg->msg_iovlen = 1;
+		if (tx->txtime) {
+			pw_net_tx_set_txtime(tx, msg, &tx->control[i], txtime);
+			txtime += tx->txtime_period;
+		}
+	}
+	while (sent < tx->n_packets) {
+		int n = sendmmsg(tx->fd, &tx->msg[sent], tx->n_packets - sent, MSG_NOSIGNAL);
+		pw_net_stats_add(&tx->stats, 1, n > 0 ? n : 0);
+		if (n <= 0) {
+			res = n < 0 ? -errno : -EIO;
+			break;
+		}
+		sent += n;
+	}
+	if (res == 0)
+		res = sent;
+done:
+	tx->n_packets = 0;
+	tx->size = 0;
+	return res;
+}
+
+/* Queue a packet, this flushes the queued packets first when there is no
+ * more space. Returns the result of the flush or 0. */
+static inline ssize_t pw_net_tx_add(struct pw_net_tx *tx, const struct iovec *iov, size_t iovlen)
+{
+	size_t i, len = 0;
+	ssize_t res = 0;
+	uint8_t *p;
+
+	for (i = 0; i < iovlen; i++)
+		len += iov[i].iov_len;
+	if (len > PW_NET_BATCH_SIZE)
+		return -EMSGSIZE;
+
+	if (tx->n_packets == PW_NET_BATCH_MAX || tx->size + len > PW_NET_BATCH_SIZE)
+		res = pw_net_tx_flush(tx);
+
+	p = &tx->data[tx->size];
+	tx->iov[tx->n_packets].iov_base = p;
+	tx->iov[tx->n_packets].iov_len = len;
+	for (i = 0; i < iovlen; i++) {
+		memcpy(p, iov[i].iov_base, iov[i].iov_len);
+		p += iov[i].iov_len;
+	}
+	tx->size += len;
+	tx->n_packets++;
+	return res;
+}
+
+/* Send one packet, batched or not. */
+static inline ssize_t pw_net_tx_send(struct pw_net_tx *tx, struct iovec *iov, size_t iovlen)
+{
+	struct msghdr msg;
+	ssize_t res;
+
+	if (tx->mode != PW_NET_BATCH_SINGLE || tx->txtime) {
+		if ((res = pw_net_tx_add(tx, iov, iovlen)) < 0)
+			return res;
+		if (tx->mode == PW_NET_BATCH_SINGLE)
+			return pw_net_tx_flush(tx);
+		return 0;
+	}
+	spa_zero(msg);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovlen;
+
+	res = sendmsg(tx->fd, &msg, MSG_NOSIGNAL);
+	pw_net_stats_add(&tx->stats, 1, 1);
+	return res < 0 ? -errno : res;
+}
+
+typedef int (*pw_net_packet_func_t) (void *data, uint8_t *buffer, size_t len,
+		const struct sockaddr_storage *sa, socklen_t salen);
+
+/* room for a timestamp, the GRO segment size and the packet info */
+union pw_net_rx_cmsg {
+	char buf[CMSG_SPACE(sizeof(struct timeval)) +
+		CMSG_SPACE(sizeof(int)) +
+		CMSG_SPACE(sizeof(struct in6_pktinfo))];
+	struct cmsghdr align;
+};
+
+struct pw_net_rx {
+	enum pw_net_batch_mode mode;
+	size_t buffer_size;
+	uint32_t n_buffers;
+	uint8_t *buffer;
+	struct iovec iov[PW_NET_BATCH_MAX];
+	struct mmsghdr msg[PW_NET_BATCH_MAX];
+	struct sockaddr_storage addr[PW_NET_BATCH_MAX];
+	union pw_net_rx_cmsg control[PW_NET_BATCH_MAX];
+	struct msghdr *current;
+
+	struct pw_net_stats stats;
+};
+
+/* Make a receiver for packets of at most max_size bytes. */
+static inline struct pw_net_rx *pw_net_rx_new(enum pw_net_batch_mode mode, size_t max_size)
+{
+	struct pw_net_rx *rx;
+	uint32_t i;
+
+	if ((rx = calloc(1, sizeof(*rx))) == NULL)
+		return NULL;
+
+	rx->mode = mode;
+	switch (mode) {
+	case PW_NET_BATCH_SINGLE:
+		rx->n_buffers = 1;
+		rx->buffer_size = max_size;
+		break;
+	case PW_NET_BATCH_MMSG:
+		rx->n_buffers = PW_NET_BATCH_MAX;
+		rx->buffer_size = max_size;
+		break;
+	case PW_NET_BATCH_GSO:
+		rx->n_buffers = SPA_MAX(1u, PW_NET_BATCH_MAX / 8u);
+		rx->buffer_size = SPA_MAX(max_size, (size_t)PW_NET_GRO_SIZE);
+		break;
+	}
+	if ((rx->buffer = calloc(rx->n_buffers, rx->buffer_size)) == NULL) {
+		free(rx);
+		return NULL;
+	}
+	for (i = 0; i < rx->n_buffers; i++) {
+		rx->iov[i].iov_base = SPA_PTROFF(rx->buffer, i * rx->buffer_size, void);
+		rx->iov[i].iov_len = rx->buffer_size;
+	}
+	return rx;
+}
+
+/* Grow the buffers for packets of at most max_size bytes. Can't be called
+ * concurrently with pw_net_rx_read(). */
+static inline int pw_net_rx_resize(struct pw_net_rx *rx, size_t max_size)
+{
+	uint8_t *buffer;
+	uint32_t i;
+
+	if (max_size <= rx->buffer_size)
+		return 0;
+	if ((buffer = calloc(rx->n_buffers, max_size)) == NULL)
+		return -errno;
+	free(rx->buffer);
+	rx->buffer = buffer;
+	rx->buffer_size = max_size;
+	for (i = 0; i < rx->n_buffers; i++) {
+		rx->iov[i].iov_base = SPA_PTROFF(rx->buffer, i * rx->buffer_size, void);
+		rx->iov[i].iov_len = rx->buffer_size;
+	}
+	return 0;
+}
+
+static inline void pw_net_rx_free(struct pw_net_rx *rx)
+{
+	free(rx->buffer);
+	free(rx);
+}
+
+/* Configure the socket for the rx options, call this on a new socket. */
+static inline int pw_net_rx_set_fd(struct pw_net_rx *rx, int fd)
+{
+	if (rx->mode != PW_NET_BATCH_GSO)
+		return 0;
+#ifdef UDP_GRO
+	int val = 1;
+	if (setsockopt(fd, SOL_UDP, UDP_GRO, &val, sizeof(val)) == 0)
+		return 0;
+#endif
+	rx->mode = PW_NET_BATCH_MMSG;
+	return -ENOTSUP;
+}
+
+/* Enable the packet info on the socket, needed for pw_net_rx_get_dst(). */
+static inline int pw_net_rx_enable_pktinfo(int fd, int family)
+{
+	int val = 1, res = -ENOTSUP;
+
+	if (family == AF_INET)
+		res = setsockopt(fd, IPPROTO_IP, IP_PKTINFO, &val, sizeof(val));
+	else if (family == AF_INET6)
+		res = setsockopt(fd, IPPROTO_IPV6, IPV6_RECVPKTINFO, &val, sizeof(val));
+	return res < 0 ? -errno : res;
+}
+
+/* Get the destination address of the packet that is passed to the callback
+ * of pw_net_rx_read(). Only valid from the callback. */
+static inline int pw_net_rx_get_dst(struct pw_net_rx *rx, struct sockaddr_storage *dst)
+{
+	struct msghdr *msg = rx->current;
+	struct cmsghdr *cmsg;
+
+	if (msg == NULL)
+		return -EINVAL;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO) {
+			struct sockaddr_in *sa = (struct sockaddr_in*)dst;
+			struct in_pktinfo pi;
+			memcpy(&pi, CMSG_DATA(cmsg), sizeof(pi));
+			spa_zero(*sa);
+			sa->sin_family = AF_INET;
+			sa->sin_addr = pi.ipi_addr;
+			return 0;
+		}
+		if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_PKTINFO) {
+			struct sockaddr_in6 *sa = (struct sockaddr_in6*)dst;
+			struct in6_pktinfo pi;
+			memcpy(&pi, CMSG_DATA(cmsg), sizeof(pi));
+			spa_zero(*sa);
+			sa->sin6_family = AF_INET6;
+			sa->sin6_addr = pi.ipi6_addr;
+			return 0;
+		}
+	}
+	return -ENOENT;
+}
+
+static inline uint16_t pw_net_rx_gro_size(struct msghdr *msg)
+{
+#ifdef UDP_GRO
+	struct cmsghdr *cmsg;
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+			int size;
+			memcpy(&size, CMSG_DATA(cmsg), sizeof(int));
+			return size;
+		}
+	}
+#endif
+	return 0;
+}
+
+/* Read all available packets, up to the number of buffers, and call func
+ * for each of them. Returns the number of packets or < 0 on error. */
+static inline int pw_net_rx_read(struct pw_net_rx *rx, int fd,
+		pw_net_packet_func_t func, void *data)
+{
+	uint32_t i;
+	int n, res, count = 0;
+
+	for (i = 0; i < rx->n_buffers; i++) {
+		struct msghdr *msg = &rx->msg[i].msg_hdr;
+		msg->msg_name = &rx->addr[i];
+		msg->msg_namelen = sizeof(rx->addr[i]);
+		msg->msg_iov = &rx->iov[i];
+		msg->msg_iovlen = 1;
+		msg->msg_control = rx->control[i].buf;
+		msg->msg_controllen = sizeof(rx->control[i].buf);
+		msg->msg_flags = 0;
+	}
+	if (rx->mode == PW_NET_BATCH_SINGLE) {
+		ssize_t len = recvmsg(fd, &rx->msg[0].msg_hdr, 0);
+		if (len >= 0)
+			rx->msg[0].msg_len = len;
+		n = len < 0 ? -1 : 1;
+	} else {
+		n = recvmmsg(fd, rx->msg, rx->n_buffers, MSG_DONTWAIT, NULL);
+	}
+	if (n < 0) {
+		res = -errno;
+		pw_net_stats_add(&rx->stats, 1, 0);
+		return res;
+	}
+
+	for (i = 0; i < (uint32_t)n; i++) {
+		struct msghdr *msg = &rx->msg[i].msg_hdr;
+		uint8_t *p = rx->iov[i].iov_base;
+		size_t len = rx->msg[i].msg_len;
+		size_t seg = rx->mode == PW_NET_BATCH_GSO ? pw_net_rx_gro_size(msg) : 0;
+
+		if (seg == 0)
+			seg = len;
+		rx->current = msg;
+		do {
+			size_t l = SPA_MIN(seg, len);
+			func(data, p, l, &rx->addr[i], msg->msg_namelen);
+			p += l;
+			len -= l;
+			count++;
+		} while (len > 0);
+	}
+	rx->current = NULL;
+	pw_net_stats_add(&rx->stats, 1, count);
+	return count;
+}
+
+#endif /* NETWORK_BATCH_H */
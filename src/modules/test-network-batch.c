@@ -0,0 +1,279 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include <spa/utils/defs.h>
+
+#include "network-batch.h"
+
+#define N_PACKETS	PW_NET_BATCH_MAX
+
+SPA_STATIC_ASSERT(PW_NET_BATCH_SIZE <= 65507u);
+
+struct data {
+	uint32_t n_packets;
+	size_t sizes[N_PACKETS * 2];
+	uint8_t seq[N_PACKETS * 2];
+};
+
+static int make_socket(struct sockaddr_in *sa)
+{
+	socklen_t len = sizeof(*sa);
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	spa_assert_se(fd >= 0);
+	spa_zero(*sa);
+	sa->sin_family = AF_INET;
+	sa->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	spa_assert_se(bind(fd, (struct sockaddr*)sa, sizeof(*sa)) == 0);
+	spa_assert_se(getsockname(fd, (struct sockaddr*)sa, &len) == 0);
+	return fd;
+}
+
+static int on_packet(void *data, uint8_t *buffer, size_t len,
+		const struct sockaddr_storage *sa, socklen_t salen)
+{
+	struct data *d = data;
+
+	spa_assert_se(d->n_packets < SPA_N_ELEMENTS(d->sizes));
+	d->sizes[d->n_packets] = len;
+	d->seq[d->n_packets] = buffer[0];
+	d->n_packets++;
+	return 0;
+}
+
+static void receive_all(struct pw_net_rx *rx, int fd, struct data *d, uint32_t n_packets)
+{
+	int res, timeout = 1000;
+
+	while (d->n_packets < n_packets && --timeout > 0) {
+		res = pw_net_rx_read(rx, fd, on_packet, d);
+		if (res == -EAGAIN)
+			usleep(1000);
+		else
+			spa_assert_se(res > 0);
+	}
+	spa_assert_se(d->n_packets == n_packets);
+}
+
+static void queue_packet(struct pw_net_tx *tx, uint8_t seq, size_t size)
+{
+	uint8_t buf[2048];
+	struct iovec iov[2];
+
+	spa_assert_se(size <= sizeof(buf));
+	memset(buf, seq, size);
+	/* the header and payload are in separate iovecs like in the senders */
+	iov[0].iov_base = buf;
+	iov[0].iov_len = 1;
+	iov[1].iov_base = buf + 1;
+	iov[1].iov_len = size - 1;
+	spa_assert_se(pw_net_tx_add(tx, iov, 2) >= 0);
+}
+
+/* a full batch is flushed before it grows over the max UDP payload */
+static void test_batch_size(void)
+{
+	struct pw_net_tx *tx;
+	uint32_t i;
+	uint8_t big[PW_NET_BATCH_SIZE + 1];
+	struct iovec iov;
+
+	tx = pw_net_tx_new(PW_NET_BATCH_MMSG);
+	spa_assert_se(tx != NULL);
+
+	/* no socket, the flushes fail but the queue is reset */
+	for (i = 0; i < 2 * N_PACKETS; i++) {
+		uint8_t buf[1400];
+		memset(buf, 0, sizeof(buf));
+		iov.iov_base = buf;
+		iov.iov_len = sizeof(buf);
+		pw_net_tx_add(tx, &iov, 1);
+		spa_assert_se(tx->size <= PW_NET_BATCH_SIZE);
+		spa_assert_se(tx->n_packets <= PW_NET_BATCH_MAX);
+	}
+	spa_assert_se(pw_net_tx_flush(tx) == -EBADF);
+	spa_assert_se(tx->n_packets == 0);
+
+	/* a packet that does not fit in a batch is refused */
+	iov.iov_base = big;
+	iov.iov_len = sizeof(big);
+	spa_assert_se(pw_net_tx_add(tx, &iov, 1) == -EMSGSIZE);
+	spa_assert_se(tx->n_packets == 0);
+
+	pw_net_tx_free(tx);
+}
+
+static void run_send_receive(enum pw_net_batch_mode tx_mode, enum pw_net_batch_mode rx_mode,
+		size_t size)
+{
+	struct sockaddr_in sa_tx, sa_rx;
+	struct pw_net_tx *tx;
+	struct pw_net_rx *rx;
+	struct pw_net_stats stats;
+	struct data d;
+	int fd_tx, fd_rx;
+	uint32_t i, n_packets;
+	ssize_t res;
+
+	fd_rx = make_socket(&sa_rx);
+	fd_tx = make_socket(&sa_tx);
+	spa_assert_se(connect(fd_tx, (struct sockaddr*)&sa_rx, sizeof(sa_rx)) == 0);
+	/* room for two full batches */
+	i = 4 * PW_NET_GRO_SIZE;
+	setsockopt(fd_rx, SOL_SOCKET, SO_RCVBUF, &i, sizeof(i));
+
+	tx = pw_net_tx_new(tx_mode);
+	rx = pw_net_rx_new(rx_mode, 2048);
+	spa_assert_se(tx != NULL && rx != NULL);
+	spa_assert_se(pw_net_tx_set_fd(tx, fd_tx) == 0);
+	pw_net_rx_set_fd(rx, fd_rx);
+
+	/* a full batch of equally sized packets, the last one smaller */
+	n_packets = SPA_MIN((uint32_t)N_PACKETS, (uint32_t)(PW_NET_BATCH_SIZE / size));
+	for (i = 0; i < n_packets; i++)
+		queue_packet(tx, i, i + 1 < n_packets ? size : size / 2);
+	spa_assert_se(tx->n_packets == n_packets);
+	res = pw_net_tx_flush(tx);
+	spa_assert_se(res == (ssize_t)n_packets);
+	/* a full batch does not make GSO fail */
+	spa_assert_se(tx->mode == tx_mode);
+
+	spa_zero(d);
+	receive_all(rx, fd_rx, &d, n_packets);
+	for (i = 0; i < n_packets; i++) {
+		spa_assert_se(d.seq[i] == i);
+		spa_assert_se(d.sizes[i] == (i + 1 < n_packets ? size : size / 2));
+	}
+
+	/* packets of different sizes are sent with mmsg without leaving
+	 * the GSO mode */
+	for (i = 0; i < 4; i++)
+		queue_packet(tx, i, 100 + i);
+	spa_assert_se(pw_net_tx_flush(tx) == 4);
+	spa_assert_se(tx->mode == tx_mode);
+
+	spa_zero(d);
+	receive_all(rx, fd_rx, &d, 4);
+	for (i = 0; i < 4; i++)
+		spa_assert_se(d.sizes[i] == 100 + i);
+
+	pw_net_stats_get(&tx->stats, &stats);
+	spa_assert_se(stats.packets == n_packets + 4);
+	spa_assert_se(stats.syscalls >= 2);
+	spa_assert_se(stats.syscalls <= stats.packets);
+
+	pw_net_rx_free(rx);
+	pw_net_tx_free(tx);
+	close(fd_tx);
+	close(fd_rx);
+}
+
+static bool gso_supported(void)
+{
+#ifdef UDP_SEGMENT
+	struct sockaddr_in sa;
+	int fd, val = 1000;
+	bool res;
+
+	fd = make_socket(&sa);
+	res = setsockopt(fd, SOL_UDP, UDP_SEGMENT, &val, sizeof(val)) == 0;
+	close(fd);
+	return res;
+#else
+	return false;
+#endif
+}
+
+static void test_send_receive(void)
+{
+	run_send_receive(PW_NET_BATCH_MMSG, PW_NET_BATCH_SINGLE, 1200);
+	run_send_receive(PW_NET_BATCH_MMSG, PW_NET_BATCH_MMSG, 1200);
+
+	if (!gso_supported()) {
+		fprintf(stderr, "UDP_SEGMENT not supported, skipping GSO\n");
+		return;
+	}
+	run_send_receive(PW_NET_BATCH_GSO, PW_NET_BATCH_MMSG, 1200);
+	run_send_receive(PW_NET_BATCH_GSO, PW_NET_BATCH_GSO, 1200);
+	/* 64 packets that fill the batch completely */
+	run_send_receive(PW_NET_BATCH_GSO, PW_NET_BATCH_GSO, PW_NET_BATCH_SIZE / N_PACKETS);
+}
+
+/* a send error that is not about GSO support keeps the GSO mode */
+static void test_send_error(void)
+{
+	struct sockaddr_in sa;
+	struct pw_net_tx *tx;
+	int fd;
+	uint32_t i;
+
+	/* not connected, sending fails with EDESTADDRREQ */
+	fd = make_socket(&sa);
+	tx = pw_net_tx_new(PW_NET_BATCH_GSO);
+	spa_assert_se(tx != NULL);
+	spa_assert_se(pw_net_tx_set_fd(tx, fd) == 0);
+
+	for (i = 0; i < 4; i++)
+		queue_packet(tx, i, 1000);
+	spa_assert_se(pw_net_tx_flush(tx) == -EDESTADDRREQ);
+	spa_assert_se(tx->mode == PW_NET_BATCH_GSO);
+	spa_assert_se(tx->n_packets == 0);
+
+	pw_net_tx_free(tx);
+	close(fd);
+}
+
+/* packets larger than the buffers are truncated until the buffers grow */
+static void test_rx_resize(void)
+{
+	struct sockaddr_in sa_rx, sa_tx;
+	struct pw_net_rx *rx;
+	struct data d;
+	uint8_t buf[1200];
+	int fd_tx, fd_rx;
+
+	fd_rx = make_socket(&sa_rx);
+	fd_tx = make_socket(&sa_tx);
+	spa_assert_se(connect(fd_tx, (struct sockaddr*)&sa_rx, sizeof(sa_rx)) == 0);
+
+	rx = pw_net_rx_new(PW_NET_BATCH_MMSG, 200);
+	spa_assert_se(rx != NULL);
+
+	memset(buf, 1, sizeof(buf));
+	spa_assert_se(send(fd_tx, buf, sizeof(buf), 0) == sizeof(buf));
+	spa_zero(d);
+	receive_all(rx, fd_rx, &d, 1);
+	spa_assert_se(d.sizes[0] == 200);
+
+	/* never shrinks */
+	spa_assert_se(pw_net_rx_resize(rx, 100) == 0);
+	spa_assert_se(rx->buffer_size == 200);
+	spa_assert_se(pw_net_rx_resize(rx, 1500) == 0);
+	spa_assert_se(rx->buffer_size == 1500);
+
+	memset(buf, 2, sizeof(buf));
+	spa_assert_se(send(fd_tx, buf, sizeof(buf), 0) == sizeof(buf));
+	spa_zero(d);
+	receive_all(rx, fd_rx, &d, 1);
+	spa_assert_se(d.sizes[0] == sizeof(buf));
+	spa_assert_se(d.seq[0] == 2);
+
+	pw_net_rx_free(rx);
+	close(fd_tx);
+	close(fd_rx);
+}
+
+int main(int argc, char *argv[])
+{
+	test_batch_size();
+	test_send_receive();
+	test_rx_resize();
+	test_send_error();
+	return 0;
+}
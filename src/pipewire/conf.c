@@ -553,6 +553,7 @@ int pw_conf_load_state(const char *prefix, const char *name, struct pw_propertie
 struct data {
 	struct pw_context *context;
 	struct pw_properties *props;
+	struct pw_module_preload *preload;
 	int count;
 };
 
@@ -794,7 +795,10 @@ static int parse_modules(void *user_data, const char *location,
 		if (!have_match)
 			continue;
 
-		if (name != NULL) {
+		if (name != NULL && d->preload != NULL) {
+			pw_module_preload_add(d->preload, name, false);
+			d->count++;
+		} else if (name != NULL) {
 			res = load_module(context, name, args, flags);
 			if (res < 0)
 				break;
@@ -807,6 +811,21 @@ static int parse_modules(void *user_data, const char *location,
 	return res;
 }
 
+static void preload_object(struct pw_context *context, struct pw_module_preload *preload,
+		const char *args)
+{
+	char factory_name[256];
+	const char *lib;
+
+	if (args == NULL ||
+	    spa_json_str_object_find(args, strlen(args), PW_KEY_FACTORY_NAME,
+			    factory_name, sizeof(factory_name)) <= 0)
+		return;
+
+	if ((lib = pw_context_find_spa_lib(context, factory_name)) != NULL)
+		pw_module_preload_add(preload, lib, true);
+}
+
 static int create_object(struct pw_context *context, const char *key, const char *args, const char *flags)
 {
 	struct pw_impl_factory *factory;
@@ -896,7 +915,10 @@ static int parse_objects(void *user_data, const char *location,
 		if (!have_match)
 			continue;
 
-		if (factory != NULL) {
+		if (factory != NULL && d->preload != NULL) {
+			preload_object(context, d->preload, args);
+			d->count++;
+		} else if (factory != NULL) {
 			res = create_object(context, factory, args, flags);
 			if (res < 0)
 				break;
@@ -1423,6 +1445,21 @@ int pw_context_parse_conf_section(struct pw_context *context,
 	return res == 0 ? data.count : res;
 }
 
+int pw_context_conf_preload(struct pw_context *context, struct pw_properties *conf,
+		struct pw_module_preload *preload)
+{
+	struct data data = { .context = context, .preload = preload };
+	int res;
+
+	if ((res = pw_conf_section_for_each(&conf->dict, "context.modules",
+				parse_modules, &data)) < 0)
+		return res;
+	if ((res = pw_conf_section_for_each(&conf->dict, "context.objects",
+				parse_objects, &data)) < 0)
+		return res;
+	return data.count;
+}
+
 SPA_EXPORT
 int pw_context_conf_section_match_rules(struct pw_context *context, const char *section,
 		const struct spa_dict *props,
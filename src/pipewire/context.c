@@ -41,6 +41,11 @@ PW_LOG_TOPIC_EXTERN(log_context);
 
 #define DEFAULT_DATA_LOOPS	1
 
+/* the name of the loop that schedules nodes on all data loops */
+#define POOL_LOOP_NAME		"data-pool"
+/* max size of the data of an invoke on the loop pool from a data loop */
+#define POOL_INVOKE_MAX		1024u
+
 #if !defined(FNM_EXTMATCH)
 #define FNM_EXTMATCH 0
 #endif
@@ -50,6 +55,29 @@ struct data_loop {
 	bool autostart;
 	bool started;
 	uint64_t last_used;
+	uint64_t pool_count;
+};
+
+struct pool_source;
+
+struct pool_worker_source {
+	struct spa_source source;
+	struct pool_source *ps;
+	struct data_loop *loop;
+};
+
+struct pool_source {
+	struct spa_list link;
+	struct spa_source *source;
+	uint32_t n_workers;
+	struct pool_worker_source workers[];
+};
+
+struct loop_pool {
+	struct pw_loop loop;
+	struct spa_loop iface;
+	struct spa_list source_list;
+	bool active;
 };
 
 /** \cond */
@@ -59,11 +87,22 @@ struct impl {
 	struct spa_plugin_loader plugin_loader;
 	unsigned int recalc:1;
 	unsigned int recalc_pending:1;
+	unsigned int recalc_full:1;
+
+	struct spa_source *recalc_event;
+	struct spa_list recalc_list;		/* dirty nodes */
+	const char *recalc_reason;		/* first reason since the last recalc */
+	uint32_t recalc_requests;
+	uint64_t recalc_target;			/* global serial of the target driver */
+
+	struct pw_context_recalc_stats recalc_stats;
 
 	uint32_t cpu_count;
 
 	uint32_t n_data_loops;
 	struct data_loop data_loops[MAX_LOOPS];
+
+	struct loop_pool loop_pool;
 };
 
 
@@ -73,6 +112,8 @@ struct factory_entry {
 };
 /** \endcond */
 
+static void do_recalc_graph(void *data, uint64_t count);
+
 static void fill_properties(struct pw_context *context)
 {
 	struct pw_properties *properties = context->properties;
@@ -300,6 +341,313 @@ static void data_loop_stop(struct impl *impl, struct data_loop *loop)
 	loop->started = false;
 }
 
+/* The loop pool is a virtual loop that dispatches its sources on all data
+ * loops. Nodes added to the pool can be processed by whatever data loop is
+ * idle when the node becomes ready. A node that is triggered again while one
+ * loop processes it is processed again by that loop, see process_node.
+ *
+ * Because every data loop holds its lock while dispatching, taking the locks
+ * of all data loops ensures that no node in the pool is being processed. This
+ * is what invoke and locked do. */
+static void loop_pool_lock(struct impl *impl)
+{
+	uint32_t i;
+	for (i = 0; i < impl->n_data_loops; i++)
+		pw_loop_lock(impl->data_loops[i].impl->loop);
+}
+
+static void loop_pool_unlock(struct impl *impl)
+{
+	uint32_t i;
+	for (i = impl->n_data_loops; i > 0; i--)
+		pw_loop_unlock(impl->data_loops[i-1].impl->loop);
+}
+
+static void loop_pool_dispatch(struct spa_source *source)
+{
+	struct pool_worker_source *ws = SPA_CONTAINER_OF(source, struct pool_worker_source, source);
+	struct spa_source *s = ws->ps->source;
+
+	s->rmask = source->rmask;
+	s->func(s);
+	/* the source clears the rmask when another data loop took the event */
+	if (s->rmask)
+		ws->loop->pool_count++;
+}
+
+static void pool_source_remove_workers(struct pool_source *ps)
+{
+	while (ps->n_workers > 0) {
+		struct pool_worker_source *ws = &ps->workers[--ps->n_workers];
+		spa_loop_remove_source(ws->loop->impl->loop->loop, &ws->source);
+	}
+}
+
+static int pool_source_add_workers(struct impl *impl, struct pool_source *ps)
+{
+	struct spa_source *source = ps->source;
+	uint32_t i;
+	int res;
+
+	for (i = 0; i < impl->n_data_loops; i++) {
+		struct pool_worker_source *ws = &ps->workers[ps->n_workers];
+
+		ws->ps = ps;
+		ws->loop = &impl->data_loops[i];
+		ws->source.func = loop_pool_dispatch;
+		ws->source.data = ps;
+		ws->source.fd = source->fd;
+		/* sources of the loop pool are added to every data loop, only
+		 * wake up one of the idle loops */
+		ws->source.mask = source->mask | SPA_IO_EXCLUSIVE;
+
+		res = spa_loop_add_source(ws->loop->impl->loop->loop, &ws->source);
+		if (res == -EEXIST) {
+			/* the data loops share a System that polls each fd only
+			 * once, the loop that has it will dispatch it */
+			pw_log_debug("%p: fd:%d already polled by another data loop",
+					impl, source->fd);
+			continue;
+		}
+		if (res < 0) {
+			pool_source_remove_workers(ps);
+			return res;
+		}
+		ps->n_workers++;
+	}
+	return ps->n_workers > 0 ? 0 : -EEXIST;
+}
+
+static struct pool_source *find_pool_source(struct impl *impl, struct spa_source *source)
+{
+	struct pool_source *ps;
+	spa_list_for_each(ps, &impl->loop_pool.source_list, link)
+		if (ps->source == source)
+			return ps;
+	return NULL;
+}
+
+static int loop_pool_add_source(void *object, struct spa_source *source)
+{
+	struct impl *impl = object;
+	struct pool_source *ps;
+	int res;
+
+	ps = calloc(1, sizeof(*ps) + impl->n_data_loops * sizeof(struct pool_worker_source));
+	if (ps == NULL)
+		return -errno;
+
+	ps->source = source;
+	source->loop = &impl->loop_pool.iface;
+	source->priv = NULL;
+	source->rmask = 0;
+
+	loop_pool_lock(impl);
+	if ((res = pool_source_add_workers(impl, ps)) < 0) {
+		loop_pool_unlock(impl);
+		source->loop = NULL;
+		free(ps);
+		return res;
+	}
+	spa_list_append(&impl->loop_pool.source_list, &ps->link);
+	loop_pool_unlock(impl);
+
+	return 0;
+}
+
+static int loop_pool_update_source(void *object, struct spa_source *source)
+{
+	struct impl *impl = object;
+	struct pool_source *ps;
+	int res;
+
+	loop_pool_lock(impl);
+	if ((ps = find_pool_source(impl, source)) == NULL) {
+		res = -ENOENT;
+	} else {
+		/* an exclusive fd can't be modified, add it again */
+		pool_source_remove_workers(ps);
+		res = pool_source_add_workers(impl, ps);
+	}
+	loop_pool_unlock(impl);
+	return res;
+}
+
+static int loop_pool_remove_source(void *object, struct spa_source *source)
+{
+	struct impl *impl = object;
+	struct pool_source *ps;
+
+	loop_pool_lock(impl);
+	if ((ps = find_pool_source(impl, source)) != NULL) {
+		pool_source_remove_workers(ps);
+		spa_list_remove(&ps->link);
+	}
+	loop_pool_unlock(impl);
+
+	source->loop = NULL;
+	source->rmask = 0;
+	free(ps);
+
+	return ps ? 0 : -ENOENT;
+}
+
+static bool loop_pool_in_thread(struct impl *impl)
+{
+	uint32_t i;
+	for (i = 0; i < impl->n_data_loops; i++)
+		if (pw_data_loop_in_thread(impl->data_loops[i].impl))
+			return true;
+	return false;
+}
+
+struct pool_invoke {
+	spa_invoke_func_t func;
+	void *user_data;
+	size_t size;
+	/* followed by the data */
+};
+
+static int do_pool_invoke(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct impl *impl = user_data;
+	const struct pool_invoke *inv = data;
+	int res;
+
+	loop_pool_lock(impl);
+	res = inv->func(&impl->loop_pool.iface, true, seq,
+			inv->size ? SPA_PTROFF(inv, sizeof(*inv), void) : NULL,
+			inv->size, inv->user_data);
+	loop_pool_unlock(impl);
+	return res;
+}
+
+static int loop_pool_invoke(void *object, spa_invoke_func_t func, uint32_t seq,
+		const void *data, size_t size, bool block, void *user_data)
+{
+	struct impl *impl = object;
+	uint8_t buffer[sizeof(struct pool_invoke) + POOL_INVOKE_MAX];
+	struct pool_invoke *inv = (struct pool_invoke *)buffer;
+	int res;
+
+	if (func == NULL)
+		return 0;
+
+	if (!loop_pool_in_thread(impl)) {
+		loop_pool_lock(impl);
+		res = func(&impl->loop_pool.iface, true, seq, data, size, user_data);
+		loop_pool_unlock(impl);
+		return res;
+	}
+
+	/* a data loop holds its own lock, taking the locks of the other loops
+	 * could deadlock with a thread that takes them in order. Let the main
+	 * loop run the function with all loops locked. */
+	if (block) {
+		pw_log_warn("%p: can't block on the loop pool from a data loop", impl);
+		return -EDEADLK;
+	}
+	if (size > POOL_INVOKE_MAX)
+		return -ENOSPC;
+
+	inv->func = func;
+	inv->user_data = user_data;
+	inv->size = size;
+	if (size > 0)
+		memcpy(SPA_PTROFF(inv, sizeof(*inv), void), data, size);
+
+	return pw_loop_invoke(impl->this.main_loop, do_pool_invoke, seq,
+			inv, sizeof(*inv) + size, false, impl);
+}
+
+static int loop_pool_locked(void *object, spa_invoke_func_t func, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct impl *impl = object;
+	int res;
+
+	if (loop_pool_in_thread(impl)) {
+		pw_log_warn("%p: can't lock the loop pool from a data loop", impl);
+		return -EDEADLK;
+	}
+
+	loop_pool_lock(impl);
+	res = func(&impl->loop_pool.iface, false, seq, data, size, user_data);
+	loop_pool_unlock(impl);
+	return res;
+}
+
+static const struct spa_loop_methods loop_pool_methods = {
+	SPA_VERSION_LOOP_METHODS,
+	.add_source = loop_pool_add_source,
+	.update_source = loop_pool_update_source,
+	.remove_source = loop_pool_remove_source,
+	.invoke = loop_pool_invoke,
+	.locked = loop_pool_locked,
+};
+
+static struct pw_loop *acquire_loop_pool(struct impl *impl)
+{
+	struct loop_pool *pool = &impl->loop_pool;
+	struct pw_loop *first;
+	uint32_t i;
+	int res;
+
+	if (pool->active)
+		return &pool->loop;
+
+	for (i = 0; i < impl->n_data_loops; i++) {
+		if ((res = data_loop_start(impl, &impl->data_loops[i])) < 0) {
+			errno = -res;
+			return NULL;
+		}
+	}
+	/* timers and the system are taken from the first data loop */
+	first = impl->data_loops[0].impl->loop;
+
+	pool->iface.iface = SPA_INTERFACE_INIT(
+			SPA_TYPE_INTERFACE_Loop,
+			SPA_VERSION_LOOP,
+			&loop_pool_methods, impl);
+	pool->loop.system = first->system;
+	pool->loop.loop = &pool->iface;
+	pool->loop.control = first->control;
+	pool->loop.utils = first->utils;
+	pool->loop.name = POOL_LOOP_NAME;
+	pool->active = true;
+
+	pw_log_info("%p: created loop pool with %d data-loops", impl, impl->n_data_loops);
+
+	return &pool->loop;
+}
+
+/* nodes on the loop pool are processed by any data loop */
+bool pw_context_is_loop_pool(struct pw_context *context, struct pw_loop *loop)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	return impl->loop_pool.active && loop == &impl->loop_pool.loop;
+}
+
+SPA_EXPORT
+uint32_t pw_context_get_loop_pool_stats(struct pw_context *context,
+		struct pw_loop_pool_stats *stats, uint32_t max_stats)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	uint32_t i, n;
+
+	if (!impl->loop_pool.active)
+		return 0;
+
+	n = SPA_MIN(impl->n_data_loops, max_stats);
+	for (i = 0; i < n; i++) {
+		struct data_loop *l = &impl->data_loops[i];
+		stats[i].name = l->impl->loop->name;
+		stats[i].count = SPA_ATOMIC_LOAD(l->pool_count);
+	}
+	return n;
+}
+
 /** Create a new context object
  *
  * \param main_loop the main loop to use
@@ -307,6 +655,30 @@ static void data_loop_stop(struct impl *impl, struct data_loop *loop)
  *
  * \return a newly allocated context object
  */
+static struct pw_module_preload *start_preload(struct impl *impl, struct pw_properties *conf)
+{
+	struct pw_context *this = &impl->this;
+	struct pw_module_preload *preload;
+	int32_t n_threads;
+
+	n_threads = pw_properties_get_int32(this->properties,
+			"context.modules.preload-threads", 0);
+	if (n_threads < 0)
+		n_threads = impl->cpu_count;
+	if (n_threads == 0)
+		return NULL;
+
+	if ((preload = pw_module_preload_new(this, n_threads)) == NULL)
+		return NULL;
+
+	if (pw_context_conf_preload(this, conf, preload) <= 0 ||
+	    pw_module_preload_start(preload) < 0) {
+		pw_module_preload_destroy(preload);
+		return NULL;
+	}
+	return preload;
+}
+
 SPA_EXPORT
 struct pw_context *pw_context_new(struct pw_loop *main_loop,
 			    struct pw_properties *properties,
@@ -318,7 +690,9 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	void *dbus_iface = NULL;
 	uint32_t i, n_support, vm_type;
 	struct pw_properties *conf;
+	struct pw_module_preload *preload;
 	struct spa_cpu *cpu;
+	uint64_t t1, t2, t3;
 	int res = 0;
 
 	impl = calloc(1, sizeof(struct impl) + user_data_size);
@@ -348,6 +722,7 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	spa_list_init(&this->device_list);
 	spa_list_init(&this->client_list);
 	spa_list_init(&this->node_list);
+	spa_list_init(&this->node_waiter_list);
 	spa_list_init(&this->factory_list);
 	spa_list_init(&this->metadata_list);
 	spa_list_init(&this->link_list);
@@ -355,6 +730,9 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	spa_list_init(&this->control_list[1]);
 	spa_list_init(&this->export_list);
 	spa_list_init(&this->driver_list);
+	spa_list_init(&impl->loop_pool.source_list);
+	spa_list_init(&impl->recalc_list);
+	impl->recalc_target = SPA_ID_INVALID;
 	spa_hook_list_init(&this->listener_list);
 	spa_hook_list_init(&this->driver_listener_list);
 
@@ -379,7 +757,7 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	if ((res = pw_conf_load_conf_for_context (properties, conf)) < 0)
 		goto error_free;
 
-	n_support = pw_get_support(this->support, SPA_N_ELEMENTS(this->support) - 6);
+	n_support = pw_get_support(this->support, SPA_N_ELEMENTS(this->support) - 8);
 	cpu = spa_support_find(this->support, n_support, SPA_TYPE_INTERFACE_CPU);
 
 	vm_type = SPA_CPU_VM_NONE;
@@ -439,6 +817,11 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 		res = -errno;
 		goto error_free;
 	}
+	impl->recalc_event = pw_loop_add_event(this->main_loop, do_recalc_graph, impl);
+	if (impl->recalc_event == NULL) {
+		res = -errno;
+		goto error_free;
+	}
 
 	init_plugin_loader(impl);
 
@@ -481,15 +864,28 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	if ((res = pw_context_parse_conf_section(this, conf, "context.spa-libs")) < 0)
 		goto error_free;
 	pw_log_info("%p: parsed %d context.spa-libs items", this, res);
-	if ((res = pw_context_parse_conf_section(this, conf, "context.modules")) < 0)
-		goto error_free;
+
+	preload = start_preload(impl, conf);
+
+	t1 = get_time_ns(this->main_loop->system);
+	res = pw_context_parse_conf_section(this, conf, "context.modules");
+	t2 = get_time_ns(this->main_loop->system);
+	if (res < 0)
+		goto error_free_preload;
 	if (res > 0 || pw_properties_get_bool(properties, "context.modules.allow-empty", false))
-		pw_log_info("%p: parsed %d context.modules items", this, res);
+		pw_log_info("%p: parsed %d context.modules items in %"PRIu64"us",
+				this, res, (t2 - t1) / 1000u);
 	else
 		pw_log_warn("%p: no modules loaded from context.modules", this);
-	if ((res = pw_context_parse_conf_section(this, conf, "context.objects")) < 0)
-		goto error_free;
-	pw_log_info("%p: parsed %d context.objects items", this, res);
+	res = pw_context_parse_conf_section(this, conf, "context.objects");
+	t3 = get_time_ns(this->main_loop->system);
+	if (res < 0)
+		goto error_free_preload;
+	pw_log_info("%p: parsed %d context.objects items in %"PRIu64"us",
+			this, res, (t3 - t2) / 1000u);
+
+	if (preload)
+		pw_module_preload_destroy(preload);
 	if ((res = pw_context_parse_conf_section(this, conf, "context.exec")) < 0)
 		goto error_free;
 	pw_log_info("%p: parsed %d context.exec items", this, res);
@@ -508,6 +904,9 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 
 	return this;
 
+error_free_preload:
+	if (preload)
+		pw_module_preload_destroy(preload);
 error_free:
 	pw_context_destroy(this);
 error_cleanup:
@@ -583,6 +982,14 @@ void pw_context_destroy(struct pw_context *context)
 	if (context->work_queue)
 		pw_work_queue_destroy(context->work_queue);
 
+	if (impl->recalc_event)
+		pw_loop_destroy_source(context->main_loop, impl->recalc_event);
+
+	pw_log_info("%p: graph recalc runs:%"PRIu64" coalesced:%"PRIu64" time:%"PRIu64"ns "
+			"max:%"PRIu64"ns", context, impl->recalc_stats.count,
+			impl->recalc_stats.coalesced, impl->recalc_stats.time,
+			impl->recalc_stats.max_time);
+
 	pw_properties_free(context->properties);
 	pw_properties_free(context->conf);
 
@@ -633,6 +1040,10 @@ const struct spa_support *context_get_support(struct pw_context *context, uint32
 		context->support[n++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_DataSystem, loop->system);
 		context->support[n++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_DataLoop, loop->loop);
 	}
+	/* plugins that make their own threads create them with the thread
+	 * utils so that the RT module can make them realtime */
+	context->support[n++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_ThreadUtils,
+			context->thread_utils ? context->thread_utils : pw_thread_utils_get());
 	*n_support = n;
 	return context->support;
 }
@@ -725,6 +1136,10 @@ struct pw_loop *pw_context_acquire_loop(struct pw_context *context, const struct
 		pw_log_info("%p: using main loop num-data-loops:%d", context, impl->n_data_loops);
 		return context->main_loop;
 	}
+	if (spa_streq(name, POOL_LOOP_NAME)) {
+		pw_log_info("%p: using loop pool num-data-loops:%d", context, impl->n_data_loops);
+		return acquire_loop_pool(impl);
+	}
 
 	loop = acquire_data_loop(impl, name, klass);
 	return loop ? loop->loop : NULL;
@@ -1105,6 +1520,8 @@ static void move_to_driver(struct pw_context *context, struct spa_list *nodes,
 {
 	struct pw_impl_node *n;
 	pw_log_debug("driver: %p %s runnable:%u", driver, driver->name, driver->runnable);
+	/* the driver gets new followers, evaluate it */
+	driver->recalc = true;
 	spa_list_consume(n, nodes, sort_link) {
 		spa_list_remove(&n->sort_link);
 
@@ -1308,7 +1725,84 @@ static uint32_t find_best_rate(const uint32_t *rates, uint32_t n_rates, uint32_t
 	return def;
 }
 
-/* here we evaluate the complete state of the graph.
+static inline void mark_recalc(struct spa_list *queue, struct pw_impl_node *node)
+{
+	if (node->recalc || !node->registered)
+		return;
+	node->recalc = true;
+	spa_list_append(queue, &node->sort_link);
+}
+
+/* Mark the dirty nodes and everything that the evaluation of those nodes can
+ * touch: the peers, the nodes in the same groups, the driver and the other
+ * followers of the driver. The result is closed under the relations that
+ * collect_nodes() follows so that the unmarked nodes can keep their state. */
+static uint32_t mark_dirty_nodes(struct impl *impl)
+{
+	struct pw_context *context = &impl->this;
+	struct spa_list queue;
+	struct pw_impl_node *n, *t;
+	struct pw_impl_port *p;
+	struct pw_impl_link *l;
+	uint32_t count = 0;
+
+	spa_list_init(&queue);
+	spa_list_consume(n, &impl->recalc_list, recalc_link) {
+		spa_list_remove(&n->recalc_link);
+		n->recalc_dirty = false;
+		mark_recalc(&queue, n);
+	}
+	spa_list_consume(n, &queue, sort_link) {
+		spa_list_remove(&n->sort_link);
+		count++;
+
+		mark_recalc(&queue, n->driver_node);
+		spa_list_for_each(t, &n->follower_list, follower_link)
+			mark_recalc(&queue, t);
+
+		spa_list_for_each(p, &n->input_ports, link)
+			spa_list_for_each(l, &p->links, input_link)
+				mark_recalc(&queue, l->output->node);
+		spa_list_for_each(p, &n->output_ports, link)
+			spa_list_for_each(l, &p->links, output_link)
+				mark_recalc(&queue, l->input->node);
+
+		if (n->groups == NULL && n->link_groups == NULL && n->sync_groups == NULL)
+			continue;
+
+		spa_list_for_each(t, &context->node_list, link) {
+			if (t->recalc)
+				continue;
+			/* the sync groups are only joined by nodes that
+			 * want to sync, see collect_nodes() */
+			if (pw_strv_find_common(t->groups, n->groups) < 0 &&
+			    pw_strv_find_common(t->link_groups, n->link_groups) < 0 &&
+			    ((!n->sync && !t->sync) ||
+			     pw_strv_find_common(t->sync_groups, n->sync_groups) < 0))
+				continue;
+			mark_recalc(&queue, t);
+		}
+	}
+	return count;
+}
+
+/* Nodes are compared by their global serial, the memory of a destroyed
+ * node can be reused for a new node */
+static inline uint64_t node_serial(struct pw_impl_node *node)
+{
+	return node && node->global ? pw_global_get_serial(node->global) : SPA_ID_INVALID;
+}
+
+static void clear_dirty_nodes(struct impl *impl)
+{
+	struct pw_impl_node *n;
+	spa_list_consume(n, &impl->recalc_list, recalc_link) {
+		spa_list_remove(&n->recalc_link);
+		n->recalc_dirty = false;
+	}
+}
+
+/* here we evaluate the state of the graph.
  *
  * It roughly operates in 3 stages:
  *
@@ -1322,37 +1816,72 @@ static uint32_t find_best_rate(const uint32_t *rates, uint32_t n_rates, uint32_t
  * 3. go over all drivers again, collect the quantum/rate of all followers, select
  *    the desired final value and activate the followers and then the driver.
  *
- * A complete graph evaluation is performed for each change that is made to the
- * graph, such as making/destroying links, adding/removing nodes, property changes such
- * as quantum/rate changes or metadata changes.
+ * An evaluation is requested for each change that is made to the graph, such as
+ * making/destroying links, adding/removing nodes, property changes such as
+ * quantum/rate changes or metadata changes. The requests are collected and
+ * handled together in the next iteration of the main loop, unless the caller
+ * needs the new state right away. A synchronous evaluation also handles all
+ * the requests that were queued before it.
+ *
+ * When the requests are for specific nodes, only the nodes that can be affected
+ * by them are evaluated, see mark_dirty_nodes(). The other nodes are skipped
+ * in all stages. When the target driver for the unassigned nodes changes, we
+ * fall back to a complete evaluation.
  */
-int pw_context_recalc_graph(struct pw_context *context, const char *reason)
+static void recalc_graph(struct impl *impl)
 {
-	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	struct pw_context *context = &impl->this;
 	struct settings *settings = &context->settings;
 	struct pw_impl_node *n, *s, *target, *fallback;
+	struct pw_context_recalc_stats *stats = &impl->recalc_stats;
 	const uint32_t *rates;
 	uint32_t max_quantum, min_quantum, def_quantum, rate_quantum, floor_quantum, ceil_quantum;
-	uint32_t n_rates, def_rate, transport;
-	bool freewheel, global_force_rate, global_force_quantum;
+	uint32_t n_rates, def_rate, transport, n_nodes;
+	bool freewheel, global_force_rate, global_force_quantum, full;
 	struct spa_list collect;
+	uint64_t t1, t2;
 
-	pw_log_info("%p: busy:%d reason:%s", context, impl->recalc, reason);
+	if (impl->recalc_requests == 0)
+		return;
 
-	if (impl->recalc) {
-		impl->recalc_pending = true;
-		return -EBUSY;
-	}
+	t1 = get_time_ns(context->main_loop->system);
 
 again:
 	impl->recalc = true;
+	impl->recalc_pending = false;
+	full = impl->recalc_full;
+
+	pw_log_info("%p: reason:%s requests:%u full:%d", context,
+			impl->recalc_reason, impl->recalc_requests, full);
+
+	stats->coalesced += impl->recalc_requests - 1;
+	impl->recalc_requests = 0;
+	impl->recalc_full = false;
+
+	if (full) {
+		clear_dirty_nodes(impl);
+	} else {
+		n_nodes = mark_dirty_nodes(impl);
+		pw_log_debug("%p: marked %u nodes", context, n_nodes);
+	}
+
+restart:
 	freewheel = false;
+	n_nodes = 0;
 
-	/* clean up the flags first */
+	/* clean up the flags first, the nodes that we don't evaluate are
+	 * marked visited so that they are skipped in stage 1 and 2 */
 	spa_list_for_each(n, &context->node_list, link) {
+		if (full)
+			n->recalc = true;
+		if (!n->recalc) {
+			n->visited = true;
+			continue;
+		}
 		n->visited = false;
 		n->checked = 0;
 		n->runnable = n->always_process && n->active;
+		n_nodes++;
 	}
 
 	get_quantums(context, &def_quantum, &min_quantum, &max_quantum, &rate_quantum,
@@ -1407,6 +1936,16 @@ again:
 	if (target == NULL)
 		target = fallback;
 
+	/* the unassigned nodes that we skipped might need to move to
+	 * the new target, evaluate everything */
+	if (!full && node_serial(target) != impl->recalc_target) {
+		pw_log_debug("%p: target changed %"PRIu64"->%"PRIu64, context,
+				impl->recalc_target, node_serial(target));
+		full = true;
+		goto restart;
+	}
+	impl->recalc_target = node_serial(target);
+
 	/* update the freewheel status */
 	if (context->freewheeling != freewheel)
 		context_set_freewheel(context, freewheel);
@@ -1463,7 +2002,7 @@ again:
 		uint32_t node_n_rates, node_def_rate;
 		uint32_t node_max_quantum, node_min_quantum, node_def_quantum, node_rate_quantum;
 
-		if (!n->driving || n->exported)
+		if (!n->driving || n->exported || !n->recalc)
 			continue;
 
 		node_def_quantum = def_quantum;
@@ -1669,7 +2208,8 @@ again:
 			if (do_reconfigure) {
 				reconfigure_driver(context, n);
 				/* we might be suspended now and the links need to be prepared again */
-				goto again;
+				full = true;
+				goto restart;
 			}
 			/* we have a pending change. We place the new values in the
 			 * pending fields so that they are picked up by the driver in
@@ -1723,15 +2263,93 @@ again:
 		/* now that all the followers are ready, start the driver */
 		ensure_state(n, running);
 	}
-	impl->recalc = false;
-	if (impl->recalc_pending) {
-		impl->recalc_pending = false;
+	spa_list_for_each(n, &context->node_list, link)
+		n->recalc = false;
+
+	pw_log_debug("%p: evaluated %u nodes", context, n_nodes);
+	stats->nodes += n_nodes;
+	if (full)
+		stats->full++;
+
+	/* new requests while we were busy */
+	if (impl->recalc_pending)
 		goto again;
+
+	impl->recalc = false;
+
+	t2 = get_time_ns(context->main_loop->system);
+	stats->count++;
+	stats->time += t2 - t1;
+	stats->max_time = SPA_MAX(stats->max_time, t2 - t1);
+
+	pw_log_debug("%p: recalc took %"PRIu64"ns runs:%"PRIu64" coalesced:%"PRIu64
+			" time:%"PRIu64"ns max:%"PRIu64"ns", context, t2 - t1,
+			stats->count, stats->coalesced, stats->time, stats->max_time);
+}
+
+static void do_recalc_graph(void *data, uint64_t count)
+{
+	recalc_graph(data);
+}
+
+static int request_recalc(struct impl *impl, struct pw_impl_node *node, const char *reason,
+		bool sync)
+{
+	pw_log_debug("%p: busy:%d node:%p reason:%s sync:%d", impl, impl->recalc,
+			node, reason, sync);
+
+	if (impl->recalc_event == NULL)
+		return 0;
+
+	if (node == NULL) {
+		impl->recalc_full = true;
+	} else if (!node->recalc_dirty) {
+		node->recalc_dirty = true;
+		spa_list_append(&impl->recalc_list, &node->recalc_link);
+	}
+	impl->recalc_stats.requests++;
+	if (impl->recalc_requests++ == 0)
+		impl->recalc_reason = reason;
+
+	if (impl->recalc) {
+		impl->recalc_pending = true;
+		return -EBUSY;
 	}
+	if (sync)
+		recalc_graph(impl);
+	else if (impl->recalc_requests == 1)
+		pw_loop_signal_event(impl->this.main_loop, impl->recalc_event);
 
 	return 0;
 }
 
+/** Evaluate the complete graph now */
+int pw_context_recalc_graph(struct pw_context *context, const char *reason)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	return request_recalc(impl, NULL, reason, true);
+}
+
+/** Evaluate the part of the graph that node is in. When sync is false,
+ * the evaluation is done later, together with the other requests. */
+int pw_context_recalc_graph_node(struct pw_context *context, struct pw_impl_node *node,
+		const char *reason, bool sync)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	if (!node->registered)
+		return 0;
+	return request_recalc(impl, node, reason, sync);
+}
+
+SPA_EXPORT
+int pw_context_get_recalc_stats(struct pw_context *context,
+		struct pw_context_recalc_stats *stats)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	*stats = impl->recalc_stats;
+	return 0;
+}
+
 SPA_EXPORT
 int pw_context_add_spa_lib(struct pw_context *context,
 		const char *factory_regexp, const char *lib)
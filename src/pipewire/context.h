@@ -141,6 +141,33 @@ struct pw_loop *pw_context_acquire_loop(struct pw_context *context, const struct
  * Since 1.1.0 */
 void pw_context_release_loop(struct pw_context *context, struct pw_loop *loop);
 
+/** Stats of a data loop of the data-pool loop. Since 1.5.0 */
+struct pw_loop_pool_stats {
+	const char *name;	/**< name of the data loop */
+	uint64_t count;		/**< number of pool sources processed by the data loop */
+};
+
+/** Get the per data loop stats of the data-pool loop, returns the number of
+ * filled stats, 0 when the data-pool loop is not in use.
+ * Since 1.5.0 */
+uint32_t pw_context_get_loop_pool_stats(struct pw_context *context,
+		struct pw_loop_pool_stats *stats, uint32_t max_stats);
+
+/** Stats of the graph recalculation. Since 1.5.0 */
+struct pw_context_recalc_stats {
+	uint64_t requests;	/**< number of requested recalculations */
+	uint64_t coalesced;	/**< number of requests handled together with another one */
+	uint64_t count;		/**< number of recalculations */
+	uint64_t full;		/**< number of recalculations of the complete graph */
+	uint64_t nodes;		/**< total number of evaluated nodes */
+	uint64_t time;		/**< total time of the recalculations in nanoseconds */
+	uint64_t max_time;	/**< maximum time of one recalculation in nanoseconds */
+};
+
+/** Get the graph recalculation stats. Since 1.5.0 */
+int pw_context_get_recalc_stats(struct pw_context *context,
+		struct pw_context_recalc_stats *stats);
+
 /** Get the work queue from the context: Since 0.3.26 */
 struct pw_work_queue *pw_context_get_work_queue(struct pw_context *context);
 
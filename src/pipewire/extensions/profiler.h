@@ -5,7 +5,12 @@
 #ifndef PIPEWIRE_EXT_PROFILER_H
 #define PIPEWIRE_EXT_PROFILER_H
 
+#include <errno.h>
+
 #include <spa/utils/defs.h>
+#include <spa/utils/hook.h>
+#include <spa/utils/ringbuffer.h>
+#include <spa/pod/pod.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -21,7 +26,7 @@ extern "C" {
  */
 #define PW_TYPE_INTERFACE_Profiler		PW_TYPE_INFO_INTERFACE_BASE "Profiler"
 
-#define PW_VERSION_PROFILER			3
+#define PW_VERSION_PROFILER			4
 struct pw_profiler;
 
 #ifndef PW_API_PROFILER
@@ -33,14 +38,32 @@ struct pw_profiler;
 #define PW_PROFILER_PERM_MASK			PW_PERM_R
 
 #define PW_PROFILER_EVENT_PROFILE		0
-#define PW_PROFILER_EVENT_NUM			1
+#define PW_PROFILER_EVENT_RING			1
+#define PW_PROFILER_EVENT_NUM			2
 
 /** \ref pw_profiler events */
 struct pw_profiler_events {
-#define PW_VERSION_PROFILER_EVENTS		0
+#define PW_VERSION_PROFILER_EVENTS		1
 	uint32_t version;
 
+	/**
+	 * Profiler data, a struct of Profiler objects. Only emitted for
+	 * resources with a version < 4, newer resources get a ring.
+	 */
 	void (*profile) (void *data, const struct spa_pod *pod);
+
+	/**
+	 * A ring with the profiler data of a driver was added or removed.
+	 *
+	 * Since version 4:1
+	 *
+	 * \param id the id of the driver node
+	 * \param mem_id the id of the memory with the \ref pw_profiler_ring
+	 *		or SPA_ID_INVALID when the ring is removed
+	 * \param offset the offset of the ring in mem_id
+	 * \param size the size of the ring, including the header
+	 */
+	void (*ring) (void *data, uint32_t id, uint32_t mem_id, uint32_t offset, uint32_t size);
 };
 
 #define PW_PROFILER_METHOD_ADD_LISTENER		0
@@ -71,6 +94,106 @@ PW_API_PROFILER int pw_profiler_add_listener(struct pw_profiler *object,
 
 #define PW_KEY_PROFILER_NAME		"profiler.name"
 
+/** Shared memory ring with profiler data.
+ *
+ * The data area follows the header and contains Profiler objects, each
+ * padded to 8 bytes. The data thread of the driver appends objects without
+ * locking and overwrites old data, it is never blocked by readers. Readers
+ * keep their own read index and use a \ref pw_profiler_ring_reader.
+ *
+ * The writer only publishes the header fields, it never reads them back. */
+struct pw_profiler_ring {
+	uint32_t version;		/**< version of the ring layout, 0 */
+	uint32_t size;			/**< size of the data area, a power of 2 */
+	uint32_t max_record;		/**< maximum size of one object */
+	uint32_t padding;
+	struct spa_ringbuffer ring;	/**< only the writeindex is used */
+	uint8_t padding2[40];
+};
+
+#define PW_PROFILER_RING_DATA(r)	SPA_PTROFF(r, sizeof(struct pw_profiler_ring), void)
+
+/** A reader of a \ref pw_profiler_ring. The size and max_record of the
+ * ring are checked once by pw_profiler_ring_reader_init(), only the data
+ * and the writeindex of the ring are read after that. */
+struct pw_profiler_ring_reader {
+	const void *data;		/**< the data area */
+	const uint32_t *writeindex;	/**< the write index of the writer */
+	uint32_t size;			/**< size of the data area, a power of 2 */
+	uint32_t max_record;		/**< maximum size of one object */
+	uint32_t index;			/**< the read index */
+};
+
+/** Set up a reader for the ring r in mem_size bytes of memory. Reading
+ * starts at the current writeindex.
+ *
+ * \return 0 on success, -EINVAL when the header is invalid */
+PW_API_PROFILER int pw_profiler_ring_reader_init(struct pw_profiler_ring_reader *rd,
+		struct pw_profiler_ring *r, size_t mem_size)
+{
+	uint32_t size, max_record;
+
+	if (mem_size < sizeof(*r) ||
+	    __atomic_load_n(&r->version, __ATOMIC_RELAXED) != 0)
+		return -EINVAL;
+
+	/* the memory can change, only look at the values once */
+	size = __atomic_load_n(&r->size, __ATOMIC_RELAXED);
+	max_record = __atomic_load_n(&r->max_record, __ATOMIC_RELAXED);
+	if (size == 0 || (size & (size - 1)) != 0 || size > mem_size - sizeof(*r) ||
+	    max_record < sizeof(struct spa_pod) || max_record > size)
+		return -EINVAL;
+
+	rd->data = PW_PROFILER_RING_DATA(r);
+	rd->writeindex = &r->ring.writeindex;
+	rd->size = size;
+	rd->max_record = max_record;
+	rd->index = __atomic_load_n(rd->writeindex, __ATOMIC_ACQUIRE);
+	return 0;
+}
+
+/** Read the next object from the ring into data of max bytes.
+ *
+ * \return the size of the object, 0 when no object is available or
+ *	-EPIPE when data was overwritten before it could be read. The read
+ *	index is then moved to the writeindex and reading can continue. */
+PW_API_PROFILER int pw_profiler_ring_read(struct pw_profiler_ring_reader *rd,
+		void *data, uint32_t max)
+{
+	uint32_t size = rd->size, mask = size - 1, w, len;
+	int32_t avail;
+	struct spa_pod *pod = (struct spa_pod *)data;
+
+	w = __atomic_load_n(rd->writeindex, __ATOMIC_ACQUIRE);
+	avail = (int32_t)(w - rd->index);
+	if (avail < 0 || (uint32_t)avail + rd->max_record > size)
+		goto lost;
+	if ((uint32_t)avail < sizeof(struct spa_pod) || max < sizeof(struct spa_pod))
+		return 0;
+
+	spa_ringbuffer_read_data(NULL, rd->data, size,
+			rd->index & mask, pod, sizeof(struct spa_pod));
+	len = SPA_ROUND_UP_N(SPA_POD_SIZE(pod), 8);
+	if (len > (uint32_t)avail || len > max || len > rd->max_record)
+		goto lost;
+
+	spa_ringbuffer_read_data(NULL, rd->data, size,
+			rd->index & mask, data, len);
+
+	/* check that the writer did not overwrite what we just copied */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	w = __atomic_load_n(rd->writeindex, __ATOMIC_RELAXED);
+	if ((uint32_t)(w - rd->index) + rd->max_record > size ||
+	    SPA_ROUND_UP_N(SPA_POD_SIZE(pod), 8) != len)
+		goto lost;
+
+	rd->index += len;
+	return len;
+lost:
+	rd->index = __atomic_load_n(rd->writeindex, __ATOMIC_ACQUIRE);
+	return -EPIPE;
+}
+
 /**
  * \}
  */
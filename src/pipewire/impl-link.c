@@ -54,6 +54,16 @@ struct impl {
 	struct spa_io_buffers io[2];
 
 	bool async;
+
+	/* last format found when both ports needed a format, valid as long as
+	 * the params of the ports did not change */
+	struct {
+		struct spa_pod *format;
+		struct pw_impl_port *port;
+		uint32_t serial[2];
+	} cache;
+
+	uint64_t setup_start;
 };
 
 /** \endcond */
@@ -89,6 +99,15 @@ static inline int port_set_busy_id(struct pw_impl_link *link, struct port_info *
 	return res;
 }
 
+static void link_recalc_graph(struct pw_impl_link *link, const char *reason, bool sync)
+{
+	struct impl *impl = SPA_CONTAINER_OF(link, struct impl, this);
+	/* the ports are still known when the link is removed from them. A sync
+	 * request also handles the queued request of the output */
+	pw_context_recalc_graph_node(link->context, impl->output.port->node, reason, false);
+	pw_context_recalc_graph_node(link->context, impl->input.port->node, reason, sync);
+}
+
 static void link_update_state(struct pw_impl_link *link, enum pw_link_state state, int res, char *error)
 {
 	struct impl *impl = SPA_CONTAINER_OF(link, struct impl, this);
@@ -120,6 +139,18 @@ static void link_update_state(struct pw_impl_link *link, enum pw_link_state stat
 
 	pw_impl_link_emit_state_changed(link, old, state, error);
 
+	if (state == PW_LINK_STATE_PAUSED && impl->setup_start != 0) {
+		uint64_t elapsed = get_time_ns(link->context->main_loop->system) - impl->setup_start;
+
+		pw_log_debug("%p: setup took %"PRIu64" nsec", link, elapsed);
+		pw_properties_setf(link->properties, PW_KEY_LINK_SETUP_TIME,
+				"%"PRIu64, elapsed / 1000u);
+		link->info.change_mask |= PW_LINK_CHANGE_MASK_PROPS;
+		impl->setup_start = 0;
+	} else if (state == PW_LINK_STATE_ERROR) {
+		impl->setup_start = 0;
+	}
+
 	link->info.change_mask |= PW_LINK_CHANGE_MASK_STATE;
 	if (state == PW_LINK_STATE_ERROR ||
 	    state == PW_LINK_STATE_PAUSED ||
@@ -135,11 +166,11 @@ static void link_update_state(struct pw_impl_link *link, enum pw_link_state stat
 	if (old < PW_LINK_STATE_PAUSED && state == PW_LINK_STATE_PAUSED) {
 		link->prepared = true;
 		link->preparing = false;
-		pw_context_recalc_graph(link->context, "link prepared");
+		link_recalc_graph(link, "link prepared", false);
 	} else if (old >= PW_LINK_STATE_PAUSED && state < PW_LINK_STATE_PAUSED) {
 		link->prepared = false;
 		link->preparing = false;
-		pw_context_recalc_graph(link->context, "link unprepared");
+		link_recalc_graph(link, "link unprepared", true);
 	} else if (state == PW_LINK_STATE_INIT) {
 		link->prepared = false;
 		link->preparing = false;
@@ -230,6 +261,7 @@ static int link_find_format(struct pw_impl_link *this,
 			struct spa_pod_builder *builder,
 			char **error)
 {
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
 	int res;
 	uint32_t state[2];
 	uint32_t idx[2] = { 0, 0 };
@@ -275,8 +307,7 @@ static int link_find_format(struct pw_impl_link *this,
 		pw_log_debug("%p: Got %s format:", this, dir[1]);
 		pw_log_pod(SPA_LOG_LEVEL_DEBUG, filter);
 
-		if ((res = spa_node_port_enum_params_sync(node[0],
-						     info[0]->port->direction, port_id[0],
+		if ((res = pw_impl_port_enum_params_sync(info[0]->port,
 						     SPA_PARAM_EnumFormat, &idx[0],
 						     filter, format, builder)) <= 0) {
 			if (res == -ENOENT || res == 0) {
@@ -314,8 +345,7 @@ static int link_find_format(struct pw_impl_link *this,
 		pw_log_debug("%p: Got %s format:", this, dir[0]);
 		pw_log_pod(SPA_LOG_LEVEL_DEBUG, filter);
 
-		if ((res = spa_node_port_enum_params_sync(node[1],
-						     info[1]->port->direction, port_id[1],
+		if ((res = pw_impl_port_enum_params_sync(info[1]->port,
 						     SPA_PARAM_EnumFormat, &idx[1],
 						     filter, format, builder)) <= 0) {
 			if (res == -ENOENT || res == 0) {
@@ -339,14 +369,29 @@ static int link_find_format(struct pw_impl_link *this,
 	} else if (state[0] == PW_IMPL_PORT_STATE_CONFIGURE && state[1] == PW_IMPL_PORT_STATE_CONFIGURE) {
 		bool do_filter = true;
 		int count = 0;
+
+		if (impl->cache.format != NULL &&
+		    impl->cache.port == info[0]->port &&
+		    impl->cache.serial[0] == info[0]->port->enum_format_serial &&
+		    impl->cache.serial[1] == info[1]->port->enum_format_serial) {
+			uint32_t offset = builder->state.offset;
+
+			pw_log_debug("%p: params unchanged, using previous format", this);
+			if ((res = spa_pod_builder_raw_padded(builder, impl->cache.format,
+						SPA_POD_SIZE(impl->cache.format))) < 0) {
+				*error = spa_aprintf("failed to add pod");
+				goto error;
+			}
+			*format = spa_pod_builder_deref(builder, offset);
+			return 1;
+		}
 	      again:
 		/* both ports need a format, we start with a format from port 0 and use that
 		 * as a filter for port 1. Because the filter has higher priority, its
 		 * defaults will be prefered. */
 		pw_log_debug("%p: do enum %s %d", this, dir[0], idx[0]);
 		spa_pod_builder_init(&fb, fbuf, sizeof(fbuf));
-		if ((res = spa_node_port_enum_params_sync(node[0],
-						     info[0]->port->direction, port_id[0],
+		if ((res = pw_impl_port_enum_params_sync(info[0]->port,
 						     SPA_PARAM_EnumFormat, &idx[0],
 						     NULL, &filter, &fb)) != 1) {
 			if (res == -ENOENT) {
@@ -373,8 +418,7 @@ static int link_find_format(struct pw_impl_link *this,
 		pw_log_debug("%p: enum %s %d with filter: %p", this, dir[1], idx[1], filter);
 		pw_log_pod(SPA_LOG_LEVEL_DEBUG, filter);
 
-		if ((res = spa_node_port_enum_params_sync(node[1],
-						     info[1]->port->direction, port_id[1],
+		if ((res = pw_impl_port_enum_params_sync(info[1]->port,
 						     SPA_PARAM_EnumFormat, &idx[1],
 						     filter, format, builder)) != 1) {
 			if (res == 0 && filter != NULL) {
@@ -387,6 +431,12 @@ static int link_find_format(struct pw_impl_link *this,
 
 		pw_log_debug("%p: Got filtered:", this);
 		pw_log_pod(SPA_LOG_LEVEL_DEBUG, *format);
+
+		free(impl->cache.format);
+		impl->cache.format = spa_pod_copy(*format);
+		impl->cache.port = info[0]->port;
+		impl->cache.serial[0] = info[0]->port->enum_format_serial;
+		impl->cache.serial[1] = info[1]->port->enum_format_serial;
 	} else {
 		res = -EBADF;
 		*error = spa_aprintf("error bad node state");
@@ -439,6 +489,7 @@ static int do_negotiate(struct pw_impl_link *this)
 	if (state[0] != PW_IMPL_PORT_STATE_CONFIGURE && state[1] != PW_IMPL_PORT_STATE_CONFIGURE)
 		return 0;
 
+	impl->setup_start = get_time_ns(context->main_loop->system);
 	link_update_state(this, PW_LINK_STATE_NEGOTIATING, 0, NULL);
 
 #if 0
@@ -1720,7 +1771,7 @@ void pw_impl_link_destroy(struct pw_impl_link *link)
 	}
 
 	if (was_prepared)
-		pw_context_recalc_graph(link->context, "link destroy");
+		link_recalc_graph(link, "link destroy", true);
 
 	pw_log_debug("%p: free", impl);
 	pw_impl_link_emit_free(link);
@@ -1734,6 +1785,7 @@ void pw_impl_link_destroy(struct pw_impl_link *link)
 	free(link->name);
 	free(link->info.format);
 	free((char *) link->info.error);
+	free(impl->cache.format);
 	free(impl);
 }
 
@@ -19,6 +19,7 @@
 #define PW_API_MODULE_IMPL	SPA_EXPORT
 #include "pipewire/impl.h"
 #include "pipewire/private.h"
+#include "pipewire/thread.h"
 
 PW_LOG_TOPIC_EXTERN(log_module);
 #define PW_LOG_TOPIC_DEFAULT log_module
@@ -30,9 +31,26 @@ struct impl {
 	uint32_t destroy_work_id;
 };
 
+#define MAX_PRELOAD_THREADS	16
+
 #define pw_module_resource_info(r,...)	pw_resource_call(r,struct pw_module_events,info,0,__VA_ARGS__)
 
 
+struct preload_item {
+	char *name;
+	bool spa_lib;
+	void *hnd;
+};
+
+struct pw_module_preload {
+	struct pw_context *context;
+	struct pw_array items;
+	uint32_t n_threads;
+	uint32_t next;
+	struct spa_thread *threads[MAX_PRELOAD_THREADS];
+	bool started;
+};
+
 /** \endcond */
 
 static char *find_module(const char *path, const char *name, int level)
@@ -85,6 +103,192 @@ static char *find_module(const char *path, const char *name, int level)
 	return NULL;
 }
 
+static const char *get_module_dir(void)
+{
+	const char *module_dir;
+
+	module_dir = getenv("PIPEWIRE_MODULE_DIR");
+	if (module_dir == NULL)
+		module_dir = MODULEDIR;
+	return module_dir;
+}
+
+static void *open_module(const char *name, char **filename)
+{
+	const char *module_dir, *state = NULL, *p;
+	char path_part[PATH_MAX];
+	size_t len;
+	void *hnd;
+
+	module_dir = get_module_dir();
+	pw_log_debug("module dir: %s", module_dir);
+
+	*filename = NULL;
+	while ((p = pw_split_walk(module_dir, ":", &len, &state))) {
+		if (spa_scnprintf(path_part, sizeof(path_part), "%.*s", (int)len, p) <= 0)
+			continue;
+		if ((*filename = find_module(path_part, name, 8)) == NULL)
+			continue;
+
+		pw_log_debug("trying to load module: %s (%s)", name, *filename);
+
+		hnd = dlopen(*filename, RTLD_NOW | RTLD_LOCAL);
+		if (hnd != NULL)
+			return hnd;
+
+		pw_log_debug("open failed: %s", dlerror());
+		free(*filename);
+		*filename = NULL;
+	}
+	return NULL;
+}
+
+static void *open_spa_lib(const char *lib)
+{
+	const char *plugin_dir, *state = NULL, *p;
+	char filename[PATH_MAX];
+	size_t len;
+	void *hnd;
+
+	if ((plugin_dir = getenv("SPA_PLUGIN_DIR")) == NULL)
+		plugin_dir = PLUGINDIR;
+
+	while ((p = pw_split_walk(plugin_dir, ":", &len, &state))) {
+		if (spa_scnprintf(filename, sizeof(filename), "%.*s/%s.so",
+					(int)len, p, lib) <= 0)
+			continue;
+		if ((hnd = dlopen(filename, RTLD_NOW)) != NULL)
+			return hnd;
+	}
+	return NULL;
+}
+
+static void *preload_thread(void *data)
+{
+	struct pw_module_preload *preload = data;
+	struct spa_system *system = preload->context->main_loop->system;
+	uint32_t n_items = pw_array_get_len(&preload->items, struct preload_item);
+
+	while (true) {
+		struct preload_item *item;
+		uint32_t idx = SPA_ATOMIC_INC(preload->next) - 1;
+		char *filename = NULL;
+		uint64_t t1, t2;
+
+		if (idx >= n_items)
+			break;
+
+		item = pw_array_get_unchecked(&preload->items, idx, struct preload_item);
+
+		t1 = get_time_ns(system);
+		if (item->spa_lib) {
+			item->hnd = open_spa_lib(item->name);
+		} else {
+			item->hnd = open_module(item->name, &filename);
+			free(filename);
+		}
+		t2 = get_time_ns(system);
+
+		pw_log_debug("%p: preloaded %s %s: %s %"PRIu64"us", preload,
+				item->spa_lib ? "spa-lib" : "module", item->name,
+				item->hnd ? "ok" : "failed", (t2 - t1) / 1000u);
+	}
+	return NULL;
+}
+
+/** Make a new module preloader
+ *
+ * The preloader opens the modules and SPA libraries that will be used in
+ * the worker threads so that the main thread can initialize the modules
+ * without waiting for the libraries to be loaded and relocated.
+ *
+ * \param context a \ref pw_context
+ * \param n_threads the number of worker threads
+ * \return a new preloader or NULL on failure
+ */
+struct pw_module_preload *
+pw_module_preload_new(struct pw_context *context, uint32_t n_threads)
+{
+	struct pw_module_preload *preload;
+
+	if ((preload = calloc(1, sizeof(*preload))) == NULL)
+		return NULL;
+
+	preload->context = context;
+	preload->n_threads = SPA_CLAMP(n_threads, 1u, (uint32_t)MAX_PRELOAD_THREADS);
+	pw_array_init(&preload->items, 16 * sizeof(struct preload_item));
+	return preload;
+}
+
+/** Add a module or SPA library to the preloader, must be called before
+ * \ref pw_module_preload_start */
+int pw_module_preload_add(struct pw_module_preload *preload, const char *name, bool spa_lib)
+{
+	struct preload_item *item;
+
+	spa_return_val_if_fail(!preload->started, -EBUSY);
+
+	pw_array_for_each(item, &preload->items) {
+		if (item->spa_lib == spa_lib && spa_streq(item->name, name))
+			return 0;
+	}
+	if ((item = pw_array_add(&preload->items, sizeof(*item))) == NULL)
+		return -errno;
+
+	item->name = strdup(name);
+	item->spa_lib = spa_lib;
+	item->hnd = NULL;
+	return 1;
+}
+
+/** Start the worker threads of the preloader */
+int pw_module_preload_start(struct pw_module_preload *preload)
+{
+	struct spa_dict_item items[1];
+	uint32_t i, n_items;
+
+	spa_return_val_if_fail(!preload->started, -EBUSY);
+
+	preload->started = true;
+
+	n_items = pw_array_get_len(&preload->items, struct preload_item);
+	preload->n_threads = SPA_MIN(preload->n_threads, n_items);
+
+	pw_log_info("%p: preloading %u modules and libraries with %u threads",
+			preload, n_items, preload->n_threads);
+
+	items[0] = SPA_DICT_ITEM_INIT(SPA_KEY_THREAD_NAME, "pw-preload");
+	for (i = 0; i < preload->n_threads; i++) {
+		preload->threads[i] = pw_thread_utils_create(&SPA_DICT_INIT_ARRAY(items),
+				preload_thread, preload);
+		if (preload->threads[i] == NULL) {
+			pw_log_warn("%p: can't create preload thread: %m", preload);
+			break;
+		}
+	}
+	preload->n_threads = i;
+	return 0;
+}
+
+/** Wait for the worker threads and release the preloaded libraries. The
+ * modules that were loaded in the meantime keep their own reference. */
+void pw_module_preload_destroy(struct pw_module_preload *preload)
+{
+	struct preload_item *item;
+	uint32_t i;
+
+	for (i = 0; i < preload->n_threads; i++)
+		pw_thread_utils_join(preload->threads[i], NULL);
+
+	pw_array_for_each(item, &preload->items) {
+		if (item->hnd && pw_should_dlclose())
+			dlclose(item->hnd);
+		free(item->name);
+	}
+	pw_array_clear(&preload->items);
+	free(preload);
+}
+
 static int
 global_bind(void *object, struct pw_impl_client *client, uint32_t permissions,
 		 uint32_t version, uint32_t id)
@@ -143,12 +347,9 @@ pw_context_load_module(struct pw_context *context,
 	struct impl *impl;
 	void *hnd;
 	char *filename = NULL;
-	const char *module_dir;
 	int res;
 	pw_impl_module_init_func_t init_func;
-	const char *state = NULL, *p;
-	size_t len;
-	char path_part[PATH_MAX];
+	uint64_t t1, t2, t3;
 	static const char * const keys[] = {
 		PW_KEY_MODULE_NAME,
 		NULL
@@ -156,31 +357,9 @@ pw_context_load_module(struct pw_context *context,
 
 	pw_log_info("%p: name:%s args:%s", context, name, args);
 
-	module_dir = getenv("PIPEWIRE_MODULE_DIR");
-	if (module_dir == NULL) {
-		module_dir = MODULEDIR;
-		pw_log_debug("moduledir set to: %s", module_dir);
-	}
-	else {
-		pw_log_debug("PIPEWIRE_MODULE_DIR set to: %s", module_dir);
-	}
+	t1 = get_time_ns(context->main_loop->system);
 
-	while ((p = pw_split_walk(module_dir, ":", &len, &state))) {
-		if ((res = spa_scnprintf(path_part, sizeof(path_part), "%.*s", (int)len, p)) > 0) {
-			filename = find_module(path_part, name, 8);
-			if (filename != NULL) {
-				pw_log_debug("trying to load module: %s (%s) args(%s)", name, filename, args);
-
-				hnd = dlopen(filename, RTLD_NOW | RTLD_LOCAL);
-				if (hnd != NULL)
-					break;
-
-				pw_log_debug("open failed: %s", dlerror());
-				free(filename);
-				filename = NULL;
-			}
-		}
-	}
+	hnd = open_module(name, &filename);
 
 	if (filename == NULL)
 		goto error_not_found;
@@ -242,6 +421,8 @@ pw_context_load_module(struct pw_context *context,
 
 	pw_global_add_listener(this->global, &this->global_listener, &global_events, this);
 
+	t2 = get_time_ns(context->main_loop->system);
+
 	if ((res = init_func(this, args)) < 0)
 		goto error_init_failed;
 
@@ -249,7 +430,10 @@ pw_context_load_module(struct pw_context *context,
 
 	pw_impl_module_emit_registered(this);
 
-	pw_log_debug("%p: loaded module: %s", this, this->info.name);
+	t3 = get_time_ns(context->main_loop->system);
+
+	pw_log_info("%p: loaded module: %s load:%"PRIu64"us init:%"PRIu64"us", this,
+			this->info.name, (t2 - t1) / 1000u, (t3 - t2) / 1000u);
 
 	return this;
 
@@ -12,8 +12,10 @@
 #include <time.h>
 #include <malloc.h>
 #include <limits.h>
+#include <poll.h>
 
 #include <spa/support/system.h>
+#include <spa/support/cpu.h>
 #include <spa/pod/parser.h>
 #include <spa/pod/filter.h>
 #include <spa/pod/dynamic.h>
@@ -76,6 +78,12 @@ static const char * const global_keys[] = {
 	NULL
 };
 
+static struct pw_node_waiter *node_waiter_acquire(struct pw_context *context,
+		struct pw_loop *loop);
+static void node_waiter_release(struct pw_node_waiter *w);
+static void node_waiter_join(struct pw_impl_node *this);
+static void node_waiter_leave(struct pw_impl_node *this);
+
 #define pw_node_resource(r,m,v,...)	pw_resource_call(r,struct pw_node_events,m,v,__VA_ARGS__)
 #define pw_node_resource_info(r,...)	pw_node_resource(r,info,0,__VA_ARGS__)
 #define pw_node_resource_param(r,...)	pw_node_resource(r,param,0,__VA_ARGS__)
@@ -216,6 +224,7 @@ do_node_prepare(struct spa_loop *loop, bool async, uint32_t seq,
 			pw_log_warn("%p: read failed %m", this);
 
 		spa_loop_add_source(loop, &this->source);
+		node_waiter_join(this);
 	}
 	if (!this->remote || this->rt.target.activation->client_version < 1)
 		SPA_ATOMIC_STORE(this->rt.target.activation->status, PW_NODE_ACTIVATION_FINISHED);
@@ -230,6 +239,15 @@ do_node_prepare(struct spa_loop *loop, bool async, uint32_t seq,
 
 static void add_node_to_graph(struct pw_impl_node *node)
 {
+	/* nodes on the loop pool are processed by any of the data loops, the
+	 * hooks of one data loop can't process them */
+	if (node->waiter == NULL && !node->remote &&
+	    node->context->settings.node_shared_wakeup &&
+	    !pw_context_is_loop_pool(node->context, node->data_loop))
+		node->waiter = node_waiter_acquire(node->context, node->data_loop);
+
+	node->rt.pooled = pw_context_is_loop_pool(node->context, node->data_loop);
+
 	pw_loop_locked(node->data_loop, do_node_prepare, 1, NULL, 0, node);
 }
 
@@ -257,8 +275,10 @@ do_node_unprepare(struct spa_loop *loop, bool async, uint32_t seq,
 	if (!this->rt.prepared)
 		return 0;
 
-	if (!this->remote)
+	if (!this->remote) {
+		node_waiter_leave(this);
 		spa_loop_remove_source(loop, &this->source);
+	}
 
 	spa_list_for_each(t, &this->rt.target_list, link)
 		deactivate_target(this, t, trigger);
@@ -946,6 +966,11 @@ static void update_io(struct pw_impl_node *node)
                             sizeof(struct spa_io_clock));
 	pw_impl_node_set_io(node, SPA_IO_Position, &t->activation->position,
                             sizeof(struct spa_io_position));
+	/* remote nodes set the meter in their mapped activation, older
+	 * clients don't know it */
+	if (!node->remote)
+		pw_impl_node_set_io(node, SPA_IO_Meter, &t->activation->meter,
+				sizeof(struct spa_io_meter));
 }
 
 SPA_EXPORT
@@ -1003,7 +1028,7 @@ int pw_impl_node_register(struct pw_impl_node *this,
 		pw_impl_port_register(port, NULL);
 
 	if (this->active)
-		pw_context_recalc_graph(context, "register active node");
+		pw_context_recalc_graph_node(context, this, "register active node", false);
 
 	return 0;
 
@@ -1324,7 +1349,7 @@ static void check_properties(struct pw_impl_node *node)
 			recalc_reason, node->active);
 
 	if (recalc_reason != NULL && node->active)
-		pw_context_recalc_graph(context, recalc_reason);
+		pw_context_recalc_graph_node(context, node, recalc_reason, false);
 }
 
 static const char *str_status(uint32_t status)
@@ -1468,9 +1493,8 @@ static inline void calculate_stats(struct pw_impl_node *this,  struct pw_node_ac
  *
  * This code runs on the client and the server, depending on where the node is.
  */
-static inline int process_node(void *data, uint64_t nsec)
+static inline int do_process_node(struct pw_impl_node *this, uint64_t nsec)
 {
-	struct pw_impl_node *this = data;
 	struct pw_impl_port *p;
 	struct pw_node_activation *a = this->rt.target.activation;
 	struct spa_system *data_system = this->rt.target.system;
@@ -1540,6 +1564,30 @@ static inline int process_node(void *data, uint64_t nsec)
 	return status;
 }
 
+static inline int process_node(void *data, uint64_t nsec)
+{
+	struct pw_impl_node *this = data;
+	int res, status = 0;
+
+	if (SPA_LIKELY(!this->rt.pooled))
+		return do_process_node(this, nsec);
+
+	/* In the loop pool, the driver can reset a node that is still being
+	 * processed after an xrun and trigger it again, waking up another
+	 * data loop. That loop leaves the node to the loop that is processing
+	 * it, which processes the node again when it is done. */
+	if (SPA_ATOMIC_INC(this->rt.processing) > 1)
+		return 0;
+	do {
+		SPA_ATOMIC_STORE(this->rt.processing, 1);
+		if ((res = do_process_node(this, nsec)) != 0)
+			status = res;
+		nsec = get_time_ns(this->rt.target.system);
+	} while (!SPA_ATOMIC_CAS(this->rt.processing, 1, 0));
+
+	return status;
+}
+
 int pw_impl_node_trigger(struct pw_impl_node *node)
 {
 	uint64_t nsec = get_time_ns(node->rt.target.system);
@@ -1558,12 +1606,19 @@ static void node_on_fd_events(struct spa_source *source)
 	if (SPA_LIKELY(source->rmask & SPA_IO_IN)) {
 		uint64_t cmd, nsec;
 		struct spa_system *data_system = this->rt.target.system;
+		int res;
 
 		nsec = get_time_ns(data_system);
 
-		if (SPA_UNLIKELY(spa_system_eventfd_read(data_system, this->source.fd, &cmd) < 0))
+		if (SPA_UNLIKELY((res = spa_system_eventfd_read(data_system, this->source.fd, &cmd)) < 0)) {
+			/* in the loop pool, another data loop might have taken the
+			 * wakeup, clearing the rmask lets the pool know */
+			if (res == -EAGAIN) {
+				source->rmask = 0;
+				return;
+			}
 			pw_log_warn("%p: read failed %m", this);
-		else if (SPA_UNLIKELY(cmd > 1)) {
+		} else if (SPA_UNLIKELY(cmd > 1)) {
 			pw_log_info("(%s-%u) client missed %"PRIu64" wakeups",
 				this->name, this->info.id, cmd - 1);
 			update_xrun_stats(this->rt.target.activation, cmd - 1,
@@ -1578,6 +1633,164 @@ static void node_on_fd_events(struct spa_source *source)
 	}
 }
 
+/* Nodes on the same data loop share one wakeup. While the data loop is awake,
+ * the wakeup word of the nodes is SPIN and the peers that trigger the nodes
+ * don't write the eventfd. Before the data loop sleeps, it processes the
+ * triggered nodes, optionally polls the nodes for node.wakeup-spin-usec and
+ * then sets the wakeup word back to EVENTFD.
+ *
+ * This works for exported nodes in clients as well, the server and the
+ * other clients trigger the node with trigger_target_v2 when they know about
+ * the wakeup word. */
+struct pw_node_waiter {
+	struct spa_list link;
+	int ref;
+	struct pw_loop *loop;
+	struct spa_hook hook;
+	uint64_t spin_nsec;
+	struct spa_list nodes;		/* rt: nodes added to the loop */
+};
+
+static uint32_t node_waiter_process(struct pw_node_waiter *w)
+{
+	struct pw_impl_node *n;
+	uint32_t count = 0;
+
+	spa_list_for_each(n, &w->nodes, rt.waiter_link) {
+		if (SPA_ATOMIC_LOAD(n->rt.target.activation->status) != PW_NODE_ACTIVATION_TRIGGERED)
+			continue;
+		pw_log_trace_fp("%p: %s-%d process without wakeup", n, n->name, n->info.id);
+		process_node(n, get_time_ns(n->rt.target.system));
+		count++;
+	}
+	return count;
+}
+
+/* the epoll fd of the loop is readable when one of its sources is ready */
+static bool node_waiter_loop_ready(struct pw_node_waiter *w)
+{
+	struct pollfd pfd = { .fd = pw_loop_get_fd(w->loop), .events = POLLIN };
+	return poll(&pfd, 1, 0) > 0;
+}
+
+/* called with the loop lock, right before the loop sleeps */
+static void node_waiter_before(void *data)
+{
+	struct pw_node_waiter *w = data;
+	struct pw_impl_node *n;
+	uint64_t start = 0, now;
+
+	/* process the nodes that were triggered without eventfd, this includes
+	 * the nodes that we triggered ourselves. Then poll for triggers from
+	 * other threads and processes for at most spin_nsec. We hold the loop
+	 * lock, so stop as soon as the loop has other work, like an invoke or
+	 * a timer. */
+	while (true) {
+		if (node_waiter_process(w) > 0)
+			continue;
+		if (w->spin_nsec == 0)
+			break;
+		now = get_time_ns(w->loop->system);
+		if (start == 0)
+			start = now;
+		else if (now - start >= w->spin_nsec ||
+		    node_waiter_loop_ready(w))
+			break;
+	}
+
+	/* from now on, the peers need to write the eventfd. A peer that
+	 * still saw SPIN has changed the status before our store, so one
+	 * more pass catches it. */
+	spa_list_for_each(n, &w->nodes, rt.waiter_link)
+		SPA_ATOMIC_STORE(n->rt.target.activation->wakeup,
+				PW_NODE_ACTIVATION_WAKEUP_EVENTFD);
+	node_waiter_process(w);
+}
+
+static void node_waiter_after(void *data)
+{
+	struct pw_node_waiter *w = data;
+	struct pw_impl_node *n;
+
+	spa_list_for_each(n, &w->nodes, rt.waiter_link)
+		SPA_ATOMIC_STORE(n->rt.target.activation->wakeup,
+				PW_NODE_ACTIVATION_WAKEUP_SPIN);
+}
+
+static const struct spa_loop_control_hooks node_waiter_hooks = {
+	SPA_VERSION_LOOP_CONTROL_HOOKS,
+	.before = node_waiter_before,
+	.after = node_waiter_after,
+};
+
+static struct pw_node_waiter *node_waiter_acquire(struct pw_context *context,
+		struct pw_loop *loop)
+{
+	struct pw_node_waiter *w;
+
+	spa_list_for_each(w, &context->node_waiter_list, link) {
+		if (w->loop == loop) {
+			w->ref++;
+			return w;
+		}
+	}
+	w = calloc(1, sizeof(*w));
+	if (w == NULL)
+		return NULL;
+
+	w->ref = 1;
+	w->loop = loop;
+	w->spin_nsec = context->settings.node_wakeup_spin * SPA_NSEC_PER_USEC;
+	spa_list_init(&w->nodes);
+	spa_list_append(&context->node_waiter_list, &w->link);
+
+	pw_log_info("%p: shared wakeup for loop %s spin:%"PRIu64"ns", w,
+			loop->name, w->spin_nsec);
+	return w;
+}
+
+static void node_waiter_release(struct pw_node_waiter *w)
+{
+	if (--w->ref > 0)
+		return;
+	spa_list_remove(&w->link);
+	free(w);
+}
+
+/* called with the loop lock */
+static void node_waiter_join(struct pw_impl_node *this)
+{
+	struct pw_node_waiter *w = this->waiter;
+
+	/* the activation of an exported node is made by the server, when it
+	 * does not know about the wakeup word, it always writes the eventfd */
+	if (w == NULL || this->rt.target.activation->server_version < 2)
+		return;
+
+	SPA_ATOMIC_STORE(this->rt.target.activation->wakeup,
+			PW_NODE_ACTIVATION_WAKEUP_EVENTFD);
+	if (spa_list_is_empty(&w->nodes))
+		pw_loop_add_hook(w->loop, &w->hook, &node_waiter_hooks, w);
+	spa_list_append(&w->nodes, &this->rt.waiter_link);
+	this->rt.waiting = true;
+}
+
+/* called with the loop lock */
+static void node_waiter_leave(struct pw_impl_node *this)
+{
+	struct pw_node_waiter *w = this->waiter;
+
+	if (!this->rt.waiting)
+		return;
+
+	spa_list_remove(&this->rt.waiter_link);
+	this->rt.waiting = false;
+	if (spa_list_is_empty(&w->nodes))
+		spa_hook_remove(&w->hook);
+	SPA_ATOMIC_STORE(this->rt.target.activation->wakeup,
+			PW_NODE_ACTIVATION_WAKEUP_EVENTFD);
+}
+
 static void reset_segment(struct spa_io_segment *seg)
 {
 	spa_zero(*seg);
@@ -1702,7 +1915,7 @@ struct pw_impl_node *pw_context_create_node(struct pw_context *context,
 	this->rt.target.node = this;
 	this->rt.target.system = this->data_loop->system;
 	this->rt.target.fd = this->source.fd;
-	this->rt.target.trigger = trigger_target_v1;
+	this->rt.target.trigger = trigger_target_v2;
 
 	reset_position(this, &this->rt.target.activation->position);
 	this->rt.target.activation->sync_timeout = DEFAULT_SYNC_TIMEOUT;
@@ -1853,7 +2066,7 @@ static void node_info(void *data, const struct spa_node_info *info)
 		emit_params(node, changed_ids, n_changed_ids);
 
 	if (flags_changed)
-		pw_context_recalc_graph(node->context, "node flags changed");
+		pw_context_recalc_graph_node(node->context, node, "node flags changed", false);
 }
 
 static void node_port_info(void *data, enum spa_direction direction, uint32_t port_id,
@@ -2427,6 +2640,8 @@ void pw_impl_node_destroy(struct pw_impl_node *node)
 		spa_list_remove(&node->link);
 		if (node->driver)
 			remove_driver(context, node);
+		/* the links we destroy below should not queue us anymore */
+		node->registered = false;
 	}
 
 	if (node->node) {
@@ -2445,9 +2660,21 @@ void pw_impl_node_destroy(struct pw_impl_node *node)
 		pw_global_destroy(node->global);
 	}
 
-	if (active || had_driver)
-		pw_context_recalc_graph(context,
-				"active node destroy");
+	/* we might have been queued by the links */
+	if (node->recalc_dirty)
+		spa_list_remove(&node->recalc_link);
+
+	/* the links are gone now, only the driver and the groups can still
+	 * be affected. Without a driver, the node could have been the target
+	 * for the unassigned nodes. */
+	if (active || had_driver) {
+		if (!had_driver || node->driver || node->groups != NULL ||
+		    node->link_groups != NULL || node->sync_groups != NULL)
+			pw_context_recalc_graph(context, "active node destroy");
+		else
+			pw_context_recalc_graph_node(context, node->driver_node,
+					"active node destroy", true);
+	}
 
 	pw_log_debug("%p: free", node);
 	pw_impl_node_emit_free(node);
@@ -2455,6 +2682,8 @@ void pw_impl_node_destroy(struct pw_impl_node *node)
 	spa_hook_list_clean(&node->listener_list);
 
 	pw_memblock_unref(node->activation);
+	if (node->waiter)
+		node_waiter_release(node->waiter);
 
 	pw_param_clear(&impl->param_list, SPA_ID_INVALID);
 	pw_param_clear(&impl->pending_list, SPA_ID_INVALID);
@@ -2840,8 +3069,9 @@ int pw_impl_node_set_active(struct pw_impl_node *node, bool active)
 		pw_impl_node_emit_active_changed(node, active);
 
 		if (node->registered)
-			pw_context_recalc_graph(node->context,
-					active ? "node activate" : "node deactivate");
+			/* a deactivated node is out of the graph when we return */
+			pw_context_recalc_graph_node(node->context, node,
+					active ? "node activate" : "node deactivate", !active);
 		else if (!active && node->exported)
 			remove_node_from_graph(node);
 	}
@@ -683,6 +683,9 @@ static void update_info(struct pw_impl_port *port, const struct spa_port_info *i
 				changed_ids[n_changed_ids++] = id;
 
 			switch (id) {
+			case SPA_PARAM_EnumFormat:
+				port->enum_format_serial++;
+				break;
 			case SPA_PARAM_Latency:
 				port->have_latency_param =
 					SPA_FLAG_IS_SET(info->params[i].flags, SPA_PARAM_INFO_WRITE);
@@ -1590,6 +1593,61 @@ int pw_impl_port_for_each_param(struct pw_impl_port *port,
 	return res;
 }
 
+struct enum_params_sync_data {
+	struct spa_pod_builder *builder;
+	struct spa_pod **param;
+	uint32_t next;
+	int res;
+};
+
+static int enum_params_sync_cb(void *data, int seq,
+		uint32_t id, uint32_t index, uint32_t next, struct spa_pod *param)
+{
+	struct enum_params_sync_data *d = data;
+	uint32_t offset = d->builder->state.offset;
+
+	if ((d->res = spa_pod_builder_raw_padded(d->builder, param, SPA_POD_SIZE(param))) < 0)
+		return d->res;
+	*d->param = spa_pod_builder_deref(d->builder, offset);
+	d->next = next;
+	d->res = 1;
+	return 0;
+}
+
+static int noop_param_cb(void *data, int seq,
+		uint32_t id, uint32_t index, uint32_t next, struct spa_pod *param)
+{
+	return 0;
+}
+
+int pw_impl_port_enum_params_sync(struct pw_impl_port *port,
+			uint32_t param_id, uint32_t *index,
+			const struct spa_pod *filter, struct spa_pod **param,
+			struct spa_pod_builder *builder)
+{
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
+	struct enum_params_sync_data d = { builder, param, 0, 0 };
+	struct spa_param_info *pi;
+	int res;
+
+	pi = pw_param_info_find(port->info.params, port->info.n_params, param_id);
+	if (pi != NULL && pi->user != 1 && impl->cache_params)
+		pw_impl_port_for_each_param(port, 0, param_id, 0, 0, NULL, noop_param_cb, NULL);
+
+	if (pi == NULL || pi->user != 1)
+		return spa_node_port_enum_params_sync(port->node->node,
+				port->direction, port->port_id,
+				param_id, index, filter, param, builder);
+
+	res = pw_impl_port_for_each_param(port, 0, param_id, *index, 1, filter,
+			enum_params_sync_cb, &d);
+	if (res < 0)
+		return res;
+	if (d.res == 1)
+		*index = d.next;
+	return d.res;
+}
+
 struct param_filter {
 	struct pw_impl_port *in_port;
 	struct pw_impl_port *out_port;
@@ -75,6 +75,8 @@ extern "C" {
 #define PW_KEY_LOOP_CLASS		"loop.class"		/**< the classes this loop handles, array of strings */
 #define PW_KEY_LOOP_RT_PRIO		"loop.rt-prio"		/**< realtime priority of the loop */
 #define PW_KEY_LOOP_CANCEL		"loop.cancel"		/**< if the loop can be canceled */
+#define PW_KEY_LOOP_SYSTEM		"loop.system"		/**< the system functions of the loop,
+							  *  epoll or io-uring */
 
 /* context */
 #define PW_KEY_CONTEXT_PROFILE_MODULES	"context.profile.modules"	/**< a context profile for modules, deprecated */
@@ -259,6 +261,9 @@ extern "C" {
 								  *  link and the target will receive data
 								  *  in the next cycle */
 #define PW_KEY_LINK_ASYNC		"link.async"		/**< the link is using async io */
+#define PW_KEY_LINK_SETUP_TIME		"link.setup-time"	/**< time in microseconds it took to
+								  *  negotiate the format and buffers of
+								  *  the link */
 
 /** device properties */
 #define PW_KEY_DEVICE_ID		"device.id"		/**< device id */
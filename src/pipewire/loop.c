@@ -46,6 +46,8 @@ struct pw_loop *pw_loop_new(const struct spa_dict *props)
 	struct spa_support support[32];
 	uint32_t n_support;
 	const char *lib, *str, *name = NULL;
+	const char *system_factory = SPA_NAME_SUPPORT_SYSTEM;
+	char factory_name[64];
 
 	n_support = pw_get_support(support, 32);
 
@@ -57,17 +59,33 @@ struct pw_loop *pw_loop_new(const struct spa_dict *props)
 
 	this = &impl->this;
 
-	if (props)
+	if (props) {
 		lib = spa_dict_lookup(props, PW_KEY_LIBRARY_NAME_SYSTEM);
-	else
+		/* support.system.<name> for anything but the default epoll */
+		if ((str = spa_dict_lookup(props, PW_KEY_LOOP_SYSTEM)) != NULL &&
+		    !spa_streq(str, "epoll")) {
+			snprintf(factory_name, sizeof(factory_name), "%s.%s",
+					SPA_NAME_SUPPORT_SYSTEM, str);
+			system_factory = factory_name;
+		}
+	} else
 		lib = NULL;
 
 	impl->system_handle = pw_load_spa_handle(lib,
-			SPA_NAME_SUPPORT_SYSTEM,
+			system_factory,
 			props, n_support, support);
+	if (impl->system_handle == NULL && !spa_streq(system_factory, SPA_NAME_SUPPORT_SYSTEM)) {
+		/* the kernel might not support it, use epoll */
+		pw_log_warn("%p: can't make %s handle, using "SPA_NAME_SUPPORT_SYSTEM": %m",
+				this, system_factory);
+		system_factory = SPA_NAME_SUPPORT_SYSTEM;
+		impl->system_handle = pw_load_spa_handle(lib,
+				system_factory,
+				props, n_support, support);
+	}
 	if (impl->system_handle == NULL) {
 		res = -errno;
-		pw_log_error("%p: can't make "SPA_NAME_SUPPORT_SYSTEM" handle: %m", this);
+		pw_log_error("%p: can't make %s handle: %m", this, system_factory);
 		goto error_free;
 	}
 
@@ -57,6 +57,8 @@ struct settings {
 	int clock_rate_update_mode;
 	uint32_t clock_force_rate;		/* force a clock rate */
 	uint32_t clock_force_quantum;		/* force a quantum */
+	unsigned int node_shared_wakeup:1;	/* skip the eventfd when the node thread is awake */
+	uint32_t node_wakeup_spin;		/* spin time in usec before sleeping */
 };
 
 #define MAX_PARAMS	32
@@ -392,6 +394,7 @@ struct pw_context {
 	struct spa_list global_list;		/**< list of globals */
 	struct spa_list client_list;		/**< list of clients */
 	struct spa_list node_list;		/**< list of nodes */
+	struct spa_list node_waiter_list;	/**< shared wakeups of the data loops */
 	struct spa_list factory_list;		/**< list of factories */
 	struct spa_list metadata_list;		/**< list of metadata */
 	struct spa_list link_list;		/**< list of links */
@@ -545,8 +548,9 @@ static inline void copy_target(struct pw_node_target *dst, const struct pw_node_
  * 1 the activation status needs to be CAS
  *   async nodes, driver resumes async nodes
  *   transport with sync.group properties instead of client command
+ * 2 the wakeup word tells if the eventfd needs to be written
  */
-#define PW_VERSION_NODE_ACTIVATION	1
+#define PW_VERSION_NODE_ACTIVATION	2
 
 #define PW_NODE_ACTIVATION_PENDING_TRIGGER(status) ((status) <= PW_NODE_ACTIVATION_AWAKE)
 
@@ -563,6 +567,11 @@ static inline void copy_target(struct pw_node_target *dst, const struct pw_node_
  *   NOT_TRIGGERED -> TRIGGERED (eventfd is written)
  *   TRIGGERED -> AWAKE (eventfd is read, node starts processing)
  *   AWAKE -> FINISHED (node completed processing and triggered the peers)
+ *
+ * The wakeup word is written by the thread that processes the node. When it
+ * is SPIN, the thread is awake and will check the status before it sleeps,
+ * the eventfd does not need to be written after the TRIGGERED status change.
+ * Old versions leave the word at 0 and always get the eventfd.
  */
 struct pw_node_activation {
 #define PW_NODE_ACTIVATION_NOT_TRIGGERED	0
@@ -597,7 +606,10 @@ struct pw_node_activation {
 							 * CAS their node id in this array. */
 	uint64_t prev_awake_time;
 	uint64_t prev_finish_time;
-	uint32_t padding[7];				/* must be 0 */
+#define PW_NODE_ACTIVATION_WAKEUP_EVENTFD	0
+#define PW_NODE_ACTIVATION_WAKEUP_SPIN		1
+	uint32_t wakeup;				/* how to wake up the node, since version 2 */
+	uint32_t padding[6];				/* must be 0 */
 
 	uint32_t client_version;			/* verions of client, see above */
 	uint32_t server_version;			/* verions of server, see above */
@@ -630,6 +642,9 @@ struct pw_node_activation {
 	uint32_t command;				/* next command */
 	uint32_t reposition_owner;			/* owner id with new reposition info, last one
 							 * to update wins */
+
+	struct spa_io_meter meter;			/* meter results of the node, written by the
+							 * data thread of the node */
 };
 
 static inline uint64_t get_time_ns(struct spa_system *system)
@@ -669,6 +684,39 @@ static inline int trigger_target_v1(struct pw_node_target *t, uint64_t nsec)
 	return res;
 }
 
+/* like trigger_target_v1 but skips the eventfd write when the thread of the
+ * node is awake and will see the new status. Only used for nodes of which the
+ * other side knows about the wakeup word. */
+static inline int trigger_target_v2(struct pw_node_target *t, uint64_t nsec)
+{
+	struct pw_node_activation *a = t->activation;
+	struct pw_node_activation_state *state = &a->state[0];
+	int32_t pending = SPA_ATOMIC_DEC(state->pending);
+	int res = pending == 0, r;
+
+	pw_log_trace_fp("%p: (%s-%u) state:%p pending:%d/%d", t->node,
+				t->name, t->id, state, pending, state->required);
+
+	if (res) {
+		if (SPA_LIKELY(SPA_ATOMIC_CAS(a->status,
+					PW_NODE_ACTIVATION_NOT_TRIGGERED,
+					PW_NODE_ACTIVATION_TRIGGERED))) {
+			a->signal_time = nsec;
+			if (SPA_ATOMIC_LOAD(a->wakeup) == PW_NODE_ACTIVATION_WAKEUP_SPIN)
+				return res;
+			if (SPA_UNLIKELY((r = spa_system_eventfd_write(t->system, t->fd, 1)) < 0)) {
+				pw_log_warn("%p: write failed %s", t->node, spa_strerror(r));
+				res = r;
+			}
+		} else {
+			pw_log_trace_fp("%p: (%s-%u) not ready %d", t->node,
+					t->name, t->id, a->status);
+			res = -EIO;
+		}
+	}
+	return res;
+}
+
 static inline int trigger_target_v0(struct pw_node_target *t, uint64_t nsec)
 {
 	struct pw_node_activation *a = t->activation;
@@ -782,6 +830,8 @@ struct pw_impl_node {
 	unsigned int sync:1;		/**< the sync-groups are active */
 	unsigned int async:1;		/**< async processing, one cycle latency */
 	unsigned int lazy:1;		/**< the graph is lazy scheduling */
+	unsigned int recalc:1;		/**< node is evaluated in the graph recalculation */
+	unsigned int recalc_dirty:1;	/**< node is queued for graph recalculation */
 
 	uint32_t transport;		/**< latest transport request */
 
@@ -793,6 +843,7 @@ struct pw_impl_node {
 	struct spa_list follower_link;
 
 	struct spa_list sort_link;	/**< link used to sort nodes */
+	struct spa_list recalc_link;	/**< link in the context recalc queue */
 
 	struct spa_list peer_list;	/* list of peers */
 
@@ -833,7 +884,14 @@ struct pw_impl_node {
 		struct spa_ratelimit rate_limit;
 
 		bool prepared;				/**< the node was added to loop */
+		bool waiting;				/**< the node uses the shared wakeup */
+		bool pooled;				/**< the node is on the loop pool */
+		int processing;				/**< data loops processing the node,
+							  *  when pooled */
+
+		struct spa_list waiter_link;		/* link in waiter nodes */
 	} rt;
+	struct pw_node_waiter *waiter;			/**< shared wakeup of the data loop */
 	struct pw_node_peer *to_driver_peer;		/* node -> driver */
 	struct pw_node_peer *from_driver_peer;		/* driver -> node */
 	struct spa_fraction target_rate;
@@ -926,6 +984,7 @@ struct pw_impl_port {
 	struct pw_properties *properties;	/**< properties of the port */
 	struct pw_port_info info;
 	struct spa_param_info params[MAX_PARAMS];
+	uint32_t enum_format_serial;	/**< incremented when EnumFormat changes */
 
 	struct pw_buffers buffers;	/**< buffers managed by this port, only on
 					  *  output ports, shared with all links */
@@ -1258,7 +1317,23 @@ int pw_proxy_init(struct pw_proxy *proxy, struct pw_core *core, const char *type
 
 void pw_proxy_remove(struct pw_proxy *proxy);
 
+struct pw_module_preload;
+
+struct pw_module_preload *
+pw_module_preload_new(struct pw_context *context, uint32_t n_threads);
+int pw_module_preload_add(struct pw_module_preload *preload, const char *name, bool spa_lib);
+int pw_module_preload_start(struct pw_module_preload *preload);
+void pw_module_preload_destroy(struct pw_module_preload *preload);
+
+/** Add the modules and SPA libraries used by the context.modules and
+ * context.objects sections of conf to the preloader */
+int pw_context_conf_preload(struct pw_context *context, struct pw_properties *conf,
+		struct pw_module_preload *preload);
+
 int pw_context_recalc_graph(struct pw_context *context, const char *reason);
+bool pw_context_is_loop_pool(struct pw_context *context, struct pw_loop *loop);
+int pw_context_recalc_graph_node(struct pw_context *context, struct pw_impl_node *node,
+		const char *reason, bool sync);
 
 void pw_impl_port_update_info(struct pw_impl_port *port, const struct spa_port_info *info);
 
@@ -1293,6 +1368,14 @@ int pw_impl_port_for_each_param(struct pw_impl_port *port,
 					    struct spa_pod *param),
 			   void *data);
 
+/** Get the param at *index that matches filter, like spa_node_port_enum_params_sync()
+ * but served from the port param cache when possible. The cache is filled on first
+ * use and dropped when the node signals a change of the param list. */
+int pw_impl_port_enum_params_sync(struct pw_impl_port *port,
+			uint32_t param_id, uint32_t *index,
+			const struct spa_pod *filter, struct spa_pod **param,
+			struct spa_pod_builder *builder);
+
 int pw_impl_port_for_each_filtered_param(struct pw_impl_port *in_port,
 				    struct pw_impl_port *out_port,
 				    int seq,
@@ -4,6 +4,7 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 #include <spa/utils/ansi.h>
 #include <spa/utils/json.h>
@@ -16,6 +17,7 @@
 #include "pipewire/array.h"
 #include "pipewire/log.h"
 #include "pipewire/utils.h"
+#include "pipewire/keys.h"
 #include "pipewire/properties.h"
 
 PW_LOG_TOPIC_EXTERN(log_properties);
@@ -26,19 +28,206 @@ struct properties {
 	struct pw_properties this;
 
 	struct pw_array items;
+
+	/* open addressing index on the items, only for larger sets */
+	struct index_slot *index;
+	uint32_t index_mask;
+
+	/* keys and values copied in one go by pw_properties_new_dict() */
+	char *arena;
+	size_t arena_size;
+};
+
+struct index_slot {
+	uint32_t hash;
+	uint32_t idx;		/* item index + 1, 0 when free */
 };
 /** \endcond */
 
-static int add_item(struct properties *impl, const char *key, bool take_key, const char *value, bool take_value)
+#define INDEX_MIN_ITEMS	16
+
+/* common keys are not copied but point to this pool */
+static const char intern_pool[] =
+	PW_KEY_OBJECT_PATH "\0" PW_KEY_OBJECT_ID "\0" PW_KEY_OBJECT_SERIAL "\0"
+	PW_KEY_OBJECT_LINGER "\0" PW_KEY_OBJECT_REGISTER "\0" PW_KEY_OBJECT_EXPORT "\0"
+	PW_KEY_LOOP_NAME "\0" PW_KEY_LOOP_CLASS "\0"
+	PW_KEY_CORE_ID "\0" PW_KEY_CORE_NAME "\0" PW_KEY_CLIENT_ID "\0" PW_KEY_CLIENT_NAME "\0"
+	PW_KEY_CLIENT_API "\0" PW_KEY_PROTOCOL "\0" PW_KEY_ACCESS "\0"
+	PW_KEY_SEC_PID "\0" PW_KEY_SEC_UID "\0" PW_KEY_SEC_GID "\0" PW_KEY_SEC_LABEL "\0"
+	PW_KEY_APP_NAME "\0" PW_KEY_APP_ID "\0" PW_KEY_APP_ICON_NAME "\0" PW_KEY_APP_LANGUAGE "\0"
+	PW_KEY_APP_PROCESS_ID "\0" PW_KEY_APP_PROCESS_BINARY "\0" PW_KEY_APP_PROCESS_USER "\0"
+	PW_KEY_APP_PROCESS_HOST "\0" PW_KEY_APP_PROCESS_MACHINE_ID "\0"
+	PW_KEY_APP_PROCESS_SESSION_ID "\0"
+	PW_KEY_NODE_ID "\0" PW_KEY_NODE_NAME "\0" PW_KEY_NODE_NICK "\0" PW_KEY_NODE_DESCRIPTION "\0"
+	PW_KEY_NODE_PLUGGED "\0" PW_KEY_NODE_SESSION "\0" PW_KEY_NODE_GROUP "\0"
+	PW_KEY_NODE_LINK_GROUP "\0" PW_KEY_NODE_AUTOCONNECT "\0" PW_KEY_NODE_LATENCY "\0"
+	PW_KEY_NODE_MAX_LATENCY "\0" PW_KEY_NODE_RATE "\0" PW_KEY_NODE_LOCK_QUANTUM "\0"
+	PW_KEY_NODE_FORCE_QUANTUM "\0" PW_KEY_NODE_DONT_RECONNECT "\0" PW_KEY_NODE_ALWAYS_PROCESS "\0"
+	PW_KEY_NODE_WANT_DRIVER "\0" PW_KEY_NODE_PAUSE_ON_IDLE "\0" PW_KEY_NODE_SUSPEND_ON_IDLE "\0"
+	PW_KEY_NODE_DRIVER "\0" PW_KEY_NODE_DRIVER_ID "\0" PW_KEY_NODE_ASYNC "\0"
+	PW_KEY_NODE_LOOP_NAME "\0" PW_KEY_NODE_STREAM "\0" PW_KEY_NODE_VIRTUAL "\0"
+	PW_KEY_NODE_PASSIVE "\0" PW_KEY_NODE_TRANSPORT "\0"
+	PW_KEY_PORT_ID "\0" PW_KEY_PORT_NAME "\0" PW_KEY_PORT_DIRECTION "\0" PW_KEY_PORT_ALIAS "\0"
+	PW_KEY_PORT_PHYSICAL "\0" PW_KEY_PORT_TERMINAL "\0" PW_KEY_PORT_MONITOR "\0"
+	PW_KEY_PORT_GROUP "\0"
+	PW_KEY_LINK_ID "\0" PW_KEY_LINK_INPUT_NODE "\0" PW_KEY_LINK_INPUT_PORT "\0"
+	PW_KEY_LINK_OUTPUT_NODE "\0" PW_KEY_LINK_OUTPUT_PORT "\0" PW_KEY_LINK_PASSIVE "\0"
+	PW_KEY_DEVICE_ID "\0" PW_KEY_DEVICE_NAME "\0" PW_KEY_DEVICE_NICK "\0"
+	PW_KEY_DEVICE_STRING "\0" PW_KEY_DEVICE_API "\0" PW_KEY_DEVICE_DESCRIPTION "\0"
+	PW_KEY_DEVICE_BUS_PATH "\0" PW_KEY_DEVICE_SERIAL "\0" PW_KEY_DEVICE_VENDOR_ID "\0"
+	PW_KEY_DEVICE_VENDOR_NAME "\0" PW_KEY_DEVICE_PRODUCT_ID "\0" PW_KEY_DEVICE_PRODUCT_NAME "\0"
+	PW_KEY_DEVICE_CLASS "\0" PW_KEY_DEVICE_FORM_FACTOR "\0" PW_KEY_DEVICE_BUS "\0"
+	PW_KEY_DEVICE_SUBSYSTEM "\0" PW_KEY_DEVICE_SYSFS_PATH "\0" PW_KEY_DEVICE_ICON_NAME "\0"
+	PW_KEY_MODULE_ID "\0" PW_KEY_MODULE_NAME "\0" PW_KEY_FACTORY_ID "\0" PW_KEY_FACTORY_NAME "\0"
+	PW_KEY_FACTORY_TYPE_NAME "\0" PW_KEY_FACTORY_TYPE_VERSION "\0"
+	PW_KEY_PRIORITY_SESSION "\0" PW_KEY_PRIORITY_DRIVER "\0"
+	PW_KEY_STREAM_IS_LIVE "\0" PW_KEY_STREAM_MONITOR "\0"
+	PW_KEY_MEDIA_TYPE "\0" PW_KEY_MEDIA_CATEGORY "\0" PW_KEY_MEDIA_ROLE "\0"
+	PW_KEY_MEDIA_CLASS "\0" PW_KEY_MEDIA_NAME "\0" PW_KEY_MEDIA_TITLE "\0"
+	PW_KEY_MEDIA_SOFTWARE "\0" PW_KEY_MEDIA_ICON_NAME "\0"
+	PW_KEY_FORMAT_DSP "\0" PW_KEY_AUDIO_CHANNEL "\0" PW_KEY_AUDIO_RATE "\0"
+	PW_KEY_AUDIO_CHANNELS "\0" PW_KEY_AUDIO_FORMAT "\0" PW_KEY_AUDIO_ALLOWED_RATES "\0"
+	PW_KEY_TARGET_OBJECT "\0"
+	"api.alsa.path\0" "api.alsa.card\0" "api.alsa.pcm.card\0" "api.alsa.pcm.device\0"
+	"api.alsa.pcm.stream\0" "api.alsa.card.name\0" "api.alsa.card.longname\0"
+	"audio.position\0" "card.profile.device\0" "device.profile.name\0"
+	"device.profile.description\0" "device.routes\0" "factory.mode\0"
+	"clock.quantum-limit\0" "alsa.card\0" "alsa.card_name\0" "alsa.long_card_name\0";
+
+#define INTERN_SIZE	512
+static uint16_t intern_index[INTERN_SIZE];
+static pthread_once_t intern_once = PTHREAD_ONCE_INIT;
+
+static inline uint32_t hash_key(const char *key)
+{
+	/* FNV-1a */
+	uint32_t h = 2166136261u;
+	while (*key)
+		h = (h ^ (uint8_t)*key++) * 16777619u;
+	return h;
+}
+
+static void intern_init(void)
+{
+	const char *k;
+	uint32_t slot;
+
+	for (k = intern_pool; k < intern_pool + sizeof(intern_pool) - 1; k += strlen(k) + 1) {
+		slot = hash_key(k) & (INTERN_SIZE - 1);
+		while (intern_index[slot] != 0) {
+			if (spa_streq(&intern_pool[intern_index[slot] - 1], k))
+				break;
+			slot = (slot + 1) & (INTERN_SIZE - 1);
+		}
+		intern_index[slot] = k - intern_pool + 1;
+	}
+}
+
+static const char *intern_key(const char *key, uint32_t hash)
+{
+	uint32_t slot = hash & (INTERN_SIZE - 1);
+
+	pthread_once(&intern_once, intern_init);
+	while (intern_index[slot] != 0) {
+		const char *k = &intern_pool[intern_index[slot] - 1];
+		if (spa_streq(k, key))
+			return k;
+		slot = (slot + 1) & (INTERN_SIZE - 1);
+	}
+	return NULL;
+}
+
+static void free_string(struct properties *impl, const char *str)
+{
+	if (str >= intern_pool && str < intern_pool + sizeof(intern_pool))
+		return;
+	if (str >= impl->arena && str < impl->arena + impl->arena_size)
+		return;
+	free((char*)str);
+}
+
+static void index_add(struct properties *impl, uint32_t hash, uint32_t idx)
+{
+	uint32_t slot = hash & impl->index_mask;
+	while (impl->index[slot].idx != 0)
+		slot = (slot + 1) & impl->index_mask;
+	impl->index[slot].hash = hash;
+	impl->index[slot].idx = idx + 1;
+}
+
+static int index_rebuild(struct properties *impl)
+{
+	struct spa_dict_item *item;
+	uint32_t i, size, n_items = pw_array_get_len(&impl->items, struct spa_dict_item);
+
+	if (n_items < INDEX_MIN_ITEMS) {
+		free(impl->index);
+		impl->index = NULL;
+		impl->index_mask = 0;
+		return 0;
+	}
+	/* keep the load factor below 1/2 */
+	for (size = INDEX_MIN_ITEMS * 2; size < n_items * 2; size <<= 1);
+
+	if (size != impl->index_mask + 1) {
+		struct index_slot *index;
+		if ((index = reallocarray(impl->index, size, sizeof(struct index_slot))) == NULL) {
+			free(impl->index);
+			impl->index = NULL;
+			impl->index_mask = 0;
+			return -errno;
+		}
+		impl->index = index;
+		impl->index_mask = size - 1;
+	}
+	memset(impl->index, 0, size * sizeof(struct index_slot));
+
+	i = 0;
+	pw_array_for_each(item, &impl->items)
+		index_add(impl, hash_key(item->key), i++);
+	return 0;
+}
+
+static struct spa_dict_item *find_item(const struct properties *impl, const char *key, uint32_t hash)
+{
+	const struct pw_properties *props = &impl->this;
+	uint32_t slot;
+
+	/* items might have been reordered by spa_dict_qsort(), which
+	 * sets the flag, the index is rebuilt on the next change */
+	if (impl->index == NULL || SPA_FLAG_IS_SET(props->dict.flags, SPA_DICT_FLAG_SORTED))
+		return (struct spa_dict_item*)spa_dict_lookup_item(&props->dict, key);
+
+	slot = hash & impl->index_mask;
+	while (impl->index[slot].idx != 0) {
+		if (impl->index[slot].hash == hash) {
+			struct spa_dict_item *item = pw_array_get_unchecked(&impl->items,
+					impl->index[slot].idx - 1, struct spa_dict_item);
+			if (spa_streq(item->key, key))
+				return item;
+		}
+		slot = (slot + 1) & impl->index_mask;
+	}
+	return NULL;
+}
+
+static int add_item(struct properties *impl, const char *key, uint32_t hash, bool take_key,
+		const char *value, bool take_value)
 {
 	struct spa_dict_item *item;
 	const char *k, *v;
 
-	k = take_key ? key : NULL;
 	v = take_value ? value: NULL;
 
-	if (!take_key && key && (k = strdup(key)) == NULL)
+	if ((k = intern_key(key, hash)) != NULL) {
+		if (take_key)
+			free_string(impl, key);
+		take_key = false;
+	} else if (take_key) {
+		k = key;
+	} else if ((k = strdup(key)) == NULL)
 		goto error;
+
 	if (!take_value && value && (v = strdup(value)) == NULL)
 		goto error;
 
@@ -51,7 +240,7 @@ static int add_item(struct properties *impl, const char *key, bool take_key, con
 	return 0;
 
 error:
-	free((char*)k);
+	free_string(impl, k);
 	free((char*)v);
 	return -errno;
 }
@@ -63,16 +252,20 @@ static void update_dict(struct pw_properties *properties)
 	properties->dict.n_items = pw_array_get_len(&impl->items, struct spa_dict_item);
 }
 
-static void clear_item(struct spa_dict_item *item)
+static void clear_item(struct properties *impl, struct spa_dict_item *item)
 {
-	free((char *) item->key);
-	free((char *) item->value);
+	free_string(impl, item->key);
+	free_string(impl, item->value);
 }
 
 static void properties_init(struct properties *impl, int prealloc)
 {
 	pw_array_init(&impl->items, 16);
 	pw_array_ensure_size(&impl->items, sizeof(struct spa_dict_item) * prealloc);
+	impl->index = NULL;
+	impl->index_mask = 0;
+	impl->arena = NULL;
+	impl->arena_size = 0;
 }
 
 static struct properties *properties_new(int prealloc)
@@ -108,12 +301,13 @@ struct pw_properties *pw_properties_new(const char *key, ...)
 	while (key != NULL) {
 		value = va_arg(varargs, char *);
 		if (value && key[0])
-			if ((res = add_item(impl, key, false, value, false)) < 0)
+			if ((res = add_item(impl, key, hash_key(key), false, value, false)) < 0)
 				goto error;
 		key = va_arg(varargs, char *);
 	}
 	va_end(varargs);
 	update_dict(&impl->this);
+	index_rebuild(impl);
 
 	return &impl->this;
 error:
@@ -132,19 +326,50 @@ struct pw_properties *pw_properties_new_dict(const struct spa_dict *dict)
 {
 	uint32_t i;
 	struct properties *impl;
+	struct spa_dict_item *item;
+	size_t size = 0, len;
+	char *p;
 	int res;
 
 	impl = properties_new(SPA_ROUND_UP_N(dict->n_items, 16));
 	if (impl == NULL)
 		return NULL;
 
+	/* copy all keys and values into one allocation */
 	for (i = 0; i < dict->n_items; i++) {
 		const struct spa_dict_item *it = &dict->items[i];
 		if (it->key != NULL && it->key[0] && it->value != NULL)
-			if ((res = add_item(impl, it->key, false, it->value, false)) < 0)
-				goto error;
+			size += strlen(it->key) + strlen(it->value) + 2;
+	}
+	if (size > 0 && (impl->arena = malloc(size)) == NULL) {
+		res = -errno;
+		goto error;
+	}
+	impl->arena_size = size;
+
+	for (i = 0, p = impl->arena; i < dict->n_items; i++) {
+		const struct spa_dict_item *it = &dict->items[i];
+		const char *k;
+
+		if (it->key == NULL || it->key[0] == 0 || it->value == NULL)
+			continue;
+
+		if ((item = pw_array_add(&impl->items, sizeof(struct spa_dict_item))) == NULL) {
+			res = -errno;
+			goto error;
+		}
+		if ((k = intern_key(it->key, hash_key(it->key))) == NULL) {
+			len = strlen(it->key) + 1;
+			k = memcpy(p, it->key, len);
+			p += len;
+		}
+		len = strlen(it->value) + 1;
+		item->key = k;
+		item->value = memcpy(p, it->value, len);
+		p += len;
 	}
 	update_dict(&impl->this);
+	index_rebuild(impl);
 
 	return &impl->this;
 
@@ -159,19 +384,31 @@ static int do_replace(struct pw_properties *properties, const char *key, bool ta
 {
 	struct properties *impl = SPA_CONTAINER_OF(properties, struct properties, this);
 	struct spa_dict_item *item;
+	bool sorted;
+	uint32_t hash;
 	int res = 0;
 
 	if (key == NULL || key[0] == 0)
 		goto exit_noupdate;
 
-	item = (struct spa_dict_item*) spa_dict_lookup_item(&properties->dict, key);
+	hash = hash_key(key);
+	item = find_item(impl, key, hash);
+	sorted = SPA_FLAG_IS_SET(properties->dict.flags, SPA_DICT_FLAG_SORTED);
 
 	if (item == NULL) {
+		uint32_t n_items;
+
 		if (value == NULL)
 			goto exit_noupdate;
-		if ((res = add_item(impl, key, take_key, value, take_value)) < 0)
+		if ((res = add_item(impl, key, hash, take_key, value, take_value)) < 0)
 			return res;
 		SPA_FLAG_CLEAR(properties->dict.flags, SPA_DICT_FLAG_SORTED);
+
+		n_items = pw_array_get_len(&impl->items, struct spa_dict_item);
+		if (sorted || impl->index == NULL || n_items * 2 > impl->index_mask + 1)
+			index_rebuild(impl);
+		else
+			index_add(impl, hash, n_items - 1);
 	} else {
 		if (value && spa_streq(item->value, value))
 			goto exit_noupdate;
@@ -180,29 +417,30 @@ static int do_replace(struct pw_properties *properties, const char *key, bool ta
 			struct spa_dict_item *last = pw_array_get_unchecked(&impl->items,
 						     pw_array_get_len(&impl->items, struct spa_dict_item) - 1,
 						     struct spa_dict_item);
-			clear_item(item);
+			clear_item(impl, item);
 			item->key = last->key;
 			item->value = last->value;
 			impl->items.size -= sizeof(struct spa_dict_item);
 			SPA_FLAG_CLEAR(properties->dict.flags, SPA_DICT_FLAG_SORTED);
+			index_rebuild(impl);
 		} else {
 			char *v = NULL;
 			if (!take_value && value && (v = strdup(value)) == NULL) {
 				res = -errno;
 				goto exit_noupdate;
 			}
-			free((char *) item->value);
+			free_string(impl, item->value);
 			item->value = take_value ? value : v;
 		}
 		if (take_key)
-			free((char*)key);
+			free_string(impl, key);
 	}
 	update_dict(properties);
 	return 1;
 
 exit_noupdate:
 	if (take_key)
-		free((char*)key);
+		free_string(impl, key);
 	if (take_value)
 		free((char*)value);
 	return res;
@@ -252,7 +490,7 @@ static int update_string(struct pw_properties *props, const char *str, size_t si
 				continue;
 			}
 			/* item changed or added, apply changes later */
-			if ((errno = -add_item(&changes, key, false, val, true) < 0)) {
+			if ((errno = -add_item(&changes, key, hash_key(key), false, val, true) < 0)) {
 				it[0].state = SPA_JSON_ERROR_FLAG;
 				break;
 			}
@@ -277,7 +515,7 @@ static int update_string(struct pw_properties *props, const char *str, size_t si
 
 		} else {
 			pw_array_for_each(item, &changes.items)
-				clear_item(item);
+				clear_item(&changes, item);
 		}
 		pw_array_clear(&changes.items);
 	}
@@ -458,9 +696,13 @@ void pw_properties_clear(struct pw_properties *properties)
 	struct spa_dict_item *item;
 
 	pw_array_for_each(item, &impl->items)
-		clear_item(item);
+		clear_item(impl, item);
 	pw_array_reset(&impl->items);
 	properties->dict.n_items = 0;
+	index_rebuild(impl);
+	free(impl->arena);
+	impl->arena = NULL;
+	impl->arena_size = 0;
 }
 
 /** Update properties
@@ -635,7 +877,14 @@ int pw_properties_setf(struct pw_properties *properties, const char *key, const
 SPA_EXPORT
 const char *pw_properties_get(const struct pw_properties *properties, const char *key)
 {
-	return spa_dict_lookup(&properties->dict, key);
+	const struct properties *impl = SPA_CONTAINER_OF(properties, struct properties, this);
+	const struct spa_dict_item *item;
+
+	if (impl->index == NULL)
+		return spa_dict_lookup(&properties->dict, key);
+
+	item = find_item(impl, key, hash_key(key));
+	return item ? item->value : NULL;
 }
 
 /** Fetch a property as uint32_t.
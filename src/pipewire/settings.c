@@ -35,6 +35,8 @@
 #define DEFAULT_LINK_MAX_BUFFERS		64u
 #define DEFAULT_MEM_WARN_MLOCK			false
 #define DEFAULT_MEM_ALLOW_MLOCK			true
+#define DEFAULT_NODE_SHARED_WAKEUP		false
+#define DEFAULT_NODE_WAKEUP_SPIN		0u
 #define DEFAULT_CHECK_QUANTUM			false
 #define DEFAULT_CHECK_RATE			false
 
@@ -224,6 +226,8 @@ void pw_settings_init(struct pw_context *this)
 	d->link_max_buffers = get_default_int(p, "link.max-buffers", DEFAULT_LINK_MAX_BUFFERS);
 	d->mem_warn_mlock = get_default_bool(p, "mem.warn-mlock", DEFAULT_MEM_WARN_MLOCK);
 	d->mem_allow_mlock = get_default_bool(p, "mem.allow-mlock", DEFAULT_MEM_ALLOW_MLOCK);
+	d->node_shared_wakeup = get_default_bool(p, "node.shared-wakeup", DEFAULT_NODE_SHARED_WAKEUP);
+	d->node_wakeup_spin = get_default_int(p, "node.wakeup-spin-usec", DEFAULT_NODE_WAKEUP_SPIN);
 
 	d->check_quantum = get_default_bool(p, "settings.check-quantum", DEFAULT_CHECK_QUANTUM);
 	d->check_rate = get_default_bool(p, "settings.check-rate", DEFAULT_CHECK_RATE);
@@ -0,0 +1,280 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <spa/node/node.h>
+#include <spa/node/utils.h>
+#include <spa/utils/result.h>
+#include <spa/utils/string.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/impl.h>
+
+#include "pipewire/private.h"
+
+/* Runs a driver and a chain of N in-process nodes, where every node
+ * depends on the previous one, and measures the time between the trigger
+ * of a node and the start of its processing. This is done with the eventfd
+ * wakeups, with the shared wakeup and with the shared wakeup and a spin
+ * phase when the chain alternates between two data loops. */
+
+#define MAX_NODES	32
+#define CYCLES		2000
+
+struct bench;
+
+struct node_data {
+	struct spa_node node;
+	struct spa_hook_list hooks;
+	struct spa_callbacks callbacks;
+	struct bench *bench;
+	struct pw_impl_node *impl;
+	bool driver;
+
+	uint64_t wake_total;
+	uint64_t wake_max;
+	uint64_t count;
+};
+
+struct bench {
+	struct pw_main_loop *loop;
+	struct pw_context *context;
+	int done_fd;
+	uint32_t n_nodes;
+	struct node_data driver;
+	struct node_data nodes[MAX_NODES];
+};
+
+static uint64_t get_time_nsec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static int node_add_listener(void *object, struct spa_hook *listener,
+		const struct spa_node_events *events, void *data)
+{
+	struct node_data *d = object;
+	struct spa_hook_list save;
+	struct spa_node_info info = SPA_NODE_INFO_INIT();
+
+	spa_hook_list_isolate(&d->hooks, &save, listener, events, data);
+
+	info.change_mask = SPA_NODE_CHANGE_MASK_FLAGS;
+	info.flags = SPA_NODE_FLAG_RT;
+	spa_node_emit_info(&d->hooks, &info);
+
+	spa_hook_list_join(&d->hooks, &save);
+	return 0;
+}
+
+static int node_set_callbacks(void *object, const struct spa_node_callbacks *callbacks,
+		void *data)
+{
+	struct node_data *d = object;
+	d->callbacks = SPA_CALLBACKS_INIT(callbacks, data);
+	return 0;
+}
+
+static int node_set_io(void *object, uint32_t id, void *data, size_t size)
+{
+	return 0;
+}
+
+static int node_send_command(void *object, const struct spa_command *command)
+{
+	return 0;
+}
+
+static int node_process(void *object)
+{
+	struct node_data *d = object;
+	struct pw_node_activation *a = d->impl->rt.target.activation;
+
+	if (d->driver) {
+		/* the last node of the chain completed the graph */
+		eventfd_write(d->bench->done_fd, 1);
+	} else if (a->awake_time > a->signal_time) {
+		uint64_t wake = a->awake_time - a->signal_time;
+		d->wake_total += wake;
+		d->wake_max = SPA_MAX(d->wake_max, wake);
+		d->count++;
+	}
+	return SPA_STATUS_HAVE_DATA;
+}
+
+static const struct spa_node_methods node_methods = {
+	SPA_VERSION_NODE_METHODS,
+	.add_listener = node_add_listener,
+	.set_callbacks = node_set_callbacks,
+	.set_io = node_set_io,
+	.send_command = node_send_command,
+	.process = node_process,
+};
+
+static int make_node(struct bench *b, struct node_data *d, const char *name,
+		const char *loop_name, bool driver)
+{
+	struct pw_properties *props;
+
+	spa_zero(*d);
+	d->bench = b;
+	d->driver = driver;
+	d->node.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_Node,
+			SPA_VERSION_NODE, &node_methods, d);
+	spa_hook_list_init(&d->hooks);
+
+	props = pw_properties_new(
+			PW_KEY_NODE_NAME, name,
+			PW_KEY_NODE_LOOP_NAME, loop_name,
+			NULL);
+	if (driver) {
+		pw_properties_set(props, PW_KEY_NODE_DRIVER, "true");
+		pw_properties_set(props, PW_KEY_PRIORITY_DRIVER, "1");
+	} else
+		pw_properties_set(props, PW_KEY_NODE_ALWAYS_PROCESS, "true");
+
+	d->impl = pw_context_create_node(b->context, props, 0);
+	if (d->impl == NULL)
+		return -errno;
+
+	pw_impl_node_set_implementation(d->impl, &d->node);
+	pw_impl_node_register(d->impl, NULL);
+	pw_impl_node_set_active(d->impl, true);
+	return 0;
+}
+
+static int do_start(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct node_data *d = user_data;
+	spa_node_call_ready(&d->callbacks, SPA_STATUS_HAVE_DATA);
+	return 0;
+}
+
+static bool nodes_running(struct bench *b)
+{
+	uint32_t i;
+
+	if (b->driver.impl->info.state != PW_NODE_STATE_RUNNING)
+		return false;
+	for (i = 0; i < b->n_nodes; i++)
+		if (b->nodes[i].impl->info.state != PW_NODE_STATE_RUNNING)
+			return false;
+	return true;
+}
+
+static int run(const char *what, uint32_t n_nodes, bool shared, uint32_t spin, bool split)
+{
+	struct bench b;
+	struct pw_node_peer *peers[MAX_NODES];
+	uint64_t t, total = 0, wake_total = 0, wake_max = 0, count = 0, val;
+	char name[64], spin_str[16];
+	uint32_t i, c;
+	int res = 0;
+
+	spa_zero(b);
+	b.n_nodes = n_nodes;
+	b.loop = pw_main_loop_new(NULL);
+	spa_scnprintf(spin_str, sizeof(spin_str), "%u", spin);
+	b.context = pw_context_new(pw_main_loop_get_loop(b.loop),
+			pw_properties_new(
+				PW_KEY_CONFIG_NAME, "null",
+				"context.num-data-loops", "2",
+				"node.shared-wakeup", shared ? "true" : "false",
+				"node.wakeup-spin-usec", spin_str,
+				NULL),
+			0);
+	if (b.context == NULL)
+		return -errno;
+
+	b.done_fd = eventfd(0, EFD_CLOEXEC);
+
+	if ((res = make_node(&b, &b.driver, "driver", "data-loop.0", true)) < 0)
+		goto exit;
+	for (i = 0; i < n_nodes; i++) {
+		snprintf(name, sizeof(name), "node.%u", i);
+		if ((res = make_node(&b, &b.nodes[i], name,
+				split && (i & 1) ? "data-loop.1" : "data-loop.0", false)) < 0)
+			goto exit;
+	}
+	/* every node is triggered by the previous one */
+	for (i = 0; i + 1 < n_nodes; i++)
+		peers[i] = pw_node_peer_ref(b.nodes[i].impl, b.nodes[i + 1].impl);
+
+	for (c = 0; c < 1000 && !nodes_running(&b); c++) {
+		pw_loop_iterate(pw_main_loop_get_loop(b.loop), 0);
+		usleep(1000);
+	}
+	if (!nodes_running(&b)) {
+		fprintf(stderr, "%s: nodes are not running\n", what);
+		res = -EIO;
+		goto exit_peers;
+	}
+
+	for (c = 0; c < CYCLES; c++) {
+		t = get_time_nsec();
+		pw_loop_invoke(b.driver.impl->data_loop, do_start, 0, NULL, 0, false, &b.driver);
+		if (eventfd_read(b.done_fd, &val) < 0) {
+			res = -errno;
+			break;
+		}
+		total += get_time_nsec() - t;
+	}
+	for (i = 0; i < n_nodes; i++) {
+		wake_total += b.nodes[i].wake_total;
+		wake_max = SPA_MAX(wake_max, b.nodes[i].wake_max);
+		count += b.nodes[i].count;
+	}
+
+	printf("%-14s %6u %14.1f %14.1f %12.1f\n", what, n_nodes,
+			(double)total / CYCLES / 1000.0,
+			count ? (double)wake_total / count / 1000.0 : 0.0,
+			(double)wake_max / 1000.0);
+
+exit_peers:
+	for (i = 0; i + 1 < n_nodes; i++)
+		pw_node_peer_unref(peers[i]);
+exit:
+	for (i = 0; i < n_nodes; i++)
+		if (b.nodes[i].impl)
+			pw_impl_node_destroy(b.nodes[i].impl);
+	if (b.driver.impl)
+		pw_impl_node_destroy(b.driver.impl);
+	close(b.done_fd);
+	pw_context_destroy(b.context);
+	pw_main_loop_destroy(b.loop);
+	return res;
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t counts[] = { 1, 4, 16, 32 };
+	int res;
+
+	pw_init(&argc, &argv);
+
+	printf("%-14s %6s %14s %14s %12s\n", "wakeup", "nodes",
+			"cycle usec", "wake usec", "max usec");
+
+	SPA_FOR_EACH_ELEMENT_VAR(counts, c) {
+		if ((res = run("eventfd", *c, false, 0, false)) < 0 ||
+		    (res = run("shared", *c, true, 0, false)) < 0 ||
+		    (res = run("eventfd-2", *c, false, 0, true)) < 0 ||
+		    (res = run("shared-2", *c, true, 0, true)) < 0 ||
+		    (res = run("shared-spin-2", *c, true, 50, true)) < 0) {
+			fprintf(stderr, "benchmark failed: %s\n", spa_strerror(res));
+			break;
+		}
+	}
+	pw_deinit();
+
+	return res < 0 ? 1 : 0;
+}
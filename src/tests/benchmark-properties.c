@@ -0,0 +1,129 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <assert.h>
+
+#include <spa/utils/dict.h>
+#include <spa/utils/string.h>
+
+#include <pipewire/pipewire.h>
+
+#define MAX_COUNT	100000
+#define MAX_ITEMS	1000
+
+static char keys[MAX_ITEMS][32];
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void report(const char *what, uint32_t n_items, uint64_t t1, uint64_t t2, uint32_t count)
+{
+	fprintf(stderr, "%-12s %4u items: elapsed %10"PRIu64" count %u = %10"PRIu64"/sec\n",
+			what, n_items, t2 - t1, count,
+			count * (uint64_t)SPA_NSEC_PER_SEC / SPA_MAX(t2 - t1, 1u));
+}
+
+static struct pw_properties *make_props(uint32_t n_items)
+{
+	struct pw_properties *props;
+	uint32_t i;
+
+	props = pw_properties_new(
+			PW_KEY_NODE_NAME, "benchmark",
+			PW_KEY_MEDIA_CLASS, "Audio/Sink",
+			PW_KEY_OBJECT_SERIAL, "42",
+			NULL);
+	for (i = 3; i < n_items; i++)
+		pw_properties_setf(props, keys[i], "value-%u", i);
+	return props;
+}
+
+static void test_lookup(struct pw_properties *props)
+{
+	const struct spa_dict *dict = &props->dict;
+	uint32_t i, idx, n_items = dict->n_items;
+	const char *str;
+	uint64_t t1, t2, t3;
+
+	t1 = get_time_ns();
+	for (i = 0; i < MAX_COUNT; i++) {
+		idx = random() % n_items;
+		/* the linear scan used by a plain spa_dict */
+		str = spa_dict_lookup(dict, dict->items[idx].key);
+		assert(str == dict->items[idx].value);
+	}
+	t2 = get_time_ns();
+	for (i = 0; i < MAX_COUNT; i++) {
+		idx = random() % n_items;
+		str = pw_properties_get(props, dict->items[idx].key);
+		assert(str == dict->items[idx].value);
+	}
+	t3 = get_time_ns();
+
+	report("dict lookup", n_items, t1, t2, MAX_COUNT);
+	report("props get", n_items, t2, t3, MAX_COUNT);
+}
+
+static void test_update(struct pw_properties *props)
+{
+	uint32_t i, n_items = props->dict.n_items;
+	uint64_t t1, t2;
+
+	t1 = get_time_ns();
+	for (i = 0; i < MAX_COUNT; i++)
+		pw_properties_setf(props, keys[i % n_items], "%u", i);
+	t2 = get_time_ns();
+
+	report("props set", n_items, t1, t2, MAX_COUNT);
+}
+
+static void test_copy(struct pw_properties *props)
+{
+	struct pw_properties *copy;
+	uint32_t i, n_items = props->dict.n_items, count = MAX_COUNT / 100;
+	uint64_t t1, t2;
+
+	t1 = get_time_ns();
+	for (i = 0; i < count; i++) {
+		copy = pw_properties_copy(props);
+		pw_properties_free(copy);
+	}
+	t2 = get_time_ns();
+
+	report("props copy", n_items, t1, t2, count);
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t sizes[] = { 10, 20, 50, 100, 1000 };
+	struct pw_properties *props;
+	uint32_t i;
+
+	pw_init(&argc, &argv);
+
+	spa_scnprintf(keys[0], sizeof(keys[0]), "%s", PW_KEY_NODE_NAME);
+	spa_scnprintf(keys[1], sizeof(keys[1]), "%s", PW_KEY_MEDIA_CLASS);
+	spa_scnprintf(keys[2], sizeof(keys[2]), "%s", PW_KEY_OBJECT_SERIAL);
+	for (i = 3; i < MAX_ITEMS; i++)
+		spa_scnprintf(keys[i], sizeof(keys[i]), "benchmark.key.%u", i);
+
+	for (i = 0; i < SPA_N_ELEMENTS(sizes); i++) {
+		props = make_props(sizes[i]);
+		test_lookup(props);
+		test_update(props);
+		test_copy(props);
+		pw_properties_free(props);
+	}
+
+	pw_deinit();
+
+	return 0;
+}
@@ -19,12 +19,20 @@
 #define MAX_NAME		128
 #define MAX_FOLLOWERS		64
 #define DEFAULT_FILENAME	"profiler.log"
+#define POLL_INTERVAL_MS	10
 
 struct follower {
 	uint32_t id;
 	char name[MAX_NAME];
 };
 
+struct ring {
+	struct spa_list link;
+	uint32_t id;
+	struct pw_memmap *map;
+	struct pw_profiler_ring_reader reader;
+};
+
 struct data {
 	struct pw_main_loop *loop;
 	struct pw_context *context;
@@ -48,6 +56,11 @@ struct data {
 	struct spa_hook profiler_listener;
 	int check_profiler;
 
+	struct spa_list rings;
+	struct spa_source *timer;
+	void *record;
+	uint32_t record_size;
+
 	uint32_t driver_id;
 
 	int n_followers;
@@ -535,51 +548,130 @@ static void dump_scripts(struct data *d)
 	printf("run 'sh generate_timings.sh' and load Timings.html in a browser\n");
 }
 
-static void profiler_profile(void *data, const struct spa_pod *pod)
+static int process_profile(struct data *d, struct spa_pod *o)
 {
-	struct data *d = data;
-	struct spa_pod *o;
 	struct spa_pod_prop *p;
 	struct point point;
+	int res = 0;
 
-	SPA_POD_STRUCT_FOREACH(pod, o) {
-		int res = 0;
-		if (!spa_pod_is_object_type(o, SPA_TYPE_OBJECT_Profiler))
-			continue;
-
-		spa_zero(point);
-		SPA_POD_OBJECT_FOREACH((struct spa_pod_object*)o, p) {
-			switch(p->key) {
-			case SPA_PROFILER_info:
-				res = process_info(d, &p->value, &point);
-				break;
-			case SPA_PROFILER_clock:
-				res = process_clock(d, &p->value, &point);
-				break;
-			case SPA_PROFILER_driverBlock:
-				res = process_driver_block(d, &p->value, &point);
-				break;
-			case SPA_PROFILER_followerBlock:
-				process_follower_block(d, &p->value, &point);
-				break;
-			case SPA_PROFILER_followerClock:
-				process_follower_clock(d, &p->value, &point);
-				break;
-			default:
-				break;
-			}
-			if (res < 0)
-				break;
+	if (!spa_pod_is_object_type(o, SPA_TYPE_OBJECT_Profiler))
+		return 0;
+
+	spa_zero(point);
+	SPA_POD_OBJECT_FOREACH((struct spa_pod_object*)o, p) {
+		switch(p->key) {
+		case SPA_PROFILER_info:
+			res = process_info(d, &p->value, &point);
+			break;
+		case SPA_PROFILER_clock:
+			res = process_clock(d, &p->value, &point);
+			break;
+		case SPA_PROFILER_driverBlock:
+			res = process_driver_block(d, &p->value, &point);
+			break;
+		case SPA_PROFILER_followerBlock:
+			process_follower_block(d, &p->value, &point);
+			break;
+		case SPA_PROFILER_followerClock:
+			process_follower_clock(d, &p->value, &point);
+			break;
+		default:
+			break;
 		}
 		if (res < 0)
-			continue;
+			return 0;
+	}
 
-		if (!d->json_dump)
-			dump_point(d, &point);
+	if (!d->json_dump)
+		dump_point(d, &point);
 
-		if (d->iterations > 0 && --d->iterations == 0) {
-			pw_main_loop_quit(d->loop);
+	if (d->iterations > 0 && --d->iterations == 0) {
+		pw_main_loop_quit(d->loop);
+		return -ECANCELED;
+	}
+	return 0;
+}
+
+static void profiler_profile(void *data, const struct spa_pod *pod)
+{
+	struct data *d = data;
+	struct spa_pod *o;
+
+	SPA_POD_STRUCT_FOREACH(pod, o) {
+		if (process_profile(d, o) < 0)
 			break;
+	}
+}
+
+static void free_ring(struct ring *r)
+{
+	spa_list_remove(&r->link);
+	pw_memmap_free(r->map);
+	free(r);
+}
+
+static void profiler_ring(void *data, uint32_t id, uint32_t mem_id, uint32_t offset, uint32_t size)
+{
+	struct data *d = data;
+	struct pw_memmap *map;
+	struct ring *r;
+
+	spa_list_for_each(r, &d->rings, link) {
+		if (r->id == id) {
+			free_ring(r);
+			break;
+		}
+	}
+	if (mem_id == SPA_ID_INVALID)
+		return;
+
+	map = pw_mempool_map_id(pw_core_get_mempool(d->core), mem_id,
+			PW_MEMMAP_FLAG_READ, offset, size, NULL);
+	if (map == NULL) {
+		pw_log_error("can't map ring %u of driver %u: %m", mem_id, id);
+		return;
+	}
+	if ((r = calloc(1, sizeof(*r))) == NULL) {
+		pw_memmap_free(map);
+		return;
+	}
+	r->id = id;
+	r->map = map;
+	if (pw_profiler_ring_reader_init(&r->reader, map->ptr, size) < 0) {
+		pw_log_error("invalid ring %u of driver %u", mem_id, id);
+		goto error;
+	}
+	if (r->reader.max_record > d->record_size) {
+		void *record = realloc(d->record, r->reader.max_record);
+		if (record == NULL)
+			goto error;
+		d->record = record;
+		d->record_size = r->reader.max_record;
+	}
+	spa_list_append(&d->rings, &r->link);
+
+	pw_log_info("reading ring of driver %u, size %u", id, r->reader.size);
+	return;
+error:
+	pw_memmap_free(map);
+	free(r);
+}
+
+static void do_poll(void *data, uint64_t expirations)
+{
+	struct data *d = data;
+	struct ring *r;
+	int res;
+
+	spa_list_for_each(r, &d->rings, link) {
+		while ((res = pw_profiler_ring_read(&r->reader,
+						d->record, d->record_size)) != 0) {
+			if (res == -EPIPE) {
+				pw_log_warn("driver %u: lost profiler data", r->id);
+				continue;
+			}
+			if (process_profile(d, d->record) < 0)
+				return;
 		}
 	}
 }
@@ -587,6 +679,7 @@ static void profiler_profile(void *data, const struct spa_pod *pod)
 static const struct pw_profiler_events profiler_events = {
 	PW_VERSION_PROFILER_EVENTS,
 	.profile = profiler_profile,
+	.ring = profiler_ring,
 };
 
 static void registry_event_global(void *data, uint32_t id,
@@ -677,6 +770,7 @@ int main(int argc, char *argv[])
 {
 	struct data data = { 0 };
 	struct pw_loop *l;
+	struct ring *r;
 	const char *opt_remote = NULL;
 	const char *opt_output = DEFAULT_FILENAME;
 	static const struct option long_options[] = {
@@ -776,8 +870,18 @@ int main(int argc, char *argv[])
 
 	data.check_profiler = pw_core_sync(data.core, 0, 0);
 
+	spa_list_init(&data.rings);
+	data.timer = pw_loop_add_timer(l, do_poll, &data);
+	pw_loop_update_timer(l, data.timer,
+			&(struct timespec) { 0, POLL_INTERVAL_MS * SPA_NSEC_PER_MSEC },
+			&(struct timespec) { 0, POLL_INTERVAL_MS * SPA_NSEC_PER_MSEC }, false);
+
 	pw_main_loop_run(data.loop);
 
+	spa_list_consume(r, &data.rings, link)
+		free_ring(r);
+	free(data.record);
+
 	if (data.profiler) {
 		spa_hook_remove(&data.profiler_listener);
 		pw_proxy_destroy((struct pw_proxy*)data.profiler);
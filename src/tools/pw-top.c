@@ -23,6 +23,7 @@
 
 #define MAX_FORMAT		16
 #define MAX_NAME		128
+#define POLL_INTERVAL_MS	50
 
 #define XRUN_INVALID	(uint32_t)-1
 
@@ -46,6 +47,12 @@ struct measurement {
 	uint32_t xrun_count;
 };
 
+struct stats {
+	int64_t count;
+	int64_t wait[4];	/* p50, p99, p99.9, max */
+	int64_t busy[4];
+};
+
 struct node {
 	struct spa_list link;
 	struct data *data;
@@ -54,6 +61,7 @@ struct node {
 	enum pw_node_state state;
 	struct measurement measurement;
 	uint32_t measurement_base;
+	struct stats stats;
 	struct driver info;
 	uint32_t info_base;
 	struct node *driver;
@@ -65,6 +73,13 @@ struct node {
 	struct spa_hook object_listener;
 };
 
+struct ring {
+	struct spa_list link;
+	uint32_t id;
+	struct pw_memmap *map;
+	struct pw_profiler_ring_reader reader;
+};
+
 struct data {
 	struct pw_main_loop *loop;
 	struct pw_context *context;
@@ -79,6 +94,11 @@ struct data {
 	struct spa_hook profiler_listener;
 	int check_profiler;
 
+	struct spa_list rings;
+	struct spa_source *poll_timer;
+	void *record;
+	uint32_t record_size;
+
 	struct spa_source *timer;
 
 	int n_nodes;
@@ -89,6 +109,7 @@ struct data {
 	WINDOW *win;
 
 	unsigned int batch_mode:1;
+	unsigned int show_stats:1;
 	int iterations;
 };
 
@@ -434,6 +455,34 @@ static int process_follower_block(struct data *d, const struct spa_pod *pod, str
 	return 0;
 }
 
+static int process_follower_stats(struct data *d, const struct spa_pod *pod)
+{
+	uint32_t id = 0;
+	struct stats s;
+	struct node *n;
+	int res;
+
+	spa_zero(s);
+	if ((res = spa_pod_parse_struct(pod,
+			SPA_POD_Int(&id),
+			SPA_POD_Long(&s.count),
+			SPA_POD_Long(&s.wait[0]),
+			SPA_POD_Long(&s.wait[1]),
+			SPA_POD_Long(&s.wait[2]),
+			SPA_POD_Long(&s.wait[3]),
+			SPA_POD_Long(&s.busy[0]),
+			SPA_POD_Long(&s.busy[1]),
+			SPA_POD_Long(&s.busy[2]),
+			SPA_POD_Long(&s.busy[3]))) < 0)
+		return res;
+
+	if ((n = find_node(d, id)) == NULL)
+		return -ENOENT;
+
+	n->stats = s;
+	return 0;
+}
+
 static const char *print_time(char *buf, bool active, size_t len, uint64_t val)
 {
 	if (val == (uint64_t)-1 || !active)
@@ -528,6 +577,27 @@ static void print_node(struct data *d, struct node *dr, struct node *n, int y)
 	else
 		busy = -1;
 
+	if (d->show_stats) {
+		struct stats *s = &n->stats;
+		char buf5[64], buf6[64], buf7[64], buf8[64];
+
+		active = active && s->count > 0;
+		print_mode_dependent(d, y, 0, "%s %4.1u %s %s %s %s %s %s %s %s %s%s",
+			state_as_string(n->state, i->transport_state),
+			n->id,
+			print_time(buf1, active, 64, s->wait[0]),
+			print_time(buf2, active, 64, s->wait[1]),
+			print_time(buf3, active, 64, s->wait[2]),
+			print_time(buf4, active, 64, s->wait[3]),
+			print_time(buf5, active, 64, s->busy[0]),
+			print_time(buf6, active, 64, s->busy[1]),
+			print_time(buf7, active, 64, s->busy[2]),
+			print_time(buf8, active, 64, s->busy[3]),
+			n->driver == n ? "" : " + ",
+			n->name);
+		return;
+	}
+
 	print_mode_dependent(d, y, 0, "%s %4.1u %6.1u %6.1u %s %s %s %s  %3.1u %16.16s %s%s",
 			state_as_string(n->state, i->transport_state),
 			n->id,
@@ -552,6 +622,7 @@ static void clear_node(struct node *n)
 }
 
 #define HEADER	"S   ID  QUANT   RATE    WAIT    BUSY   W/Q   B/Q  ERR FORMAT           NAME "
+#define HEADER_STATS	"S   ID  W-P50   W-P99  W-P99.9  W-MAX   B-P50   B-P99  B-P99.9  B-MAX   NAME "
 
 static void do_refresh(struct data *d, bool force_refresh)
 {
@@ -564,11 +635,12 @@ static void do_refresh(struct data *d, bool force_refresh)
 	if (!d->batch_mode) {
 		wclear(d->win);
 		wattron(d->win, A_REVERSE);
-		wprintw(d->win, "%-*.*s", COLS, COLS, HEADER);
+		wprintw(d->win, "%-*.*s", COLS, COLS,
+				d->show_stats ? HEADER_STATS : HEADER);
 		wattroff(d->win, A_REVERSE);
 		wprintw(d->win, "\n");
 	} else
-		printf(HEADER "\n");
+		printf("%s\n", d->show_stats ? HEADER_STATS : HEADER);
 
 	spa_list_for_each_safe(n, t, &d->node_list, link) {
 		if (n->driver != n)
@@ -626,49 +698,124 @@ static void reset_xruns(struct data *d)
 	do_refresh(d, true);
 }
 
-static void profiler_profile(void *data, const struct spa_pod *pod)
+static void process_profile(struct data *d, struct spa_pod *o)
 {
-	struct data *d = data;
-	struct spa_pod *o;
 	struct spa_pod_prop *p;
 	struct point point;
+	int res = 0;
 
-	SPA_POD_STRUCT_FOREACH(pod, o) {
-		int res = 0;
-		if (!spa_pod_is_object_type(o, SPA_TYPE_OBJECT_Profiler))
-			continue;
+	if (!spa_pod_is_object_type(o, SPA_TYPE_OBJECT_Profiler))
+		return;
 
-		spa_zero(point);
-		SPA_POD_OBJECT_FOREACH((struct spa_pod_object*)o, p) {
-			switch(p->key) {
-			case SPA_PROFILER_info:
-				res = process_info(d, &p->value, &point.info);
-				break;
-			case SPA_PROFILER_clock:
-				res = process_clock(d, &p->value, &point.info);
-				break;
-			case SPA_PROFILER_driverBlock:
-				res = process_driver_block(d, &p->value, &point);
-				break;
-			case SPA_PROFILER_followerBlock:
-				process_follower_block(d, &p->value, &point);
-				break;
-			default:
-				break;
-			}
-			if (res < 0)
-				break;
+	spa_zero(point);
+	SPA_POD_OBJECT_FOREACH((struct spa_pod_object*)o, p) {
+		switch(p->key) {
+		case SPA_PROFILER_info:
+			res = process_info(d, &p->value, &point.info);
+			break;
+		case SPA_PROFILER_clock:
+			res = process_clock(d, &p->value, &point.info);
+			break;
+		case SPA_PROFILER_driverBlock:
+			res = process_driver_block(d, &p->value, &point);
+			break;
+		case SPA_PROFILER_followerBlock:
+			process_follower_block(d, &p->value, &point);
+			break;
+		case SPA_PROFILER_followerStats:
+			process_follower_stats(d, &p->value);
+			break;
+		default:
+			break;
 		}
 		if (res < 0)
-			continue;
+			break;
+	}
+}
+
+static void profiler_profile(void *data, const struct spa_pod *pod)
+{
+	struct data *d = data;
+	struct spa_pod *o;
+
+	SPA_POD_STRUCT_FOREACH(pod, o)
+		process_profile(d, o);
+
+	do_refresh(d, false);
+}
+
+static void free_ring(struct ring *r)
+{
+	spa_list_remove(&r->link);
+	pw_memmap_free(r->map);
+	free(r);
+}
+
+static void profiler_ring(void *data, uint32_t id, uint32_t mem_id, uint32_t offset, uint32_t size)
+{
+	struct data *d = data;
+	struct pw_memmap *map;
+	struct ring *r;
+
+	spa_list_for_each(r, &d->rings, link) {
+		if (r->id == id) {
+			free_ring(r);
+			break;
+		}
 	}
+	if (mem_id == SPA_ID_INVALID)
+		return;
 
+	map = pw_mempool_map_id(pw_core_get_mempool(d->core), mem_id,
+			PW_MEMMAP_FLAG_READ, offset, size, NULL);
+	if (map == NULL) {
+		pw_log_warn("can't map ring %u of driver %u: %m", mem_id, id);
+		return;
+	}
+	if ((r = calloc(1, sizeof(*r))) == NULL) {
+		pw_memmap_free(map);
+		return;
+	}
+	r->id = id;
+	r->map = map;
+	if (pw_profiler_ring_reader_init(&r->reader, map->ptr, size) < 0) {
+		pw_log_warn("invalid ring %u of driver %u", mem_id, id);
+		goto error;
+	}
+	if (r->reader.max_record > d->record_size) {
+		void *record = realloc(d->record, r->reader.max_record);
+		if (record == NULL)
+			goto error;
+		d->record = record;
+		d->record_size = r->reader.max_record;
+	}
+	spa_list_append(&d->rings, &r->link);
+	return;
+error:
+	pw_memmap_free(map);
+	free(r);
+}
+
+static void do_poll(void *data, uint64_t expirations)
+{
+	struct data *d = data;
+	struct ring *r;
+	int res;
+
+	spa_list_for_each(r, &d->rings, link) {
+		while ((res = pw_profiler_ring_read(&r->reader,
+						d->record, d->record_size)) != 0) {
+			if (res > 0)
+				process_profile(d, d->record);
+		}
+	}
 	do_refresh(d, false);
 }
 
 static const struct pw_profiler_events profiler_events = {
 	PW_VERSION_PROFILER_EVENTS,
 	.profile = profiler_profile,
+	.ring = profiler_ring,
 };
 
 static void registry_event_global(void *data, uint32_t id,
@@ -771,6 +918,7 @@ static void show_help(const char *name, bool error)
 		"Options:\n"
 		"  -b, --batch-mode		         run in non-interactive batch mode\n"
 		"  -n, --iterations = NUMBER             exit after NUMBER batch iterations\n"
+		"  -s, --stats                           show wait and busy time percentiles\n"
 		"  -r, --remote                          Remote daemon name\n"
 		"\n"
 		"  -h, --help                            Show this help\n"
@@ -805,6 +953,10 @@ static void do_handle_io(void *data, int fd, uint32_t mask)
 		case 'c':
 			reset_xruns(d);
 			break;
+		case 's':
+			d->show_stats = !d->show_stats;
+			do_refresh(d, true);
+			break;
 		default:
 			do_refresh(d, !d->batch_mode);
 			break;
@@ -820,6 +972,7 @@ int main(int argc, char *argv[])
 	static const struct option long_options[] = {
 		{ "batch-mode",	no_argument,		NULL, 'b' },
 		{ "iterations",	required_argument,	NULL, 'n' },
+		{ "stats",	no_argument,		NULL, 's' },
 		{ "remote",	required_argument,	NULL, 'r' },
 		{ "help",	no_argument,		NULL, 'h' },
 		{ "version",	no_argument,		NULL, 'V' },
@@ -828,6 +981,7 @@ int main(int argc, char *argv[])
 	int c;
 	struct timespec value, interval;
 	struct node *n;
+	struct ring *r;
 
 	setlocale(LC_ALL, "");
 	pw_init(&argc, &argv);
@@ -835,8 +989,9 @@ int main(int argc, char *argv[])
 	data.iterations = -1;
 
 	spa_list_init(&data.node_list);
+	spa_list_init(&data.rings);
 
-	while ((c = getopt_long(argc, argv, "hVr:o:bn:", long_options, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hVr:o:bn:s", long_options, NULL)) != -1) {
 		switch (c) {
 		case 'h':
 			show_help(argv[0], false);
@@ -858,6 +1013,9 @@ int main(int argc, char *argv[])
 		case 'n':
 			spa_atoi32(optarg, &data.iterations, 10);
 			break;
+		case 's':
+			data.show_stats = 1;
+			break;
 		default:
 			show_help(argv[0], true);
 			return -1;
@@ -919,6 +1077,11 @@ int main(int argc, char *argv[])
 	interval.tv_nsec = 0;
 	pw_loop_update_timer(l, data.timer, &value, &interval, false);
 
+	data.poll_timer = pw_loop_add_timer(l, do_poll, &data);
+	value.tv_sec = interval.tv_sec = 0;
+	value.tv_nsec = interval.tv_nsec = POLL_INTERVAL_MS * SPA_NSEC_PER_MSEC;
+	pw_loop_update_timer(l, data.poll_timer, &value, &interval, false);
+
 	if (!data.batch_mode)
 		pw_loop_add_io(l, fileno(stdin), SPA_IO_IN, false, do_handle_io, &data);
 
@@ -929,6 +1092,9 @@ int main(int argc, char *argv[])
 
 	spa_list_consume(n, &data.node_list, link)
 		remove_node(&data, n);
+	spa_list_consume(r, &data.rings, link)
+		free_ring(r);
+	free(data.record);
 	if (data.profiler) {
 		spa_hook_remove(&data.profiler_listener);
 		pw_proxy_destroy((struct pw_proxy*)data.profiler);
@@ -4,12 +4,18 @@
 
 #include "pwtest.h"
 
+#include <unistd.h>
+
+#include <spa/utils/atomic.h>
 #include <spa/utils/string.h>
 #include <spa/support/dbus.h>
 #include <spa/support/cpu.h>
+#include <spa/node/node.h>
+#include <spa/node/utils.h>
 
 #include <pipewire/pipewire.h>
 #include <pipewire/global.h>
+#include <pipewire/impl.h>
 
 #define TEST_FUNC(a,b,func)	\
 do {				\
@@ -259,12 +265,299 @@ PWTEST(context_support)
 	return PWTEST_PASS;
 }
 
+static int pool_locked(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	int *count = user_data;
+	(*count)++;
+	return 0;
+}
+
+struct pool_data {
+	struct pw_loop *pool;
+	int count;
+	int invoked;
+	int invoke_res;
+	int block_res;
+};
+
+static void pool_on_event(struct spa_source *source)
+{
+	struct pool_data *d = source->data;
+	uint64_t cmd;
+
+	if (spa_system_eventfd_read(d->pool->system, source->fd, &cmd) < 0) {
+		/* another data loop took the wakeup */
+		source->rmask = 0;
+		return;
+	}
+	if (cmd > 1) {
+		/* ask for an invoke from the data loop */
+		d->block_res = pw_loop_invoke(d->pool, pool_locked, 0, NULL, 0, true, &d->invoked);
+		d->invoke_res = pw_loop_invoke(d->pool, pool_locked, 0, NULL, 0, false, &d->invoked);
+	}
+	SPA_ATOMIC_INC(d->count);
+}
+
+PWTEST(context_loop_pool)
+{
+	struct pw_main_loop *loop;
+	struct pw_context *context;
+	struct pw_loop *pool;
+	struct spa_source source;
+	struct pool_data data;
+	struct pw_loop_pool_stats stats[2];
+	uint64_t total;
+	int i, count = 0, res, timeout;
+
+	pw_init(0, NULL);
+
+	loop = pw_main_loop_new(NULL);
+	context = pw_context_new(pw_main_loop_get_loop(loop),
+			pw_properties_new("context.num-data-loops", "2", NULL),
+			0);
+	pwtest_ptr_notnull(context);
+
+	pool = pw_context_acquire_loop(context,
+			&SPA_DICT_ITEMS(SPA_DICT_ITEM(PW_KEY_NODE_LOOP_NAME, "data-pool")));
+	pwtest_ptr_notnull(pool);
+	pwtest_str_eq(pool->name, "data-pool");
+
+	/* the same loop is returned for the name */
+	pwtest_ptr_eq(pool, pw_context_acquire_loop(context,
+			&SPA_DICT_ITEMS(SPA_DICT_ITEM(PW_KEY_NODE_LOOP_NAME, "data-pool"))));
+
+	pwtest_int_eq(pw_loop_locked(pool, pool_locked, 0, NULL, 0, &count), 0);
+	pwtest_int_eq(count, 1);
+	pwtest_int_eq(pw_loop_invoke(pool, pool_locked, 0, NULL, 0, true, &count), 0);
+	pwtest_int_eq(count, 2);
+
+	spa_zero(data);
+	data.pool = pool;
+	res = spa_system_eventfd_create(pool->system, SPA_FD_CLOEXEC | SPA_FD_NONBLOCK);
+	pwtest_neg_errno_ok(res);
+
+	spa_zero(source);
+	source.fd = res;
+	source.func = pool_on_event;
+	source.data = &data;
+	source.mask = SPA_IO_IN;
+	pwtest_neg_errno_ok(spa_loop_add_source(pool->loop, &source));
+
+	/* every wakeup is handled by exactly one of the data loops */
+	for (i = 0; i < 10; i++) {
+		timeout = 1000;
+		spa_system_eventfd_write(pool->system, source.fd, 1);
+		while (SPA_ATOMIC_LOAD(data.count) != i + 1 && timeout-- > 0)
+			usleep(1000);
+		pwtest_int_eq(SPA_ATOMIC_LOAD(data.count), i + 1);
+	}
+
+	/* every wakeup is counted once */
+	pwtest_int_eq(pw_context_get_loop_pool_stats(context, stats, 2), 2u);
+	total = stats[0].count + stats[1].count;
+	pwtest_int_eq(total, 10u);
+
+	/* an invoke from a data loop is done by the main loop with all
+	 * loops locked, a blocking invoke is refused */
+	spa_system_eventfd_write(pool->system, source.fd, 2);
+	for (timeout = 1000; SPA_ATOMIC_LOAD(data.count) != 11 && timeout > 0; timeout--)
+		usleep(1000);
+	pwtest_int_eq(SPA_ATOMIC_LOAD(data.count), 11);
+	pwtest_int_eq(data.block_res, -EDEADLK);
+	pwtest_int_eq(data.invoke_res, 0);
+	for (timeout = 1000; data.invoked == 0 && timeout > 0; timeout--)
+		pw_loop_iterate(pw_main_loop_get_loop(loop), 1);
+	pwtest_int_eq(data.invoked, 1);
+
+	pwtest_neg_errno_ok(spa_loop_remove_source(pool->loop, &source));
+	spa_system_close(pool->system, source.fd);
+
+	pw_context_destroy(context);
+	pw_main_loop_destroy(loop);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
+struct recalc_node {
+	struct spa_node node;
+	struct spa_hook_list hooks;
+	struct pw_impl_node *impl;
+};
+
+static int recalc_node_add_listener(void *object, struct spa_hook *listener,
+		const struct spa_node_events *events, void *data)
+{
+	struct recalc_node *d = object;
+	spa_hook_list_append(&d->hooks, listener, events, data);
+	return 0;
+}
+
+static int recalc_node_set_callbacks(void *object,
+		const struct spa_node_callbacks *callbacks, void *data)
+{
+	return 0;
+}
+
+static int recalc_node_set_io(void *object, uint32_t id, void *data, size_t size)
+{
+	return 0;
+}
+
+static int recalc_node_send_command(void *object, const struct spa_command *command)
+{
+	return 0;
+}
+
+static int recalc_node_process(void *object)
+{
+	return SPA_STATUS_OK;
+}
+
+static const struct spa_node_methods recalc_node_methods = {
+	SPA_VERSION_NODE_METHODS,
+	.add_listener = recalc_node_add_listener,
+	.set_callbacks = recalc_node_set_callbacks,
+	.set_io = recalc_node_set_io,
+	.send_command = recalc_node_send_command,
+	.process = recalc_node_process,
+};
+
+static void recalc_node_make(struct pw_context *context, struct recalc_node *d,
+		const char *name, bool driver, bool always_process)
+{
+	struct pw_properties *props;
+
+	spa_zero(*d);
+	d->node.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_Node,
+			SPA_VERSION_NODE, &recalc_node_methods, d);
+	spa_hook_list_init(&d->hooks);
+
+	props = pw_properties_new(PW_KEY_NODE_NAME, name, NULL);
+	if (driver) {
+		pw_properties_set(props, PW_KEY_NODE_DRIVER, "true");
+		pw_properties_set(props, PW_KEY_PRIORITY_DRIVER, "1");
+	}
+	if (always_process)
+		pw_properties_set(props, PW_KEY_NODE_ALWAYS_PROCESS, "true");
+
+	d->impl = pw_context_create_node(context, props, 0);
+	pwtest_ptr_notnull(d->impl);
+	pwtest_neg_errno_ok(pw_impl_node_set_implementation(d->impl, &d->node));
+	pwtest_neg_errno_ok(pw_impl_node_register(d->impl, NULL));
+}
+
+/* the state changes complete in the main loop */
+static bool recalc_node_running(struct pw_main_loop *loop, struct recalc_node *d, bool running)
+{
+	int timeout;
+
+	for (timeout = 1000; timeout > 0; timeout--) {
+		if ((pw_impl_node_get_info(d->impl)->state == PW_NODE_STATE_RUNNING) == running)
+			return true;
+		pw_loop_iterate(pw_main_loop_get_loop(loop), 0);
+		usleep(1000);
+	}
+	return false;
+}
+
+PWTEST(context_recalc_graph)
+{
+	struct pw_main_loop *loop;
+	struct pw_context *context;
+	struct pw_context_recalc_stats s0, s1;
+	struct recalc_node driver, nodes[3], single;
+	uint32_t i;
+
+	pw_init(0, NULL);
+
+	loop = pw_main_loop_new(NULL);
+	context = pw_context_new(pw_main_loop_get_loop(loop),
+			pw_properties_new(PW_KEY_CONFIG_NAME, "null", NULL), 0);
+	pwtest_ptr_notnull(context);
+
+	recalc_node_make(context, &driver, "driver", true, false);
+	for (i = 0; i < SPA_N_ELEMENTS(nodes); i++)
+		recalc_node_make(context, &nodes[i], "node", false, true);
+	pw_loop_iterate(pw_main_loop_get_loop(loop), 0);
+
+	/* activations are queued and evaluated together */
+	pwtest_int_eq(pw_context_get_recalc_stats(context, &s0), 0);
+	pw_impl_node_set_active(driver.impl, true);
+	for (i = 0; i < SPA_N_ELEMENTS(nodes); i++)
+		pw_impl_node_set_active(nodes[i].impl, true);
+
+	pw_context_get_recalc_stats(context, &s1);
+	pwtest_int_eq(s1.requests - s0.requests, 4u);
+	pwtest_int_eq(s1.count, s0.count);
+	pwtest_int_ne(pw_impl_node_get_info(nodes[0].impl)->state, PW_NODE_STATE_RUNNING);
+
+	pw_loop_iterate(pw_main_loop_get_loop(loop), 0);
+
+	pw_context_get_recalc_stats(context, &s1);
+	pwtest_int_eq(s1.count - s0.count, 1u);
+	pwtest_int_eq(s1.coalesced - s0.coalesced, 3u);
+	pwtest_bool_true(recalc_node_running(loop, &driver, true));
+	for (i = 0; i < SPA_N_ELEMENTS(nodes); i++)
+		pwtest_bool_true(recalc_node_running(loop, &nodes[i], true));
+
+	/* a node that is not linked to anything is evaluated alone */
+	recalc_node_make(context, &single, "single", false, false);
+	pw_context_get_recalc_stats(context, &s0);
+	pw_impl_node_set_active(single.impl, true);
+	pw_loop_iterate(pw_main_loop_get_loop(loop), 0);
+	pw_context_get_recalc_stats(context, &s1);
+	pwtest_int_eq(s1.count - s0.count, 1u);
+	pwtest_int_eq(s1.full, s0.full);
+	pwtest_int_eq(s1.nodes - s0.nodes, 1u);
+
+	/* a deactivated node is out of the graph right away */
+	pw_context_get_recalc_stats(context, &s0);
+	pw_impl_node_set_active(nodes[2].impl, false);
+	pw_context_get_recalc_stats(context, &s1);
+	pwtest_int_eq(s1.count - s0.count, 1u);
+	pwtest_bool_true(recalc_node_running(loop, &nodes[2], false));
+	pwtest_bool_true(recalc_node_running(loop, &nodes[1], true));
+
+	/* destroying an active node without a driver evaluates the graph */
+	pw_context_get_recalc_stats(context, &s0);
+	pw_impl_node_destroy(single.impl);
+	pw_context_get_recalc_stats(context, &s1);
+	pwtest_int_eq(s1.count - s0.count, 1u);
+	pwtest_int_eq(s1.full - s0.full, 1u);
+
+	/* destroying an active follower evaluates its driver */
+	pw_context_get_recalc_stats(context, &s0);
+	pw_impl_node_destroy(nodes[1].impl);
+	pw_context_get_recalc_stats(context, &s1);
+	pwtest_int_eq(s1.count - s0.count, 1u);
+	pwtest_bool_true(recalc_node_running(loop, &nodes[0], true));
+
+	/* destroying the driver stops its followers */
+	pw_impl_node_destroy(driver.impl);
+	pwtest_bool_true(recalc_node_running(loop, &nodes[0], false));
+
+	pw_impl_node_destroy(nodes[0].impl);
+	pw_impl_node_destroy(nodes[2].impl);
+
+	pw_context_destroy(context);
+	pw_main_loop_destroy(loop);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
 PWTEST_SUITE(context)
 {
 	pwtest_add(context_abi, PWTEST_NOARG);
 	pwtest_add(context_create, PWTEST_NOARG);
 	pwtest_add(context_properties, PWTEST_NOARG);
 	pwtest_add(context_support, PWTEST_NOARG);
+	pwtest_add(context_loop_pool, PWTEST_NOARG);
+	pwtest_add(context_recalc_graph, PWTEST_NOARG);
 
 	return PWTEST_PASS;
 }
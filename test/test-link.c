@@ -0,0 +1,333 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "pwtest.h"
+
+#include <unistd.h>
+
+#include <spa/node/node.h>
+#include <spa/node/utils.h>
+#include <spa/pod/filter.h>
+#include <spa/param/audio/format-utils.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/impl.h>
+
+#include "pipewire/private.h"
+
+struct test_node {
+	struct spa_node node;
+	struct spa_hook_list hooks;
+	bool driver;
+	enum spa_direction direction;
+
+	struct spa_param_info params[4];
+	struct spa_port_info port_info;
+
+	bool have_format;
+	struct spa_audio_info_raw format;
+
+	uint32_t n_enum_format;
+	struct pw_impl_node *impl;
+};
+
+static void emit_port_info(struct test_node *d, uint64_t change_mask)
+{
+	d->port_info.change_mask = change_mask;
+	spa_node_emit_port_info(&d->hooks, d->direction, 0, &d->port_info);
+	d->port_info.change_mask = 0;
+}
+
+static int node_add_listener(void *object, struct spa_hook *listener,
+		const struct spa_node_events *events, void *data)
+{
+	struct test_node *d = object;
+	struct spa_hook_list save;
+	struct spa_node_info info = SPA_NODE_INFO_INIT();
+
+	spa_hook_list_isolate(&d->hooks, &save, listener, events, data);
+
+	info.max_input_ports = !d->driver && d->direction == SPA_DIRECTION_INPUT ? 1 : 0;
+	info.max_output_ports = !d->driver && d->direction == SPA_DIRECTION_OUTPUT ? 1 : 0;
+	info.change_mask = SPA_NODE_CHANGE_MASK_FLAGS;
+	info.flags = SPA_NODE_FLAG_RT;
+	spa_node_emit_info(&d->hooks, &info);
+	if (!d->driver)
+		emit_port_info(d, SPA_PORT_CHANGE_MASK_FLAGS | SPA_PORT_CHANGE_MASK_PARAMS);
+
+	spa_hook_list_join(&d->hooks, &save);
+	return 0;
+}
+
+static int node_set_callbacks(void *object, const struct spa_node_callbacks *callbacks,
+		void *data)
+{
+	return 0;
+}
+
+static int node_set_io(void *object, uint32_t id, void *data, size_t size)
+{
+	return 0;
+}
+
+static int node_send_command(void *object, const struct spa_command *command)
+{
+	return 0;
+}
+
+static int node_port_enum_params(void *object, int seq,
+		enum spa_direction direction, uint32_t port_id,
+		uint32_t id, uint32_t start, uint32_t num,
+		const struct spa_pod *filter)
+{
+	struct test_node *d = object;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+	struct spa_result_node_params result;
+
+	if (id == SPA_PARAM_EnumFormat)
+		d->n_enum_format++;
+
+	result.id = id;
+	result.index = start;
+	result.next = start + 1;
+
+	if (start > 0)
+		return 0;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (id) {
+	case SPA_PARAM_EnumFormat:
+		param = spa_format_audio_raw_build(&b, id,
+				&SPA_AUDIO_INFO_RAW_INIT(
+					.format = SPA_AUDIO_FORMAT_F32P,
+					.rate = 48000,
+					.channels = 1,
+					.position = { SPA_AUDIO_CHANNEL_MONO }));
+		break;
+	case SPA_PARAM_Format:
+		if (!d->have_format)
+			return -EIO;
+		param = spa_format_audio_raw_build(&b, id, &d->format);
+		break;
+	case SPA_PARAM_Buffers:
+		if (!d->have_format)
+			return -EIO;
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_ParamBuffers, id,
+			SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(1, 1, 2),
+			SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(1),
+			SPA_PARAM_BUFFERS_size,    SPA_POD_CHOICE_RANGE_Int(4096, 16, INT32_MAX),
+			SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(4));
+		break;
+	case SPA_PARAM_IO:
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_ParamIO, id,
+			SPA_PARAM_IO_id,   SPA_POD_Id(SPA_IO_Buffers),
+			SPA_PARAM_IO_size, SPA_POD_Int(sizeof(struct spa_io_buffers)));
+		break;
+	default:
+		return -ENOENT;
+	}
+
+	if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+		return 0;
+
+	spa_node_emit_result(&d->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
+	return 0;
+}
+
+static int node_port_set_param(void *object,
+		enum spa_direction direction, uint32_t port_id,
+		uint32_t id, uint32_t flags, const struct spa_pod *param)
+{
+	struct test_node *d = object;
+
+	if (id != SPA_PARAM_Format)
+		return -ENOENT;
+
+	if (param == NULL) {
+		d->have_format = false;
+		return 0;
+	}
+	spa_zero(d->format);
+	if (spa_format_audio_raw_parse(param, &d->format) < 0)
+		return -EINVAL;
+	d->have_format = true;
+	return 0;
+}
+
+static int node_port_use_buffers(void *object,
+		enum spa_direction direction, uint32_t port_id, uint32_t flags,
+		struct spa_buffer **buffers, uint32_t n_buffers)
+{
+	return 0;
+}
+
+static int node_port_set_io(void *object, enum spa_direction direction, uint32_t port_id,
+		uint32_t id, void *data, size_t size)
+{
+	return 0;
+}
+
+static int node_process(void *object)
+{
+	return SPA_STATUS_OK;
+}
+
+static const struct spa_node_methods node_methods = {
+	SPA_VERSION_NODE_METHODS,
+	.add_listener = node_add_listener,
+	.set_callbacks = node_set_callbacks,
+	.set_io = node_set_io,
+	.send_command = node_send_command,
+	.port_enum_params = node_port_enum_params,
+	.port_set_param = node_port_set_param,
+	.port_use_buffers = node_port_use_buffers,
+	.port_set_io = node_port_set_io,
+	.process = node_process,
+};
+
+/* a driver has no ports */
+static void make_node(struct pw_context *context, struct test_node *d,
+		const char *name, bool driver, enum spa_direction direction)
+{
+	struct pw_properties *props;
+
+	spa_zero(*d);
+	d->node.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_Node,
+			SPA_VERSION_NODE, &node_methods, d);
+	spa_hook_list_init(&d->hooks);
+	d->driver = driver;
+	d->direction = direction;
+
+	d->params[0] = SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
+	d->params[1] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+	d->params[2] = SPA_PARAM_INFO(SPA_PARAM_Buffers, SPA_PARAM_INFO_READ);
+	d->params[3] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
+	d->port_info = SPA_PORT_INFO_INIT();
+	d->port_info.params = d->params;
+	d->port_info.n_params = SPA_N_ELEMENTS(d->params);
+
+	props = pw_properties_new(PW_KEY_NODE_NAME, name, NULL);
+	if (driver) {
+		pw_properties_set(props, PW_KEY_NODE_DRIVER, "true");
+		pw_properties_set(props, PW_KEY_PRIORITY_DRIVER, "1");
+	} else {
+		pw_properties_set(props, PW_KEY_NODE_ALWAYS_PROCESS, "true");
+	}
+	d->impl = pw_context_create_node(context, props, 0);
+	pwtest_ptr_notnull(d->impl);
+	pwtest_neg_errno_ok(pw_impl_node_set_implementation(d->impl, &d->node));
+	pwtest_neg_errno_ok(pw_impl_node_register(d->impl, NULL));
+	pw_impl_node_set_active(d->impl, true);
+}
+
+static bool wait_link_state(struct pw_main_loop *loop, struct pw_impl_link *link,
+		enum pw_link_state state)
+{
+	int timeout;
+
+	for (timeout = 1000; timeout > 0; timeout--) {
+		if (pw_impl_link_get_info(link)->state == state)
+			return true;
+		pw_loop_iterate(pw_main_loop_get_loop(loop), 0);
+		usleep(1000);
+	}
+	return false;
+}
+
+/* suspend both nodes, this clears the formats, and start them again */
+static void renegotiate(struct pw_main_loop *loop, struct pw_impl_link *link,
+		struct test_node *out, struct test_node *in)
+{
+	pw_impl_node_set_active(out->impl, false);
+	pw_impl_node_set_state(out->impl, PW_NODE_STATE_SUSPENDED);
+	pw_impl_node_set_state(in->impl, PW_NODE_STATE_SUSPENDED);
+	pwtest_bool_false(out->have_format);
+	pwtest_bool_false(in->have_format);
+
+	pw_impl_node_set_active(out->impl, true);
+	pwtest_bool_true(wait_link_state(loop, link, PW_LINK_STATE_ACTIVE));
+	pwtest_bool_true(out->have_format);
+	pwtest_bool_true(in->have_format);
+}
+
+PWTEST(link_format_cache)
+{
+	struct pw_main_loop *loop;
+	struct pw_context *context;
+	struct test_node driver, out, in;
+	struct pw_impl_link *link;
+	uint32_t n_out, n_in;
+
+	pw_init(0, NULL);
+
+	loop = pw_main_loop_new(NULL);
+	context = pw_context_new(pw_main_loop_get_loop(loop),
+			pw_properties_new(PW_KEY_CONFIG_NAME, "null", NULL), 0);
+	pwtest_ptr_notnull(context);
+
+	make_node(context, &driver, "driver", true, 0);
+	make_node(context, &out, "out", false, SPA_DIRECTION_OUTPUT);
+	make_node(context, &in, "in", false, SPA_DIRECTION_INPUT);
+
+	link = pw_context_create_link(context,
+			pw_impl_node_find_port(out.impl, PW_DIRECTION_OUTPUT, 0),
+			pw_impl_node_find_port(in.impl, PW_DIRECTION_INPUT, 0),
+			NULL, NULL, 0);
+	pwtest_ptr_notnull(link);
+	pwtest_neg_errno_ok(pw_impl_link_register(link, NULL));
+
+	/* the first negotiation asks both nodes */
+	pwtest_bool_true(wait_link_state(loop, link, PW_LINK_STATE_ACTIVE));
+	pwtest_int_eq(out.format.rate, 48000u);
+	pwtest_int_eq(in.format.rate, 48000u);
+	pwtest_int_gt(out.n_enum_format, 0u);
+	pwtest_int_gt(in.n_enum_format, 0u);
+
+	/* the same format is used again without asking the nodes */
+	n_out = out.n_enum_format;
+	n_in = in.n_enum_format;
+	renegotiate(loop, link, &out, &in);
+	pwtest_int_eq(out.n_enum_format, n_out);
+	pwtest_int_eq(in.n_enum_format, n_in);
+	pwtest_int_eq(in.format.rate, 48000u);
+
+	/* a change of the EnumFormat param of a port drops the cache */
+	out.params[0].flags ^= SPA_PARAM_INFO_SERIAL;
+	emit_port_info(&out, SPA_PORT_CHANGE_MASK_PARAMS);
+
+	renegotiate(loop, link, &out, &in);
+	pwtest_int_gt(out.n_enum_format, n_out);
+	pwtest_int_gt(in.n_enum_format, n_in);
+
+	/* and the new result is cached again */
+	n_out = out.n_enum_format;
+	n_in = in.n_enum_format;
+	renegotiate(loop, link, &out, &in);
+	pwtest_int_eq(out.n_enum_format, n_out);
+	pwtest_int_eq(in.n_enum_format, n_in);
+
+	pw_impl_link_destroy(link);
+	pw_impl_node_destroy(in.impl);
+	pw_impl_node_destroy(out.impl);
+	pw_impl_node_destroy(driver.impl);
+
+	pw_context_destroy(context);
+	pw_main_loop_destroy(loop);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
+PWTEST_SUITE(link)
+{
+	pwtest_add(link_format_cache, PWTEST_NOARG);
+
+	return PWTEST_PASS;
+}
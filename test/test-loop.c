@@ -6,10 +6,13 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/eventfd.h>
 
 #include "pwtest.h"
 
+#include <spa/utils/names.h>
+
 #include <pipewire/pipewire.h>
 
 struct obj {
@@ -24,6 +27,38 @@ struct data {
 	int count;
 };
 
+/* the properties of the loops of the test, NULL when the System of the
+ * loop.system property can't be used here */
+static struct pw_properties *loop_props(struct pwtest_test *t)
+{
+	struct pw_properties *props;
+	struct spa_support support[32];
+	struct spa_handle *handle;
+	const char *str;
+	char name[64];
+	uint32_t n_support;
+
+	if (pwtest_get_props(t) != NULL)
+		props = pw_properties_copy(pwtest_get_props(t));
+	else
+		props = pw_properties_new(NULL, NULL);
+	pwtest_ptr_notnull(props);
+
+	/* the loop uses epoll when the System is not available, skip the
+	 * test instead of running it twice with epoll */
+	str = pw_properties_get(props, PW_KEY_LOOP_SYSTEM);
+	if (str != NULL && !spa_streq(str, "epoll")) {
+		snprintf(name, sizeof(name), "%s.%s", SPA_NAME_SUPPORT_SYSTEM, str);
+		n_support = pw_get_support(support, SPA_N_ELEMENTS(support));
+		if ((handle = pw_load_spa_handle(NULL, name, NULL, n_support, support)) == NULL) {
+			pw_properties_free(props);
+			return NULL;
+		}
+		pw_unload_spa_handle(handle);
+	}
+	return props;
+}
+
 static inline void write_eventfd(int evfd)
 {
 	uint64_t value = 1;
@@ -56,12 +91,16 @@ static void on_event(struct spa_source *source)
 
 PWTEST(pwtest_loop_destroy2)
 {
+	struct pw_properties *props;
 	struct data data;
 
 	pw_init(0, NULL);
 
+	if ((props = loop_props(current_test)) == NULL)
+		return PWTEST_SKIP;
+
 	spa_zero(data);
-	data.ml = pw_main_loop_new(NULL);
+	data.ml = pw_main_loop_new(&props->dict);
 	pwtest_ptr_notnull(data.ml);
 
 	data.l = pw_main_loop_get_loop(data.ml);
@@ -87,6 +126,7 @@ PWTEST(pwtest_loop_destroy2)
 
 	pw_main_loop_run(data.ml);
 	pw_main_loop_destroy(data.ml);
+	pw_properties_free(props);
 
 	pw_deinit();
 
@@ -115,12 +155,16 @@ on_event_recurse1(struct spa_source *source)
 
 PWTEST(pwtest_loop_recurse1)
 {
+	struct pw_properties *props;
 	struct data data;
 
 	pw_init(0, NULL);
 
+	if ((props = loop_props(current_test)) == NULL)
+		return PWTEST_SKIP;
+
 	spa_zero(data);
-	data.ml = pw_main_loop_new(NULL);
+	data.ml = pw_main_loop_new(&props->dict);
 	pwtest_ptr_notnull(data.ml);
 
 	data.l = pw_main_loop_get_loop(data.ml);
@@ -146,6 +190,7 @@ PWTEST(pwtest_loop_recurse1)
 
 	pw_main_loop_run(data.ml);
 	pw_main_loop_destroy(data.ml);
+	pw_properties_free(props);
 
 	pw_deinit();
 
@@ -184,12 +229,16 @@ on_event_recurse2(struct spa_source *source)
 
 PWTEST(pwtest_loop_recurse2)
 {
+	struct pw_properties *props;
 	struct data data;
 
 	pw_init(0, NULL);
 
+	if ((props = loop_props(current_test)) == NULL)
+		return PWTEST_SKIP;
+
 	spa_zero(data);
-	data.ml = pw_main_loop_new(NULL);
+	data.ml = pw_main_loop_new(&props->dict);
 	pwtest_ptr_notnull(data.ml);
 
 	data.l = pw_main_loop_get_loop(data.ml);
@@ -215,6 +264,7 @@ PWTEST(pwtest_loop_recurse2)
 
 	pw_main_loop_run(data.ml);
 	pw_main_loop_destroy(data.ml);
+	pw_properties_free(props);
 
 	pw_deinit();
 
@@ -256,9 +306,13 @@ PWTEST(destroy_managed_source_before_dispatch)
 {
 	pw_init(NULL, NULL);
 
+	struct pw_properties *props = loop_props(current_test);
+	if (props == NULL)
+		return PWTEST_SKIP;
+
 	struct dmsbd_data data = {0};
 
-	data.ml = pw_main_loop_new(NULL);
+	data.ml = pw_main_loop_new(&props->dict);
 	pwtest_ptr_notnull(data.ml);
 
 	data.l = pw_main_loop_get_loop(data.ml);
@@ -273,6 +327,7 @@ PWTEST(destroy_managed_source_before_dispatch)
 
 	pw_main_loop_run(data.ml);
 	pw_main_loop_destroy(data.ml);
+	pw_properties_free(props);
 
 	pw_deinit();
 
@@ -331,11 +386,15 @@ PWTEST(destroy_managed_source_before_dispatch_recurse)
 {
 	pw_init(NULL, NULL);
 
+	struct pw_properties *props = loop_props(current_test);
+	if (props == NULL)
+		return PWTEST_SKIP;
+
 	struct dmsbd_recurse_data data = {
 		.first = true,
 	};
 
-	data.ml = pw_main_loop_new(NULL);
+	data.ml = pw_main_loop_new(&props->dict);
 	pwtest_ptr_notnull(data.ml);
 
 	data.l = pw_main_loop_get_loop(data.ml);
@@ -353,6 +412,7 @@ PWTEST(destroy_managed_source_before_dispatch_recurse)
 
 	pw_main_loop_run(data.ml);
 	pw_main_loop_destroy(data.ml);
+	pw_properties_free(props);
 
 	pw_deinit();
 
@@ -386,11 +446,6 @@ static int ctwd_add_source(struct spa_loop *loop, bool async, uint32_t seq,
 
 PWTEST(cancel_thread_while_dispatching)
 {
-	static const struct spa_dict_item data_loop_props_items[] = {
-		{ PW_KEY_LOOP_CANCEL, "true" },
-	};
-	static const struct spa_dict data_loop_props = SPA_DICT_INIT_ARRAY(data_loop_props_items);
-
 	struct ctwd_data data = {
 		.source = {
 			.data = &data,
@@ -403,7 +458,12 @@ PWTEST(cancel_thread_while_dispatching)
 
 	pw_init(NULL, NULL);
 
-	struct pw_data_loop *dl = pw_data_loop_new(&data_loop_props);
+	struct pw_properties *props = loop_props(current_test);
+	if (props == NULL)
+		return PWTEST_SKIP;
+	pw_properties_set(props, PW_KEY_LOOP_CANCEL, "true");
+
+	struct pw_data_loop *dl = pw_data_loop_new(&props->dict);
 	pwtest_ptr_notnull(dl);
 
 	struct pw_loop *l = pw_data_loop_get_loop(dl);
@@ -429,20 +489,142 @@ PWTEST(cancel_thread_while_dispatching)
 
 	close(data.source.fd);
 	close(data.handler_running_barrier);
+	pw_properties_free(props);
 
 	pw_deinit();
 
 	return PWTEST_PASS;
 }
 
+#define MP_THREADS	8
+#define MP_INVOKES	10000
+
+struct mp_data {
+	struct pw_loop *l;
+	int count;
+	int order[MP_THREADS];
+	int errors;
+};
+
+struct mp_item {
+	int thread;
+	int seq;
+};
+
+static int mp_invoke(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct mp_data *d = user_data;
+	const struct mp_item *item = data;
+
+	/* items from one thread must arrive in order */
+	if (item->seq != d->order[item->thread]++)
+		d->errors++;
+	d->count++;
+	return 0;
+}
+
+static void *mp_thread(void *arg)
+{
+	struct mp_data *d = arg;
+	static int thread_id = 0;
+	struct mp_item item;
+	int i;
+
+	item.thread = __atomic_fetch_add(&thread_id, 1, __ATOMIC_SEQ_CST);
+	for (i = 0; i < MP_INVOKES; i++) {
+		item.seq = i;
+		pw_loop_invoke(d->l, mp_invoke, 0, &item, sizeof(item),
+				i == MP_INVOKES - 1, d);
+	}
+	return NULL;
+}
+
+PWTEST(multi_producer_invoke)
+{
+	struct pw_properties *props;
+	struct mp_data data;
+	pthread_t threads[MP_THREADS];
+	int i;
+
+	pw_init(NULL, NULL);
+
+	if ((props = loop_props(current_test)) == NULL)
+		return PWTEST_SKIP;
+
+	spa_zero(data);
+
+	struct pw_data_loop *dl = pw_data_loop_new(&props->dict);
+	pwtest_ptr_notnull(dl);
+
+	data.l = pw_data_loop_get_loop(dl);
+	pwtest_ptr_notnull(data.l);
+
+	pwtest_neg_errno_ok(pw_data_loop_start(dl));
+
+	/* many non-blocking invokes from many threads share wakeups, make
+	 * sure none of them gets lost */
+	for (i = 0; i < MP_THREADS; i++)
+		pthread_create(&threads[i], NULL, mp_thread, &data);
+	for (i = 0; i < MP_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	pwtest_int_eq(data.count, MP_THREADS * MP_INVOKES);
+	pwtest_int_eq(data.errors, 0);
+
+	pwtest_neg_errno_ok(pw_data_loop_stop(dl));
+	pw_data_loop_destroy(dl);
+	pw_properties_free(props);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
+PWTEST(loop_system_fallback)
+{
+	static const struct spa_dict_item items[] = {
+		{ PW_KEY_LOOP_SYSTEM, "does-not-exist" },
+	};
+	static const struct spa_dict props = SPA_DICT_INIT_ARRAY(items);
+	struct pw_loop *l;
+	int fd;
+
+	pw_init(NULL, NULL);
+
+	/* a System that can't be made uses epoll */
+	l = pw_loop_new(&props);
+	pwtest_ptr_notnull(l);
+
+	fd = spa_system_eventfd_create(l->system, SPA_FD_CLOEXEC);
+	pwtest_errno_ok(fd);
+	spa_system_close(l->system, fd);
+
+	pw_loop_destroy(l);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
+#define LOOP_SYSTEM(s)	PWTEST_ARG_PROP, PW_KEY_LOOP_SYSTEM, s
+
 PWTEST_SUITE(support)
 {
-	pwtest_add(pwtest_loop_destroy2, PWTEST_NOARG);
-	pwtest_add(pwtest_loop_recurse1, PWTEST_NOARG);
-	pwtest_add(pwtest_loop_recurse2, PWTEST_NOARG);
-	pwtest_add(destroy_managed_source_before_dispatch, PWTEST_NOARG);
-	pwtest_add(destroy_managed_source_before_dispatch_recurse, PWTEST_NOARG);
-	pwtest_add(cancel_thread_while_dispatching, PWTEST_NOARG);
+	static const char * const systems[] = { "epoll", "io-uring" };
+	size_t i;
+
+	/* run all tests with each System of the loop */
+	for (i = 0; i < SPA_N_ELEMENTS(systems); i++) {
+		pwtest_add(pwtest_loop_destroy2, LOOP_SYSTEM(systems[i]));
+		pwtest_add(pwtest_loop_recurse1, LOOP_SYSTEM(systems[i]));
+		pwtest_add(pwtest_loop_recurse2, LOOP_SYSTEM(systems[i]));
+		pwtest_add(destroy_managed_source_before_dispatch, LOOP_SYSTEM(systems[i]));
+		pwtest_add(destroy_managed_source_before_dispatch_recurse, LOOP_SYSTEM(systems[i]));
+		pwtest_add(cancel_thread_while_dispatching, LOOP_SYSTEM(systems[i]));
+		pwtest_add(multi_producer_invoke, LOOP_SYSTEM(systems[i]));
+	}
+	pwtest_add(loop_system_fallback, PWTEST_NOARG);
 
 	return PWTEST_PASS;
 }
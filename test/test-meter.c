@@ -0,0 +1,213 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "pwtest.h"
+
+#include <unistd.h>
+
+#include <spa/utils/atomic.h>
+#include <spa/node/node.h>
+#include <spa/node/io.h>
+#include <spa/node/utils.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/impl.h>
+
+struct test_node {
+	struct spa_node node;
+	struct spa_hook_list hooks;
+	struct spa_io_meter *meter;
+	struct pw_impl_node *impl;
+};
+
+struct data {
+	struct pw_main_loop *loop;
+	struct pw_impl_metadata *metadata;
+	struct spa_hook metadata_listener;
+	uint32_t subject;
+	char value[256];
+	uint32_t n_changes;
+};
+
+static int node_add_listener(void *object, struct spa_hook *listener,
+		const struct spa_node_events *events, void *data)
+{
+	struct test_node *d = object;
+	struct spa_hook_list save;
+	struct spa_node_info info = SPA_NODE_INFO_INIT();
+
+	spa_hook_list_isolate(&d->hooks, &save, listener, events, data);
+	info.change_mask = SPA_NODE_CHANGE_MASK_FLAGS;
+	info.flags = SPA_NODE_FLAG_RT;
+	spa_node_emit_info(&d->hooks, &info);
+	spa_hook_list_join(&d->hooks, &save);
+	return 0;
+}
+
+static int node_set_io(void *object, uint32_t id, void *data, size_t size)
+{
+	struct test_node *d = object;
+
+	switch (id) {
+	case SPA_IO_Meter:
+		d->meter = data;
+		break;
+	case SPA_IO_Clock:
+	case SPA_IO_Position:
+		break;
+	default:
+		return -ENOENT;
+	}
+	return 0;
+}
+
+static const struct spa_node_methods node_methods = {
+	SPA_VERSION_NODE_METHODS,
+	.add_listener = node_add_listener,
+	.set_io = node_set_io,
+};
+
+static void write_meter(struct test_node *d, float momentary, float short_term, float true_peak)
+{
+	SPA_SEQ_WRITE(d->meter->seq);
+	d->meter->momentary = momentary;
+	d->meter->short_term = short_term;
+	d->meter->true_peak = true_peak;
+	SPA_SEQ_WRITE(d->meter->seq);
+}
+
+static int metadata_property(void *data, uint32_t subject, const char *key,
+		const char *type, const char *value)
+{
+	struct data *d = data;
+
+	if (subject != d->subject)
+		return 0;
+	if (key == NULL || value == NULL)
+		d->value[0] = '\0';
+	else
+		snprintf(d->value, sizeof(d->value), "%s", value);
+	d->n_changes++;
+	return 0;
+}
+
+static const struct pw_impl_metadata_events metadata_events = {
+	PW_VERSION_IMPL_METADATA_EVENTS,
+	.property = metadata_property,
+};
+
+static int find_metadata(void *data, struct pw_global *global)
+{
+	struct data *d = data;
+	const struct pw_properties *props;
+
+	if (!pw_global_is_type(global, PW_TYPE_INTERFACE_Metadata))
+		return 0;
+	props = pw_global_get_properties(global);
+	if (!spa_streq(pw_properties_get(props, PW_KEY_METADATA_NAME), "meter"))
+		return 0;
+	d->metadata = pw_global_get_object(global);
+	return 1;
+}
+
+/* iterate until there are n_changes of the meter property */
+static bool wait_changes(struct data *d, uint32_t n_changes)
+{
+	int timeout;
+
+	for (timeout = 2000; timeout > 0; timeout--) {
+		if (d->n_changes >= n_changes)
+			return true;
+		pw_loop_iterate(pw_main_loop_get_loop(d->loop), 1);
+	}
+	return false;
+}
+
+PWTEST(meter_metadata)
+{
+	struct pw_context *context;
+	struct test_node node;
+	struct data data;
+	uint32_t n;
+
+	pw_init(0, NULL);
+
+	spa_zero(data);
+	data.loop = pw_main_loop_new(NULL);
+	context = pw_context_new(pw_main_loop_get_loop(data.loop),
+			pw_properties_new(PW_KEY_CONFIG_NAME, "null", NULL), 0);
+	pwtest_ptr_notnull(context);
+
+	pwtest_ptr_notnull(pw_context_load_module(context, "libpipewire-module-meter",
+				"{ meter.interval.ms = 10 }", NULL));
+	pw_context_for_each_global(context, find_metadata, &data);
+	pwtest_ptr_notnull(data.metadata);
+	pw_impl_metadata_add_listener(data.metadata, &data.metadata_listener,
+			&metadata_events, &data);
+
+	spa_zero(node);
+	node.node.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_Node,
+			SPA_VERSION_NODE, &node_methods, &node);
+	spa_hook_list_init(&node.hooks);
+	node.impl = pw_context_create_node(context,
+			pw_properties_new(PW_KEY_NODE_NAME, "metered", NULL), 0);
+	pwtest_ptr_notnull(node.impl);
+	pwtest_neg_errno_ok(pw_impl_node_set_implementation(node.impl, &node.node));
+	pwtest_neg_errno_ok(pw_impl_node_register(node.impl, NULL));
+	data.subject = pw_global_get_id(pw_impl_node_get_global(node.impl));
+
+	/* the node got the meter area in its activation */
+	pwtest_ptr_notnull(node.meter);
+
+	/* a node that does not write the meter is not published */
+	pw_loop_iterate(pw_main_loop_get_loop(data.loop), 50);
+	pwtest_int_eq(data.n_changes, 0u);
+
+	write_meter(&node, -23.0f, -22.5f, -1.0f);
+	pwtest_bool_true(wait_changes(&data, 1));
+	pwtest_str_eq(data.value,
+			"{ \"momentary\": -23.000000, \"short-term\": -22.500000, \"true-peak\": -1.000000 }");
+
+	/* the same results are not published again */
+	n = data.n_changes;
+	usleep(50 * 1000);
+	pw_loop_iterate(pw_main_loop_get_loop(data.loop), 0);
+	pwtest_int_eq(data.n_changes, n);
+
+	write_meter(&node, -20.0f, -21.0f, -3.0f);
+	pwtest_bool_true(wait_changes(&data, n + 1));
+	pwtest_str_eq(data.value,
+			"{ \"momentary\": -20.000000, \"short-term\": -21.000000, \"true-peak\": -3.000000 }");
+
+	/* results that are not updated are removed */
+	n = data.n_changes;
+	pwtest_bool_true(wait_changes(&data, n + 1));
+	pwtest_str_eq(data.value, "");
+
+	/* and published again on the next update */
+	write_meter(&node, -18.0f, -19.0f, -2.0f);
+	pwtest_bool_true(wait_changes(&data, n + 2));
+	pwtest_str_eq(data.value,
+			"{ \"momentary\": -18.000000, \"short-term\": -19.000000, \"true-peak\": -2.000000 }");
+
+	/* the results of removed nodes are removed */
+	pw_impl_node_destroy(node.impl);
+	pwtest_bool_true(wait_changes(&data, n + 3));
+	pwtest_str_eq(data.value, "");
+
+	spa_hook_remove(&data.metadata_listener);
+	pw_context_destroy(context);
+	pw_main_loop_destroy(data.loop);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
+PWTEST_SUITE(meter)
+{
+	pwtest_add(meter_metadata, PWTEST_NOARG);
+
+	return PWTEST_PASS;
+}
@@ -0,0 +1,508 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2025 Wim Taymans */
+/* SPDX-License-Identifier: MIT */
+
+#include "pwtest.h"
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <spa/node/node.h>
+#include <spa/node/utils.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/impl.h>
+
+#include "pipewire/private.h"
+
+#define N_NODES		8
+#define CYCLES		100
+
+struct graph;
+
+struct test_node {
+	struct spa_node node;
+	struct spa_hook_list hooks;
+	struct spa_callbacks callbacks;
+	struct graph *graph;
+	struct pw_impl_node *impl;
+	bool driver;
+
+	uint32_t count;
+	uint32_t spin_count;
+
+	int busy;
+	uint32_t overlaps;
+	int hold;
+};
+
+struct graph {
+	struct pw_main_loop *loop;
+	struct pw_context *context;
+	int done_fd;
+	struct test_node driver;
+	struct test_node nodes[N_NODES];
+	struct pw_node_peer *peers[N_NODES];
+
+	struct pw_loop *hook_loop;
+	struct spa_hook hook;
+	uint32_t wakeups;
+};
+
+static int node_add_listener(void *object, struct spa_hook *listener,
+		const struct spa_node_events *events, void *data)
+{
+	struct test_node *d = object;
+	struct spa_hook_list save;
+	struct spa_node_info info = SPA_NODE_INFO_INIT();
+
+	spa_hook_list_isolate(&d->hooks, &save, listener, events, data);
+	info.change_mask = SPA_NODE_CHANGE_MASK_FLAGS;
+	info.flags = SPA_NODE_FLAG_RT;
+	spa_node_emit_info(&d->hooks, &info);
+	spa_hook_list_join(&d->hooks, &save);
+	return 0;
+}
+
+static int node_set_callbacks(void *object, const struct spa_node_callbacks *callbacks,
+		void *data)
+{
+	struct test_node *d = object;
+	d->callbacks = SPA_CALLBACKS_INIT(callbacks, data);
+	return 0;
+}
+
+static int node_set_io(void *object, uint32_t id, void *data, size_t size)
+{
+	return 0;
+}
+
+static int node_send_command(void *object, const struct spa_command *command)
+{
+	return 0;
+}
+
+static int node_process(void *object)
+{
+	struct test_node *d = object;
+	struct pw_node_activation *a = d->impl->rt.target.activation;
+
+	/* a node is never processed by two threads at once */
+	if (SPA_ATOMIC_INC(d->busy) > 1)
+		SPA_ATOMIC_INC(d->overlaps);
+
+	/* the data loop is awake, the peers don't need the eventfd */
+	if (SPA_ATOMIC_LOAD(a->wakeup) == PW_NODE_ACTIVATION_WAKEUP_SPIN)
+		d->spin_count++;
+	SPA_ATOMIC_INC(d->count);
+
+	/* the last node of the chain completed the graph */
+	if (d->driver)
+		eventfd_write(d->graph->done_fd, 1);
+
+	/* keep the data loop busy until the test lets go */
+	if (SPA_ATOMIC_LOAD(d->hold)) {
+		eventfd_write(d->graph->done_fd, 1);
+		while (SPA_ATOMIC_LOAD(d->hold))
+			usleep(100);
+	}
+	SPA_ATOMIC_DEC(d->busy);
+	return SPA_STATUS_HAVE_DATA;
+}
+
+static const struct spa_node_methods node_methods = {
+	SPA_VERSION_NODE_METHODS,
+	.add_listener = node_add_listener,
+	.set_callbacks = node_set_callbacks,
+	.set_io = node_set_io,
+	.send_command = node_send_command,
+	.process = node_process,
+};
+
+static void loop_before(void *data)
+{
+}
+
+static void loop_after(void *data)
+{
+	struct graph *g = data;
+	g->wakeups++;
+}
+
+static const struct spa_loop_control_hooks loop_hooks = {
+	SPA_VERSION_LOOP_CONTROL_HOOKS,
+	.before = loop_before,
+	.after = loop_after,
+};
+
+static int do_add_hook(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct graph *g = user_data;
+	pw_loop_add_hook(g->hook_loop, &g->hook, &loop_hooks, g);
+	return 0;
+}
+
+static int do_remove_hook(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct graph *g = user_data;
+	spa_hook_remove(&g->hook);
+	return 0;
+}
+
+static int do_start(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct test_node *d = user_data;
+	spa_node_call_ready(&d->callbacks, SPA_STATUS_HAVE_DATA);
+	return 0;
+}
+
+static void make_node(struct graph *g, struct test_node *d, const char *name,
+		const char *loop_name, bool driver, uint32_t server_version)
+{
+	struct pw_properties *props;
+
+	spa_zero(*d);
+	d->graph = g;
+	d->driver = driver;
+	d->node.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_Node,
+			SPA_VERSION_NODE, &node_methods, d);
+	spa_hook_list_init(&d->hooks);
+
+	props = pw_properties_new(
+			PW_KEY_NODE_NAME, name,
+			PW_KEY_NODE_LOOP_NAME, loop_name,
+			NULL);
+	if (driver) {
+		pw_properties_set(props, PW_KEY_NODE_DRIVER, "true");
+		pw_properties_set(props, PW_KEY_PRIORITY_DRIVER, "1");
+	} else
+		pw_properties_set(props, PW_KEY_NODE_ALWAYS_PROCESS, "true");
+
+	d->impl = pw_context_create_node(g->context, props, 0);
+	pwtest_ptr_notnull(d->impl);
+
+	/* like an exported node with the activation of an older server */
+	d->impl->rt.target.activation->server_version = server_version;
+
+	pwtest_neg_errno_ok(pw_impl_node_set_implementation(d->impl, &d->node));
+	pwtest_neg_errno_ok(pw_impl_node_register(d->impl, NULL));
+	pwtest_neg_errno_ok(pw_impl_node_set_active(d->impl, true));
+}
+
+static bool nodes_running(struct graph *g)
+{
+	uint32_t i;
+
+	if (g->driver.impl->info.state != PW_NODE_STATE_RUNNING)
+		return false;
+	for (i = 0; i < N_NODES; i++)
+		if (g->nodes[i].impl->info.state != PW_NODE_STATE_RUNNING)
+			return false;
+	return true;
+}
+
+/* a driver and a chain of nodes where every node is triggered by the
+ * previous one, the wakeups of the data loop of the chain are counted */
+static void graph_init(struct graph *g, bool shared, const char *loop_name,
+		uint32_t server_version, uint32_t spin)
+{
+	char name[64], spin_str[16];
+	uint32_t i, c;
+
+	spa_zero(*g);
+	g->loop = pw_main_loop_new(NULL);
+	spa_scnprintf(spin_str, sizeof(spin_str), "%u", spin);
+	g->context = pw_context_new(pw_main_loop_get_loop(g->loop),
+			pw_properties_new(
+				PW_KEY_CONFIG_NAME, "null",
+				"context.num-data-loops", "2",
+				"node.shared-wakeup", shared ? "true" : "false",
+				"node.wakeup-spin-usec", spin_str,
+				NULL),
+			0);
+	pwtest_ptr_notnull(g->context);
+
+	g->done_fd = eventfd(0, EFD_CLOEXEC);
+	pwtest_errno_ok(g->done_fd);
+
+	make_node(g, &g->driver, "driver", "data-loop.0", true, server_version);
+	for (i = 0; i < N_NODES; i++) {
+		snprintf(name, sizeof(name), "node.%u", i);
+		make_node(g, &g->nodes[i], name, loop_name, false, server_version);
+	}
+	for (i = 0; i + 1 < N_NODES; i++)
+		g->peers[i] = pw_node_peer_ref(g->nodes[i].impl, g->nodes[i + 1].impl);
+
+	for (c = 0; c < 1000 && !nodes_running(g); c++) {
+		pw_loop_iterate(pw_main_loop_get_loop(g->loop), 0);
+		usleep(1000);
+	}
+	pwtest_bool_true(nodes_running(g));
+
+	g->hook_loop = g->nodes[0].impl->rt.pooled ?
+		g->driver.impl->data_loop : g->nodes[0].impl->data_loop;
+	pw_loop_locked(g->hook_loop, do_add_hook, 0, NULL, 0, g);
+}
+
+static void graph_run(struct graph *g)
+{
+	uint64_t val;
+	uint32_t i, c;
+
+	/* the nodes might have run before the chain was complete */
+	g->driver.count = g->wakeups = 0;
+	for (i = 0; i < N_NODES; i++)
+		g->nodes[i].count = g->nodes[i].spin_count = 0;
+
+	for (c = 0; c < CYCLES; c++) {
+		pw_loop_invoke(g->driver.impl->data_loop, do_start, 0, NULL, 0, false, &g->driver);
+		pwtest_errno_ok(eventfd_read(g->done_fd, &val));
+	}
+	pwtest_int_eq(g->driver.count, (uint32_t)CYCLES);
+	for (i = 0; i < N_NODES; i++)
+		pwtest_int_eq(g->nodes[i].count, (uint32_t)CYCLES);
+}
+
+/* the data loop might still be awake after the graph completed */
+static bool wait_wakeup_eventfd(struct test_node *d)
+{
+	struct pw_node_activation *a = d->impl->rt.target.activation;
+	uint32_t c;
+
+	for (c = 0; c < 1000; c++) {
+		if (SPA_ATOMIC_LOAD(a->wakeup) == PW_NODE_ACTIVATION_WAKEUP_EVENTFD)
+			return true;
+		usleep(1000);
+	}
+	return false;
+}
+
+static void graph_clear(struct graph *g)
+{
+	uint32_t i;
+
+	pw_loop_locked(g->hook_loop, do_remove_hook, 0, NULL, 0, g);
+	for (i = 0; i + 1 < N_NODES; i++)
+		pw_node_peer_unref(g->peers[i]);
+	for (i = 0; i < N_NODES; i++)
+		pw_impl_node_destroy(g->nodes[i].impl);
+	pw_impl_node_destroy(g->driver.impl);
+	close(g->done_fd);
+	pw_context_destroy(g->context);
+	pw_main_loop_destroy(g->loop);
+}
+
+PWTEST(node_wakeup_shared)
+{
+	struct graph g;
+	uint32_t i, eventfd_wakeups;
+
+	pw_init(0, NULL);
+
+	/* every node of the chain wakes up the data loop */
+	graph_init(&g, false, "data-loop.0", PW_VERSION_NODE_ACTIVATION, 0);
+	for (i = 0; i < N_NODES; i++)
+		pwtest_ptr_null(g.nodes[i].impl->waiter);
+	graph_run(&g);
+	for (i = 0; i < N_NODES; i++)
+		pwtest_int_eq(g.nodes[i].spin_count, 0u);
+	eventfd_wakeups = g.wakeups;
+	pwtest_int_ge(eventfd_wakeups, (uint32_t)(CYCLES * N_NODES));
+	graph_clear(&g);
+
+	/* the nodes are processed without eventfd while the loop is awake */
+	graph_init(&g, true, "data-loop.0", PW_VERSION_NODE_ACTIVATION, 0);
+	for (i = 0; i < N_NODES; i++)
+		pwtest_ptr_notnull(g.nodes[i].impl->waiter);
+	graph_run(&g);
+	for (i = 0; i < N_NODES; i++)
+		pwtest_int_eq(g.nodes[i].spin_count, (uint32_t)CYCLES);
+	pwtest_int_lt(g.wakeups, eventfd_wakeups / 4);
+
+	/* the sleeping loop needs the eventfd again */
+	for (i = 0; i < N_NODES; i++)
+		pwtest_bool_true(wait_wakeup_eventfd(&g.nodes[i]));
+
+	/* and the nodes that leave the loop too */
+	pw_impl_node_set_active(g.nodes[0].impl, false);
+	pwtest_int_eq(SPA_ATOMIC_LOAD(g.nodes[0].impl->rt.target.activation->wakeup),
+			(uint32_t)PW_NODE_ACTIVATION_WAKEUP_EVENTFD);
+	graph_clear(&g);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
+PWTEST(node_wakeup_old_server)
+{
+	struct graph g;
+	uint32_t i;
+
+	pw_init(0, NULL);
+
+	/* a server that does not know the wakeup word always writes the
+	 * eventfd, the nodes don't announce that they are awake */
+	graph_init(&g, true, "data-loop.0", 1, 0);
+	graph_run(&g);
+	for (i = 0; i < N_NODES; i++)
+		pwtest_int_eq(g.nodes[i].spin_count, 0u);
+	pwtest_int_ge(g.wakeups, (uint32_t)(CYCLES * N_NODES));
+	graph_clear(&g);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
+PWTEST(node_wakeup_spin)
+{
+	struct graph g;
+	uint32_t i, eventfd_wakeups;
+
+	pw_init(0, NULL);
+
+	/* the driver on the other data loop wakes up the chain every cycle */
+	graph_init(&g, true, "data-loop.1", PW_VERSION_NODE_ACTIVATION, 0);
+	graph_run(&g);
+	eventfd_wakeups = g.wakeups;
+	pwtest_int_ge(eventfd_wakeups, (uint32_t)CYCLES);
+	graph_clear(&g);
+
+	/* the idle data loop polls its nodes and sees the next cycle without
+	 * the eventfd */
+	graph_init(&g, true, "data-loop.1", PW_VERSION_NODE_ACTIVATION, 100000);
+	graph_run(&g);
+	pwtest_int_lt(g.wakeups, eventfd_wakeups / 4);
+
+	/* the poll is bounded, the loop goes to sleep afterwards */
+	for (i = 0; i < N_NODES; i++)
+		pwtest_bool_true(wait_wakeup_eventfd(&g.nodes[i]));
+	graph_clear(&g);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
+PWTEST(node_wakeup_loop_pool)
+{
+	struct graph g;
+	uint32_t i;
+
+	pw_init(0, NULL);
+
+	/* the nodes of the loop pool are processed by any data loop and
+	 * always use the eventfd */
+	graph_init(&g, true, "data-pool", PW_VERSION_NODE_ACTIVATION, 0);
+	for (i = 0; i < N_NODES; i++)
+		pwtest_ptr_null(g.nodes[i].impl->waiter);
+	graph_run(&g);
+	for (i = 0; i < N_NODES; i++)
+		pwtest_int_eq(g.nodes[i].spin_count, 0u);
+	graph_clear(&g);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
+/* like the driver, make the node ready to be triggered */
+static void node_trigger(struct test_node *d)
+{
+	struct pw_node_target *t = &d->impl->rt.target;
+
+	pw_node_activation_state_reset(&t->activation->state[0]);
+	pwtest_int_eq(t->trigger(t, 0), 1);
+}
+
+static bool wait_count(struct test_node *d, uint32_t count)
+{
+	uint32_t c;
+
+	for (c = 0; c < 1000; c++) {
+		if (SPA_ATOMIC_LOAD(d->count) == count &&
+		    SPA_ATOMIC_LOAD(d->impl->rt.processing) == 0)
+			return true;
+		usleep(1000);
+	}
+	return false;
+}
+
+PWTEST(node_wakeup_loop_pool_xrun)
+{
+	struct graph g;
+	struct test_node *d = &g.nodes[0];
+	struct pw_node_activation *a;
+	uint64_t val;
+	uint32_t c;
+
+	pw_init(0, NULL);
+
+	spa_zero(g);
+	g.loop = pw_main_loop_new(NULL);
+	g.context = pw_context_new(pw_main_loop_get_loop(g.loop),
+			pw_properties_new(
+				PW_KEY_CONFIG_NAME, "null",
+				"context.num-data-loops", "2",
+				NULL),
+			0);
+	pwtest_ptr_notnull(g.context);
+	g.done_fd = eventfd(0, EFD_CLOEXEC);
+	pwtest_errno_ok(g.done_fd);
+
+	make_node(&g, &g.driver, "driver", "data-loop.0", true, PW_VERSION_NODE_ACTIVATION);
+	make_node(&g, d, "node.0", "data-pool", false, PW_VERSION_NODE_ACTIVATION);
+	for (c = 0; c < 1000 && d->impl->info.state != PW_NODE_STATE_RUNNING; c++) {
+		pw_loop_iterate(pw_main_loop_get_loop(g.loop), 0);
+		usleep(1000);
+	}
+	pwtest_int_eq(d->impl->info.state, PW_NODE_STATE_RUNNING);
+	pwtest_bool_true(d->impl->rt.pooled);
+	a = d->impl->rt.target.activation;
+
+	/* one data loop is processing the node */
+	SPA_ATOMIC_STORE(d->count, 0);
+	SPA_ATOMIC_STORE(d->hold, 1);
+	SPA_ATOMIC_STORE(a->status, PW_NODE_ACTIVATION_NOT_TRIGGERED);
+	node_trigger(d);
+	pwtest_errno_ok(eventfd_read(g.done_fd, &val));
+
+	/* after an xrun, the driver resets the node that is still being
+	 * processed and triggers it again, which wakes up the other data loop */
+	pwtest_bool_true(SPA_ATOMIC_CAS(a->status,
+				PW_NODE_ACTIVATION_AWAKE,
+				PW_NODE_ACTIVATION_NOT_TRIGGERED));
+	node_trigger(d);
+	usleep(20000);
+	SPA_ATOMIC_STORE(d->hold, 0);
+
+	/* the node was processed again by the first loop when it was done */
+	pwtest_bool_true(wait_count(d, 2));
+	pwtest_int_eq(SPA_ATOMIC_LOAD(d->overlaps), 0u);
+	pwtest_int_eq(SPA_ATOMIC_LOAD(a->status), (uint32_t)PW_NODE_ACTIVATION_FINISHED);
+
+	pw_impl_node_destroy(d->impl);
+	pw_impl_node_destroy(g.driver.impl);
+	close(g.done_fd);
+	pw_context_destroy(g.context);
+	pw_main_loop_destroy(g.loop);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
+PWTEST_SUITE(node_wakeup)
+{
+	pwtest_add(node_wakeup_shared, PWTEST_NOARG);
+	pwtest_add(node_wakeup_old_server, PWTEST_NOARG);
+	pwtest_add(node_wakeup_spin, PWTEST_NOARG);
+	pwtest_add(node_wakeup_loop_pool, PWTEST_NOARG);
+	pwtest_add(node_wakeup_loop_pool_xrun, PWTEST_NOARG);
+
+	return PWTEST_PASS;
+}
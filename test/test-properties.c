@@ -7,6 +7,7 @@
 
 #include "pwtest.h"
 
+#include "pipewire/keys.h"
 #include "pipewire/properties.h"
 
 PWTEST(properties_abi)
@@ -584,6 +585,78 @@ PWTEST(properties_update)
 	return PWTEST_PASS;
 }
 
+static void check_large(struct pw_properties *props, uint32_t n_items, uint32_t removed)
+{
+	char key[64], value[64];
+	uint32_t i;
+
+	/* all the test keys and the node name */
+	pwtest_int_eq(props->dict.n_items, n_items + 1 - removed);
+	for (i = 0; i < n_items; i++) {
+		spa_scnprintf(key, sizeof(key), "test.key.%u", i);
+		spa_scnprintf(value, sizeof(value), "value %u", i);
+		if (i % 3 == 0 && i < removed * 3)
+			pwtest_ptr_null(pw_properties_get(props, key));
+		else
+			pwtest_str_eq(pw_properties_get(props, key), value);
+	}
+	pwtest_str_eq(pw_properties_get(props, PW_KEY_NODE_NAME), "large");
+	pwtest_ptr_null(pw_properties_get(props, "test.key.none"));
+}
+
+PWTEST(properties_large)
+{
+	struct pw_properties *props, *copy;
+	char key[64], value[64];
+	uint32_t i, n_items = 200, removed = 0;
+
+	props = pw_properties_new(PW_KEY_NODE_NAME, "large", NULL);
+	pwtest_ptr_notnull(props);
+
+	for (i = 0; i < n_items; i++) {
+		spa_scnprintf(key, sizeof(key), "test.key.%u", i);
+		pwtest_int_eq(pw_properties_setf(props, key, "value %u", i), 1);
+	}
+	check_large(props, n_items, 0);
+
+	/* remove some items, this moves items around */
+	for (i = 0; i < n_items; i += 3, removed++) {
+		spa_scnprintf(key, sizeof(key), "test.key.%u", i);
+		pwtest_int_eq(pw_properties_set(props, key, NULL), 1);
+	}
+	check_large(props, n_items, removed);
+
+	copy = pw_properties_copy(props);
+	pwtest_ptr_notnull(copy);
+	check_large(copy, n_items, removed);
+
+	/* sorting reorders the items behind our back */
+	spa_dict_qsort(&copy->dict);
+	check_large(copy, n_items, removed);
+	pwtest_int_eq(pw_properties_set(copy, "test.key.1", "changed"), 1);
+	pwtest_str_eq(pw_properties_get(copy, "test.key.1"), "changed");
+	pwtest_int_eq(pw_properties_set(copy, "test.key.1", "value 1"), 1);
+	pwtest_int_eq(pw_properties_set(copy, "test.key.new", "new"), 1);
+	pwtest_int_eq(pw_properties_set(copy, "test.key.new", NULL), 1);
+	check_large(copy, n_items, removed);
+
+	/* values from the copy arena can be replaced and removed */
+	for (i = 1; i < n_items; i += 3) {
+		spa_scnprintf(key, sizeof(key), "test.key.%u", i);
+		spa_scnprintf(value, sizeof(value), "other %u", i);
+		pwtest_int_eq(pw_properties_set(copy, key, value), 1);
+		pwtest_str_eq(pw_properties_get(copy, key), value);
+	}
+	pw_properties_clear(copy);
+	pwtest_int_eq(copy->dict.n_items, 0U);
+	pwtest_ptr_null(pw_properties_get(copy, "test.key.1"));
+
+	pw_properties_free(copy);
+	pw_properties_free(props);
+
+	return PWTEST_PASS;
+}
+
 PWTEST_SUITE(properties)
 {
 	pwtest_add(properties_abi, PWTEST_NOARG);
@@ -603,6 +676,7 @@ PWTEST_SUITE(properties)
 	pwtest_add(properties_new_dict, PWTEST_NOARG);
 	pwtest_add(properties_new_json, PWTEST_NOARG);
 	pwtest_add(properties_update, PWTEST_NOARG);
+	pwtest_add(properties_large, PWTEST_NOARG);
 
 	return PWTEST_PASS;
 }